@@ -38,6 +38,7 @@ dependencies {
     implementation(libs.material)
     implementation(libs.activity)
     implementation(libs.constraintlayout)
+    implementation(project(":csicore"))
 
     // NEW: Dependency for the Android 12+ Splash Screen API
     // This resolves the 'Theme.SplashScreen not found' and related errors
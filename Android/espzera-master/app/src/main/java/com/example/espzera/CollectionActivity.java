@@ -12,6 +12,7 @@ import android.os.Looper;
 import android.util.Log;
 import android.view.View;
 import android.widget.Button;
+import android.widget.CheckBox;
 import android.widget.ProgressBar;
 import android.widget.ScrollView;
 import android.widget.TextView;
@@ -19,31 +20,32 @@ import android.widget.Toast;
 import androidx.activity.result.ActivityResultLauncher;
 import androidx.activity.result.contract.ActivityResultContracts;
 import androidx.appcompat.app.AppCompatActivity;
+import com.example.espzera.capture.CaptureWriter;
+import com.example.espzera.capture.CsiLineParser;
 import com.google.android.material.textfield.TextInputEditText;
 import java.io.File;
 import java.io.FileInputStream;
-import java.io.FileOutputStream;
 import java.io.InputStream;
 import java.io.OutputStream;
+import java.math.BigInteger;
 import java.net.DatagramPacket;
 import java.net.DatagramSocket;
 import java.net.InetAddress;
 import java.net.SocketTimeoutException;
-import java.text.SimpleDateFormat;
-import java.util.ArrayList;
-import java.util.Arrays;
-import java.util.Date;
-import java.util.List;
-import java.util.Locale;
 import java.util.concurrent.ExecutorService;
 import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
 import java.util.concurrent.atomic.AtomicBoolean;
 
 public class CollectionActivity extends AppCompatActivity {
 
     private static final String TAG = "CollectionActivity";
 
+    private static final int CAPTURE_MAX_PAIRS = 128; // CSI_CAPTURE_MAX_PAIRS on the node
+
     private TextInputEditText espIpInput, collectionTimeInput, cenarioInput;
+    private TextInputEditText scMaskInput, decimationInput, rateInput;
+    private CheckBox amplitudeCheckbox;
     private Button discoverButton, selectDbButton, startButton, stopButton;
     private ProgressBar discoveryProgress;
     private TextView consoleOutput, selectedDbPath;
@@ -55,7 +57,10 @@ public class CollectionActivity extends AppCompatActivity {
     private DatagramSocket listenSocket;
     private final AtomicBoolean isCollecting = new AtomicBoolean(false);
     private final AtomicBoolean firstPacketReceived = new AtomicBoolean(false);
-    private final List<String> csiDataBuffer = new ArrayList<>();
+    // The acquisition in progress: frames go from the listener through the writer into the store.
+    private volatile CsiCaptureStore captureStore;
+    private volatile CaptureWriter captureWriter;
+    private Future<?> listenerTask;
     private CountDownTimer collectionTimer;
 
     @Override
@@ -92,6 +97,10 @@ public class CollectionActivity extends AppCompatActivity {
         espIpInput = findViewById(R.id.esp_ip_input);
         collectionTimeInput = findViewById(R.id.collection_time_input);
         cenarioInput = findViewById(R.id.cenario_input);
+        scMaskInput = findViewById(R.id.sc_mask_input);
+        decimationInput = findViewById(R.id.decimation_input);
+        rateInput = findViewById(R.id.rate_input);
+        amplitudeCheckbox = findViewById(R.id.amplitude_checkbox);
         discoverButton = findViewById(R.id.discover_button);
         selectDbButton = findViewById(R.id.select_db_button);
         startButton = findViewById(R.id.start_button);
@@ -153,22 +162,44 @@ public class CollectionActivity extends AppCompatActivity {
         }
 
         int collectionTime = Integer.parseInt(timeStr);
+        final String startMessage;
+        try {
+            startMessage = buildStartCommand(collectionTime,
+                    scMaskInput.getText().toString().trim(),
+                    decimationInput.getText().toString().trim(),
+                    rateInput.getText().toString().trim(),
+                    amplitudeCheckbox.isChecked());
+        } catch (IllegalArgumentException e) {
+            Toast.makeText(this, e.getMessage(), Toast.LENGTH_LONG).show();
+            return;
+        }
+
+        try {
+            captureStore = new CsiCaptureStore(
+                    new File(getNoBackupFilesDir(), "capture_" + System.currentTimeMillis() + ".db"), cenario);
+        } catch (Exception e) {
+            Log.e(TAG, "Error creating capture database", e);
+            logToConsole("Error creating capture database: " + e.getMessage());
+            return;
+        }
+        CaptureWriter writer = new CaptureWriter(captureStore);
+        captureWriter = writer;
 
         setCollectionState(true);
         isCollecting.set(true);
         firstPacketReceived.set(false);
-        csiDataBuffer.clear();
 
         logToConsole("---------------------------------");
         logToConsole("Starting collection for " + collectionTime + " seconds...");
 
-        executor.execute(this::udpListenerThread); // Start UDP listener
-        executor.execute(() -> sendStartCommand(espIp, timeStr)); // Send start command
+        listenerTask = executor.submit(() -> udpListenerThread(writer)); // Start UDP listener
+        executor.execute(() -> sendStartCommand(espIp, startMessage)); // Send start command
 
         collectionTimer = new CountDownTimer(collectionTime * 1000L, 5000L) { // Tick every 5 seconds
             @Override
             public void onTick(long millisUntilFinished) {
-                logToConsole("... " + csiDataBuffer.size() + " packets in buffer ...");
+                logToConsole("... " + writer.written() + " packets saved, " + writer.pending()
+                        + " pending, " + writer.dropped() + " dropped ...");
             }
             @Override
             public void onFinish() {
@@ -178,16 +209,69 @@ public class CollectionActivity extends AppCompatActivity {
         }.start();
     }
 
-    private void sendStartCommand(String espIp, String time) {
+    /**
+     * Builds the ESP32 start command with its capture options (see csi_capture.h in the firmware):
+     * {@code start,<seconds>[,sc=<hex>][,dec=N][,rate=Hz][,mode=amp]}. Empty or default options are
+     * left out, so the defaults produce the legacy {@code start,<seconds>}.
+     */
+    static String buildStartCommand(int seconds, String scMask, String decimation, String rate, boolean amplitude) {
+        if (seconds <= 0) {
+            throw new IllegalArgumentException("Collection time must be positive.");
+        }
+        StringBuilder command = new StringBuilder("start,").append(seconds);
+        if (!scMask.isEmpty()) {
+            BigInteger mask;
+            try {
+                mask = new BigInteger(scMask, 16);
+            } catch (NumberFormatException e) {
+                throw new IllegalArgumentException("Subcarrier mask must be hexadecimal.");
+            }
+            if (mask.signum() <= 0 || mask.bitLength() > CAPTURE_MAX_PAIRS) {
+                throw new IllegalArgumentException("Subcarrier mask must select 1 to " + CAPTURE_MAX_PAIRS + " pairs.");
+            }
+            command.append(",sc=").append(mask.toString(16));
+        }
+        int dec = parseOption(decimation, 1, "Decimation");
+        if (dec < 1) {
+            throw new IllegalArgumentException("Decimation must be at least 1.");
+        }
+        if (dec > 1) {
+            command.append(",dec=").append(dec);
+        }
+        int hz = parseOption(rate, 0, "Max rate");
+        if (hz > 0) {
+            command.append(",rate=").append(hz);
+        }
+        if (amplitude) {
+            command.append(",mode=amp");
+        }
+        return command.toString();
+    }
+
+    private static int parseOption(String value, int fallback, String name) {
+        if (value.isEmpty()) {
+            return fallback;
+        }
+        try {
+            int parsed = Integer.parseInt(value);
+            if (parsed >= 0 && parsed <= 0xFFFF) {
+                return parsed;
+            }
+        } catch (NumberFormatException ignored) {
+            // Reported below
+        }
+        throw new IllegalArgumentException(name + " must be between 0 and 65535.");
+    }
+
+    private void sendStartCommand(String espIp, String startMessage) {
         try (DatagramSocket commandSocket = new DatagramSocket()) {
             // Keep sending 'start' command until first CSI packet is received
             while (isCollecting.get() && !firstPacketReceived.get()) {
-                String startMessage = "start," + time;
                 byte[] buffer = startMessage.getBytes("UTF-8");
                 InetAddress espAddress = InetAddress.getByName(espIp);
                 DatagramPacket packet = new DatagramPacket(buffer, buffer.length, espAddress, 50000);
                 commandSocket.send(packet);
-                logToConsole("Sent 'start' command to " + espIp);
+                logToConsole("Sent '" + startMessage + "' to " + espIp);
                 Thread.sleep(200); // Small delay before resending
             }
         } catch (Exception e) {
@@ -196,26 +280,23 @@ public class CollectionActivity extends AppCompatActivity {
         }
     }
 
-    private void udpListenerThread() {
+    private void udpListenerThread(CaptureWriter writer) {
         try {
             listenSocket = new DatagramSocket(50001);
             logToConsole("Listening for CSI data on port 50001...");
-            byte[] buffer = new byte[2048]; // Buffer for incoming UDP packets
+            // One buffer and packet for the whole acquisition; the writer parses each datagram in place.
+            byte[] buffer = new byte[8192]; // Largest CSI_DATA line: 1024 values plus the header
+            DatagramPacket packet = new DatagramPacket(buffer, buffer.length);
             while (isCollecting.get()) {
-                DatagramPacket packet = new DatagramPacket(buffer, buffer.length);
+                packet.setLength(buffer.length);
                 listenSocket.receive(packet); // Blocks until a packet is received
-                String data = new String(packet.getData(), 0, packet.getLength()).trim();
+                int length = packet.getLength();
 
-                if (data.startsWith("CSI_DATA")) {
+                if (CsiLineParser.isCsiData(buffer, 0, length)) {
                     if (!firstPacketReceived.getAndSet(true)) {
                         logToConsole("First CSI packet received. Stopping 'start' command transmission.");
                     }
-                    // For debugging, you might want to only log the raw data if not too verbose
-                    // logToConsole(data); // This can flood the console, enable carefully
-
-                    synchronized (csiDataBuffer) {
-                        csiDataBuffer.add(data); // Add raw CSI string to buffer
-                    }
+                    writer.offer(buffer, 0, length, System.currentTimeMillis());
                 }
             }
         } catch (Exception e) {
@@ -255,92 +336,83 @@ public class CollectionActivity extends AppCompatActivity {
         mainHandler.post(() -> {
             setCollectionState(false); // Update UI buttons
             logToConsole("Collection stopped. Saving data...");
-            // Delay saving slightly to allow any last buffered packets to be processed or UI to update
-            new Handler(Looper.getMainLooper()).postDelayed(this::saveDataToSelectedFile, 500);
+            saveDataToSelectedFile();
         });
     }
 
+    /**
+     * Finishes the acquisition: the frames were written to the capture database while it ran, so
+     * this only writes the last batch, closes the database and copies it to the selected file.
+     */
     private void saveDataToSelectedFile() {
-        final List<String> dataToSave;
-        synchronized (csiDataBuffer) {
-            if (csiDataBuffer.isEmpty()) {
-                logToConsole("No data to save. Buffer is empty.");
-                return;
-            }
-            dataToSave = new ArrayList<>(csiDataBuffer); // Copy data to avoid ConcurrentModification
-            csiDataBuffer.clear(); // Clear main buffer
+        final CaptureWriter writer = captureWriter;
+        final CsiCaptureStore store = captureStore;
+        final Future<?> listener = listenerTask;
+        final Uri target = targetDbUri;
+        if (writer == null || store == null) {
+            return;
         }
-
-        logToConsole("Starting save for " + dataToSave.size() + " records...");
-        executor.execute(() -> {
-            File tempDbFile = new File(getCacheDir(), "temp_csi.db");
-            if(tempDbFile.exists()) tempDbFile.delete(); // Clean up old temp file
-
-            long successCount = 0;
-            try (android.database.sqlite.SQLiteDatabase tempDb = android.database.sqlite.SQLiteDatabase.openOrCreateDatabase(tempDbFile, null)) {
-                DatabaseHelper.createCsiDataTable(tempDb); // Ensure table exists
-                tempDb.beginTransaction(); // Start transaction for efficiency
-                try {
-                    String timestamp = new SimpleDateFormat("yyyy-MM-dd HH:mm:ss", Locale.getDefault()).format(new Date());
-                    String cenario = cenarioInput.getText().toString(); // Get scenario from input field
-
-                    // --- START OF CORRECTION (FROM ORIGINAL PROMPT) ---
-                    for (String line : dataToSave) {
-                        // The limit 25 ensures the first 24 fields are separated
-                        // and the 25th field (the data array) remains intact.
-                        String[] parts = line.trim().split(",", 25);
-
-                        // The 'parts' array will have 25 elements: CSI_DATA, seq, mac, ..., data array
-                        if (parts.length == 25) {
-                            // Remove "CSI_DATA" and pass the rest to the Helper
-                            String[] csiPayload = Arrays.copyOfRange(parts, 1, parts.length);
-                            if (DatabaseHelper.addCsiData(tempDb, timestamp, cenario, csiPayload) != -1) {
-                                successCount++;
-                            }
-                        } else {
-                            Log.w(TAG, "Discarding packet due to unexpected format. Parts count: " + parts.length + " Data: " + line); // Log warning
-                            logToConsole("Packet discarded, unexpected format. Parts: " + parts.length);
-                        }
-                    }
-                    // --- END OF CORRECTION ---
-
-                    tempDb.setTransactionSuccessful(); // Mark transaction as successful
-                } finally {
-                    tempDb.endTransaction(); // End transaction (commit or rollback)
+        captureWriter = null;
+        captureStore = null;
+        listenerTask = null;
+
+        Runnable save = () -> {
+            File captureFile = store.getFile();
+            try {
+                if (listener != null) {
+                    listener.get(); // The listener has returned once the socket is closed
                 }
+                writer.close();
+                store.close();
             } catch (Exception e) {
-                Log.e(TAG, "Error writing to temporary DB", e); // Log full stack trace
+                Log.e(TAG, "Error finishing capture database", e);
                 mainHandler.post(() -> logToConsole("Error preparing data for saving."));
+                store.delete();
                 return;
             }
 
-            // Copy the temporary database file to the user-selected URI
-            try (InputStream in = new FileInputStream(tempDbFile);
-                 OutputStream out = getContentResolver().openOutputStream(targetDbUri)) {
+            long written = writer.written();
+            String counts = written + " records saved, " + writer.malformed() + " malformed, "
+                    + writer.dropped() + " dropped";
+            if (writer.error() != null) {
+                Log.e(TAG, "Error writing capture database", writer.error());
+                mainHandler.post(() -> logToConsole("Error writing data: " + writer.error().getMessage()
+                        + " (" + writer.failed() + " records lost)"));
+            }
+            if (written == 0) {
+                mainHandler.post(() -> logToConsole("No data to save. " + counts + "."));
+                store.delete();
+                return;
+            }
+
+            // Copy the capture database to the user-selected URI
+            try (InputStream in = new FileInputStream(captureFile);
+                 OutputStream out = getContentResolver().openOutputStream(target)) {
                 if (out == null) {
                     throw new Exception("Could not open output stream for target URI.");
                 }
-                byte[] buf = new byte[4096];
+                byte[] buf = new byte[65536];
                 int len;
                 while ((len = in.read(buf)) > 0) {
                     out.write(buf, 0, len);
                 }
 
-                long finalCount = successCount; // Capture for use in inner class
                 mainHandler.post(() -> {
-                    logToConsole("Success! " + finalCount + " out of " + dataToSave.size() + " valid records saved.");
+                    logToConsole("Success! " + counts + ".");
                     Toast.makeText(this, ".db file saved successfully!", Toast.LENGTH_LONG).show();
                 });
             } catch (Exception e) {
                 Log.e(TAG, "Error copying DB to final file", e);
                 mainHandler.post(() -> logToConsole("Error saving final file: " + e.getMessage()));
             } finally {
-                // Ensure temporary file is deleted
-                if(tempDbFile.exists()) {
-                    tempDbFile.delete();
-                }
+                store.delete(); // Ensure the capture database is deleted
             }
-        });
+        };
+        if (executor.isShutdown()) {
+            new Thread(save, "csi-capture-save").start(); // Stopped by onDestroy: still save the data
+        } else {
+            executor.execute(save);
+        }
     }
 
     private void setCollectionState(boolean collecting) {
@@ -359,6 +431,10 @@ public class CollectionActivity extends AppCompatActivity {
         espIpInput.setEnabled(enabled);
         collectionTimeInput.setEnabled(enabled);
         cenarioInput.setEnabled(enabled);
+        scMaskInput.setEnabled(enabled);
+        decimationInput.setEnabled(enabled);
+        rateInput.setEnabled(enabled);
+        amplitudeCheckbox.setEnabled(enabled);
         selectDbButton.setEnabled(enabled);
 
         // Adjust start/stop button states based on overall state and file selection
@@ -0,0 +1,109 @@
+package com.example.espzera;
+
+import android.database.sqlite.SQLiteDatabase;
+import android.database.sqlite.SQLiteStatement;
+
+import com.example.espzera.capture.CaptureWriter;
+import com.example.espzera.capture.CsiRecord;
+
+import java.io.Closeable;
+import java.io.File;
+import java.text.SimpleDateFormat;
+import java.util.Date;
+import java.util.List;
+import java.util.Locale;
+
+/**
+ * The csi_data table of the acquisition in progress, filled batch by batch by a
+ * {@link CaptureWriter} while the capture runs. Rows are the ones {@link DatabaseHelper#addCsiData}
+ * wrote, except that data_hora is the receive time of each frame rather than the save time.
+ * Once closed, the file is the finished session database and only needs copying to its
+ * destination.
+ */
+final class CsiCaptureStore implements CaptureWriter.Sink, Closeable {
+
+    private static final String INSERT_SQL = "INSERT INTO " + DatabaseHelper.TABLE_CSI_DATA
+            + " (data_hora, cenario, type, seq, mac, rssi, rate, sig_mode, mcs, bandwidth, smoothing,"
+            + " not_sounding, aggregation, stbc, fec_coding, sgi, noise_floor, ampdu_cnt, channel,"
+            + " secondary_channel, local_timestamp, ant, sig_len, rx_state, len, first_word, data)"
+            + " VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)";
+    // Bind index of the first field after mac (rssi); rate is bound as REAL.
+    private static final int FIRST_FIELD = 6;
+    private static final int DATA = FIRST_FIELD + CsiRecord.FIELD_COUNT;
+
+    private final File file;
+    private final SQLiteDatabase db;
+    private final SQLiteStatement insert;
+    private final String cenario;
+    private final SimpleDateFormat dateFormat = new SimpleDateFormat("yyyy-MM-dd HH:mm:ss", Locale.getDefault());
+    private final StringBuilder text = new StringBuilder(CsiRecord.MAX_VALUES * 5);
+    private long dateSecond = Long.MIN_VALUE;
+    private String date;
+
+    /** Creates file afresh, removing what a previous capture may have left. */
+    CsiCaptureStore(File file, String cenario) {
+        this.file = file;
+        this.cenario = cenario;
+        SQLiteDatabase.deleteDatabase(file);
+        db = SQLiteDatabase.openOrCreateDatabase(file, null);
+        db.enableWriteAheadLogging();
+        // Losing the last batches on a power cut is acceptable; an fsync per batch is not.
+        db.execSQL("PRAGMA synchronous=NORMAL");
+        DatabaseHelper.createCsiDataTable(db);
+        insert = db.compileStatement(INSERT_SQL);
+    }
+
+    File getFile() {
+        return file;
+    }
+
+    @Override
+    public void write(List<CsiRecord> batch) {
+        db.beginTransactionNonExclusive();
+        try {
+            for (CsiRecord record : batch) {
+                bind(record);
+                insert.executeInsert();
+            }
+            db.setTransactionSuccessful();
+        } finally {
+            db.endTransaction();
+        }
+    }
+
+    private void bind(CsiRecord record) {
+        long second = record.receivedAtMs / 1000;
+        if (second != dateSecond) {
+            dateSecond = second;
+            date = dateFormat.format(new Date(second * 1000));
+        }
+        insert.bindString(1, date);
+        insert.bindString(2, cenario);
+        insert.bindString(3, "CSI_DATA");
+        insert.bindLong(4, record.seq);
+        text.setLength(0);
+        insert.bindString(5, record.appendMac(text).toString());
+        for (int i = 0; i < CsiRecord.FIELD_COUNT; i++) {
+            if (i == CsiRecord.RATE) {
+                insert.bindDouble(FIRST_FIELD + i, record.fields[i]);
+            } else {
+                insert.bindLong(FIRST_FIELD + i, record.fields[i]);
+            }
+        }
+        text.setLength(0);
+        insert.bindString(DATA, record.appendValues(text).toString());
+    }
+
+    /** Checkpoints the write-ahead log into the file and closes it. */
+    @Override
+    public void close() {
+        insert.close();
+        db.disableWriteAheadLogging();
+        db.close();
+    }
+
+    /** Removes the file and anything SQLite left beside it. */
+    void delete() {
+        SQLiteDatabase.deleteDatabase(file);
+    }
+}
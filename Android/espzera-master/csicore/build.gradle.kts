@@ -0,0 +1,24 @@
+// Plain-Java capture core: parsing of the node's CSI_DATA datagrams and the
+// bounded, batched hand-off to a writer. No Android dependencies, so it is
+// unit tested and benchmarked on the JVM:
+//   ./gradlew :csicore:test
+//   ./gradlew :csicore:bench
+plugins {
+    `java-library`
+}
+
+java {
+    sourceCompatibility = JavaVersion.VERSION_11
+    targetCompatibility = JavaVersion.VERSION_11
+}
+
+dependencies {
+    testImplementation(libs.junit)
+}
+
+tasks.register<JavaExec>("bench") {
+    description = "Runs the capture throughput benchmark."
+    classpath = sourceSets["test"].runtimeClasspath
+    mainClass.set("com.example.espzera.capture.CaptureBench")
+    jvmArgs("-Xmx256m")
+}
@@ -0,0 +1,188 @@
+package com.example.espzera.capture;
+
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicLong;
+
+/**
+ * Hands the frames of an acquisition from the receive thread to a {@link Sink} on a background
+ * thread, in bounded batches, while the acquisition runs.
+ *
+ * <p>The receive thread calls {@link #offer} with each datagram. The datagram is parsed into a
+ * record taken from a fixed pool and queued; the writer thread drains the queue into batches of
+ * at most batchSize records, or what arrived within flushIntervalMs, and gives each batch to the
+ * sink before returning its records to the pool. Memory is therefore fixed by the pool size
+ * whatever the session length, and no record is allocated after construction. When the sink
+ * falls behind and the pool runs dry, frames are dropped and counted rather than blocking the
+ * receive thread. The first sink error stops writing; later frames are counted as failed.
+ */
+public final class CaptureWriter implements AutoCloseable {
+
+    /** Destination of the batches, called on the writer thread only. */
+    public interface Sink {
+        void write(List<CsiRecord> batch) throws Exception;
+    }
+
+    public static final int DEFAULT_POOL = 2048;
+    public static final int DEFAULT_BATCH = 500;
+    public static final long DEFAULT_FLUSH_MS = 500;
+    // Longest the writer thread waits before looking at closing again.
+    private static final long POLL_NS = TimeUnit.MILLISECONDS.toNanos(50);
+
+    private final Sink sink;
+    private final int batchSize;
+    private final long flushIntervalMs;
+    private final ArrayBlockingQueue<CsiRecord> free;
+    private final ArrayBlockingQueue<CsiRecord> queued;
+    private final CsiLineParser parser = new CsiLineParser();
+    private final Thread thread;
+    private volatile boolean closing;
+    private volatile Exception error;
+
+    private final AtomicLong accepted = new AtomicLong();
+    private final AtomicLong malformed = new AtomicLong();
+    private final AtomicLong dropped = new AtomicLong();
+    private final AtomicLong written = new AtomicLong();
+    private final AtomicLong failed = new AtomicLong();
+    private final AtomicLong batches = new AtomicLong();
+
+    public CaptureWriter(Sink sink) {
+        this(sink, DEFAULT_POOL, DEFAULT_BATCH, DEFAULT_FLUSH_MS);
+    }
+
+    public CaptureWriter(Sink sink, int poolSize, int batchSize, long flushIntervalMs) {
+        if (poolSize < 1 || batchSize < 1 || flushIntervalMs < 0) {
+            throw new IllegalArgumentException("pool and batch sizes must be positive");
+        }
+        this.sink = sink;
+        this.batchSize = batchSize;
+        this.flushIntervalMs = flushIntervalMs;
+        free = new ArrayBlockingQueue<>(poolSize);
+        queued = new ArrayBlockingQueue<>(poolSize);
+        for (int i = 0; i < poolSize; i++) {
+            free.add(new CsiRecord());
+        }
+        thread = new Thread(this::run, "csi-capture-writer");
+        thread.setDaemon(true);
+        thread.start();
+    }
+
+    /**
+     * Parses one datagram received at receivedAtMs and queues it for the sink. Returns false if it
+     * is not a well-formed CSI_DATA line or the pool is exhausted. Call from a single thread.
+     */
+    public boolean offer(byte[] data, int offset, int length, long receivedAtMs) {
+        CsiRecord record = free.poll();
+        if (record == null) {
+            dropped.incrementAndGet();
+            return false;
+        }
+        if (!parser.parse(data, offset, length, record)) {
+            free.add(record);
+            malformed.incrementAndGet();
+            return false;
+        }
+        record.receivedAtMs = receivedAtMs;
+        queued.add(record);
+        accepted.incrementAndGet();
+        return true;
+    }
+
+    private void run() {
+        List<CsiRecord> batch = new ArrayList<>(batchSize);
+        try {
+            while (!closing || !queued.isEmpty()) {
+                CsiRecord first = queued.poll(POLL_NS, TimeUnit.NANOSECONDS);
+                if (first == null) {
+                    continue;
+                }
+                batch.add(first);
+                long deadline = System.nanoTime() + TimeUnit.MILLISECONDS.toNanos(flushIntervalMs);
+                while (batch.size() < batchSize) {
+                    queued.drainTo(batch, batchSize - batch.size());
+                    long wait = deadline - System.nanoTime();
+                    if (batch.size() == batchSize || wait <= 0 || closing) {
+                        break;
+                    }
+                    CsiRecord next = queued.poll(Math.min(wait, POLL_NS), TimeUnit.NANOSECONDS);
+                    if (next != null) {
+                        batch.add(next);
+                    }
+                }
+                flush(batch);
+            }
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+        }
+    }
+
+    private void flush(List<CsiRecord> batch) {
+        if (error == null) {
+            try {
+                sink.write(batch);
+                written.addAndGet(batch.size());
+                batches.incrementAndGet();
+            } catch (Exception e) {
+                error = e;
+            }
+        }
+        if (error != null) {
+            failed.addAndGet(batch.size());
+        }
+        free.addAll(batch);
+        batch.clear();
+    }
+
+    /**
+     * Writes what is still queued and stops the writer thread. Returns once the sink has seen
+     * every accepted frame. Call after the receive thread's last offer; any later offer is
+     * dropped.
+     */
+    @Override
+    public void close() throws InterruptedException {
+        closing = true;
+        thread.join();
+        free.clear();
+    }
+
+    /** The sink error that stopped writing, or null. */
+    public Exception error() {
+        return error;
+    }
+
+    /** Frames parsed and queued. */
+    public long accepted() {
+        return accepted.get();
+    }
+
+    /** Datagrams that were not well-formed CSI_DATA lines. */
+    public long malformed() {
+        return malformed.get();
+    }
+
+    /** Frames dropped because every pooled record was waiting for the sink. */
+    public long dropped() {
+        return dropped.get();
+    }
+
+    /** Frames the sink accepted, and the batches they came in. */
+    public long written() {
+        return written.get();
+    }
+
+    public long batches() {
+        return batches.get();
+    }
+
+    /** Frames lost to a sink error. */
+    public long failed() {
+        return failed.get();
+    }
+
+    /** Frames queued and not yet written. */
+    public int pending() {
+        return queued.size();
+    }
+}
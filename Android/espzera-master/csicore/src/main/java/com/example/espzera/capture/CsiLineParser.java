@@ -0,0 +1,181 @@
+package com.example.espzera.capture;
+
+/**
+ * Parses CSI_DATA datagrams straight from the receive buffer into a {@link CsiRecord}, without
+ * building a String or splitting the line. Accepts what the desktop collector and the native host
+ * tools accept (csi::parse_csi_line): integer fields, a lowercase or uppercase MAC address and a
+ * "[a,b,...]" payload list, optionally quoted, of values that fit in a signed byte.
+ *
+ * <p>A parser keeps its position between calls, so each thread needs its own.
+ */
+public final class CsiLineParser {
+
+    private static final byte[] PREFIX = {'C', 'S', 'I', '_', 'D', 'A', 'T', 'A', ','};
+    private static final long MAX_FIELD = 0xFFFFFFFFL;
+
+    private byte[] buf;
+    private int pos;
+    private int end;
+    private long value;
+
+    /** Returns true if the datagram starts with "CSI_DATA,". */
+    public static boolean isCsiData(byte[] data, int offset, int length) {
+        if (length < PREFIX.length) {
+            return false;
+        }
+        for (int i = 0; i < PREFIX.length; i++) {
+            if (data[offset + i] != PREFIX[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Parses one CSI_DATA line of length bytes at offset into out. Returns false if the line is
+     * malformed, in which case out holds partial data.
+     */
+    public boolean parse(byte[] data, int offset, int length, CsiRecord out) {
+        if (!isCsiData(data, offset, length)) {
+            return false;
+        }
+        buf = data;
+        pos = offset + PREFIX.length;
+        end = offset + length;
+        if (!readInt()) {
+            return false;
+        }
+        out.seq = value;
+        if (!expect(',') || !readMac()) {
+            return false;
+        }
+        out.mac = value;
+        for (int i = 0; i < CsiRecord.FIELD_COUNT; i++) {
+            if (!expect(',') || !readInt()) {
+                return false;
+            }
+            out.fields[i] = value;
+        }
+        return expect(',') && readValues(out);
+    }
+
+    private boolean expect(char c) {
+        if (pos < end && buf[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    private boolean readInt() {
+        boolean negative = false;
+        if (pos < end && (buf[pos] == '-' || buf[pos] == '+')) {
+            negative = buf[pos] == '-';
+            pos++;
+        }
+        int start = pos;
+        long v = 0;
+        while (pos < end) {
+            int d = buf[pos] - '0';
+            if (d < 0 || d > 9) {
+                break;
+            }
+            v = v * 10 + d;
+            if (v > MAX_FIELD) {
+                return false;
+            }
+            pos++;
+        }
+        value = negative ? -v : v;
+        return pos > start;
+    }
+
+    private boolean readMac() {
+        long mac = 0;
+        for (int i = 0; i < 6; i++) {
+            if (i > 0 && !expect(':')) {
+                return false;
+            }
+            if (end - pos < 2) {
+                return false;
+            }
+            int hi = hexDigit(buf[pos]);
+            int lo = hexDigit(buf[pos + 1]);
+            if (hi < 0 || lo < 0) {
+                return false;
+            }
+            mac = mac << 8 | hi << 4 | lo;
+            pos += 2;
+        }
+        value = mac;
+        return true;
+    }
+
+    private static int hexDigit(byte c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        int lower = c | 0x20;
+        return lower >= 'a' && lower <= 'f' ? lower - 'a' + 10 : -1;
+    }
+
+    private static boolean isTrimmed(byte c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '"' || c == 0;
+    }
+
+    private boolean readValues(CsiRecord out) {
+        while (pos < end && isTrimmed(buf[pos])) {
+            pos++;
+        }
+        while (end > pos && isTrimmed(buf[end - 1])) {
+            end--;
+        }
+        if (end - pos < 2 || buf[pos] != '[' || buf[end - 1] != ']') {
+            return false;
+        }
+        pos++;
+        end--;
+        int count = 0;
+        if (pos == end) {
+            out.valueCount = 0;
+            return true;
+        }
+        while (true) {
+            while (pos < end && buf[pos] == ' ') {
+                pos++;
+            }
+            boolean negative = false;
+            if (pos < end && (buf[pos] == '-' || buf[pos] == '+')) {
+                negative = buf[pos] == '-';
+                pos++;
+            }
+            int start = pos;
+            int v = 0;
+            while (pos < end) {
+                int d = buf[pos] - '0';
+                if (d < 0 || d > 9) {
+                    break;
+                }
+                v = v * 10 + d;
+                if (v > 128) {
+                    return false;
+                }
+                pos++;
+            }
+            if (pos == start || (!negative && v > 127) || count == CsiRecord.MAX_VALUES) {
+                return false;
+            }
+            out.values[count++] = (byte) (negative ? -v : v);
+            while (pos < end && buf[pos] == ' ') {
+                pos++;
+            }
+            if (pos == end) {
+                out.valueCount = count;
+                return true;
+            }
+            if (buf[pos++] != ',') {
+                return false;
+            }
+        }
+    }
+}
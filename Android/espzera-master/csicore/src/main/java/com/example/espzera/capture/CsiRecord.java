@@ -0,0 +1,75 @@
+package com.example.espzera.capture;
+
+/**
+ * One parsed CSI_DATA frame. Records are pooled by {@link CaptureWriter} and filled in place by
+ * {@link CsiLineParser}, so a capture allocates none per frame.
+ *
+ * <p>The integer fields of the line, after the MAC address, are kept in {@link #fields} in line
+ * order (csi_frame_format_text on the node):
+ * {@code CSI_DATA,seq,mac,rssi,rate,sig_mode,...,len,first_word,"[v,v,...]"}.
+ */
+public final class CsiRecord {
+
+    /** CSI_FRAME_MAX_PAYLOAD on the node. */
+    public static final int MAX_VALUES = 1024;
+
+    // Indices into fields, in line order after the MAC address.
+    public static final int RSSI = 0;
+    public static final int RATE = 1;
+    public static final int SIG_MODE = 2;
+    public static final int MCS = 3;
+    public static final int BANDWIDTH = 4;
+    public static final int SMOOTHING = 5;
+    public static final int NOT_SOUNDING = 6;
+    public static final int AGGREGATION = 7;
+    public static final int STBC = 8;
+    public static final int FEC_CODING = 9;
+    public static final int SGI = 10;
+    public static final int NOISE_FLOOR = 11;
+    public static final int AMPDU_CNT = 12;
+    public static final int CHANNEL = 13;
+    public static final int SECONDARY_CHANNEL = 14;
+    public static final int LOCAL_TIMESTAMP = 15;
+    public static final int ANT = 16;
+    public static final int SIG_LEN = 17;
+    public static final int RX_STATE = 18;
+    public static final int LEN = 19;
+    public static final int FIRST_WORD = 20;
+    public static final int FIELD_COUNT = 21;
+
+    private static final char[] HEX = "0123456789abcdef".toCharArray();
+
+    public long seq;
+    /** Transmitter address, big-endian in the low 48 bits. */
+    public long mac;
+    public final long[] fields = new long[FIELD_COUNT];
+    /** I/Q (or amplitude) values; the first {@link #valueCount} are valid. */
+    public final byte[] values = new byte[MAX_VALUES];
+    public int valueCount;
+    /** Host receive time, milliseconds since the epoch. */
+    public long receivedAtMs;
+
+    /** Appends the MAC address as aa:bb:cc:dd:ee:ff. */
+    public StringBuilder appendMac(StringBuilder out) {
+        for (int shift = 40; shift >= 0; shift -= 8) {
+            int b = (int) (mac >>> shift) & 0xFF;
+            out.append(HEX[b >> 4]).append(HEX[b & 0xF]);
+            if (shift > 0) {
+                out.append(':');
+            }
+        }
+        return out;
+    }
+
+    /** Appends the payload as the legacy "[a,b,...]" text, without quotes. */
+    public StringBuilder appendValues(StringBuilder out) {
+        out.append('[');
+        for (int i = 0; i < valueCount; i++) {
+            if (i > 0) {
+                out.append(',');
+            }
+            out.append(values[i]);
+        }
+        return out.append(']');
+    }
+}
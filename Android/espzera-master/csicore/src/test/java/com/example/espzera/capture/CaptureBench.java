@@ -0,0 +1,151 @@
+package com.example.espzera.capture;
+
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import java.util.Random;
+
+/**
+ * Capture throughput on the JVM: ./gradlew :csicore:bench [--args="frames values"]
+ *
+ * <ul>
+ *   <li>legacy: what the collector did per datagram before, a String of the packet kept in a
+ *       list, then split(",", 25), quote stripping and parseInt of every field at save time;</li>
+ *   <li>parser: {@link CsiLineParser} into one reused record;</li>
+ *   <li>writer: the whole pipeline, {@link CaptureWriter#offer} on this thread and a sink that
+ *       formats the mac and data columns as the Android store does.</li>
+ * </ul>
+ *
+ * Prints frames per second and the heap in use after each run, with the frames still
+ * reachable: the legacy path grows with the session, the writer stays at its pool.
+ */
+public final class CaptureBench {
+
+    private CaptureBench() {
+    }
+
+    static byte[][] synthesize(int count, int values) {
+        Random rng = new Random(1);
+        byte[][] lines = new byte[count][];
+        for (int i = 0; i < count; i++) {
+            StringBuilder line = new StringBuilder("CSI_DATA,").append(i).append(",aa:bb:cc:dd:ee:0")
+                    .append(1 + i % 2).append(',').append(-30 - rng.nextInt(60))
+                    .append(",11,1,7,0,1,1,0,0,0,0,-93,0,6,0,").append(10000L * i)
+                    .append(",0,").append(values).append(",0,").append(values).append(",0,\"[");
+            for (int v = 0; v < values; v++) {
+                line.append(v == 0 ? "" : ",").append(rng.nextInt(256) - 128);
+            }
+            lines[i] = line.append("]\"").toString().getBytes(StandardCharsets.US_ASCII);
+        }
+        return lines;
+    }
+
+    static long usedHeap() {
+        Runtime rt = Runtime.getRuntime();
+        for (int i = 0; i < 3; i++) {
+            System.gc();
+        }
+        return rt.totalMemory() - rt.freeMemory();
+    }
+
+    static void report(String name, int frames, long nanos, long heap) {
+        System.out.printf("%-8s %12.0f frames/s  %8.3f s  heap %6.1f MiB%n",
+                name, frames / (nanos / 1e9), nanos / 1e9, heap / 1048576.0);
+    }
+
+    static long legacy(byte[][] lines) {
+        List<String> buffer = new ArrayList<>();
+        for (byte[] packet : lines) {
+            String data = new String(packet, 0, packet.length).trim();
+            if (data.startsWith("CSI_DATA")) {
+                buffer.add(data);
+            }
+        }
+        long sum = 0;
+        for (String line : buffer) {
+            String[] parts = line.trim().split(",", 25);
+            String[] csiParts = Arrays.copyOfRange(parts, 1, parts.length);
+            for (int i = 0; i < csiParts.length; i++) {
+                csiParts[i] = csiParts[i].trim().replace("\"", "");
+            }
+            sum += Integer.parseInt(csiParts[0]);
+            for (int i = 2; i < 23; i++) {
+                sum += i == 17 ? Long.parseLong(csiParts[i]) : Integer.parseInt(csiParts[i]);
+            }
+            sum += csiParts[23].length();
+        }
+        keep = buffer;
+        return sum;
+    }
+
+    static long parser(byte[][] lines) {
+        CsiLineParser parser = new CsiLineParser();
+        CsiRecord record = new CsiRecord();
+        long sum = 0;
+        for (byte[] packet : lines) {
+            if (parser.parse(packet, 0, packet.length, record)) {
+                sum += record.seq + record.valueCount;
+            }
+        }
+        return sum;
+    }
+
+    static long writer(byte[][] lines) throws Exception {
+        StringBuilder text = new StringBuilder();
+        long[] sum = new long[1];
+        CaptureWriter writer = new CaptureWriter(batch -> {
+            for (CsiRecord record : batch) {
+                text.setLength(0);
+                sum[0] += record.appendMac(text).length();
+                text.setLength(0);
+                sum[0] += record.appendValues(text).toString().length();
+            }
+        });
+        for (byte[] packet : lines) {
+            // Like the receive thread, never block; a real capture is paced by the network.
+            while (!writer.offer(packet, 0, packet.length, 0) && writer.malformed() == 0) {
+                Thread.yield();
+            }
+        }
+        writer.close();
+        if (writer.written() != lines.length) {
+            throw new IllegalStateException(writer.written() + " of " + lines.length + " frames written");
+        }
+        keep = writer;
+        return sum[0];
+    }
+
+    static Object keep;
+
+    public static void main(String[] args) throws Exception {
+        int frames = args.length > 0 ? Integer.parseInt(args[0]) : 200000;
+        int values = args.length > 1 ? Integer.parseInt(args[1]) : 128;
+        byte[][] lines = synthesize(frames, values);
+        System.out.println(frames + " frames of " + values + " values");
+        long base = usedHeap();
+        for (int round = 0; round < 2; round++) {
+            if (round == 1) {
+                System.out.println("(warm)");
+            }
+            long start = System.nanoTime();
+            legacy(lines);
+            long legacyNs = System.nanoTime() - start;
+            report("legacy", frames, legacyNs, usedHeap() - base);
+            keep = null;
+
+            start = System.nanoTime();
+            parser(lines);
+            long parserNs = System.nanoTime() - start;
+            report("parser", frames, parserNs, usedHeap() - base);
+
+            start = System.nanoTime();
+            writer(lines);
+            long writerNs = System.nanoTime() - start;
+            report("writer", frames, writerNs, usedHeap() - base);
+            keep = null;
+            System.out.printf("parser %.1fx, writer %.1fx the legacy path%n",
+                    (double) legacyNs / parserNs, (double) legacyNs / writerNs);
+        }
+    }
+}
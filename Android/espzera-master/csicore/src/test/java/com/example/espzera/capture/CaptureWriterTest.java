@@ -0,0 +1,149 @@
+package com.example.espzera.capture;
+
+import org.junit.Test;
+
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.IdentityHashMap;
+import java.util.List;
+import java.util.Set;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.TimeUnit;
+
+import static org.junit.Assert.*;
+
+public class CaptureWriterTest {
+
+    /** Records what it is given: sequence numbers, batch sizes and the record instances. */
+    private static final class RecordingSink implements CaptureWriter.Sink {
+        final List<Long> seqs = Collections.synchronizedList(new ArrayList<>());
+        final List<Integer> batchSizes = Collections.synchronizedList(new ArrayList<>());
+        final Set<CsiRecord> instances = Collections.synchronizedSet(
+                Collections.newSetFromMap(new IdentityHashMap<>()));
+
+        @Override
+        public void write(List<CsiRecord> batch) throws Exception {
+            batchSizes.add(batch.size());
+            for (CsiRecord record : batch) {
+                seqs.add(record.seq);
+                instances.add(record);
+            }
+        }
+    }
+
+    static byte[] line(long seq) {
+        return (CsiLineParserTest.HEADER.replace(",42,", "," + seq + ",") + "\"[1,2,3,4]\"")
+                .getBytes(StandardCharsets.US_ASCII);
+    }
+
+    private static boolean offer(CaptureWriter writer, long seq) {
+        byte[] bytes = line(seq);
+        return writer.offer(bytes, 0, bytes.length, 0);
+    }
+
+    @Test
+    public void writesEveryFrameInOrderAndInBoundedBatches() throws Exception {
+        RecordingSink sink = new RecordingSink();
+        CaptureWriter writer = new CaptureWriter(sink, 64, 10, 5);
+        for (long seq = 0; seq < 1000; seq++) {
+            while (!offer(writer, seq)) {
+                Thread.sleep(1); // The pool is small; wait for the sink rather than drop
+            }
+        }
+        writer.close();
+        assertEquals(1000, sink.seqs.size());
+        for (int i = 0; i < 1000; i++) {
+            assertEquals(i, sink.seqs.get(i).longValue());
+        }
+        for (int size : sink.batchSizes) {
+            assertTrue(size >= 1 && size <= 10);
+        }
+        assertEquals(sink.batchSizes.size(), writer.batches());
+        assertEquals(1000, writer.accepted());
+        assertEquals(1000, writer.written());
+        assertEquals(0, writer.pending());
+        // Records are recycled: no more instances than the pool holds.
+        assertTrue(sink.instances.size() <= 64);
+    }
+
+    @Test
+    public void closeWritesWhatIsStillQueued() throws Exception {
+        RecordingSink sink = new RecordingSink();
+        CaptureWriter writer = new CaptureWriter(sink, 16, 100, TimeUnit.HOURS.toMillis(1));
+        for (long seq = 0; seq < 5; seq++) {
+            assertTrue(offer(writer, seq));
+        }
+        writer.close();
+        assertEquals(5, writer.written());
+        assertEquals(5, sink.seqs.size());
+        assertFalse(offer(writer, 5));
+    }
+
+    @Test
+    public void dropsWhenTheSinkFallsBehind() throws Exception {
+        CountDownLatch release = new CountDownLatch(1);
+        CaptureWriter writer = new CaptureWriter(batch -> release.await(), 8, 4, 0);
+        int accepted = 0;
+        for (long seq = 0; seq < 100; seq++) {
+            if (offer(writer, seq)) {
+                accepted++;
+            }
+        }
+        // The sink holds at most one batch, the rest of the pool is queued.
+        assertTrue(accepted <= 8);
+        assertEquals(accepted, writer.accepted());
+        assertEquals(100 - accepted, writer.dropped());
+        release.countDown();
+        writer.close();
+        assertEquals(accepted, writer.written());
+    }
+
+    @Test
+    public void countsMalformedDatagramsWithoutUsingThePool() throws Exception {
+        RecordingSink sink = new RecordingSink();
+        CaptureWriter writer = new CaptureWriter(sink, 1, 1, 0);
+        byte[] junk = "CSI_DATA,1,2".getBytes(StandardCharsets.US_ASCII);
+        for (int i = 0; i < 10; i++) {
+            assertFalse(writer.offer(junk, 0, junk.length, 0));
+        }
+        assertEquals(10, writer.malformed());
+        assertEquals(0, writer.dropped());
+        writer.close();
+        assertTrue(sink.seqs.isEmpty());
+    }
+
+    @Test
+    public void stopsWritingAfterASinkError() throws Exception {
+        Exception failure = new Exception("disk full");
+        CaptureWriter writer = new CaptureWriter(batch -> {
+            throw failure;
+        }, 16, 4, 0);
+        for (long seq = 0; seq < 6; seq++) {
+            assertTrue(offer(writer, seq));
+        }
+        writer.close();
+        assertSame(failure, writer.error());
+        assertEquals(0, writer.written());
+        assertEquals(6, writer.failed());
+    }
+
+    @Test
+    public void keepsTheReceiveTime() throws Exception {
+        List<Long> times = Collections.synchronizedList(new ArrayList<>());
+        CaptureWriter writer = new CaptureWriter(batch -> {
+            for (CsiRecord record : batch) {
+                times.add(record.receivedAtMs);
+            }
+        }, 4, 4, 0);
+        byte[] bytes = line(1);
+        writer.offer(bytes, 0, bytes.length, 1700000000123L);
+        writer.close();
+        assertEquals(Collections.singletonList(1700000000123L), times);
+    }
+
+    @Test(expected = IllegalArgumentException.class)
+    public void rejectsAnEmptyPool() {
+        new CaptureWriter(batch -> { }, 0, 1, 0);
+    }
+}
@@ -0,0 +1,112 @@
+package com.example.espzera.capture;
+
+import org.junit.Test;
+
+import java.nio.charset.StandardCharsets;
+import java.util.Arrays;
+
+import static org.junit.Assert.*;
+
+public class CsiLineParserTest {
+
+    static final String HEADER = "CSI_DATA,42,AA:bb:cc:dd:ee:01,-57,11,1,7,0,1,1,0,0,0,0,-93,0,6,0,"
+            + "3000000000,0,4,0,4,0,";
+
+    private final CsiLineParser parser = new CsiLineParser();
+    private final CsiRecord record = new CsiRecord();
+
+    private boolean parse(String line) {
+        byte[] bytes = line.getBytes(StandardCharsets.US_ASCII);
+        return parser.parse(bytes, 0, bytes.length, record);
+    }
+
+    @Test
+    public void parsesEveryField() {
+        assertTrue(parse(HEADER + "\"[1,-2,127,-128]\""));
+        assertEquals(42, record.seq);
+        assertEquals(0xaabbccddee01L, record.mac);
+        assertEquals(-57, record.fields[CsiRecord.RSSI]);
+        assertEquals(11, record.fields[CsiRecord.RATE]);
+        assertEquals(7, record.fields[CsiRecord.MCS]);
+        assertEquals(-93, record.fields[CsiRecord.NOISE_FLOOR]);
+        assertEquals(6, record.fields[CsiRecord.CHANNEL]);
+        assertEquals(3000000000L, record.fields[CsiRecord.LOCAL_TIMESTAMP]);
+        assertEquals(4, record.fields[CsiRecord.LEN]);
+        assertEquals(0, record.fields[CsiRecord.FIRST_WORD]);
+        assertEquals(4, record.valueCount);
+        assertArrayEquals(new byte[] {1, -2, 127, -128}, Arrays.copyOf(record.values, 4));
+    }
+
+    @Test
+    public void acceptsUnquotedSpacedAndTerminatedLists() {
+        assertTrue(parse(HEADER + "[1, 2 ,+3]\r\n"));
+        assertEquals(3, record.valueCount);
+        assertEquals(3, record.values[2]);
+        assertTrue(parse(HEADER + "[]"));
+        assertEquals(0, record.valueCount);
+    }
+
+    @Test
+    public void parsesAtAnOffset() {
+        byte[] bytes = ("xx" + HEADER + "[5]yy").getBytes(StandardCharsets.US_ASCII);
+        assertTrue(parser.parse(bytes, 2, bytes.length - 4, record));
+        assertEquals(1, record.valueCount);
+        assertEquals(5, record.values[0]);
+    }
+
+    @Test
+    public void rejectsMalformedLines() {
+        assertFalse(parse("CSI_IP,192.168.4.1"));
+        assertFalse(parse("CSI_DATA"));
+        assertFalse(parse(HEADER + "[1,2"));
+        assertFalse(parse(HEADER + "1,2]"));
+        assertFalse(parse(HEADER + "[1,,2]"));
+        assertFalse(parse(HEADER + "[1,2,]"));
+        assertFalse(parse(HEADER + "[1,x]"));
+        assertFalse(parse(HEADER + "[1 2]"));
+        assertFalse(parse(HEADER + "[-]"));
+        assertFalse(parse(HEADER.replace(",-57,", ",,") + "[1]"));
+        assertFalse(parse(HEADER.replace("AA:bb", "AA-bb") + "[1]"));
+        assertFalse(parse(HEADER.replace("AA:bb", "AG:bb") + "[1]"));
+        assertFalse(parse(HEADER.replace(",3000000000,", ",4294967296,") + "[1]"));
+        assertFalse(parse(HEADER.substring(0, HEADER.length() - 4) + "[1]"));
+    }
+
+    @Test
+    public void rejectsValuesOutOfByteRange() {
+        assertFalse(parse(HEADER + "[128]"));
+        assertFalse(parse(HEADER + "[-129]"));
+        assertFalse(parse(HEADER + "[1000]"));
+        // Leading zeros are accepted, as by int() in the desktop collector.
+        assertTrue(parse(HEADER + "[-0,007,00000000001]"));
+        assertEquals(7, record.values[1]);
+        assertEquals(1, record.values[2]);
+    }
+
+    @Test
+    public void rejectsMoreValuesThanTheNodeSends() {
+        StringBuilder line = new StringBuilder(HEADER).append('[');
+        for (int i = 0; i < CsiRecord.MAX_VALUES; i++) {
+            line.append(i == 0 ? "" : ",").append(i % 100);
+        }
+        assertTrue(parse(line + "]"));
+        assertEquals(CsiRecord.MAX_VALUES, record.valueCount);
+        assertFalse(parse(line + ",1]"));
+    }
+
+    @Test
+    public void reusesTheRecord() {
+        assertTrue(parse(HEADER + "[1,2,3,4,5]"));
+        assertTrue(parse(HEADER.replace(",42,", ",43,") + "[9]"));
+        assertEquals(43, record.seq);
+        assertEquals(1, record.valueCount);
+        assertEquals(9, record.values[0]);
+    }
+
+    @Test
+    public void formatsMacAndValuesLikeTheLegacyTable() {
+        assertTrue(parse(HEADER + "\"[1,-2,127,-128]\""));
+        assertEquals("aa:bb:cc:dd:ee:01", record.appendMac(new StringBuilder()).toString());
+        assertEquals("[1,-2,127,-128]", record.appendValues(new StringBuilder()).toString());
+    }
+}
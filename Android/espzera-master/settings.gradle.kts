@@ -21,4 +21,5 @@ dependencyResolutionManagement {
 
 rootProject.name = "espzera"
 include(":app")
+include(":csicore")
  
\ No newline at end of file
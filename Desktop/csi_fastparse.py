@@ -0,0 +1,247 @@
+# -*- coding: utf-8 -*-
+"""
+Bulk loading of CSI recorded in the legacy text format, through the native
+parser in Desktop/native (libcsi_parse, csi/parse.h) loaded with ctypes.
+
+Sources: logs of CSI_DATA lines as printed by the node, "[a,b,...]" payload
+strings, and whole csi_data tables written by the older desktop collector
+(save_to_db) or by the Android app (DatabaseHelper.addCsiData). csi_frame
+tables load the same way.
+
+Results are Frames: a dense int8 payload matrix (rows x width, zero-padded)
+and per-row metadata, all in flat array.array buffers that NumPy, if
+installed, views without copying:
+
+    payload = numpy.frombuffer(frames.payload, numpy.int8).reshape(frames.rows, frames.width)
+    meta = numpy.frombuffer(frames.meta, numpy.int64).reshape(frames.rows, len(COLUMNS))
+
+The library is looked up in $CSI_PARSE_LIB, then in the native build
+directories (build, _gate_build), then on the system library path.
+"""
+import ctypes
+import ctypes.util
+import os
+from array import array
+
+# Metadata columns, in the order of the CSI_DATA line (CSI_PARSE_* in csi/parse.h).
+# len is the number of payload values, before any cut to width.
+COLUMNS = ('seq', 'rssi', 'rate', 'sig_mode', 'mcs', 'cwb', 'smoothing', 'not_sounding', 'aggregation',
+           'stbc', 'fec_coding', 'sgi', 'noise_floor', 'ampdu_cnt', 'channel', 'secondary_channel',
+           'timestamp', 'ant', 'sig_len', 'rx_state', 'len', 'first_word')
+
+MAX_PAYLOAD = 1024          # CSI_FRAME_MAX_PAYLOAD
+DEFAULT_WIDTH = 128         # I/Q values of a 20 MHz LLTF frame
+CHUNK_ROWS = 65536
+READ_BYTES = 1 << 22
+
+_NATIVE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'native')
+
+
+class _Out(ctypes.Structure):
+    _fields_ = [
+        ('payload', ctypes.c_void_p),
+        ('width', ctypes.c_uint32),
+        ('meta', ctypes.c_void_p),
+        ('mac', ctypes.c_void_p),
+        ('host_time', ctypes.c_void_p),
+        ('capacity', ctypes.c_uint64),
+        ('rows', ctypes.c_uint64),
+        ('skipped', ctypes.c_uint64),
+        ('truncated', ctypes.c_uint64),
+    ]
+
+
+_lib = None
+
+
+def load_library(path=None):
+    """Loads libcsi_parse once; raises OSError if it cannot be found."""
+    global _lib
+    if _lib is not None and path is None:
+        return _lib
+    candidates = [path] if path else [os.environ.get('CSI_PARSE_LIB')] + [
+        os.path.join(_NATIVE_DIR, d, 'libcsi_parse.so') for d in ('build', '_gate_build')
+    ] + [ctypes.util.find_library('csi_parse')]
+    for candidate in filter(None, candidates):
+        if os.path.sep in candidate and not os.path.exists(candidate):
+            continue
+        lib = ctypes.CDLL(candidate)
+        break
+    else:
+        raise OSError("libcsi_parse not found: build Desktop/native or set CSI_PARSE_LIB")
+    out = ctypes.POINTER(_Out)
+    lib.csi_parse_simd.argtypes = [ctypes.c_int]
+    lib.csi_parse_simd.restype = ctypes.c_int
+    lib.csi_parse_payload.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_size_t]
+    lib.csi_parse_payload.restype = ctypes.c_long
+    lib.csi_parse_lines.argtypes = [ctypes.c_char_p, ctypes.c_size_t, out]
+    lib.csi_parse_lines.restype = ctypes.c_size_t
+    lib.csi_parse_db_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p,
+                                      ctypes.c_size_t]
+    lib.csi_parse_db_open.restype = ctypes.c_void_p
+    lib.csi_parse_db_rows.argtypes = [ctypes.c_void_p]
+    lib.csi_parse_db_rows.restype = ctypes.c_uint64
+    lib.csi_parse_db_max_len.argtypes = [ctypes.c_void_p]
+    lib.csi_parse_db_max_len.restype = ctypes.c_uint32
+    lib.csi_parse_db_read.argtypes = [ctypes.c_void_p, out]
+    lib.csi_parse_db_read.restype = ctypes.c_uint64
+    lib.csi_parse_db_close.argtypes = [ctypes.c_void_p]
+    lib.csi_parse_db_close.restype = None
+    if path is None:
+        _lib = lib
+    return lib
+
+
+def use_simd(enable=None):
+    """Selects the SSE2 or the scalar payload scanner; returns whether SSE2 is in use."""
+    return bool(load_library().csi_parse_simd(-1 if enable is None else int(bool(enable))))
+
+
+class Frames:
+    """
+    rows frames: payload holds rows x width int8 values, meta rows x
+    len(COLUMNS) int64 values, mac one 48-bit integer per row and host_time
+    one receive time per row (NaN when the source does not record it).
+    skipped counts malformed lines or rows, truncated payloads longer than width.
+    """
+
+    def __init__(self, capacity, width):
+        self.width = width
+        self.capacity = capacity
+        self.payload = array('b', bytes(capacity * width))
+        self.meta = array('q', bytes(8 * capacity * len(COLUMNS)))
+        self.mac = array('Q', bytes(8 * capacity))
+        self.host_time = array('d', bytes(8 * capacity))
+        self._out = _Out(self.payload.buffer_info()[0], width, self.meta.buffer_info()[0],
+                         self.mac.buffer_info()[0], self.host_time.buffer_info()[0], capacity, 0, 0, 0)
+
+    @property
+    def rows(self):
+        return self._out.rows
+
+    @property
+    def skipped(self):
+        return self._out.skipped
+
+    @property
+    def truncated(self):
+        return self._out.truncated
+
+    @property
+    def full(self):
+        return self._out.rows == self.capacity
+
+    def column(self, name):
+        """One metadata column as an array('q') of rows values."""
+        return self.meta[COLUMNS.index(name):self.rows * len(COLUMNS):len(COLUMNS)]
+
+    def row(self, i):
+        """Payload of frame i as signed values (the padded row, width long)."""
+        return self.payload[i * self.width:(i + 1) * self.width]
+
+    def mac_text(self, i):
+        return ':'.join(f'{b:02x}' for b in self.mac[i].to_bytes(6, 'big'))
+
+    def shrink(self):
+        """Drops the unused capacity; the Frames is read-only afterwards."""
+        n = self.rows
+        self._out = _Out(None, self.width, None, None, None, n, n, self.skipped, self.truncated)
+        del self.payload[n * self.width:]
+        del self.meta[n * len(COLUMNS):]
+        del self.mac[n:]
+        del self.host_time[n:]
+        self.capacity = n
+        return self
+
+
+def parse_payload(text, cap=MAX_PAYLOAD):
+    """Values of a "[a,b,...]" string as array('b'); raises ValueError if it is malformed."""
+    data = text.encode('ascii') if isinstance(text, str) else text
+    out = array('b', bytes(cap))
+    n = load_library().csi_parse_payload(data, len(data), out.buffer_info()[0], cap)
+    if n < 0 or n > cap:
+        raise ValueError("malformed payload list" if n < 0 else f"more than {cap} values")
+    del out[n:]
+    return out
+
+
+def iter_lines(path, width=DEFAULT_WIDTH, chunk_rows=CHUNK_ROWS):
+    """Frames of at most chunk_rows CSI_DATA lines each from a text file; other lines are ignored."""
+    lib = load_library()
+    frames = Frames(chunk_rows, width)
+    pending = b''
+    with open(path, 'rb') as f:
+        while True:
+            data = f.read(READ_BYTES)
+            eof = not data
+            pending += data if not eof else (b'\n' if pending and not pending.endswith(b'\n') else b'')
+            while True:
+                used = lib.csi_parse_lines(pending, len(pending), frames._out)
+                pending = pending[used:]
+                if not frames.full:
+                    break
+                yield frames
+                frames = Frames(chunk_rows, width)
+            if eof:
+                break
+    if frames.rows or frames.skipped:
+        yield frames.shrink()
+
+
+def parse_lines(text, width=DEFAULT_WIDTH):
+    """Frames of every CSI_DATA line in text (str or bytes); other lines are ignored."""
+    data = text.encode('ascii', 'replace') if isinstance(text, str) else bytes(text)
+    if data and not data.endswith(b'\n'):
+        data += b'\n'
+    frames = Frames(data.count(b'\n'), width)
+    load_library().csi_parse_lines(data, len(data), frames._out)
+    return frames.shrink()
+
+
+class _Table:
+    def __init__(self, path, table, scenario):
+        self.lib = load_library()
+        err = ctypes.create_string_buffer(256)
+        self.handle = self.lib.csi_parse_db_open(os.fsencode(path), table.encode() if table else None,
+                                                 scenario.encode() if scenario else None, err, len(err))
+        if not self.handle:
+            raise OSError(err.value.decode(errors='replace'))
+
+    def close(self):
+        if self.handle:
+            self.lib.csi_parse_db_close(self.handle)
+            self.handle = None
+
+
+def iter_table(path, table='csi_data', scenario=None, width=None, chunk_rows=CHUNK_ROWS):
+    """
+    Frames of at most chunk_rows rows each, streamed from a table of a session
+    database. width defaults to the largest len recorded in the table.
+    """
+    source = _Table(path, table, scenario)
+    try:
+        if width is None:
+            width = source.lib.csi_parse_db_max_len(source.handle) or DEFAULT_WIDTH
+        while True:
+            frames = Frames(chunk_rows, width)
+            source.lib.csi_parse_db_read(source.handle, frames._out)
+            if not frames.full:
+                if frames.rows or frames.skipped:
+                    yield frames.shrink()
+                return
+            yield frames
+    finally:
+        source.close()
+
+
+def load_table(path, table='csi_data', scenario=None, width=None):
+    """A whole table of a session database as one Frames, allocated once from its row count."""
+    source = _Table(path, table, scenario)
+    try:
+        if width is None:
+            width = source.lib.csi_parse_db_max_len(source.handle) or DEFAULT_WIDTH
+        frames = Frames(source.lib.csi_parse_db_rows(source.handle), width)
+        source.lib.csi_parse_db_read(source.handle, frames._out)
+        return frames.shrink()
+    finally:
+        source.close()
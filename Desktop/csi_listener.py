@@ -0,0 +1,349 @@
+# -*- coding: utf-8 -*-
+"""
+UDP listener of the desktop collector.
+
+udp_listener_thread is the acquisition loop the collector UI runs in a thread:
+it sends the 'start' command to every selected node until it answers, echoes
+traffic generator probes, decodes every datagram to CSI_DATA lines and hands
+them to a SessionWriter, tagged with the node's address. All nodes share one
+port and one non-blocking receive loop. Progress is reported as
+(message_type, data) tuples put on an events queue, which the UI drains; per
+node, ("node_rate", (node_ip, summary line)) gives the rate and sequence
+losses once per second and ("node_stats", (node_ip, summary line)) the node's
+own health report.
+
+Clock sync requests (csi_clock.h) are answered with this host's wall clock as
+the shared timebase. Once a node has reported its clock mapping, its frames
+are stored with their capture time on that timebase (csi_frame.sync_time), so
+the frames of every node line up to well under a millisecond.
+
+The wake report a node sends after its first frame (csi_link.h) is logged:
+whether it resumed on its retained connection state and how long each wake
+phase took.
+
+A schedule command (csi_schedule.h) instead of a start command is resent until
+each node acknowledges the plan with a CSI_SCHED report rather than until its
+first frame, since the first window may be hours away. The listener is armed
+for the plan's windows: it announces each one, reports per window how many
+frames each node sent and which nodes missed it, and stops on its own after
+the last one. A "schedule,cancel" command stops once every node confirmed it.
+
+A node capturing several transmitters (the src option, csi_sources.h) sends
+one stream per transmitter, each with its own sequence numbers: losses and
+rates are followed per stream and reported per transmitter.
+
+With nack set, frames missing from a stream's sequence numbers are asked for
+again with CSI_NACK datagrams (csi_history.h) naming its transmitter, to the
+address its frames come from; resent frames are stored like the others,
+late, and the per-node summary adds how many were recovered and given up.
+
+Run as a script, the same loop records one session without the UI, which is
+what the end-to-end benchmark (native/tools/csi_e2e_bench.cpp) drives:
+
+    python csi_listener.py --port 50001 --db bench.db [--esp-ip 192.168.1.50 [--esp-ip ...] --start start,60]
+                           [--schedule IN_S,EVERY_S,COUNT] [--nack]
+
+The session is closed as 'complete' on SIGINT or SIGTERM.
+"""
+import argparse
+import selectors
+import signal
+import socket
+import sys
+import threading
+import time
+
+from csi_protocol import (DatagramDecoder, MAX_DATAGRAM_SIZE, clock_to_shared, hist_percentile, is_probe,
+                          format_schedule_command, parse_clock_report, parse_rate_report, parse_schedule_command,
+                          parse_schedule_report, parse_stats_report, parse_wake_report, schedule_windows, sync_reply)
+from csi_nodes import NackTracker, NodeTracker, PlanTracker
+from csi_store import SessionWriter
+
+
+def describe_stats(report, previous=None):
+    """
+    One-line summary of a CSI_STATS report: where the frames of the interval
+    since the previous report went, ring occupancy, and callback duration and
+    inter-frame interval percentiles over the interval.
+    """
+    def delta(key):
+        return report[key] - previous[key] if previous else report[key]
+
+    def hist(key):
+        if not previous:
+            return report[key]
+        return [a - b for a, b in zip(report[key], previous[key])]
+
+    callback, interval = hist('callback_us'), hist('interval_us')
+    return (f"seen {delta('seen')}  filtered {delta('filtered')}  truncated {delta('truncated')}  "
+            f"decimated {delta('decimated')}  ring full {delta('ring_full')}  sent {delta('sent')}  "
+            f"send failed {delta('send_failed')}  resent {delta('resent')}  queue {report['queue_depth']}/{report['queue_high']}  "
+            f"callback p50/p99 <{hist_percentile(callback, 50)}/<{hist_percentile(callback, 99)} us  "
+            f"interval p50/p99 <{hist_percentile(interval, 50)}/<{hist_percentile(interval, 99)} us")
+
+
+def udp_listener_thread(esp_ips, start_message, local_port, stop_event, writer, events, nack=False, live=None,
+                        raw_log=True):
+    """
+    A thread that listens for CSI packets of every node in esp_ips on one
+    socket, dispatches 'start' commands, streams the data to the session writer
+    and reports it on the events queue. esp_ips is a list of node addresses (a
+    single address string is accepted too); when empty no command is sent and
+    any sender is recorded (the nodes are already streaming). nack asks the
+    nodes to resend the frames lost on the way. Every frame goes to live
+    (csi_live.LiveView) if given, and as a "log_csi" event only with raw_log.
+    """
+    if isinstance(esp_ips, str):
+        esp_ips = [esp_ips]
+    esp_ips = [ip for ip in (esp_ips or []) if ip]
+    events.put(("log_system", f"Initiating listener on port {local_port}..."))
+    listen_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    try:
+        listen_socket.bind(('', int(local_port)))
+        listen_socket.setblocking(False)
+    except Exception as e:
+        events.put(("error", f"Error binding to port {local_port}: {e}"))
+        writer.flush()
+        events.put(("collection_finished", 0))
+        return
+
+    events.put(("log_system", f"Awaiting CSI data from {', '.join(esp_ips) or 'any node'}..."))
+    pending = set(esp_ips)    # nodes still waiting for their start command to take effect
+    plan = parse_schedule_command(start_message or '')
+    plan_tracker = None
+    if plan and not plan.get('cancel'):
+        plan_tracker = PlanTracker(schedule_windows(plan), esp_ips)
+        first = plan['first_start_us'] / 1e6
+        events.put(("log_system", f"Plan {plan['id']}: {plan['count']} windows of {plan['duration_s']} s every "
+                                  f"{plan['interval_s']} s, the first at {time.strftime('%H:%M:%S', time.localtime(first))}"
+                                  f" (in {first - time.time():.0f} s)"))
+    command_send_time = 0
+    decoders = {}             # one decoder per node: delta references are per stream
+    trackers = {}             # NodeTracker per (node, transmitter MAC): each numbers its frames on its own
+    nacks = {}                # NackTracker and frame source address per (node, MAC), with nack set
+    last_stats = {}           # latest CSI_STATS report per node address
+    clocks = {}               # latest CSI_CLOCK report per node address
+    selector = selectors.DefaultSelector()
+    selector.register(listen_socket, selectors.EVENT_READ)
+
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as command_socket:
+        while not stop_event.is_set():
+            if plan_tracker:
+                for message in plan_tracker.poll(time.time_ns() // 1000):
+                    events.put(("log_system", message))
+                if plan_tracker.done():
+                    events.put(("log_system", f"Plan {plan['id']} finished, {plan_tracker.missed} windows missed"))
+                    break
+            elif plan and not pending:
+                break  # every node confirmed the cancel
+            # Persistently send the 'start' command until each node's first data packet is received
+            # (or, for a schedule, until it acknowledges the plan).
+            if pending and time.time() - command_send_time > 3: # Send every 3 seconds
+                for ip in sorted(pending):
+                    try:
+                        command_socket.sendto(start_message.encode('utf-8'), (ip, 50000))
+                        events.put(("log_system", f"Command '{start_message}' dispatched to {ip}"))
+                    except Exception as e:
+                        events.put(("log_system", f"Error sending 'start' command to {ip}: {e}"))
+                command_send_time = time.time()
+
+            if not selector.select(timeout=0.2):
+                continue
+            # Drain everything queued on the socket before the next select.
+            while True:
+                try:
+                    data, addr = listen_socket.recvfrom(MAX_DATAGRAM_SIZE)
+                    received_us = time.time_ns() // 1000
+                except (BlockingIOError, InterruptedError):
+                    break
+                except Exception as e:
+                    events.put(("log_system", f"Error receiving data: {e}"))
+                    stop_event.set()
+                    break
+                node = addr[0]
+                # Traffic generator datagrams (csi_traffic.h): echo UDP probes, show rate reports.
+                if is_probe(data):
+                    listen_socket.sendto(data, addr)
+                    continue
+                reply = sync_reply(data, received_us)
+                if reply is not None:
+                    listen_socket.sendto(reply, addr)
+                    continue
+                clock = parse_clock_report(data)
+                if clock is not None:
+                    if node not in clocks:
+                        events.put(("log_system", f"Node {node} clock synced, rate correction "
+                                                  f"{clock['drift_ppb'] / 1000:+.1f} ppm, "
+                                                  f"error <{clock['error_us']} us"))
+                    clocks[node] = clock
+                    continue
+                wake = parse_wake_report(data)
+                if wake is not None:
+                    path = 'fast resume' if wake['mode'] == 'fast' and not wake['fell_back'] else (
+                        'full connect after failed fast resume' if wake['fell_back'] else 'full connect')
+                    events.put(("log_system", f"Node {node} wake {wake['wakes']}: {path}, address at "
+                                              f"{wake['ip_ms']} ms, first frame at {wake['first_frame_ms']} ms "
+                                              f"after boot"))
+                    continue
+                sched = parse_schedule_report(data)
+                if sched is not None:
+                    acked = sched['id'] == plan.get('id') if plan and not plan.get('cancel') else not sched['count']
+                    if plan and node in pending and acked:
+                        events.put(("log_system", f"Node {node} acknowledged the plan. Halting its command."))
+                        pending.discard(node)
+                    if not sched['count']:
+                        events.put(("log_system", f"Node {node} plan {sched['id']} cancelled"))
+                    elif sched['index'] == sched['count']:
+                        events.put(("log_system", f"Node {node} plan {sched['id']} done"))
+                    else:
+                        events.put(("log_system", f"Node {node} plan {sched['id']}: window {sched['index'] + 1}/"
+                                                  f"{sched['count']} in {sched['start_us'] / 1e6 - time.time():.0f} s"))
+                    continue
+                report = parse_rate_report(data)
+                if report is not None:
+                    events.put(("log_system", f"Node {node} CSI rate {report['achieved_hz']:.1f}/{report['target_hz']} Hz, "
+                                              f"jitter {report['jitter_us']} us, {report['probe']} probe every "
+                                              f"{report['interval_us']} us"))
+                    continue
+                stats = parse_stats_report(data)
+                if stats is not None:
+                    # A report older than the last one means the node rebooted.
+                    previous = last_stats.get(node)
+                    if previous and stats['uptime_ms'] < previous['uptime_ms']:
+                        previous = None
+                    last_stats[node] = stats
+                    events.put(("node_stats", (node, describe_stats(stats, previous))))
+                    continue
+                if not writer.accepts(node):
+                    continue
+                decoder = decoders.get(node)
+                if decoder is None:
+                    decoder = decoders[node] = DatagramDecoder()
+                # Text, binary, batched and delta frames are all normalised to CSI_DATA lines.
+                if plan_tracker:
+                    plan_tracker.add(node, received_us)
+                for decoded_data in decoder.decode(data):
+                    if node in pending and not plan:
+                        events.put(("log_system", f"Initial CSI packet received from {node}. Halting its 'start' command."))
+                        pending.discard(node)
+                    fields = decoded_data.split(',', 20)
+                    try:
+                        stream, seq = (node, fields[2]), int(fields[1])
+                    except (IndexError, ValueError):
+                        stream = None
+                    if stream:
+                        tracker = trackers.get(stream)
+                        if tracker is None:
+                            tracker = trackers[stream] = NodeTracker(node)
+                        tracker.add(seq)
+                        if nack:
+                            entry = nacks.setdefault(stream, [NackTracker(), addr])
+                            entry[1] = addr
+                            entry[0].on_frame(seq, received_us)
+                    sync_time = None
+                    if node in clocks:
+                        try:
+                            sync_time = clock_to_shared(clocks[node], int(fields[18])) / 1e6
+                        except (IndexError, ValueError):
+                            pass
+
+                    if live is not None:
+                        live.add(node, decoded_data)
+                    if raw_log:
+                        events.put(("log_csi", decoded_data))
+                    writer.submit(decoded_data, node, sync_time) # Persisted in the background as it arrives
+
+            now_us = time.time_ns() // 1000
+            for (_, mac), (nack_tracker, addr) in nacks.items():
+                message = nack_tracker.poll(now_us, mac)
+                if message:
+                    try:
+                        listen_socket.sendto(message, addr)
+                    except OSError:
+                        pass
+            now = time.monotonic()
+            streams = {}
+            for (node, mac), tracker in trackers.items():
+                streams.setdefault(node, []).append((mac, tracker))
+            for node, node_streams in streams.items():
+                if not node_streams[0][1].due(now):
+                    continue
+                if len(node_streams) == 1:
+                    summary = node_streams[0][1].report(now)
+                else:
+                    summary = "\n    ".join(f"{mac}  {tracker.report(now)}" for mac, tracker in sorted(node_streams))
+                events.put(("node_rate", (node, summary)))
+
+    selector.close()
+    listen_socket.close()
+    writer.flush()
+    sources = {}
+    for node, _ in trackers:
+        sources[node] = sources.get(node, 0) + 1
+    for (node, mac), tracker in sorted(trackers.items()):
+        recovery = nacks.get((node, mac), [None])[0]
+        name = f"{node} from {mac}" if sources[node] > 1 else node
+        events.put(("log_system", f"Node {name}: {tracker.frames} frames, {tracker.lost} lost"
+                                  + (f", {tracker.restarts} restarts" if tracker.restarts else "")
+                                  + (f", {recovery.recovered} recovered, {recovery.abandoned + recovery.outstanding()}"
+                                     f" given up after {recovery.nacks} NACKs" if recovery else "")))
+    events.put(("log_system", f"{writer.frames_written} frames written to "
+                              + (f"session #{writer.session_id}" if len(writer.session_ids) == 1
+                                 else f"sessions #{', #'.join(str(i) for i in writer.session_ids.values())}")
+                              + (f", {writer.frames_dropped} dropped" if writer.frames_dropped else "")))
+    desync = sum(decoder.delta.desync for decoder in decoders.values())
+    if desync:
+        events.put(("log_system", f"{desync} compressed frames lost their keyframe and were skipped"))
+    if writer.error:
+        events.put(("log_system", f"Database error during acquisition: {writer.error}"))
+    events.put(("collection_finished", writer.frames_written))
+
+
+class ConsoleEvents:
+    """Events sink for headless runs: prints system messages, counts CSI lines."""
+
+    def __init__(self):
+        self.frames = 0
+
+    def put(self, event):
+        message_type, data = event
+        if message_type == "log_csi":
+            self.frames += 1
+        elif message_type in ("log_system", "error"):
+            print(data, file=sys.stderr, flush=True)
+        elif message_type in ("node_stats", "node_rate"):
+            print(f"Node {data[0]}: {data[1]}", file=sys.stderr, flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Record one CSI session without the collector UI.")
+    parser.add_argument("--port", type=int, default=50001, help="UDP port the node streams to")
+    parser.add_argument("--db", required=True, help="session database (created if missing)")
+    parser.add_argument("--esp-ip", action="append", default=[],
+                        help="node to send the start command to; repeat for several nodes, one session each")
+    parser.add_argument("--start", default="start,60", help="start command sent to every --esp-ip")
+    parser.add_argument("--schedule", metavar="IN_S,EVERY_S,COUNT",
+                        help="instead of starting now, run --start in COUNT windows EVERY_S apart, the first in IN_S")
+    parser.add_argument("--nack", action="store_true", help="ask the nodes to resend lost frames (csi_history.h)")
+    parser.add_argument("--scenario", default="N/A")
+    args = parser.parse_args()
+    if args.schedule:
+        try:
+            in_s, every_s, count = (int(v) for v in args.schedule.split(','))
+            now_us = time.time_ns() // 1000
+            args.start = format_schedule_command(now_us // 1_000_000 % (1 << 32), now_us + in_s * 1_000_000,
+                                                 every_s, count, args.start)
+        except ValueError as e:
+            parser.error(f"--schedule: {e}")
+
+    stop_event = threading.Event()
+    for signum in (signal.SIGINT, signal.SIGTERM):
+        signal.signal(signum, lambda *_: stop_event.set())
+
+    writer = SessionWriter(args.db, args.scenario, args.start if args.esp_ip else None, args.esp_ip or None)
+    udp_listener_thread(args.esp_ip, args.start, args.port, stop_event, writer, ConsoleEvents(), args.nack)
+    writer.finish('complete')
+
+
+if __name__ == '__main__':
+    main()
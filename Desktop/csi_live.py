@@ -0,0 +1,209 @@
+# -*- coding: utf-8 -*-
+"""
+Live view of an acquisition for the collector's console.
+
+LiveView takes every CSI_DATA line from the receive loop (add) and keeps, per
+stream (node and transmitter MAC, csi_sources.h), a fixed-size ring of
+amplitude rows plus one rate and one RSSI sample per second. The UI renders it
+(render) at a rate of its own choosing into small PNG images: a waterfall
+heatmap of the subcarrier amplitudes, newest row on top, and two sparklines.
+
+Both sides are bounded whatever the packet rate: a stream takes at most
+ROW_HZ rows per second into its ring and ignores the payload of the frames in
+between, the ring and the sparklines have fixed lengths, at most MAX_STREAMS
+streams are kept, and a render only encodes the streams that changed since
+the previous one. The images are built with zlib alone.
+"""
+import base64
+import math
+import struct
+import threading
+import time
+import zlib
+from collections import deque
+
+ROWS = 150              # heatmap height: ROWS / ROW_HZ seconds of history
+ROW_HZ = 25             # rows per second and stream; frames in between only count
+SPARK_SECONDS = 120
+SPARK_HEIGHT = 24
+MAX_STREAMS = 16
+MAX_PAIRS = 128         # CSI_CAPTURE_MAX_PAIRS
+
+# Dark blue through teal to yellow, 256 entries.
+_STOPS = ((0, (13, 8, 135)), (64, (33, 102, 172)), (128, (32, 164, 134)), (192, (134, 213, 73)),
+          (255, (253, 231, 37)))
+
+
+def _palette():
+    colors = bytearray()
+    for i in range(256):
+        for (x0, c0), (x1, c1) in zip(_STOPS, _STOPS[1:]):
+            if i <= x1:
+                t = (i - x0) / (x1 - x0)
+                colors += bytes(round(a + (b - a) * t) for a, b in zip(c0, c1))
+                break
+    return bytes(colors)
+
+
+HEAT_PALETTE = _palette()
+SPARK_PALETTE = bytes((0, 0, 0, 77, 208, 225))     # background, line (cyan)
+
+
+def encode_png(width, height, rows, palette):
+    """8-bit palette PNG of height rows of width palette indices each (bytes-like)."""
+    def chunk(kind, data):
+        return struct.pack('>I', len(data)) + kind + data + struct.pack('>I', zlib.crc32(kind + data))
+
+    raw = b''.join(b'\x00' + bytes(row) for row in rows)
+    return (b'\x89PNG\r\n\x1a\n'
+            + chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, 8, 3, 0, 0, 0))
+            + chunk(b'PLTE', palette)
+            + chunk(b'IDAT', zlib.compress(raw, 1))
+            + chunk(b'IEND', b''))
+
+
+def sparkline(values, width=SPARK_SECONDS, height=SPARK_HEIGHT):
+    """PNG of the last width values scaled to their own range, right-aligned."""
+    values = list(values)[-width:]
+    rows = [bytearray(width) for _ in range(height)]
+    if values:
+        low, high = min(values), max(values)
+        offset = width - len(values)
+        previous = None
+        for x, v in enumerate(values):
+            # A flat line sits in the middle.
+            y = height - 1 - round((v - low) * (height - 1) / (high - low)) if high > low else height // 2
+            # Join the points vertically so steep changes stay visible.
+            p = y if previous is None else previous
+            for yy in range(min(y, p), max(y, p) + 1):
+                rows[yy][offset + x] = 1
+            previous = y
+    return encode_png(width, height, rows, SPARK_PALETTE)
+
+
+class _Stream:
+    def __init__(self):
+        self.rows = deque(maxlen=ROWS)  # amplitude rows, newest last
+        self.width = 0
+        self.next_row = 0.0
+        self.rate = deque(maxlen=SPARK_SECONDS)
+        self.rssi = deque(maxlen=SPARK_SECONDS)
+        self.second = None
+        self.frames = 0                 # in the current second
+        self.rssi_sum = 0
+        self.total = 0
+        self.last_rssi = None
+        self.dirty = False
+
+
+class LiveView:
+    """Bounded per-stream state of the live console; add and render may run on different threads."""
+
+    def __init__(self, amplitude_payload=False):
+        # With mode=amp (csi_capture.h) the payload holds amplitudes, not I/Q pairs.
+        self.amplitude_payload = amplitude_payload
+        self.dropped_streams = 0
+        self._streams = {}
+        self._lock = threading.Lock()
+
+    def add(self, node, line, now=None):
+        """Accounts for one CSI_DATA line of node; takes its payload as a heatmap row at most ROW_HZ times a second."""
+        now = time.monotonic() if now is None else now
+        try:
+            _, _, mac, rssi, _ = line.split(',', 4)
+            rssi = int(rssi)
+        except ValueError:
+            return
+        with self._lock:
+            stream = self._streams.get((node, mac))
+            if stream is None:
+                if len(self._streams) == MAX_STREAMS:
+                    self.dropped_streams += 1
+                    return
+                stream = self._streams[(node, mac)] = _Stream()
+            self._roll(stream, now)
+            stream.frames += 1
+            stream.total += 1
+            stream.rssi_sum += rssi
+            stream.last_rssi = rssi
+            if now < stream.next_row:
+                return
+            stream.next_row = max(stream.next_row + 1 / ROW_HZ, now)
+        row = self._amplitudes(line)
+        if row is None:
+            return
+        with self._lock:
+            if len(row) != stream.width:
+                stream.rows.clear()
+                stream.width = len(row)
+            stream.rows.append(row)
+            stream.dirty = True
+
+    def _amplitudes(self, line):
+        start = line.find('"[')
+        if start < 0 or not line.endswith(']"'):
+            return None
+        try:
+            values = list(map(int, line[start + 2:-2].split(','))) if line[start + 2:-2] else []
+        except ValueError:
+            return None
+        if self.amplitude_payload:
+            row = bytes(min(max(v, 0), 255) for v in values[:MAX_PAIRS])
+        else:
+            row = bytes(min(int(math.hypot(values[i], values[i + 1])), 255)
+                        for i in range(0, min(len(values) - 1, 2 * MAX_PAIRS), 2))
+        return row or None
+
+    @staticmethod
+    def _roll(stream, now):
+        second = int(now)
+        if stream.second is None:
+            stream.second = second
+        # One sample per elapsed second; a silent stream shows as zero rate.
+        for _ in range(min(second - stream.second, SPARK_SECONDS)):
+            stream.rate.append(stream.frames)
+            stream.rssi.append(stream.rssi_sum / stream.frames if stream.frames else
+                               (stream.rssi[-1] if stream.rssi else 0))
+            stream.frames = stream.rssi_sum = 0
+            stream.dirty = True
+        stream.second = max(stream.second, second)
+
+    def render(self, now=None):
+        """
+        The streams that changed since the previous call, as a list of dicts
+        with key (node, mac), frames, rssi, rate_hz and the base64 PNGs heatmap
+        (None before the first row), rate and rssi_line.
+        """
+        now = time.monotonic() if now is None else now
+        changed = []
+        with self._lock:
+            for key, stream in self._streams.items():
+                self._roll(stream, now)
+                if not stream.dirty:
+                    continue
+                stream.dirty = False
+                changed.append((key, list(stream.rows), stream.width, list(stream.rate), list(stream.rssi),
+                                stream.total, stream.last_rssi))
+        views = []
+        for key, rows, width, rate, rssi, total, last_rssi in sorted(changed):
+            heatmap = None
+            if rows:
+                top = max(max(row) for row in rows) or 1
+                scale = bytes(min(v * 255 // top, 255) for v in range(256))
+                rows = [row.translate(scale) for row in reversed(rows)]
+                heatmap = base64.b64encode(encode_png(width, len(rows), rows, HEAT_PALETTE)).decode('ascii')
+            views.append({
+                'key': key,
+                'frames': total,
+                'rssi': last_rssi,
+                'rate_hz': rate[-1] if rate else 0,
+                'heatmap': heatmap,
+                'rate': base64.b64encode(sparkline(rate)).decode('ascii'),
+                'rssi_line': base64.b64encode(sparkline(rssi)).decode('ascii'),
+            })
+        return views
+
+    def clear(self):
+        with self._lock:
+            self._streams.clear()
+            self.dropped_streams = 0
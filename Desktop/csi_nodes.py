@@ -0,0 +1,287 @@
+# -*- coding: utf-8 -*-
+"""
+Multi-node bookkeeping of the desktop collector.
+
+NodeRegistry keeps listening for the "CSI_IP,<ip>" broadcasts every node sends
+after joining the network (send_ip_broadcast_task in the firmware), so nodes
+that boot late or wake up from deep sleep between acquisitions are picked up
+too. It posts ("discovery_listening", port) once its socket is bound, then
+reports each new address once on the events queue as ("ip_discovered", ip).
+
+NodeTracker follows one stream of a node during an acquisition, that of one
+transmitter it captures (csi_sources.h): frames, losses
+from sequence gaps, late frames and restarts, with the same rules as the
+native ingest daemon (csi_ingestd), plus the frame rate since the last report.
+
+NackTracker keeps the gaps in one such stream's sequence numbers and says when to
+ask for which of them again (csi_history.h), with the timing of the native
+csi_nack_tracker_t.
+
+PlanTracker follows a plan of scheduled acquisition windows (csi_schedule.h)
+on the collector's side: it announces each window as it opens, counts every
+node's frames per window and reports the nodes that missed one once it closes.
+"""
+import socket
+import threading
+import time
+
+from csi_protocol import NACK_MAX_RANGES, format_nack
+
+BROADCAST_PORT = 50002
+IP_PREFIX = "CSI_IP,"
+# A backwards sequence jump at least this large is a node reboot, not a late frame.
+RESTART_JUMP = 1024
+
+
+class NodeRegistry:
+    """Background listener collecting the addresses of the nodes on the network."""
+
+    def __init__(self, events, port=BROADCAST_PORT):
+        self.events = events
+        self.port = port
+        self._nodes = {}  # ip -> time.time() of the last broadcast
+        self._lock = threading.Lock()
+        self._stop = threading.Event()
+        self._thread = None
+
+    def start(self):
+        """Starts listening; does nothing if the registry is already running."""
+        if self._thread and self._thread.is_alive():
+            return
+        self._stop.clear()
+        self._thread = threading.Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    def stop(self):
+        self._stop.set()
+
+    @property
+    def running(self):
+        return bool(self._thread and self._thread.is_alive())
+
+    def nodes(self):
+        """Known node addresses with the time of their last broadcast, sorted by address."""
+        with self._lock:
+            return sorted(self._nodes.items(), key=lambda item: socket.inet_aton(item[0]))
+
+    def _run(self):
+        with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+            s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+            s.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+            try:
+                s.bind(("0.0.0.0", self.port))
+                s.settimeout(1.0)
+            except Exception as e:
+                self.events.put(("log_system", f"ERROR: Failed to listen for broadcast: {e}"))
+                self.events.put(("discovery_failed", "Error initiating listener."))
+                return
+            self.events.put(("log_system", f"Listening for nodes on port {self.port}..."))
+            self.events.put(("discovery_listening", self.port))
+
+            while not self._stop.is_set():
+                try:
+                    data, addr = s.recvfrom(1024)
+                except socket.timeout:
+                    continue
+                except Exception as e:
+                    self.events.put(("log_system", f"ERROR in discovery thread: {e}"))
+                    continue
+                message = data.decode('utf-8', errors='ignore')
+                if not message.startswith(IP_PREFIX):
+                    continue
+                ip = message[len(IP_PREFIX):].strip()
+                try:
+                    socket.inet_aton(ip)
+                except OSError:
+                    continue
+                with self._lock:
+                    known = ip in self._nodes
+                    self._nodes[ip] = time.time()
+                if not known:
+                    self.events.put(("ip_discovered", ip))
+        self.events.put(("log_system", "Discovery thread terminated."))
+
+
+class NodeTracker:
+    """Per-node frame, loss and rate accounting from the sequence numbers of its frames."""
+
+    def __init__(self, ip):
+        self.ip = ip
+        self.frames = 0
+        self.lost = 0
+        self.reordered = 0
+        self.restarts = 0
+        self.last_seq = 0
+        self._window_frames = 0
+        self._window_start = time.monotonic()
+
+    def add(self, seq):
+        if self.frames:
+            delta = (seq - self.last_seq + (1 << 31)) % (1 << 32) - (1 << 31)
+            if delta > 0:
+                self.lost += delta - 1
+                self.last_seq = seq
+            elif -RESTART_JUMP < delta < 0:
+                # A late frame fills a gap that was already counted as lost.
+                self.reordered += 1
+                self.lost = max(self.lost - 1, 0)
+            elif delta <= -RESTART_JUMP:
+                self.restarts += 1
+                self.last_seq = seq
+        else:
+            self.last_seq = seq
+        self.frames += 1
+        self._window_frames += 1
+
+    def due(self, now, interval=1.0):
+        return now - self._window_start >= interval
+
+    def report(self, now):
+        """Summary line of the stream; the rate covers the time since the previous report."""
+        elapsed = now - self._window_start
+        rate = self._window_frames / elapsed if elapsed > 0 else 0.0
+        self._window_frames = 0
+        self._window_start = now
+        expected = self.frames + self.lost
+        return (f"{rate:6.1f} fps  frames {self.frames}  lost {self.lost} "
+                f"({100 * self.lost / expected if expected else 0:.2f}%)"
+                + (f"  late {self.reordered}" if self.reordered else "")
+                + (f"  restarts {self.restarts}" if self.restarts else ""))
+
+
+class NackTracker:
+    """Open sequence gaps of one node's transmitter and the NACKs that ask for them (csi_history.h)."""
+
+    DELAY_US = 20_000       # a gap is first requested this long after it shows, so reordering does not count
+    RETRY_US = 150_000
+    MAX_TRIES = 4
+    MAX_GAPS = 64
+    MAX_SPAN = 1024         # further back than any node history
+
+    def __init__(self):
+        self.gaps = []          # [first, last, due_us, tries], oldest first
+        self.next_seq = None
+        self.recovered = 0
+        self.abandoned = 0
+        self.nacks = 0
+
+    def _add_gap(self, gap):
+        if len(self.gaps) == self.MAX_GAPS:
+            oldest = self.gaps.pop(0)
+            self.abandoned += oldest[1] - oldest[0] + 1
+        self.gaps.append(gap)
+
+    def on_frame(self, seq, now_us):
+        """Accounts for a received frame; True if it filled a gap (a late or resent frame)."""
+        if self.next_seq is None:
+            self.next_seq = (seq + 1) & 0xFFFFFFFF
+            return False
+        delta = (seq - self.next_seq + (1 << 31)) % (1 << 32) - (1 << 31)
+        if delta >= 0:
+            if delta > 0:
+                first = self.next_seq
+                if delta > self.MAX_SPAN:
+                    self.abandoned += delta - self.MAX_SPAN
+                    first = (seq - self.MAX_SPAN) & 0xFFFFFFFF
+                self._add_gap([first, (seq - 1) & 0xFFFFFFFF, now_us + self.DELAY_US, 0])
+            self.next_seq = (seq + 1) & 0xFFFFFFFF
+            return False
+        if delta < -self.MAX_SPAN:
+            # The node restarted its sequence: nothing before can be asked for.
+            self.abandoned += self.outstanding()
+            self.gaps = []
+            self.next_seq = (seq + 1) & 0xFFFFFFFF
+            return False
+        for i, gap in enumerate(self.gaps):
+            first, last = gap[0], gap[1]
+            if (seq - first) & 0xFFFFFFFF > (last - first) & 0xFFFFFFFF:
+                continue
+            self.recovered += 1
+            if first == last:
+                del self.gaps[i]
+            elif seq == first:
+                gap[0] = (seq + 1) & 0xFFFFFFFF
+            elif seq == last:
+                gap[1] = (seq - 1) & 0xFFFFFFFF
+            else:
+                self.gaps.insert(i + 1, [(seq + 1) & 0xFFFFFFFF, last, gap[2], gap[3]])
+                gap[1] = (seq - 1) & 0xFFFFFFFF
+                if len(self.gaps) > self.MAX_GAPS:
+                    oldest = self.gaps.pop(0)
+                    self.abandoned += oldest[1] - oldest[0] + 1
+            return True
+        return False  # a duplicate
+
+    def poll(self, now_us, mac=None):
+        """
+        The NACK datagram for the gaps due at now_us, or None, naming the
+        transmitter mac if given. Gaps asked for MAX_TRIES times are given up.
+        """
+        ranges = []
+        kept = []
+        for gap in self.gaps:
+            if gap[2] <= now_us and gap[3] >= self.MAX_TRIES:
+                self.abandoned += gap[1] - gap[0] + 1
+                continue
+            if gap[2] <= now_us and len(ranges) < NACK_MAX_RANGES:
+                ranges.append((gap[0], gap[1]))
+                gap[2] = now_us + self.RETRY_US
+                gap[3] += 1
+            kept.append(gap)
+        self.gaps = kept
+        if not ranges:
+            return None
+        self.nacks += 1
+        return format_nack(ranges, mac)
+
+    def outstanding(self):
+        """Frames in the gaps still open."""
+        return sum(((last - first) & 0xFFFFFFFF) + 1 for first, last, _, _ in self.gaps)
+
+
+class PlanTracker:
+    """Per-window frame accounting of a scheduled acquisition, against the collector's wall clock."""
+
+    # Frames of a window can still be in flight, and a node's clock is off by a little, after it ends.
+    GRACE_US = 2_000_000
+
+    def __init__(self, windows, nodes):
+        self.windows = windows                 # (start_us, end_us) per window
+        self.nodes = list(nodes)
+        self.frames = [dict() for _ in windows]
+        self.missed = 0
+        self._opened = 0
+        self._closed = 0
+
+    def add(self, node, received_us):
+        for i in range(self._closed, len(self.windows)):
+            start, end = self.windows[i]
+            if start - self.GRACE_US <= received_us <= end + self.GRACE_US:
+                self.frames[i][node] = self.frames[i].get(node, 0) + 1
+                return
+            if received_us < start:
+                return
+
+    def next_start_us(self):
+        """Start of the next window not yet open, or None."""
+        return self.windows[self._opened][0] if self._opened < len(self.windows) else None
+
+    def poll(self, now_us):
+        """Messages for the windows that opened or closed since the last call."""
+        messages = []
+        count = len(self.windows)
+        while self._opened < count and now_us >= self.windows[self._opened][0]:
+            self._opened += 1
+            messages.append(f"Window {self._opened}/{count} open")
+        while self._closed < self._opened and now_us >= self.windows[self._closed][1] + self.GRACE_US:
+            frames = self.frames[self._closed]
+            self._closed += 1
+            missing = [node for node in self.nodes if not frames.get(node)]
+            self.missed += len(missing)
+            messages.append(f"Window {self._closed}/{count} closed: "
+                            + (", ".join(f"{node} {n} frames" for node, n in sorted(frames.items())) or "no frames")
+                            + (f"; missed by {', '.join(missing)}" if missing else ""))
+        return messages
+
+    def done(self):
+        return self._closed == len(self.windows)
@@ -0,0 +1,577 @@
+# -*- coding: utf-8 -*-
+"""
+Decoding of the datagrams emitted by the ESP32 receiver node.
+
+The node sends either the legacy "CSI_DATA,..." text lines or the packed binary
+frame defined in csi_recv_router/components/csi_core/include/csi_frame.h, optionally
+coalesced into batch datagrams (csi_batch.h). All of them are normalised here to
+the legacy text line so the rest of the collector is agnostic to the wire format.
+
+Nodes built with compression send delta frames (csi_delta.h) between keyframes;
+DatagramDecoder keeps the per-node reference needed to expand them.
+
+format_start_command builds the command that starts an acquisition, including
+the capture options of csi_capture.h. With the src option a node captures
+other transmitters than its access point (csi_sources.h); the frames of each
+transmitter, told apart by the MAC of the CSI_DATA line, carry their own
+sequence numbers.
+
+While capturing, the node's traffic generator (csi_traffic.h) sends one
+"CSI_RATE,..." report per second, parsed by parse_rate_report, and in UDP probe
+mode "CSI_PROBE,<n>" datagrams that the collector must echo back (is_probe).
+It also sends a "CSI_STATS,..." capture health report (csi_stats.h) per
+second, parsed by parse_stats_report.
+
+For multi-node alignment the node syncs to the collector's clock (csi_clock.h):
+its "CSI_SYNC,<seq>,<t1>" requests are answered by sync_reply, and the
+"CSI_CLOCK,..." report it sends after every exchange (parse_clock_report) maps
+the local timestamp of its frames to the collector's time (clock_to_shared).
+
+After its first frame of a wake the node sends one "CSI_WAKE,..." report of
+the wake-phase timings (csi_link.h), parsed by parse_wake_report.
+
+A node can also be given a plan of acquisition windows on the shared clock
+(csi_schedule.h): format_schedule_command builds it around a start command,
+parse_schedule_command reads one back and schedule_windows lists its windows.
+The node acknowledges the plan and announces each next window with a
+"CSI_SCHED,..." report, parsed by parse_schedule_report.
+
+A node keeps its recently sent frames (csi_history.h) and sends them again
+when asked with a "CSI_NACK,[<mac>,]<first>[-<last>],..." datagram
+(format_nack) to the address its frames come from. Resent frames carry FRAME_FLAG_RETRANSMIT
+and are always whole frames, which the delta decoder passes through without
+making them its reference.
+"""
+import socket
+import struct
+import time
+from array import array
+
+FRAME_MAGIC = 0xC51F
+FRAME_VERSION = 1
+
+# Mirrors the binary header layout documented in csi_frame.h (little-endian, 40 bytes).
+FRAME_HEADER = struct.Struct('<HBBI6sbBBBBBBBBBBbBBBBIHBBH')
+FRAME_FLAG_DELTA = 0x01
+FRAME_FLAG_AMPLITUDE = 0x02
+FRAME_FLAG_RETRANSMIT = 0x04
+
+BATCH_MAGIC = 0xC5B7
+BATCH_VERSION = 1
+BATCH_HEADER = struct.Struct('<HBBI')
+BATCH_ENTRY = struct.Struct('<H')
+
+# Large enough for a full batch or a single unbatched frame of any supported length.
+MAX_DATAGRAM_SIZE = 4096
+
+# Records published by the native ingest daemon's local feed (Desktop/native, csi/ingest.hpp):
+# a little-endian uint64 host receive time in nanoseconds, the sending node's IPv4 address
+# (4 bytes, network order, zero if unknown) and an int64 capture time in microseconds on the
+# shared clock (FEED_NO_CAPTURE_TIME until the node reported its CSI_CLOCK mapping), followed
+# by one binary frame.
+FEED_RECORD_HEADER = struct.Struct('<Q4sq')
+FEED_NO_CAPTURE_TIME = -(1 << 63)
+
+FRAME_FIELDS = (
+    'magic', 'version', 'flags', 'seq', 'mac', 'rssi', 'rate', 'sig_mode', 'mcs', 'cwb',
+    'smoothing', 'not_sounding', 'aggregation', 'stbc', 'fec_coding', 'sgi', 'noise_floor',
+    'ampdu_cnt', 'channel', 'secondary_channel', 'ant', 'timestamp', 'sig_len', 'rx_state',
+    'first_word_invalid', 'len',
+)
+
+
+def is_binary_frame(data):
+    """Returns True if the datagram starts with the binary frame magic."""
+    return len(data) >= 2 and struct.unpack_from('<H', data)[0] == FRAME_MAGIC
+
+
+def decode_binary_frame(data, offset=0):
+    """
+    Parses one binary frame starting at offset.
+    Returns (fields, payload) where fields is a dict keyed by FRAME_FIELDS and
+    payload is the raw I/Q bytes; raises ValueError on malformed input.
+    """
+    if len(data) - offset < FRAME_HEADER.size:
+        raise ValueError("truncated CSI frame header")
+    fields = dict(zip(FRAME_FIELDS, FRAME_HEADER.unpack_from(data, offset)))
+    if fields['magic'] != FRAME_MAGIC:
+        raise ValueError("bad CSI frame magic")
+    if fields['version'] != FRAME_VERSION:
+        raise ValueError(f"unsupported CSI frame version {fields['version']}")
+    start = offset + FRAME_HEADER.size
+    end = start + fields['len']
+    if end > len(data):
+        raise ValueError("truncated CSI frame payload")
+    return fields, data[start:end]
+
+
+def frame_to_text(fields, payload):
+    """Formats a decoded binary frame as the legacy CSI_DATA line (without newline)."""
+    mac = ':'.join(f'{b:02x}' for b in fields['mac'])
+    values = struct.unpack(f'{len(payload)}b', payload)
+    return (
+        f"CSI_DATA,{fields['seq']},{mac},{fields['rssi']},{fields['rate']},{fields['sig_mode']},"
+        f"{fields['mcs']},{fields['cwb']},{fields['smoothing']},{fields['not_sounding']},"
+        f"{fields['aggregation']},{fields['stbc']},{fields['fec_coding']},{fields['sgi']},"
+        f"{fields['noise_floor']},{fields['ampdu_cnt']},{fields['channel']},"
+        f"{fields['secondary_channel']},{fields['timestamp']},{fields['ant']},{fields['sig_len']},"
+        f"{fields['rx_state']},{fields['len']},{fields['first_word_invalid']},"
+        f"\"[{','.join(map(str, values))}]\""
+    )
+
+
+def split_batch(data):
+    """
+    Splits a batch datagram into its individual frames.
+    Returns (first_seq, frames); raises ValueError on malformed input.
+    """
+    if len(data) < BATCH_HEADER.size:
+        raise ValueError("truncated CSI batch header")
+    magic, version, count, first_seq = BATCH_HEADER.unpack_from(data)
+    if magic != BATCH_MAGIC or version != BATCH_VERSION:
+        raise ValueError("not a CSI batch")
+    frames = []
+    offset = BATCH_HEADER.size
+    for _ in range(count):
+        if offset + BATCH_ENTRY.size > len(data):
+            raise ValueError("truncated CSI batch entry")
+        (length,) = BATCH_ENTRY.unpack_from(data, offset)
+        offset += BATCH_ENTRY.size
+        if offset + length > len(data):
+            raise ValueError("truncated CSI batch entry")
+        frames.append(data[offset:offset + length])
+        offset += length
+    return first_seq, frames
+
+
+def _read_varint(data, pos):
+    value = 0
+    for shift in range(0, 35, 7):
+        if pos >= len(data):
+            break
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+    raise ValueError("truncated varint in delta frame")
+
+
+class DeltaDecoder:
+    """Per-node reference state for expanding delta-compressed frames."""
+
+    def __init__(self):
+        self._refs = {}
+        self.desync = 0
+
+    def expand(self, fields, payload):
+        """
+        Returns the raw payload of a binary frame, updating the node's reference.
+        Returns None for a delta frame whose reference was not received; the node
+        is back in sync at its next keyframe. Raises ValueError on corrupt input.
+        """
+        mac = fields['mac']
+        if not fields['flags'] & FRAME_FLAG_DELTA:
+            if not fields['flags'] & FRAME_FLAG_RETRANSMIT:  # an old frame resent: the reference stays
+                self._refs[mac] = (fields['seq'], bytes(payload))
+            return payload
+        back, pos = _read_varint(payload, 0)
+        ref = self._refs.pop(mac, None)
+        if ref is None or (fields['seq'] - back) & 0xFFFFFFFF != ref[0]:
+            self.desync += 1
+            return None
+        values = array('b', ref[1])
+        nibbles = (len(payload) - pos) * 2
+        nib = pos * 2
+        end = pos * 2 + nibbles
+        for i in range(len(values)):
+            zz = shift = 0
+            while True:
+                if nib >= end or shift > 6:
+                    raise ValueError("corrupt delta frame")
+                v = (payload[nib >> 1] >> ((nib & 1) * 4)) & 0x0F
+                nib += 1
+                zz |= (v & 7) << shift
+                shift += 3
+                if not v & 8:
+                    break
+            values[i] = ((values[i] + ((zz >> 1) ^ -(zz & 1)) + 128) & 0xFF) - 128
+        if end - nib > 1 or (nib < end and (payload[nib >> 1] >> 4) != 0):
+            raise ValueError("trailing bytes in delta frame")
+        raw = values.tobytes()
+        self._refs[mac] = (fields['seq'], raw)
+        fields['flags'] &= ~FRAME_FLAG_DELTA
+        fields['len'] = len(raw)
+        return raw
+
+
+def _decode_frame(data, delta):
+    if is_binary_frame(data):
+        try:
+            fields, payload = decode_binary_frame(data)
+            if delta is not None:
+                payload = delta.expand(fields, payload)
+            elif fields['flags'] & FRAME_FLAG_DELTA:
+                payload = None
+            return [] if payload is None else [frame_to_text(fields, payload)]
+        except ValueError:
+            return []
+    line = data.decode('utf-8', errors='ignore').strip()
+    return [line] if line.startswith("CSI_DATA") else []
+
+
+def _decode(data, delta):
+    if len(data) >= 2 and struct.unpack_from('<H', data)[0] == BATCH_MAGIC:
+        try:
+            _, frames = split_batch(data)
+        except ValueError:
+            return []
+        lines = []
+        for frame in frames:
+            lines.extend(_decode_frame(frame, delta))
+        return lines
+    return _decode_frame(data, delta)
+
+
+def decode_datagram(data):
+    """
+    Converts one received datagram into a list of CSI_DATA text lines.
+    Batches are unpacked transparently; datagrams that are neither CSI text nor
+    a valid frame or batch yield an empty list. Stateless, so delta frames are
+    skipped; use DatagramDecoder for nodes that compress.
+    """
+    return _decode(data, None)
+
+
+class DatagramDecoder:
+    """decode_datagram for one receive stream, expanding delta frames."""
+
+    def __init__(self):
+        self.delta = DeltaDecoder()
+
+    def decode(self, data):
+        return _decode(data, self.delta)
+
+
+def decode_feed_record(data):
+    """
+    Parses one csi_ingestd feed record.
+    Returns (host_time_ns, node_ip, capture_us, csi_data_line), node_ip and
+    capture_us (shared clock) None if unknown; raises ValueError on malformed
+    input.
+    """
+    if len(data) < FEED_RECORD_HEADER.size:
+        raise ValueError("truncated feed record")
+    host_ns, node, capture_us = FEED_RECORD_HEADER.unpack_from(data)
+    node_ip = socket.inet_ntoa(node) if any(node) else None
+    capture_us = None if capture_us == FEED_NO_CAPTURE_TIME else capture_us
+    return host_ns, node_ip, capture_us, frame_to_text(*decode_binary_frame(data, FEED_RECORD_HEADER.size))
+
+
+# Highest subcarrier pair a start command mask can select (CSI_CAPTURE_MAX_PAIRS).
+CAPTURE_MAX_PAIRS = 128
+PAYLOAD_MODES = ('raw', 'amp')
+PROBE_TYPES = ('icmp', 'udp')
+# Transmitters an allowlist of the src option can name (CSI_CAPTURE_MAX_SOURCES).
+CAPTURE_MAX_SOURCES = 8
+# Longest start command a node accepts (UDP_START_CMD_MAX_LEN, CSI_SCHEDULE_START_MAX_LEN).
+START_COMMAND_MAX_LEN = 255
+PROBE_PREFIX = b"CSI_PROBE,"
+RATE_REPORT_PREFIX = b"CSI_RATE,"
+STATS_REPORT_PREFIX = b"CSI_STATS,"
+SYNC_PREFIX = b"CSI_SYNC,"
+CLOCK_REPORT_PREFIX = b"CSI_CLOCK,"
+CLOCK_FIELDS = ('radio_anchor_us', 'shared_anchor_us', 'drift_ppb', 'error_us', 'samples')
+WAKE_REPORT_PREFIX = b"CSI_WAKE,"
+# Integer fields of a CSI_WAKE report after the mode; the *_ms ones are uptimes, 0 if not reached.
+WAKE_FIELDS = ('fell_back', 'wifi_ms', 'assoc_ms', 'ip_ms', 'start_ms', 'first_frame_ms', 'wakes', 'fast_ok',
+               'fast_failed')
+NACK_PREFIX = b"CSI_NACK,"
+NACK_MAX_RANGES = 16
+SCHEDULE_COMMAND_PREFIX = "schedule,"
+SCHEDULE_REPORT_PREFIX = b"CSI_SCHED,"
+SCHEDULE_FIELDS = ('id', 'index', 'count', 'start_us')
+# Least idle time between two windows of a plan (CSI_SCHEDULE_MIN_GAP_S).
+SCHEDULE_MIN_GAP_S = 10
+# Counters of a CSI_STATS report, in wire order, followed by two histograms of
+# STATS_HIST_BINS log2 microsecond bins: callback_us and interval_us.
+STATS_FIELDS = ('uptime_ms', 'seen', 'accepted', 'filtered', 'truncated', 'decimated', 'ring_full',
+                'serialized', 'sent', 'send_failed', 'resent', 'queue_depth', 'queue_high')
+STATS_HIST_BINS = 20
+
+
+def format_start_command(duration, subcarrier_mask=None, decimation=1, rate_hz=0, payload_mode='raw',
+                         target_hz=0, probe='icmp', sources=None):
+    """
+    Builds the start command understood by the node (csi_capture.h).
+    subcarrier_mask is an int or hex string whose bit i keeps the i-th I/Q pair
+    of the CSI buffer; None or empty keeps every pair. target_hz is the CSI rate
+    the node's traffic generator aims for (0 keeps the firmware default) and
+    probe selects ICMP or UDP echo probes. sources picks the transmitters: None,
+    empty or 'ap' for the access point, 'any' for every transmitter heard, or
+    MACs and 'ap' as a list or a string separated by '+', ',' or spaces. The
+    defaults produce the legacy "start,<seconds>". Raises ValueError on
+    out-of-range options.
+    """
+    duration = int(duration)
+    if duration <= 0:
+        raise ValueError("acquisition duration must be positive")
+    command = f"start,{duration}"
+    if isinstance(subcarrier_mask, str):
+        subcarrier_mask = int(subcarrier_mask, 16) if subcarrier_mask.strip() else None
+    if subcarrier_mask is not None:
+        if not 0 < subcarrier_mask < 1 << CAPTURE_MAX_PAIRS:
+            raise ValueError(f"subcarrier mask must select 1 to {CAPTURE_MAX_PAIRS} pairs")
+        command += f",sc={subcarrier_mask:x}"
+    decimation = int(decimation)
+    if not 1 <= decimation <= 0xFFFF:
+        raise ValueError("decimation must be between 1 and 65535")
+    if decimation > 1:
+        command += f",dec={decimation}"
+    rate_hz = int(rate_hz)
+    if not 0 <= rate_hz <= 0xFFFF:
+        raise ValueError("rate must be between 0 (unlimited) and 65535 Hz")
+    if rate_hz:
+        command += f",rate={rate_hz}"
+    if payload_mode not in PAYLOAD_MODES:
+        raise ValueError(f"payload mode must be one of {', '.join(PAYLOAD_MODES)}")
+    if payload_mode != 'raw':
+        command += f",mode={payload_mode}"
+    target_hz = int(target_hz)
+    if not 0 <= target_hz <= 0xFFFF:
+        raise ValueError("target rate must be between 0 (firmware default) and 65535 Hz")
+    if target_hz:
+        command += f",target={target_hz}"
+    if probe not in PROBE_TYPES:
+        raise ValueError(f"probe must be one of {', '.join(PROBE_TYPES)}")
+    if probe != 'icmp':
+        command += f",probe={probe}"
+    if isinstance(sources, str):
+        sources = sources.replace('+', ' ').replace(',', ' ').split()
+    sources = [s.strip().lower() for s in sources or ()]
+    if sources and sources != ['ap']:
+        if sources == ['any']:
+            command += ",src=any"
+        else:
+            if len(set(sources)) != len(sources) or len([s for s in sources if s != 'ap']) > CAPTURE_MAX_SOURCES:
+                raise ValueError(f"sources must name the access point and up to {CAPTURE_MAX_SOURCES} distinct MACs")
+            for source in sources:
+                if source != 'ap' and not _is_mac(source):
+                    raise ValueError(f"source {source!r} is neither 'ap' nor a MAC aa:bb:cc:dd:ee:ff")
+            command += ",src=" + '+'.join(sources)
+    if len(command) > START_COMMAND_MAX_LEN:
+        raise ValueError(f"start command longer than {START_COMMAND_MAX_LEN} characters")
+    return command
+
+
+def _is_mac(text):
+    parts = text.split(':')
+    return len(parts) == 6 and all(len(p) == 2 and all(c in '0123456789abcdef' for c in p) for p in parts)
+
+
+def is_probe(data):
+    """Returns True for a traffic generator probe, which the collector echoes to its sender."""
+    return data.startswith(PROBE_PREFIX)
+
+
+def parse_rate_report(data):
+    """
+    Parses a CSI_RATE datagram (csi_traffic.h) into a dict with target_hz,
+    achieved_hz, jitter_us, interval_us, probe and sent. Returns None for any
+    other datagram.
+    """
+    if not data.startswith(RATE_REPORT_PREFIX):
+        return None
+    parts = data[len(RATE_REPORT_PREFIX):].decode('ascii', errors='ignore').strip().split(',')
+    if len(parts) != 6 or parts[4] not in PROBE_TYPES:
+        return None
+    try:
+        return {
+            'target_hz': int(parts[0]), 'achieved_hz': float(parts[1]), 'jitter_us': int(parts[2]),
+            'interval_us': int(parts[3]), 'probe': parts[4], 'sent': int(parts[5]),
+        }
+    except ValueError:
+        return None
+
+
+def parse_stats_report(data):
+    """
+    Parses a CSI_STATS datagram (csi_stats.h) into a dict with the STATS_FIELDS
+    counters and the callback_us and interval_us histograms as lists. Returns
+    None for any other datagram.
+    """
+    if not data.startswith(STATS_REPORT_PREFIX):
+        return None
+    parts = data[len(STATS_REPORT_PREFIX):].decode('ascii', errors='ignore').strip().split(',')
+    if len(parts) != len(STATS_FIELDS) + 2 * STATS_HIST_BINS:
+        return None
+    try:
+        values = [int(p) for p in parts]
+    except ValueError:
+        return None
+    report = dict(zip(STATS_FIELDS, values))
+    hist = len(STATS_FIELDS)
+    report['callback_us'] = values[hist:hist + STATS_HIST_BINS]
+    report['interval_us'] = values[hist + STATS_HIST_BINS:]
+    return report
+
+
+def hist_percentile(bins, p):
+    """
+    Upper edge in microseconds of the bin holding the p-th percentile (0-100)
+    of a CSI_STATS histogram, 0 if it is empty (csi_stats_hist_percentile).
+    """
+    total = sum(bins)
+    if not total:
+        return 0
+    rank = min(max(int(p / 100 * total + 0.5), 1), total)
+    seen = 0
+    for b, count in enumerate(bins[:-1]):
+        seen += count
+        if seen >= rank:
+            return 1 << b if b else 0
+    return 1 << (len(bins) - 2)
+
+
+def sync_reply(data, t2_us, t3_us=None):
+    """
+    Reply to a CSI_SYNC request (csi_clock.h), or None for any other datagram.
+    t2_us is the receive time of the request on the collector's clock
+    (microseconds since the epoch); t3_us, the send time, defaults to now.
+    """
+    if not data.startswith(SYNC_PREFIX):
+        return None
+    parts = data[len(SYNC_PREFIX):].decode('ascii', errors='ignore').strip().split(',')
+    if len(parts) != 2 or not all(p.lstrip('-').isdigit() for p in parts):
+        return None
+    if t3_us is None:
+        t3_us = time.time_ns() // 1000
+    return SYNC_PREFIX + f"{parts[0]},{parts[1]},{t2_us},{t3_us}".encode('ascii')
+
+
+def parse_clock_report(data):
+    """
+    Parses a CSI_CLOCK datagram (csi_clock.h) into a dict with the
+    CLOCK_FIELDS values. Returns None for any other datagram.
+    """
+    if not data.startswith(CLOCK_REPORT_PREFIX):
+        return None
+    parts = data[len(CLOCK_REPORT_PREFIX):].decode('ascii', errors='ignore').strip().split(',')
+    if len(parts) != len(CLOCK_FIELDS):
+        return None
+    try:
+        return dict(zip(CLOCK_FIELDS, (int(p) for p in parts)))
+    except ValueError:
+        return None
+
+
+def clock_to_shared(report, radio_us):
+    """
+    Collector time in microseconds of a frame's local_timestamp, with the
+    node's CSI_CLOCK report (csi_clock_report_to_shared).
+    """
+    d = (radio_us - report['radio_anchor_us'] + (1 << 31)) % (1 << 32) - (1 << 31)
+    return report['shared_anchor_us'] + d + int(d * report['drift_ppb'] / 1_000_000_000)
+
+
+def parse_wake_report(data):
+    """
+    Parses a CSI_WAKE datagram (csi_link.h) into a dict with mode ('fast' or
+    'full') and the WAKE_FIELDS values. Returns None for any other datagram.
+    """
+    if not data.startswith(WAKE_REPORT_PREFIX):
+        return None
+    parts = data[len(WAKE_REPORT_PREFIX):].decode('ascii', errors='ignore').strip().split(',')
+    if len(parts) != len(WAKE_FIELDS) + 1 or parts[0] not in ('fast', 'full'):
+        return None
+    try:
+        report = dict(zip(WAKE_FIELDS, (int(p) for p in parts[1:])))
+    except ValueError:
+        return None
+    report['mode'] = parts[0]
+    return report
+
+
+def format_nack(ranges, mac=None):
+    """
+    Builds the CSI_NACK datagram asking a node to resend its frames in the
+    inclusive (first, last) sequence ranges, at most NACK_MAX_RANGES of them.
+    mac ('aa:bb:cc:dd:ee:ff') names the transmitter whose frames are missing;
+    without it the node takes the transmitter of its newest frame, which is
+    only right for a node capturing a single one.
+    """
+    if not 0 < len(ranges) <= NACK_MAX_RANGES:
+        raise ValueError(f"a NACK holds 1 to {NACK_MAX_RANGES} ranges")
+    if mac is not None and not _is_mac(mac.lower()):
+        raise ValueError(f"{mac!r} is not a MAC aa:bb:cc:dd:ee:ff")
+    return NACK_PREFIX + ((mac.lower() + ',') if mac else '').encode('ascii') + ','.join(
+        str(first) if first == last else f"{first}-{last}" for first, last in ranges).encode('ascii')
+
+
+def format_schedule_command(plan_id, first_start_us, interval_s, count, start_command):
+    """
+    Builds the schedule command of csi_schedule.h: count windows, the first at
+    first_start_us on the collector's wall clock (microseconds since the epoch),
+    interval_s apart, each running start_command (format_start_command), whose
+    duration is the window length. Raises ValueError on an inconsistent plan.
+    """
+    plan_id, first_start_us, interval_s, count = int(plan_id), int(first_start_us), int(interval_s), int(count)
+    if not 0 <= plan_id < 1 << 32:
+        raise ValueError("plan id must fit in 32 bits")
+    if first_start_us <= 0:
+        raise ValueError("first window start must be positive")
+    if not 1 <= count < 1 << 32:
+        raise ValueError("a plan needs at least one window")
+    parts = start_command.split(',')
+    if len(parts) < 2 or parts[0] != 'start' or not parts[1].isdigit() or int(parts[1]) <= 0:
+        raise ValueError("the window command must be a start command with a duration")
+    if count > 1 and interval_s < int(parts[1]) + SCHEDULE_MIN_GAP_S:
+        raise ValueError(f"windows must be at least {SCHEDULE_MIN_GAP_S} s longer apart than they last")
+    return f"{SCHEDULE_COMMAND_PREFIX}{plan_id},{first_start_us},{interval_s},{count},{start_command}"
+
+
+def parse_schedule_command(command):
+    """
+    Reads a schedule command back into a dict with id, first_start_us,
+    interval_s, count, duration_s and start, or {'cancel': True} for
+    "schedule,cancel". Returns None for any other command.
+    """
+    if not command.startswith(SCHEDULE_COMMAND_PREFIX):
+        return None
+    rest = command[len(SCHEDULE_COMMAND_PREFIX):]
+    if rest == 'cancel':
+        return {'cancel': True}
+    parts = rest.split(',', 4)
+    if len(parts) != 5 or not all(p.isdigit() for p in parts[:4]):
+        return None
+    start = parts[4].split(',')
+    if len(start) < 2 or start[0] != 'start' or not start[1].isdigit():
+        return None
+    return {'id': int(parts[0]), 'first_start_us': int(parts[1]), 'interval_s': int(parts[2]),
+            'count': int(parts[3]), 'duration_s': int(start[1]), 'start': parts[4]}
+
+
+def schedule_windows(plan):
+    """(start_us, end_us) of every window of a parsed schedule command."""
+    return [(plan['first_start_us'] + i * plan['interval_s'] * 1_000_000,
+             plan['first_start_us'] + i * plan['interval_s'] * 1_000_000 + plan['duration_s'] * 1_000_000)
+            for i in range(plan['count'])]
+
+
+def parse_schedule_report(data):
+    """
+    Parses a CSI_SCHED datagram (csi_schedule.h) into a dict with the
+    SCHEDULE_FIELDS values: index is the node's next window, equal to count
+    (and start_us 0) once the plan is done; count 0 means it was cancelled.
+    Returns None for any other datagram.
+    """
+    if not data.startswith(SCHEDULE_REPORT_PREFIX):
+        return None
+    parts = data[len(SCHEDULE_REPORT_PREFIX):].decode('ascii', errors='ignore').strip().split(',')
+    if len(parts) != len(SCHEDULE_FIELDS):
+        return None
+    try:
+        report = dict(zip(SCHEDULE_FIELDS, (int(p) for p in parts)))
+    except ValueError:
+        return None
+    return report if 0 <= report['index'] <= report['count'] else None
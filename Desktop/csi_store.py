@@ -0,0 +1,201 @@
+# -*- coding: utf-8 -*-
+"""
+Incremental persistence of CSI acquisitions.
+
+A SessionWriter owns a background thread that parses CSI_DATA lines and commits
+them to SQLite in bounded batches while the acquisition is running, so memory
+use stays flat and saving a session only has to flip its status.
+
+Schema (created on demand next to the legacy csi_data table):
+
+    csi_session  one row per acquisition; status is 'recording' while frames are
+                 being written, then 'complete' or 'discarded'. Sessions left in
+                 'recording' by a crash are marked 'interrupted' on the next open.
+                 capture holds the start command sent to the node, which records
+                 the subcarrier mask, decimation and payload mode of the frames.
+                 node is the address of the node that produced the frames. A
+                 multi-node acquisition writes one session per node, all with
+                 the same started_at and scenario.
+    csi_frame    one row per frame; the I/Q payload is stored as a BLOB of raw
+                 int8 values instead of the decimal "[a,b,...]" text.
+                 sync_time is the capture time on the collector's clock, from
+                 the node's clock sync report (csi_clock.h), comparable across
+                 the nodes of an acquisition; NULL until the node reported.
+"""
+import queue
+import sqlite3
+import threading
+import time
+from array import array
+from datetime import datetime
+
+SCHEMA = '''
+    CREATE TABLE IF NOT EXISTS csi_session (
+        id INTEGER PRIMARY KEY,
+        started_at TEXT, ended_at TEXT, scenario TEXT, status TEXT, frames INTEGER DEFAULT 0,
+        capture TEXT, node TEXT
+    );
+    CREATE TABLE IF NOT EXISTS csi_frame (
+        id INTEGER PRIMARY KEY,
+        session_id INTEGER NOT NULL REFERENCES csi_session(id),
+        host_time REAL, seq INTEGER, mac TEXT, rssi INTEGER, rate REAL,
+        sig_mode INTEGER, mcs INTEGER, bandwidth INTEGER, smoothing INTEGER,
+        not_sounding INTEGER, aggregation INTEGER, stbc INTEGER, fec_coding INTEGER,
+        sgi INTEGER, noise_floor INTEGER, ampdu_cnt INTEGER, channel INTEGER,
+        secondary_channel INTEGER, local_timestamp INTEGER, ant INTEGER,
+        sig_len INTEGER, rx_state INTEGER, len INTEGER, first_word INTEGER, data BLOB,
+        sync_time REAL
+    );
+    CREATE INDEX IF NOT EXISTS csi_frame_session ON csi_frame(session_id, id);
+'''
+
+INSERT_FRAME = '''
+    INSERT INTO csi_frame (
+        session_id, host_time, seq, mac, rssi, rate, sig_mode, mcs, bandwidth, smoothing,
+        not_sounding, aggregation, stbc, fec_coding, sgi, noise_floor, ampdu_cnt, channel,
+        secondary_channel, local_timestamp, ant, sig_len, rx_state, len, first_word, data, sync_time
+    ) VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)
+'''
+
+
+def parse_csi_line(line):
+    """
+    Splits a CSI_DATA line into the csi_frame column values (without session_id
+    and host_time). Returns None for malformed lines.
+    """
+    parts = line.split(',', 24)
+    if len(parts) != 25 or parts[0] != "CSI_DATA":
+        return None
+    try:
+        numbers = [int(p) for p in parts[3:24]]
+        payload = parts[24].strip().strip('"').strip('[]')
+        data = array('b', map(int, payload.split(','))).tobytes() if payload else b''
+    except ValueError:
+        return None
+    return (int(parts[1]), parts[2], *numbers, data)
+
+
+def open_db(path):
+    """Opens a session database in WAL mode and makes sure the schema exists."""
+    conn = sqlite3.connect(path, check_same_thread=False)
+    conn.execute('PRAGMA journal_mode=WAL')
+    conn.execute('PRAGMA synchronous=NORMAL')
+    conn.executescript(SCHEMA)
+    columns = {row[1] for row in conn.execute("PRAGMA table_info(csi_session)")}
+    if 'capture' not in columns:  # Databases created before capture options existed
+        conn.execute("ALTER TABLE csi_session ADD COLUMN capture TEXT")
+    if 'node' not in columns:  # Databases created before multi-node acquisitions
+        conn.execute("ALTER TABLE csi_session ADD COLUMN node TEXT")
+    if 'sync_time' not in {row[1] for row in conn.execute("PRAGMA table_info(csi_frame)")}:
+        conn.execute("ALTER TABLE csi_frame ADD COLUMN sync_time REAL")  # Before clock sync
+    conn.execute("UPDATE csi_session SET status = 'interrupted' WHERE status = 'recording'")
+    conn.commit()
+    return conn
+
+
+class SessionWriter:
+    """
+    Background writer that streams one acquisition into SQLite: a single
+    session, or with nodes one session per node address.
+    """
+
+    def __init__(self, path, scenario, capture=None, nodes=None, batch_size=500, flush_interval=0.5,
+                 max_pending=20000):
+        self.path = path
+        self.scenario = scenario
+        self.batch_size = batch_size
+        self.flush_interval = flush_interval
+        self.frames_written = 0
+        self.frames_dropped = 0
+        self.frames_by_node = {}
+        self.error = None
+        self._queue = queue.Queue(maxsize=max_pending)
+        self._stop = threading.Event()
+        self._conn = open_db(path)
+        started_at = datetime.now().isoformat()
+        self.session_ids = {}  # node -> session id; the single session is keyed by None
+        for node in (nodes or [None]):
+            cursor = self._conn.execute(
+                "INSERT INTO csi_session (started_at, scenario, status, capture, node) VALUES (?, ?, 'recording', ?, ?)",
+                (started_at, scenario, capture, node))
+            self.session_ids[node] = cursor.lastrowid
+        self._conn.commit()
+        self.session_id = next(iter(self.session_ids.values()))
+        self._single = nodes is None
+        self._thread = threading.Thread(target=self._run, daemon=True)
+        self._thread.start()
+
+    def accepts(self, node):
+        """True if frames of node have a session (always for a single-session writer)."""
+        return self._single or node in self.session_ids
+
+    def submit(self, line, node=None, sync_time=None):
+        """
+        Queues one CSI_DATA line from node, with its capture time on the
+        collector's clock if known; drops (and counts) it at once if the
+        writer has fallen max_pending frames behind, so the receive loop never
+        waits on the disk. Frames of nodes without a session are ignored.
+        """
+        session_id = self.session_id if self._single else self.session_ids.get(node)
+        if session_id is None:
+            return
+        try:
+            self._queue.put_nowait((time.time(), session_id, line, sync_time))
+        except queue.Full:
+            self.frames_dropped += 1
+
+    def _run(self):
+        batch = []
+        deadline = time.monotonic() + self.flush_interval
+        while not (self._stop.is_set() and self._queue.empty()):
+            try:
+                host_time, session_id, line, sync_time = self._queue.get(timeout=self.flush_interval)
+                row = parse_csi_line(line)
+                if row is not None:
+                    batch.append((session_id, host_time) + row + (sync_time,))
+            except queue.Empty:
+                pass
+            if batch and (len(batch) >= self.batch_size or time.monotonic() >= deadline):
+                self._write(batch)
+                batch = []
+                deadline = time.monotonic() + self.flush_interval
+        if batch:
+            self._write(batch)
+
+    def _write(self, batch):
+        counts = {}
+        for row in batch:
+            counts[row[0]] = counts.get(row[0], 0) + 1
+        try:
+            with self._conn:
+                self._conn.executemany(INSERT_FRAME, batch)
+                self._conn.executemany("UPDATE csi_session SET frames = frames + ? WHERE id = ?",
+                                       [(n, session_id) for session_id, n in counts.items()])
+            self.frames_written += len(batch)
+            for node, session_id in self.session_ids.items():
+                if session_id in counts:
+                    self.frames_by_node[node] = self.frames_by_node.get(node, 0) + counts[session_id]
+        except sqlite3.Error as e:
+            self.error = e
+            self.frames_dropped += len(batch)
+
+    def flush(self):
+        """Stops accepting frames and waits until everything queued is committed."""
+        self._stop.set()
+        self._thread.join()
+
+    def finish(self, status='complete'):
+        """
+        Closes the sessions with the given status ('complete' or 'discarded').
+        Discarded sessions have their frames deleted. Returns the frames kept.
+        """
+        self.flush()
+        ended_at = datetime.now().isoformat()
+        with self._conn:
+            for session_id in self.session_ids.values():
+                if status == 'discarded':
+                    self._conn.execute("DELETE FROM csi_frame WHERE session_id = ?", (session_id,))
+                self._conn.execute("UPDATE csi_session SET status = ?, ended_at = ? WHERE id = ?",
+                                   (status, ended_at, session_id))
+        self._conn.close()
+        return 0 if status == 'discarded' else self.frames_written
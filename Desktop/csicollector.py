@@ -1,15 +1,25 @@
 # -*- coding: utf-8 -*-
 import flet as ft
+import base64
 import socket
 import threading
 import time
 import queue
-import sqlite3
-from datetime import datetime
+from csi_protocol import format_schedule_command, format_start_command
+from csi_listener import udp_listener_thread
+from csi_live import LiveView, encode_png
+from csi_nodes import NodeRegistry
+from csi_store import SessionWriter
 
 # Queue for communication between network threads and the User Interface (UI).
 q = queue.Queue()
 
+# The console keeps only its latest lines, and the live view is redrawn at most this often,
+# so the control tree and the render cost do not grow with the packet rate.
+CONSOLE_MAX_LINES = 500
+LIVE_REFRESH_S = 0.2
+BLANK_PNG = base64.b64encode(encode_png(1, 1, [b'\x00'], bytes(3))).decode('ascii')
+
 # --- REUSABLE UI COMPONENTS ---
 
 class AppCard(ft.Card):
@@ -51,98 +61,6 @@ def send_provision_command(command, page: ft.Page):
         q.put(("error", f"Failed to transmit command: {e}"))
     page.update()
 
-def udp_listener_thread(esp_ip, collection_time, local_port, stop_event):
-    """
-    A thread that listens for CSI packets, dispatches 'start' commands,
-    and forwards the data to be saved and displayed on the UI.
-    """
-    q.put(("log_system", f"Initiating listener on port {local_port}..."))
-    listen_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    try:
-        listen_socket.bind(('', int(local_port)))
-        listen_socket.settimeout(1.0)
-    except Exception as e:
-        q.put(("error", f"Error binding to port {local_port}: {e}"))
-        q.put(("collection_finished", None))
-        return
-
-    q.put(("log_system", f"Awaiting CSI data from ESP32 node at {esp_ip}..."))
-    command_send_time = 0
-    first_packet_received = False
-    
-    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as command_socket:
-        while not stop_event.is_set():
-            # Persistently send the 'start' command until the first data packet is received.
-            if not first_packet_received and time.time() - command_send_time > 3: # Send every 3 seconds
-                try:
-                    start_message = f"start,{collection_time}"
-                    command_socket.sendto(start_message.encode('utf-8'), (esp_ip, 50000))
-                    q.put(("log_system", f"Command '{start_message}' dispatched to {esp_ip}"))
-                    command_send_time = time.time()
-                except Exception as e:
-                    q.put(("log_system", f"Error sending 'start' command: {e}"))
-            
-            try:
-                data, addr = listen_socket.recvfrom(2048) # Increased buffer size for safety
-                decoded_data = data.decode('utf-8', errors='ignore').strip()
-                if decoded_data.startswith("CSI_DATA"):
-                    if not first_packet_received:
-                        q.put(("log_system", "Initial CSI packet received. Halting 'start' command transmission."))
-                        first_packet_received = True
-                    
-                    q.put(("log_csi", decoded_data))
-                    q.put(("buffer_data", decoded_data)) # Add to the in-memory buffer
-
-            except socket.timeout:
-                continue
-            except Exception as e:
-                q.put(("log_system", f"Error receiving data: {e}"))
-                break
-
-    listen_socket.close()
-    q.put(("collection_finished", None))
-
-
-def listen_for_esp_ip_thread(stop_event):
-    """Listens for broadcast packets from the ESP32 for a limited time."""
-    listen_ip = "0.0.0.0"
-    listen_port = 50002
-    search_duration = 75
-    ip_found = False
-
-    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
-        s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
-        s.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
-        try:
-            s.bind((listen_ip, listen_port))
-            s.settimeout(1.0)
-            q.put(("log_system", f"Listening on port {listen_port} for {search_duration}s..."))
-        except Exception as e:
-            q.put(("log_system", f"ERROR: Failed to listen for broadcast: {e}"))
-            q.put(("discovery_failed", "Error initiating listener."))
-            return
-        
-        start_time = time.time()
-        while not stop_event.is_set() and time.time() - start_time < search_duration:
-            try:
-                data, addr = s.recvfrom(1024)
-                message = data.decode('utf-8')
-                if message.startswith("CSI_IP,"):
-                    discovered_ip = message.split(',')[1]
-                    q.put(("ip_discovered", discovered_ip))
-                    ip_found = True
-                    break 
-            except socket.timeout:
-                continue
-            except Exception as e:
-                q.put(("log_system", f"ERROR in discovery thread: {e}"))
-    
-    if not ip_found:
-        q.put(("discovery_failed", "No ESP32 node discovered. Please try again."))
-        
-    q.put(("log_system", "Discovery thread terminated."))
-
-
 # --- MAIN APPLICATION FUNCTION ---
 
 def main(page: ft.Page):
@@ -153,11 +71,13 @@ def main(page: ft.Page):
 
     # State variables
     stop_collection_event = threading.Event()
-    stop_discovery_event = threading.Event()
     network_thread = None
-    discovery_thread = None
-    collected_data_buffer = []
+    # Keeps collecting CSI_IP broadcasts once started, so every node on the network can be selected.
+    node_registry = NodeRegistry(q)
+    session_writer = None
     selected_db_path = None
+    live_view = None
+    live_refreshed = 0.0
 
     # --- UI Controls ---
     prov_auth_type = ft.Dropdown(label="Authentication Protocol",options=[ft.dropdown.Option("wpa2psk", "WPA2-PSK (Personal)"),ft.dropdown.Option("peap", "WPA2-Enterprise (PEAP)")],value="wpa2psk")
@@ -166,14 +86,39 @@ def main(page: ft.Page):
     prov_password = ft.TextField(label="Network Passphrase", password=True, can_reveal_password=True)
     prov_server_ip = ft.TextField(label="Server IP Address (This Host)", value=get_local_ip())
     prov_server_port = ft.TextField(label="Server Port", value="50001")
-    collect_esp_ip = ft.TextField(label="ESP32 Receiver IP Address", hint_text="Click 'Discover'", expand=True)
+    collect_esp_ip = ft.TextField(label="Additional Node IP Addresses (comma-separated)", hint_text="Discovered nodes are listed below", expand=True)
+    collect_nodes = ft.Column(spacing=0)  # one checkbox per discovered node
     collect_time = ft.TextField(label="Acquisition Duration (seconds)", value="60", input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9]"))
     collect_port = ft.TextField(label="Listening Port (This Host)", value="50001", input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9]"))
+    # Capture options applied on the node before transmission (csi_capture.h).
+    collect_sc_mask = ft.TextField(label="Subcarrier Mask (hex, bit i = I/Q pair i)", hint_text="Empty keeps every subcarrier", input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9a-fA-F]"))
+    collect_decimation = ft.TextField(label="Decimation (keep 1 of N frames)", value="1", expand=True, input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9]"))
+    collect_rate = ft.TextField(label="Max Rate (Hz, 0 = unlimited)", value="0", expand=True, input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9]"))
+    collect_payload_mode = ft.Dropdown(label="Payload", options=[ft.dropdown.Option("raw", "Raw I/Q"), ft.dropdown.Option("amp", "Amplitude only (int8)")], value="raw")
+    # Traffic generator on the node (csi_traffic.h): UDP probes are echoed by this collector.
+    collect_target = ft.TextField(label="Target CSI Rate (Hz, 0 = default)", value="0", expand=True, input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9]"))
+    collect_probe = ft.Dropdown(label="Probe", options=[ft.dropdown.Option("icmp", "ICMP to gateway"), ft.dropdown.Option("udp", "UDP echo via collector")], value="icmp", expand=True)
+    # Transmitters captured (csi_sources.h): each one is tracked as its own stream.
+    collect_sources = ft.TextField(label="Sources (ap, any, or MACs and ap separated by +)", value="ap", input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9a-fA-FnNyYpP:+ ]"))
+    # Scheduled windows (csi_schedule.h): more than one window sends a plan the nodes sleep through.
+    collect_windows = ft.TextField(label="Windows (1 = start now)", value="1", expand=True, input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9]"))
+    collect_every = ft.TextField(label="Every (seconds)", value="600", expand=True, input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9]"))
+    collect_first_in = ft.TextField(label="First Window In (seconds)", value="60", expand=True, input_filter=ft.InputFilter(allow=True, regex_string=r"[0-9]"))
+    # Gap retransmission (csi_history.h): lost frames are asked for again and stored late.
+    collect_nack = ft.Checkbox(label="Request lost frames again", value=False)
+    # Every frame as a text line in the console, on top of the live view; costly at high rates.
+    collect_raw_log = ft.Checkbox(label="Show raw CSI lines in the console", value=False)
     
     cenario_input = ft.TextField(label="Experiment Scenario", hint_text="Describe the activity during the acquisition")
     selected_db_text = ft.Text("No database file selected.", italic=True, color="grey")
 
     console_output = ft.ListView(expand=True, spacing=5, auto_scroll=True)
+    # Live view (csi_live.py): per stream an amplitude waterfall and rate and RSSI sparklines.
+    console_live = ft.Row(wrap=True, spacing=10, run_spacing=10)
+    live_controls = {}
+    # Live state of each node: stream rate and losses, and its capture health (CSI_STATS, csi_stats.h).
+    console_health = ft.Column(spacing=2)
+    node_health = {}
     console_stop_button = ft.ElevatedButton("Stop Acquisition", on_click=lambda _: stop_collection(), color="white", bgcolor="red700")
     console_back_button = ft.ElevatedButton("Return", on_click=lambda _: discard_and_go_back(), visible=False)
     console_save_button = ft.ElevatedButton("Save Data", icon="save", on_click=lambda _: trigger_save_dialog(), visible=False)
@@ -181,48 +126,12 @@ def main(page: ft.Page):
     discovery_progress = ft.ProgressRing(width=20, height=20, stroke_width=2, visible=False)
     
     # --- Dialogs and File Logic ---
-    def save_to_db(path: str, cenario: str):
-        nonlocal collected_data_buffer
-        try:
-            with sqlite3.connect(path) as conn:
-                cursor = conn.cursor()
-                cursor.execute('''
-                    CREATE TABLE IF NOT EXISTS csi_data (
-                        id INTEGER PRIMARY KEY,
-                        timestamp TEXT, scenario TEXT, type TEXT, seq INTEGER, mac TEXT, rssi INTEGER, rate REAL, 
-                        sig_mode INTEGER, mcs INTEGER, bandwidth INTEGER, smoothing INTEGER, 
-                        not_sounding INTEGER, aggregation INTEGER, stbc INTEGER, fec_coding INTEGER, 
-                        sgi INTEGER, noise_floor INTEGER, ampdu_cnt INTEGER, channel INTEGER,
-                        secondary_channel INTEGER, local_timestamp INTEGER, ant INTEGER,
-                        sig_len INTEGER, rx_state INTEGER, len INTEGER, first_word INTEGER, data TEXT
-                    )
-                ''')
-                
-                processed_data = []
-                timestamp_now = datetime.now().isoformat()
-                for row_str in collected_data_buffer:
-                    # Split only up to the data field to handle commas in the data itself
-                    parts = row_str.split(',', 24) 
-                    if len(parts) == 25:
-                        parts[24] = parts[24].strip('"')
-                        processed_data.append([timestamp_now, cenario] + parts)
-                
-                sql_insert_command = """
-                    INSERT INTO csi_data (
-                        timestamp, scenario, type, seq, mac, rssi, rate, sig_mode, mcs, bandwidth, 
-                        smoothing, not_sounding, aggregation, stbc, fec_coding, sgi, noise_floor, 
-                        ampdu_cnt, channel, secondary_channel, local_timestamp, ant, sig_len, 
-                        rx_state, len, first_word, data
-                    ) VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)
-                """
-                cursor.executemany(sql_insert_command, processed_data)
-                conn.commit()
-            page.show_snack_bar(ft.SnackBar(content=ft.Text(f"Data successfully committed to: {path}"), open=True))
-        except Exception as ex:
-            show_dialog("Save Error", f"Failed to commit data to the database: {ex}")
-        finally:
-            collected_data_buffer.clear()
-            q.put(("disable_save_button", None))
+    def finish_session(status):
+        nonlocal session_writer
+        if session_writer is None:
+            return 0
+        writer, session_writer = session_writer, None
+        return writer.finish(status)
 
     def on_select_db_result(e: ft.FilePickerResultEvent):
         nonlocal selected_db_path
@@ -249,30 +158,40 @@ def main(page: ft.Page):
         save_data_to_selected_db()
 
     def save_data_to_selected_db():
-        if not collected_data_buffer:
-            page.show_snack_bar(ft.SnackBar(content=ft.Text("No data available to save."), open=True))
-            return
-        
-        save_to_db(selected_db_path, cenario_input.value or "N/A")
+        # Frames are already committed during acquisition; saving only closes the session.
+        try:
+            saved = finish_session('complete')
+            page.show_snack_bar(ft.SnackBar(content=ft.Text(f"{saved} frames committed to: {selected_db_path}"), open=True))
+        except Exception as ex:
+            show_dialog("Save Error", f"Failed to finalize the session: {ex}")
+        console_save_button.disabled = True
+        page.update()
 
     def discard_and_go_back():
-        nonlocal collected_data_buffer
-        collected_data_buffer.clear()
+        try:
+            finish_session('discarded')
+        except Exception as ex:
+            show_dialog("Error", f"Failed to discard the session: {ex}")
         go_to_view('/collect')
 
     def go_to_view(route):
         page.go(route)
         
     def start_discovery():
-        nonlocal discovery_thread
         discovery_button.disabled = True
         discovery_progress.visible = True
-        collect_esp_ip.value = ""
-        collect_esp_ip.hint_text = "Discovering for 75 seconds..."
-        stop_discovery_event.clear()
-        discovery_thread = threading.Thread(target=listen_for_esp_ip_thread,args=(stop_discovery_event,),daemon=True)
-        discovery_thread.start()
         page.update()
+        node_registry.start()
+
+    def selected_nodes():
+        """Checked discovered nodes plus the addresses typed in by hand, in order, without duplicates."""
+        nodes = [box.data for box in collect_nodes.controls if box.value]
+        for ip in (collect_esp_ip.value or "").split(','):
+            ip = ip.strip()
+            if ip and ip not in nodes:
+                socket.inet_aton(ip)  # Raises OSError for anything that is not an IPv4 address
+                nodes.append(ip)
+        return nodes
 
     def on_auth_type_change(e):
         prov_identity.visible = (e.control.value == "peap")
@@ -287,18 +206,42 @@ def main(page: ft.Page):
         threading.Thread(target=send_provision_command, args=(command, page), daemon=True).start()
 
     def start_collection():
-        nonlocal network_thread, stop_collection_event, collected_data_buffer
+        nonlocal network_thread, stop_collection_event, session_writer, live_view
         
         if not selected_db_path:
             show_dialog("Warning", "Please select a database file to store the data before initiating the acquisition.")
             return
 
         try:
-            stop_discovery_event.set()
-            collected_data_buffer.clear()
+            start_message = format_start_command(collect_time.value, collect_sc_mask.value,
+                                                 collect_decimation.value or 1, collect_rate.value or 0,
+                                                 collect_payload_mode.value, collect_target.value or 0,
+                                                 collect_probe.value, collect_sources.value)
+            if int(collect_windows.value or 1) > 1:
+                now_us = time.time_ns() // 1000
+                start_message = format_schedule_command(now_us // 1_000_000 % (1 << 32),
+                                                        now_us + int(collect_first_in.value or 0) * 1_000_000,
+                                                        collect_every.value or 0, collect_windows.value, start_message)
+        except ValueError as e:
+            show_dialog("Invalid Capture Options", str(e))
+            return
+
+        try:
+            nodes = selected_nodes()
+        except OSError:
+            show_dialog("Invalid Node Address", "Additional node addresses must be IPv4 addresses separated by commas.")
+            return
+        if not nodes:
+            show_dialog("Warning", "Please select or enter at least one ESP32 node before initiating the acquisition.")
+            return
+
+        try:
+            finish_session('discarded')
+            session_writer = SessionWriter(selected_db_path, cenario_input.value or "N/A", start_message, nodes)
+            live_view = LiveView(amplitude_payload=collect_payload_mode.value == 'amp')
             go_to_view('/console')
             stop_collection_event.clear()
-            network_thread = threading.Thread(target=udp_listener_thread,args=(collect_esp_ip.value,collect_time.value,collect_port.value,stop_collection_event),daemon=True)
+            network_thread = threading.Thread(target=udp_listener_thread,args=(nodes,start_message,collect_port.value,stop_collection_event,session_writer,q,collect_nack.value,live_view,collect_raw_log.value),daemon=True)
             network_thread.start()
         except Exception as e:
             show_dialog("Initialization Error", f"Could not start acquisition: {e}")
@@ -309,7 +252,33 @@ def main(page: ft.Page):
         stop_collection_event.set()
         q.put(("log_system", "\n--- Acquisition terminated by user. ---"))
 
+    def refresh_live():
+        """Redraws the streams of the live view that changed; returns True if any did."""
+        views = live_view.render() if live_view else []
+        for view in views:
+            controls = live_controls.get(view['key'])
+            if controls is None:
+                node, mac = view['key']
+                label = ft.Text(font_family="monospace", size=11, color="cyan200")
+                heatmap = ft.Image(src_base64=BLANK_PNG, width=256, height=150, fit=ft.ImageFit.FILL, gapless_playback=True)
+                rate = ft.Image(src_base64=BLANK_PNG, width=120, height=24, fit=ft.ImageFit.FILL, gapless_playback=True)
+                rssi = ft.Image(src_base64=BLANK_PNG, width=120, height=24, fit=ft.ImageFit.FILL, gapless_playback=True)
+                controls = live_controls[view['key']] = (label, heatmap, rate, rssi)
+                console_live.controls.append(ft.Container(
+                    content=ft.Column([ft.Text(f"{node}  {mac}", font_family="monospace", size=11), heatmap, label,
+                                       ft.Row([ft.Text("fps ", size=10, color="grey"), rate]),
+                                       ft.Row([ft.Text("rssi", size=10, color="grey"), rssi])], spacing=2),
+                    bgcolor="black", border=ft.border.all(1, "white24"), border_radius=ft.border_radius.all(5), padding=6))
+            label, heatmap, rate, rssi = controls
+            label.value = f"{view['rate_hz']:4d} fps  rssi {view['rssi']}  frames {view['frames']}"
+            if view['heatmap']:
+                heatmap.src_base64 = view['heatmap']
+            rate.src_base64 = view['rate']
+            rssi.src_base64 = view['rssi_line']
+        return bool(views)
+
     def process_queue():
+        nonlocal live_refreshed
         needs_update = False
         new_console_items = []
         
@@ -319,29 +288,30 @@ def main(page: ft.Page):
                 needs_update = True
 
                 if message_type == "ip_discovered":
-                    if page.route == "/collect":
-                        collect_esp_ip.value = data
-                        collect_esp_ip.hint_text = "IP Address Discovered!"
-                        discovery_progress.visible = False
-                        discovery_button.disabled = False
+                    if all(box.data != data for box in collect_nodes.controls):
+                        collect_nodes.controls.append(ft.Checkbox(label=f"ESP32 node {data}", value=True, data=data))
+                elif message_type == "discovery_listening":
+                    discovery_progress.visible = False
+                    discovery_button.disabled = False
                 elif message_type == "discovery_failed":
-                    if page.route == "/collect":
-                        collect_esp_ip.hint_text = data if data else "No ESP32 node discovered."
-                        discovery_progress.visible = False
-                        discovery_button.disabled = False
+                    collect_esp_ip.hint_text = data if data else "No ESP32 node discovered."
+                    discovery_progress.visible = False
+                    discovery_button.disabled = False
                 elif message_type == "log_csi":
-                    new_console_items.append(ft.Text(data, font_family="monospace", size=12, selectable=True, color="white"))
+                    new_console_items.append((data, 12, "white"))
                 elif message_type == "log_system":
-                    new_console_items.append(ft.Text(data, font_family="monospace", size=11, color="grey", selectable=True))
-                elif message_type == "buffer_data":
-                    collected_data_buffer.append(data)
+                    new_console_items.append((data, 11, "grey"))
+                elif message_type in ("node_rate", "node_stats"):
+                    node_ip, summary = data
+                    node_health.setdefault(node_ip, {})[message_type] = summary
+                    console_health.controls = [ft.Text(f"{ip}  " + "\n    ".join(lines[kind] for kind in ("node_rate", "node_stats") if kind in lines),
+                                                       font_family="monospace", size=11, color="cyan200", selectable=True)
+                                               for ip, lines in sorted(node_health.items())]
                 elif message_type == "collection_finished":
                     console_stop_button.visible = False
-                    if collected_data_buffer:
+                    if data:
                         console_save_button.visible = True
                     console_back_button.visible = True
-                elif message_type == "disable_save_button":
-                    console_save_button.disabled = True
                 elif message_type == "provision_success":
                     show_dialog("Success", "Configuration submitted! The ESP32 node will now restart.")
                     go_to_view('/')
@@ -354,8 +324,16 @@ def main(page: ft.Page):
                 print(f"UNEXPECTED ERROR IN PROCESS_QUEUE: {e}")
         
         if new_console_items:
-            console_output.controls.extend(new_console_items)
-        
+            # Lines that would be trimmed right away never become controls.
+            console_output.controls.extend(ft.Text(text, font_family="monospace", size=size, color=color, selectable=True)
+                                           for text, size, color in new_console_items[-CONSOLE_MAX_LINES:])
+            del console_output.controls[:-CONSOLE_MAX_LINES]
+
+        now = time.monotonic()
+        if now - live_refreshed >= LIVE_REFRESH_S:
+            live_refreshed = now
+            needs_update = refresh_live() or needs_update
+
         if needs_update:
             page.update()
 
@@ -371,7 +349,7 @@ def main(page: ft.Page):
         
     def window_event(e):
         if e.data == "close":
-            stop_discovery_event.set()
+            node_registry.stop()
             stop_collection_event.set()
             page.window_destroy()
 
@@ -397,9 +375,19 @@ def main(page: ft.Page):
             page.views.append(
                 ft.View(route="/collect",appbar=ft.AppBar(leading=ft.IconButton(icon="arrow_back_rounded", on_click=lambda _: go_to_view('/')),title=ft.Text("Configure Data Acquisition"),bgcolor="surfaceVariant"),controls=[AppCard(ft.Column([
                     ft.Row(controls=[collect_esp_ip, discovery_progress, discovery_button], alignment=ft.MainAxisAlignment.START),
+                    collect_nodes,
                     collect_time,
                     collect_port,
                     ft.Divider(),
+                    collect_sc_mask,
+                    ft.Row(controls=[collect_decimation, collect_rate]),
+                    collect_payload_mode,
+                    ft.Row(controls=[collect_target, collect_probe]),
+                    collect_sources,
+                    ft.Row(controls=[collect_windows, collect_every, collect_first_in]),
+                    collect_nack,
+                    collect_raw_log,
+                    ft.Divider(),
                     cenario_input,
                     ft.Row(controls=[
                         ft.ElevatedButton("Select Database", icon="folder_open", on_click=lambda _: select_db_dialog.save_file(
@@ -416,10 +404,14 @@ def main(page: ft.Page):
                         icon="play_arrow", 
                         on_click=lambda _: start_collection()
                     )
-                ]))],vertical_alignment=ft.MainAxisAlignment.CENTER,horizontal_alignment=ft.CrossAxisAlignment.CENTER)
+                ]))],scroll=ft.ScrollMode.AUTO,vertical_alignment=ft.MainAxisAlignment.CENTER,horizontal_alignment=ft.CrossAxisAlignment.CENTER)
             )
         if page.route == "/console":
             console_output.controls.clear()
+            console_health.controls.clear()
+            node_health.clear()
+            console_live.controls.clear()
+            live_controls.clear()
             console_stop_button.visible = True
             console_save_button.visible = False
             console_save_button.disabled = False
@@ -429,6 +421,8 @@ def main(page: ft.Page):
                     route="/console",
                     appbar=ft.AppBar(title=ft.Text("CSI Acquisition Console"),bgcolor="surfaceVariant", automatically_imply_leading=False),
                     controls=[
+                        console_health,
+                        console_live,
                         ft.Container(content=console_output, expand=True, bgcolor="black", border=ft.border.all(1, "white24"), border_radius=ft.border_radius.all(5), padding=10),
                         ft.Container(
                             content=ft.Row([console_stop_button, console_save_button, console_back_button], alignment=ft.MainAxisAlignment.CENTER),
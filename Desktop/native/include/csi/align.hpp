@@ -0,0 +1,86 @@
+// Multi-node alignment onto one time grid.
+//
+// Every node stamps its frames with its own radio clock. NodeClock turns those
+// timestamps into shared time (the collector's CLOCK_REALTIME, microseconds)
+// with the node's latest CSI_CLOCK mapping (csi_clock.h), so frames of
+// different receivers become comparable.
+//
+// StreamAligner then resamples N streams of fixed-width sample vectors (one
+// stream per node, e.g. the amplitude rows of csi::dsp::Extractor) onto a
+// common grid period_us apart, by linear interpolation between the samples on
+// either side of each grid point. It is incremental: a grid point is emitted
+// once every stream has a sample at or after it, so the output lags the
+// slowest node. A stream silent for more than max_lag_us behind the newest
+// sample of any stream no longer holds the grid back; across a gap wider
+// than max_gap_us (lost frames, a stopped node) a stream has no value at that
+// point rather than a value interpolated over the gap.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "csi_clock.h"
+
+namespace csi {
+
+class NodeClock {
+public:
+    // Installs a newer mapping; frames are converted with the latest one.
+    void update(const csi_clock_report_t &report);
+    bool valid() const { return valid_; }
+    const csi_clock_report_t &report() const { return report_; }
+
+    // Shared time of a radio timestamp. Only meaningful when valid().
+    int64_t to_shared(uint32_t radio_us) const { return csi_clock_report_to_shared(&report_, radio_us); }
+
+private:
+    csi_clock_report_t report_ = {};
+    bool valid_ = false;
+};
+
+struct AlignedRow {
+    int64_t t_us = 0;
+    std::vector<float> values;   // streams * width, stream-major
+    std::vector<uint8_t> valid;  // one flag per stream
+};
+
+class StreamAligner {
+public:
+    // Throws std::invalid_argument for zero streams, width or period.
+    StreamAligner(size_t streams, size_t width, int64_t period_us, int64_t max_gap_us, int64_t max_lag_us);
+
+    // Appends a sample of width values. Samples older than the previous one of
+    // the same stream, or older than the grid already emitted, are dropped.
+    void add(size_t stream, int64_t t_us, const float *values);
+
+    // Appends every grid point that is complete to out; with flush, every grid
+    // point up to the newest sample. Returns the number of rows appended.
+    size_t drain(std::vector<AlignedRow> &out, bool flush = false);
+
+    size_t streams() const { return streams_.size(); }
+    size_t width() const { return width_; }
+    uint64_t late() const { return late_; }
+
+private:
+    struct Sample {
+        int64_t t_us;
+        std::vector<float> values;
+    };
+    struct Stream {
+        std::deque<Sample> samples;
+    };
+
+    size_t width_;
+    int64_t period_us_;
+    int64_t max_gap_us_;
+    int64_t max_lag_us_;
+    std::vector<Stream> streams_;
+    bool started_ = false;
+    int64_t next_us_ = 0;
+    int64_t newest_us_ = INT64_MIN;
+    uint64_t late_ = 0;
+};
+
+}  // namespace csi
@@ -0,0 +1,184 @@
+// Columnar CSI archive (.csia): a read-only, memory-mapped layout for offline
+// analysis of long sessions.
+//
+// Every column is a contiguous, 64-byte aligned array with one entry per
+// frame, so a slice of frames is a set of pointers into the mapping and the
+// subcarrier data is a single row-major int8 matrix of width() columns:
+//
+//   header     ArchiveHeader (fixed size, offsets of everything below)
+//   payload    int8   [frames][width]   I/Q values, zero padded to width
+//   time_us    int64  [frames]          non-decreasing time key
+//   local_ts   uint32 [frames]          node timestamp (csi_frame_meta_t.timestamp)
+//   seq        uint32 [frames]
+//   len        uint16 [frames]          valid payload bytes in the row
+//   node       uint16 [frames]          index into the node table
+//   rssi       int8   [frames]
+//   noise      int8   [frames]
+//   channel    uint8  [frames]
+//   nodes      uint8  [node_count][8]   MAC address + 2 bytes padding
+//   index      ArchiveIndexEntry [index_entries]
+//
+// The sparse index has one entry per index_block frames: the first row, its
+// time key and the sequence range covered by the block. Time lookups binary
+// search the index and then only the matching block of the time column.
+//
+// All integers are stored little-endian; the reader maps the file as is, so it
+// only supports little-endian hosts.
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "csi_frame.h"
+
+namespace csi {
+
+inline constexpr char kArchiveMagic[8] = {'C', 'S', 'I', 'A', 'R', 'C', '1', '\0'};
+inline constexpr uint32_t kArchiveVersion = 1;
+inline constexpr size_t kArchiveAlign = 64;
+
+struct ArchiveHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint64_t frames;
+    uint32_t node_count;
+    uint32_t index_block;
+    uint64_t index_entries;
+    uint64_t off_payload;
+    uint64_t off_time_us;
+    uint64_t off_local_ts;
+    uint64_t off_seq;
+    uint64_t off_len;
+    uint64_t off_node;
+    uint64_t off_rssi;
+    uint64_t off_noise;
+    uint64_t off_channel;
+    uint64_t off_nodes;
+    uint64_t off_index;
+};
+
+struct ArchiveIndexEntry {
+    uint64_t first_row;
+    int64_t first_time_us;
+    uint32_t min_seq;
+    uint32_t max_seq;
+};
+
+using Mac = std::array<uint8_t, 6>;
+
+// Zero-copy view of rows [begin, begin + rows) of an open archive.
+struct ArchiveSlice {
+    uint64_t begin = 0;
+    size_t rows = 0;
+    uint32_t width = 0;
+    const int8_t *payload = nullptr;
+    const int64_t *time_us = nullptr;
+    const uint32_t *local_ts = nullptr;
+    const uint32_t *seq = nullptr;
+    const uint16_t *len = nullptr;
+    const uint16_t *node = nullptr;
+    const int8_t *rssi = nullptr;
+    const int8_t *noise = nullptr;
+    const uint8_t *channel = nullptr;
+
+    const int8_t *row(size_t i) const { return payload + i * width; }
+};
+
+class ArchiveWriter {
+public:
+    // Creates path (truncating it). width is the row size of the payload
+    // matrix; frames longer than width are rejected by append().
+    // Throws std::system_error if the file cannot be created.
+    ArchiveWriter(const std::string &path, uint32_t width, uint32_t index_block = 1024);
+    ~ArchiveWriter();
+
+    ArchiveWriter(const ArchiveWriter &) = delete;
+    ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+    // Appends one frame. time_us must not be smaller than the previous one.
+    // Throws std::invalid_argument for an oversized payload, a decreasing time
+    // key or more than 65535 nodes, and std::system_error on write failure.
+    void append(const csi_frame_meta_t &meta, const int8_t *payload, int64_t time_us);
+
+    // Writes the metadata columns, node table, index and header. Called by the
+    // destructor if needed, where errors are swallowed.
+    void close();
+
+    uint64_t frames() const { return frames_; }
+    size_t nodes() const { return nodes_.size(); }
+
+private:
+    void write(const void *data, size_t len);
+    void pad_to_alignment();
+    template <typename T>
+    uint64_t write_column(const std::vector<T> &column);
+
+    std::FILE *file_ = nullptr;
+    std::string path_;
+    uint32_t width_;
+    uint32_t index_block_;
+    uint64_t frames_ = 0;
+    uint64_t offset_ = 0;
+    std::vector<int8_t> row_;
+    std::vector<int64_t> time_us_;
+    std::vector<uint32_t> local_ts_;
+    std::vector<uint32_t> seq_;
+    std::vector<uint16_t> len_;
+    std::vector<uint16_t> node_;
+    std::vector<int8_t> rssi_;
+    std::vector<int8_t> noise_;
+    std::vector<uint8_t> channel_;
+    std::vector<Mac> nodes_;
+    std::vector<ArchiveIndexEntry> index_;
+};
+
+class ArchiveReader {
+public:
+    // Maps path read-only and validates the header and column bounds.
+    // Throws std::system_error if the file cannot be mapped and
+    // std::runtime_error if it is not a valid archive.
+    explicit ArchiveReader(const std::string &path);
+    ~ArchiveReader();
+
+    ArchiveReader(const ArchiveReader &) = delete;
+    ArchiveReader &operator=(const ArchiveReader &) = delete;
+
+    uint64_t frames() const { return header_->frames; }
+    uint32_t width() const { return header_->width; }
+    const std::vector<Mac> &nodes() const { return nodes_; }
+    const ArchiveIndexEntry *index() const { return index_; }
+    uint64_t index_entries() const { return header_->index_entries; }
+
+    // Rows [begin, end), clamped to the archive.
+    ArchiveSlice slice(uint64_t begin, uint64_t end) const;
+
+    // Row range [first, last) whose time key lies in [t0_us, t1_us).
+    std::pair<uint64_t, uint64_t> time_range(int64_t t0_us, int64_t t1_us) const;
+
+    // First row with the given node and sequence number, or frames() if none.
+    // Only index blocks whose sequence range covers seq are scanned.
+    uint64_t find_seq(uint16_t node, uint32_t seq) const;
+
+    // Hints the kernel to read the whole mapping ahead (MADV_WILLNEED).
+    void prefetch() const;
+
+private:
+    template <typename T>
+    const T *column(uint64_t offset, uint64_t count, size_t elem = sizeof(T)) const;
+    uint64_t lower_bound_time(int64_t t_us) const;
+
+    const uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+    const ArchiveHeader *header_ = nullptr;
+    ArchiveSlice all_;
+    const ArchiveIndexEntry *index_ = nullptr;
+    std::vector<Mac> nodes_;
+};
+
+}  // namespace csi
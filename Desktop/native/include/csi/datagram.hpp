@@ -0,0 +1,145 @@
+// Host-side decoding of everything the receiver node can put on the wire:
+// legacy CSI_DATA text lines, packed binary frames (csi_frame.h) and batch
+// datagrams (csi_batch.h). Every frame is delivered as a csi_frame_meta_t plus
+// a view of its int8 payload, regardless of the wire format it arrived in.
+// Delta-compressed frames (csi_delta.h) are expanded back to raw payloads
+// using per-stream reference state (StreamKey).
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "csi_batch.h"
+#include "csi_delta.h"
+#include "csi_frame.h"
+
+namespace csi {
+
+struct Frame {
+    csi_frame_meta_t meta;
+    const int8_t *payload;
+};
+
+// Packs a MAC address into the low 48 bits of an integer key.
+inline uint64_t mac_key(const uint8_t mac[6]) {
+    uint64_t key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = (key << 8) | mac[i];
+    }
+    return key;
+}
+
+// One frame stream: the node that sent it and the transmitter MAC inside the
+// frames. Nodes associated with the same AP all report its BSSID, so the MAC
+// alone does not tell their streams apart. source is the sender's IPv4
+// address in network byte order, 0 when unknown.
+struct StreamKey {
+    uint32_t source = 0;
+    uint64_t mac = 0;
+
+    bool operator==(const StreamKey &other) const { return source == other.source && mac == other.mac; }
+};
+
+struct StreamKeyHash {
+    size_t operator()(const StreamKey &key) const {
+        return std::hash<uint64_t>()(key.mac ^ (static_cast<uint64_t>(key.source) * 0x9E3779B97F4A7C15ull));
+    }
+};
+
+// Scans "[a,b,...]" (quotes and surrounding whitespace allowed) into out and
+// returns the number of values; only the first cap are written. Returns -1 if
+// the list is malformed or a value does not fit in int8. Plain lists are
+// converted 16 bytes at a time with SSE2 where available, the rest in scalar
+// code with the same result.
+long scan_payload_list(std::string_view text, int8_t *out, size_t cap);
+
+// Selects the SSE2 or the scalar scanner for every caller (benchmarks compare
+// the two). Returns whether SSE2 is in use afterwards: never where the build
+// target lacks it.
+bool set_simd_scan(bool enabled);
+bool simd_scan();
+
+// Parses "[a,b,...]" into out. Returns false if the list is malformed or a
+// value does not fit in int8.
+bool parse_payload_list(std::string_view text, std::vector<int8_t> &out);
+
+// Parses one CSI_DATA line. meta.len is set to the number of payload values.
+bool parse_csi_line(std::string_view line, csi_frame_meta_t &meta, std::vector<int8_t> &payload);
+
+// Same, writing the payload to row (cap values, the rest dropped). Returns the
+// number of payload values, or -1 if the line is malformed.
+long parse_csi_line(std::string_view line, csi_frame_meta_t &meta, int8_t *row, size_t cap);
+
+class DatagramDecoder {
+public:
+    // Invokes on_frame(const Frame &) for every frame in the datagram and
+    // returns the number of frames delivered. Malformed input is counted in
+    // malformed() rather than reported as an error. source is the sender's
+    // address (StreamKey); delta references are kept per stream.
+    template <typename OnFrame>
+    size_t decode(const uint8_t *data, size_t len, OnFrame &&on_frame, uint32_t source = 0) {
+        if (csi_batch_is_batch(data, len)) {
+            csi_batch_reader_t reader;
+            if (csi_batch_open(&reader, data, len) != 0) {
+                malformed_++;
+                return 0;
+            }
+            size_t n = 0;
+            const uint8_t *frame;
+            uint16_t frame_len;
+            int rc;
+            while ((rc = csi_batch_next(&reader, &frame, &frame_len)) == 1) {
+                n += decode_frame(frame, frame_len, on_frame, source);
+            }
+            if (rc < 0) {
+                malformed_++;
+            }
+            return n;
+        }
+        return decode_frame(data, len, on_frame, source);
+    }
+
+    uint64_t malformed() const { return malformed_; }
+    // Delta frames dropped because their reference frame was never received.
+    uint64_t delta_desync() const { return delta_desync_; }
+
+private:
+    template <typename OnFrame>
+    size_t decode_frame(const uint8_t *data, size_t len, OnFrame &on_frame, uint32_t source) {
+        Frame frame;
+        if (csi_frame_is_binary(data, len)) {
+            if (csi_frame_decode(data, len, &frame.meta, &frame.payload) != CSI_FRAME_OK) {
+                malformed_++;
+                return 0;
+            }
+            if (!expand_delta(frame, source)) {
+                return 0;
+            }
+        } else {
+            std::string_view line(reinterpret_cast<const char *>(data), len);
+            if (!parse_csi_line(line, frame.meta, scratch_)) {
+                malformed_++;
+                return 0;
+            }
+            frame.payload = scratch_.data();
+        }
+        on_frame(static_cast<const Frame &>(frame));
+        return 1;
+    }
+
+    // Keeps the stream's delta reference current and replaces a delta payload
+    // with the reconstructed raw one. Returns false if the frame is dropped.
+    bool expand_delta(Frame &frame, uint32_t source);
+
+    std::vector<int8_t> scratch_;
+    std::unordered_map<StreamKey, std::unique_ptr<csi_delta_dec_t>, StreamKeyHash> delta_;
+    uint64_t malformed_ = 0;
+    uint64_t delta_desync_ = 0;
+};
+
+}  // namespace csi
@@ -0,0 +1,77 @@
+// Vectorized amplitude/phase extraction for CSI payloads.
+//
+// The node delivers each subcarrier as an (imaginary, real) pair of int8 values
+// in buffer order. With only LLTF enabled (see wifi_csi_init) a 20 MHz frame
+// carries 64 pairs ordered as subcarriers 0..31, -32..-1 and a 40 MHz frame
+// 128 pairs ordered as 0..63, -64..-1.
+//
+// The amplitude and phase kernels come in AVX2, SSE2 and scalar versions and
+// are picked at runtime from what the CPU supports. Phase uses a polynomial
+// atan2 (max error about 2e-6 rad) in every version, so results agree across
+// ISAs to float rounding. Unwrapping and linear-offset removal are plain loops
+// left to the compiler's vectorizer.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace csi::dsp {
+
+enum class Isa { Scalar, Sse2, Avx2 };
+
+// Best ISA supported by the running CPU.
+Isa best_isa();
+bool isa_supported(Isa isa);
+const char *isa_name(Isa isa);
+
+// Frequency-ordered selection of subcarriers from the raw pair buffer.
+struct SubcarrierMask {
+    std::vector<uint16_t> index;       // pair index in the raw buffer
+    std::vector<int16_t> subcarrier;   // signed subcarrier number of each entry
+
+    size_t size() const { return index.size(); }
+
+    // Every pair of an LLTF buffer (64 or 128 pairs), reordered by frequency.
+    static SubcarrierMask lltf_all(size_t pairs);
+    // LLTF data and pilot subcarriers only: guard bands and DC removed
+    // (52 of 64 pairs at 20 MHz, 104 of 128 at 40 MHz).
+    // Both throw std::invalid_argument for other buffer sizes.
+    static SubcarrierMask lltf(size_t pairs);
+};
+
+// Amplitude sqrt(re^2 + im^2) and phase atan2(im, re) of n interleaved
+// (imag, real) pairs.
+void amplitude(const int8_t *iq, size_t n, float *out, Isa isa = best_isa());
+void phase(const int8_t *iq, size_t n, float *out, Isa isa = best_isa());
+
+// Removes 2*pi jumps between consecutive entries.
+void unwrap(float *phase, size_t n);
+
+// Subtracts the least-squares line a * subcarrier + b, which removes the
+// timing (slope) and carrier (offset) errors of the receiver.
+void remove_linear_phase(float *phase, const int16_t *subcarrier, size_t n);
+
+// Batch front end: gathers the masked subcarriers of a run of frames into a
+// contiguous buffer and runs the kernels over it in one pass.
+class Extractor {
+public:
+    explicit Extractor(SubcarrierMask mask, Isa isa = best_isa());
+
+    // frames points at count raw payloads, stride bytes apart. amp and phase
+    // (either may be null) receive count * width() floats, one row per frame.
+    // With sanitize set every phase row is unwrapped and detrended. Throws
+    // std::invalid_argument if stride cannot hold every masked pair.
+    void run(const int8_t *frames, size_t count, size_t stride, float *amp, float *phase, bool sanitize = true);
+
+    size_t width() const { return mask_.size(); }
+    const SubcarrierMask &mask() const { return mask_; }
+    Isa isa() const { return isa_; }
+
+private:
+    SubcarrierMask mask_;
+    Isa isa_;
+    std::vector<int8_t> gathered_;
+};
+
+}  // namespace csi::dsp
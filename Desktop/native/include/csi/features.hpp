@@ -0,0 +1,159 @@
+// Streaming feature extraction for live presence and activity detection.
+//
+// FeaturePipeline takes frames one at a time, in arrival order, from
+// csi_ingestd's feed, a DatagramDecoder or a recorded session. For each
+// stream (sending node and transmitter, StreamKey) it runs a chain of incremental operators over the amplitudes
+// of the LLTF data subcarriers (csi::dsp):
+//
+//   1. Hampel filter. A sample more than hampel_sigmas robust standard
+//      deviations (1.4826 * MAD) from the median of the 2*hampel_half+1
+//      samples centred on it is replaced by that median. This needs
+//      hampel_half frames of lookahead, which is the pipeline's only delay.
+//   2. Moving average of the last `smooth` filtered samples (low-pass).
+//   3. Sliding window of the last `window` smoothed samples: mean and
+//      variance per subcarrier.
+//   4. Incremental PCA (CCIPCA, covariance-free) of the samples centred on
+//      the window mean. Its memory is about pca_memory frames. The window
+//      also holds the variance of each component's projection.
+//
+// Once the window is full, every hop-th frame completes a FeatureVector.
+// State lives in ring buffers, allocated when a transmitter is first seen.
+// A frame costs O(width * (hampel_half + components)) and allocates nothing.
+//
+// Frames must be raw LLTF captures of `pairs` subcarrier pairs. Other frames
+// are rejected: amplitude mode, a subcarrier mask, another bandwidth. Frames
+// older than the transmitter's previous one are dropped, as are
+// retransmissions that arrive late. A silence longer than reset_gap_us
+// restarts the transmitter's state.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "csi/datagram.hpp"
+#include "csi/dsp.hpp"
+#include "csi_frame.h"
+
+namespace csi {
+
+struct FeatureConfig {
+    size_t pairs = 64;            // 64 (20 MHz) or 128 (40 MHz) LLTF pairs
+    size_t hampel_half = 3;       // Hampel window of 2 * hampel_half + 1 samples
+    float hampel_sigmas = 3.0f;
+    size_t smooth = 5;            // moving average length
+    size_t window = 100;          // samples per feature window (1 s at 100 Hz)
+    size_t hop = 25;              // frames between feature windows
+    size_t components = 3;        // principal components tracked
+    size_t pca_memory = 500;      // frames; the CCIPCA learning rate is 1/min(n, pca_memory)
+    size_t max_nodes = 64;        // transmitters tracked; frames of others are dropped
+    int64_t reset_gap_us = 1000000;
+};
+
+struct FeatureVector {
+    uint64_t node = 0;            // transmitter, csi::mac_key
+    uint32_t source = 0;          // sending node's address (StreamKey), 0 if unknown
+    uint64_t index = 0;           // windows of this transmitter since its state (re)started
+    int64_t start_us = 0;         // times of the oldest and newest sample in the window
+    int64_t end_us = 0;
+    std::vector<float> mean;      // width() values
+    std::vector<float> variance;  // width() values
+    float motion = 0;             // mean of variance over the subcarriers
+    std::vector<float> eigenvalues;   // components values, CCIPCA estimates
+    std::vector<float> pc_variance;   // components values, variance of each projection
+    std::vector<float> basis;         // components * width() values, unit vectors
+};
+
+class FeaturePipeline {
+public:
+    // Throws std::invalid_argument for an unsupported pairs value or a zero
+    // window, hop, smooth, components or pca_memory, or components > width.
+    explicit FeaturePipeline(const FeatureConfig &config);
+
+    // Feeds one frame received from source (StreamKey) at t_us (any monotonic
+    // microsecond clock that all transmitters share). Returns the completed
+    // window, or null. The vector stays valid until the next call.
+    const FeatureVector *push(const csi_frame_meta_t &meta, const int8_t *payload, int64_t t_us,
+                              uint32_t source = 0);
+
+    // Drops the state of every transmitter.
+    void reset();
+
+    const FeatureConfig &config() const { return config_; }
+    size_t width() const { return extractor_.width(); }
+    const dsp::SubcarrierMask &mask() const { return extractor_.mask(); }
+    size_t nodes() const { return nodes_.size(); }
+
+    uint64_t frames() const { return frames_; }
+    uint64_t windows() const { return windows_; }
+    uint64_t rejected() const { return rejected_; }
+    uint64_t late() const { return late_; }
+    uint64_t overflow() const { return overflow_; }
+    uint64_t restarts() const { return restarts_; }
+    // Samples (frame, subcarrier) replaced by the Hampel filter.
+    uint64_t outliers() const { return outliers_; }
+
+private:
+    struct Node {
+        int64_t last_us = 0;
+        uint64_t windows = 0;
+        // Hampel: ring of raw amplitude rows and their times, plus each
+        // subcarrier's samples kept sorted (width rows of span values).
+        std::vector<float> raw;
+        std::vector<int64_t> raw_t;
+        std::vector<float> sorted;
+        size_t raw_count = 0;
+        size_t raw_head = 0;
+        // Moving average: ring of filtered rows and their running sums.
+        std::vector<float> lp;
+        std::vector<double> lp_sum;
+        size_t lp_count = 0;
+        size_t lp_head = 0;
+        // Window: ring of smoothed rows and component projections, with
+        // their running means and sums of squared deviations (Welford).
+        std::vector<float> win;
+        std::vector<int64_t> win_t;
+        std::vector<double> mean;
+        std::vector<double> m2;
+        std::vector<float> proj;
+        std::vector<double> proj_mean;
+        std::vector<double> proj_m2;
+        size_t win_count = 0;
+        size_t win_head = 0;
+        size_t since_hop = 0;
+        // CCIPCA: unnormalised eigenvector estimates, components rows.
+        std::vector<float> v;
+        uint64_t pca_n = 0;
+    };
+
+    Node *node_for(const StreamKey &key, int64_t t_us);
+    void restart(Node &node);
+    void hampel(Node &node, const float *amp, int64_t t_us);
+    void smooth(Node &node, const float *filtered);
+    const FeatureVector *slide(Node &node, const StreamKey &key, const float *y, int64_t t_us);
+    void pca(Node &node, const float *u, float *proj);
+    void publish(Node &node, const StreamKey &key);
+
+    FeatureConfig config_;
+    dsp::Extractor extractor_;
+    size_t span_;                 // 2 * hampel_half + 1
+    std::unordered_map<StreamKey, Node, StreamKeyHash> nodes_;
+    std::vector<float> amp_;
+    std::vector<float> filtered_;
+    std::vector<float> smoothed_;
+    std::vector<float> centred_;
+    std::vector<float> residual_;
+    std::vector<float> old_proj_;
+    FeatureVector out_;
+
+    uint64_t frames_ = 0;
+    uint64_t windows_ = 0;
+    uint64_t rejected_ = 0;
+    uint64_t late_ = 0;
+    uint64_t overflow_ = 0;
+    uint64_t restarts_ = 0;
+    uint64_t outliers_ = 0;
+};
+
+}  // namespace csi
@@ -0,0 +1,206 @@
+// Multi-node UDP ingest: one non-blocking socket drained with recvmmsg from a
+// single epoll loop, frames demultiplexed per stream, written to per-stream
+// log files and fanned out to local feed subscribers. A stream is the frames of
+// one transmitter MAC as heard by one node (StreamKey): the nodes on one AP all
+// report its BSSID, so they are told apart by their address.
+//
+// Record format, shared by the .csilog files and the feed datagrams:
+//
+//   uint64  host receive time, CLOCK_REALTIME nanoseconds (little-endian)
+//   4 bytes IPv4 address of the node that sent the frame (network order)
+//   int64   capture time on the shared timebase, CLOCK_REALTIME microseconds
+//           (little-endian): the frame's radio timestamp mapped with the
+//           node's latest CSI_CLOCK report, kNoCaptureTime until it sent one
+//   bytes   the frame re-encoded as a binary csi_frame (csi_frame.h)
+//
+// In .csilog files each record is additionally prefixed with its uint32 length,
+// and the file starts with the 8-byte magic "CSILOG3\0".
+//
+// Feed subscribers bind their own AF_UNIX datagram socket and send "SUB" to
+// the feed path; "UNSUB" (or closing the socket) ends the subscription.
+//
+// Traffic generator datagrams (csi_traffic.h) are handled before decoding:
+// UDP probes are echoed to their sender and CSI_RATE reports are kept per
+// node address, as are the CSI_STATS health reports (csi_stats.h). CSI_SYNC
+// requests (csi_clock.h) are answered with CLOCK_REALTIME as the shared
+// timebase and the nodes' CSI_CLOCK mappings are kept per address (and applied
+// to the records of the node's frames), as are the
+// CSI_WAKE timing report (csi_link.h) of each node's latest wake and its
+// latest CSI_SCHED acquisition plan report (csi_schedule.h).
+//
+// With IngestConfig::nack set, sequence gaps are asked for again with CSI_NACK
+// datagrams (csi_history.h) sent to the address the stream's frames come from.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "csi/align.hpp"
+#include "csi/datagram.hpp"
+#include "csi_clock.h"
+#include "csi_history.h"
+#include "csi_link.h"
+#include "csi_schedule.h"
+#include "csi_stats.h"
+#include "csi_traffic.h"
+
+namespace csi {
+
+inline constexpr char kCsiLogMagic[8] = {'C', 'S', 'I', 'L', 'O', 'G', '3', '\0'};
+inline constexpr size_t kFeedRecordHeader = 20;
+inline constexpr size_t kFeedRecordSource = 8;    // offset of the node address
+inline constexpr size_t kFeedRecordCapture = 12;  // offset of the shared capture time
+inline constexpr int64_t kNoCaptureTime = std::numeric_limits<int64_t>::min();
+
+struct IngestConfig {
+    std::string bind_addr = "0.0.0.0";
+    uint16_t port = 50001;
+    int rcvbuf_bytes = 16 << 20;
+    unsigned recv_batch = 64;
+    std::string out_dir;     // empty: no disk output
+    std::string feed_path;   // empty: no local feed
+    bool nack = false;       // request lost frames again (csi_history.h)
+};
+
+struct NodeStats {
+    uint32_t source = 0;      // node address, network byte order (StreamKey)
+    uint8_t mac[6] = {};
+    uint64_t frames = 0;
+    uint64_t lost = 0;        // frames missing according to sequence gaps
+    uint64_t reordered = 0;
+    uint64_t restarts = 0;    // large backwards sequence jumps (node rebooted)
+    uint64_t recovered = 0;   // gap frames that arrived after all (NACK mode)
+    uint64_t abandoned = 0;   // gap frames given up on (NACK mode)
+    uint64_t nacks = 0;       // CSI_NACK datagrams sent
+    uint32_t last_seq = 0;
+    int8_t last_rssi = 0;
+    uint64_t first_ns = 0;
+    uint64_t last_ns = 0;
+};
+
+struct RateReport {
+    struct sockaddr_in from = {};
+    csi_traffic_report_t report = {};
+    uint64_t received_ns = 0;
+};
+
+struct HealthReport {
+    struct sockaddr_in from = {};
+    csi_stats_report_t report = {};
+    csi_stats_report_t previous = {};  // the report before, for per-interval deltas
+    uint64_t received_ns = 0;
+};
+
+struct ClockReport {
+    struct sockaddr_in from = {};
+    csi_clock_report_t report = {};
+    uint64_t received_ns = 0;
+};
+
+struct WakeReport {
+    struct sockaddr_in from = {};
+    csi_wake_report_t report = {};
+    uint64_t received_ns = 0;
+};
+
+struct ScheduleReport {
+    struct sockaddr_in from = {};
+    csi_schedule_report_t report = {};
+    uint64_t received_ns = 0;
+};
+
+class IngestServer {
+public:
+    // Binds the UDP socket (and the feed socket if configured).
+    // Throws std::system_error on setup failure.
+    explicit IngestServer(IngestConfig config);
+    ~IngestServer();
+
+    IngestServer(const IngestServer &) = delete;
+    IngestServer &operator=(const IngestServer &) = delete;
+
+    // Waits up to timeout_ms for activity and drains every ready socket.
+    // Returns the number of frames ingested during the call.
+    size_t poll(int timeout_ms);
+
+    // Flushes buffered log output to disk.
+    void flush();
+
+    uint16_t port() const { return port_; }
+    int rcvbuf_bytes() const { return rcvbuf_bytes_; }
+    uint64_t datagrams() const { return datagrams_; }
+    uint64_t frames() const { return frames_; }
+    uint64_t malformed() const { return decoder_.malformed(); }
+    uint64_t delta_desync() const { return decoder_.delta_desync(); }
+    uint64_t feed_drops() const { return feed_drops_; }
+    uint64_t probes_echoed() const { return probes_echoed_; }
+    uint64_t syncs_answered() const { return syncs_answered_; }
+    uint64_t nacks_sent() const { return nacks_sent_; }
+    size_t subscribers() const { return subscribers_.size(); }
+    std::vector<NodeStats> node_stats() const;
+    // Latest CSI_RATE report of every node address that sent one.
+    std::vector<RateReport> rate_reports() const;
+    // Latest CSI_STATS report of every node address that sent one.
+    std::vector<HealthReport> health_reports() const;
+    // Latest CSI_CLOCK mapping of every node address that sent one.
+    std::vector<ClockReport> clock_reports() const;
+    // Latest CSI_WAKE report of every node address that sent one.
+    std::vector<WakeReport> wake_reports() const;
+    // Latest CSI_SCHED report of every node address that sent one.
+    std::vector<ScheduleReport> schedule_reports() const;
+
+private:
+    struct Node {
+        NodeStats stats;
+        std::FILE *log = nullptr;
+        csi_nack_tracker_t nack;
+        struct sockaddr_in from = {};  // where the node's frames come from
+    };
+
+    size_t drain_udp();
+    bool handle_traffic(const uint8_t *data, size_t len, const struct sockaddr_in &from, uint64_t now_ns);
+    void drain_feed_control();
+    void on_frame(const Frame &frame, const struct sockaddr_in &from, uint64_t now_ns);
+    void send_nacks(uint64_t now_ns);
+    Node &node_for(uint32_t source, const uint8_t mac[6]);
+
+    IngestConfig config_;
+    int epoll_fd_ = -1;
+    int udp_fd_ = -1;
+    int feed_fd_ = -1;
+    uint16_t port_ = 0;
+    int rcvbuf_bytes_ = 0;
+
+    std::vector<uint8_t> rx_buffers_;
+    std::vector<struct mmsghdr> msgs_;
+    std::vector<struct iovec> iovs_;
+    std::vector<struct sockaddr_in> addrs_;
+    std::vector<uint8_t> record_;
+
+    DatagramDecoder decoder_;
+    std::unordered_map<StreamKey, Node, StreamKeyHash> nodes_;
+    std::unordered_map<uint64_t, RateReport> rate_reports_;  // keyed by IPv4 address and port
+    std::unordered_map<uint64_t, HealthReport> health_reports_;
+    std::unordered_map<uint64_t, ClockReport> clock_reports_;
+    std::unordered_map<uint32_t, NodeClock> clocks_;  // keyed by IPv4 address: frames use another port
+    std::unordered_map<uint64_t, WakeReport> wake_reports_;
+    std::unordered_map<uint64_t, ScheduleReport> schedule_reports_;
+    std::vector<struct sockaddr_un> subscribers_;
+
+    uint64_t datagrams_ = 0;
+    uint64_t frames_ = 0;
+    uint64_t feed_drops_ = 0;
+    uint64_t probes_echoed_ = 0;
+    uint64_t syncs_answered_ = 0;
+    uint64_t nacks_sent_ = 0;
+};
+
+}  // namespace csi
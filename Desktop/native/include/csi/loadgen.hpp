@@ -0,0 +1,135 @@
+// Deterministic CSI load generator.
+//
+// Plays N virtual nodes towards a collector over UDP, in the wire formats the
+// firmware produces: the CSI_DATA line of csi_frame_format_text (the exact
+// formatter wifi_csi_rx_cb uses), binary frames, or csi_batch datagrams built
+// the way csi_sender_task builds them.
+//
+// The whole send schedule is computed up front from the profile and its seed,
+// so two runs with the same profile send the same frames at the same offsets:
+//
+//   - each node sends rate_hz frames/s starting at a random phase; with
+//     burst > 1 the frames of a burst share one send time and the bursts are
+//     spaced so the mean rate is unchanged
+//   - jitter_us adds zero-mean Gaussian noise to every send time
+//   - losses follow a two-state (Gilbert) model per node with the given mean
+//     loss fraction and mean run length. A lost frame still takes its sequence
+//     number, as a frame missed on the air would, so collectors see a gap
+//
+// Frame contents cycle through a list of templates: synthetic frames or rows
+// replayed from a collector database. Every node reports the same transmitter
+// MAC, kLoadMac, as nodes associated with one AP report its BSSID, and is told
+// apart by its source address: towards a loopback collector node n sends from
+// node_address(n), 127.1.0.0 + n + 1. Towards another host the nodes share this
+// host's address, so there each falls back to its own MAC 02:00:00:00:hi:lo
+// (node_mac). keep_mac replays the recorded MACs as they are.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "csi_frame.h"
+
+namespace csi {
+
+enum class WireFormat { Text, Binary, Batch };
+
+// Parses "text", "binary" or "batch". Returns false for anything else.
+bool parse_wire_format(const std::string &name, WireFormat &format);
+const char *wire_format_name(WireFormat format);
+
+struct LoadProfile {
+    unsigned nodes = 1;
+    double rate_hz = 100;          // per node
+    uint32_t frames = 1000;        // per node, lost frames included
+    double jitter_us = 0;          // standard deviation of the send time
+    unsigned burst = 1;            // frames sent back to back
+    double loss = 0;               // mean fraction of frames lost before transmission
+    double loss_burst = 1;         // mean length of a loss run; 1 = independent losses
+    uint64_t seed = 1;
+    WireFormat format = WireFormat::Text;
+    bool keep_mac = false;
+};
+
+struct FrameTemplate {
+    csi_frame_meta_t meta;
+    std::vector<int8_t> payload;
+};
+
+struct ScheduledFrame {
+    uint64_t at_ns;                // send time, from the start of the run
+    uint32_t node;
+    uint32_t seq;
+    bool lost;
+};
+
+struct LoadResult {
+    uint64_t start_ns = 0;         // CLOCK_REALTIME at schedule offset 0
+    uint64_t frames_sent = 0;
+    uint64_t frames_lost = 0;      // injected by the loss profile
+    uint64_t datagrams = 0;
+    uint64_t send_errors = 0;
+    uint64_t max_late_ns = 0;      // worst delay behind the schedule
+    double elapsed_s = 0;
+};
+
+// count synthetic frames of len payload bytes, slowly varying like a static link.
+std::vector<FrameTemplate> synthetic_templates(size_t count, unsigned len);
+
+// Up to limit frames (0: all) of a collector database, in recorded order.
+// Throws std::runtime_error if the database holds no frames.
+std::vector<FrameTemplate> sqlite_templates(const std::string &path, size_t limit);
+
+// Transmitter MAC of every virtual node: the AP they are all associated with.
+inline constexpr uint8_t kLoadMac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+// Source address of node n towards a loopback collector, network byte order.
+uint32_t node_address(unsigned node);
+
+// MAC of node n where the nodes cannot have their own address.
+void node_mac(unsigned node, uint8_t mac[6]);
+
+// Sorted by send time; ties keep node and sequence order.
+std::vector<ScheduledFrame> build_schedule(const LoadProfile &profile);
+
+class LoadGenerator {
+public:
+    // Throws std::invalid_argument on an empty template list or a bad profile.
+    LoadGenerator(LoadProfile profile, std::vector<FrameTemplate> templates);
+    ~LoadGenerator();
+
+    LoadGenerator(const LoadGenerator &) = delete;
+    LoadGenerator &operator=(const LoadGenerator &) = delete;
+
+    // Resolves host and connects the sending socket. Throws std::system_error.
+    // A loopback host lets every node send from its own address.
+    void connect(const std::string &host, uint16_t port);
+
+    // Sends the schedule in real time and returns when it is done or stop is set.
+    LoadResult run(const std::atomic<bool> *stop = nullptr);
+
+    const LoadProfile &profile() const { return profile_; }
+    const std::vector<ScheduledFrame> &schedule() const { return schedule_; }
+    // Whether the nodes send from their own addresses (set by connect).
+    bool node_sources() const { return node_sources_; }
+
+    // The node that sent a frame a collector received from source (0 if the
+    // collector did not record it) with transmitter mac, or -1 if no node of
+    // this run sent it.
+    long node_of(uint32_t source, const uint8_t mac[6]) const;
+
+    // Serializes one scheduled frame in the profile's per-frame format
+    // (binary for batch). Returns the length, 0 if cap is too small.
+    size_t encode(const ScheduledFrame &frame, uint8_t *out, size_t cap) const;
+
+private:
+    LoadProfile profile_;
+    std::vector<FrameTemplate> templates_;
+    std::vector<ScheduledFrame> schedule_;
+    int fd_ = -1;
+    bool node_sources_ = false;
+};
+
+}  // namespace csi
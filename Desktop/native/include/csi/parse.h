@@ -0,0 +1,115 @@
+/*
+ * C interface to the host parsers for the legacy text format, built as the
+ * shared library csi_parse (libcsi_parse.so) so that Python can load it with
+ * ctypes (Desktop/csi_fastparse.py).
+ *
+ * Everything is written into arrays the caller allocates, described by a
+ * csi_parse_out_t: a dense int8 payload matrix of capacity x width values
+ * (zero-padded rows, longer payloads cut and counted), a metadata matrix of
+ * capacity x CSI_PARSE_COLUMNS int64 values and one MAC and host time per
+ * row. Each call appends after the rows already filled, so a table or a log
+ * larger than the arrays is read in chunks.
+ *
+ * Sources:
+ *   - CSI_DATA lines (wifi_csi_rx_cb, csi_frame_format_text), one per line
+ *   - "[a,b,...]" payload strings
+ *   - whole csi_data tables, in both the older desktop layout (save_to_db)
+ *     and the Android one (DatabaseHelper.addCsiData), and csi_frame tables
+ *
+ * The payload lists are scanned with SSE2 where the build target has it
+ * (csi::scan_payload_list). No function throws or keeps a pointer to its
+ * input.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Metadata columns, in the order of the CSI_DATA line. */
+enum {
+    CSI_PARSE_SEQ,
+    CSI_PARSE_RSSI,
+    CSI_PARSE_RATE,
+    CSI_PARSE_SIG_MODE,
+    CSI_PARSE_MCS,
+    CSI_PARSE_CWB,
+    CSI_PARSE_SMOOTHING,
+    CSI_PARSE_NOT_SOUNDING,
+    CSI_PARSE_AGGREGATION,
+    CSI_PARSE_STBC,
+    CSI_PARSE_FEC_CODING,
+    CSI_PARSE_SGI,
+    CSI_PARSE_NOISE_FLOOR,
+    CSI_PARSE_AMPDU_CNT,
+    CSI_PARSE_CHANNEL,
+    CSI_PARSE_SECONDARY_CHANNEL,
+    CSI_PARSE_TIMESTAMP,
+    CSI_PARSE_ANT,
+    CSI_PARSE_SIG_LEN,
+    CSI_PARSE_RX_STATE,
+    CSI_PARSE_LEN,          /* payload values parsed, before any cut to width */
+    CSI_PARSE_FIRST_WORD,
+    CSI_PARSE_COLUMNS
+};
+
+typedef struct {
+    int8_t   *payload;      /* capacity x width */
+    uint32_t  width;
+    int64_t  *meta;         /* capacity x CSI_PARSE_COLUMNS, or NULL */
+    uint64_t *mac;          /* capacity, big-endian in the low 48 bits, or NULL */
+    double   *host_time;    /* capacity, seconds; NaN when not recorded; or NULL */
+    uint64_t  capacity;     /* rows the arrays hold */
+    uint64_t  rows;         /* rows filled; new rows are appended after them */
+    uint64_t  skipped;      /* malformed lines or table rows */
+    uint64_t  truncated;    /* payloads longer than width */
+} csi_parse_out_t;
+
+typedef struct csi_parse_db csi_parse_db_t;
+
+/**
+ * Selects the SSE2 (enable != 0) or the scalar payload scanner, or with a
+ * negative enable only queries. Returns 1 if SSE2 is in use afterwards.
+ */
+int csi_parse_simd(int enable);
+
+/**
+ * Parses a "[a,b,...]" string of len bytes into out (cap values). Returns the
+ * number of values, even past cap, or -1 if the list is malformed.
+ */
+long csi_parse_payload(const char *text, size_t len, int8_t *out, size_t cap);
+
+/**
+ * Parses the complete lines ('\n'-terminated, '\r' ignored) of text into out
+ * until it is full. Lines that do not start with "CSI_DATA," are ignored.
+ * Returns the bytes consumed: the start of the first line not parsed, either
+ * a trailing partial line or the first one that did not fit.
+ */
+size_t csi_parse_lines(const char *text, size_t len, csi_parse_out_t *out);
+
+/**
+ * Opens a session database read-only. table is "csi_data" or "csi_frame",
+ * NULL or empty to prefer csi_frame; scenario, if not NULL or empty, keeps
+ * only that scenario. Returns NULL on failure with the reason in err.
+ */
+csi_parse_db_t *csi_parse_db_open(const char *path, const char *table, const char *scenario, char *err,
+                                  size_t err_len);
+
+/** Rows the open table holds for the scenario, and the largest len among them. */
+uint64_t csi_parse_db_rows(csi_parse_db_t *db);
+uint32_t csi_parse_db_max_len(csi_parse_db_t *db);
+
+/**
+ * Appends the next rows of the table to out until it is full or the table
+ * ends. Returns the rows appended; 0 once the table is exhausted.
+ */
+uint64_t csi_parse_db_read(csi_parse_db_t *db, csi_parse_out_t *out);
+
+void csi_parse_db_close(csi_parse_db_t *db);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+// Sequential reader for CSI sessions stored in SQLite by the collectors.
+//
+// Understands the three layouts found in the field:
+//   - csi_frame (+ csi_session): desktop collector, payload as an int8 BLOB
+//   - csi_data with timestamp/scenario columns: older desktop collector
+//   - csi_data with data_hora/cenario columns: Android DatabaseHelper
+// In the csi_data layouts the payload is the "[a,b,...]" text column.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "csi_frame.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace csi {
+
+struct SqliteSourceFilter {
+    int64_t session_id = -1;   // csi_frame only; -1 selects every session
+    std::string scenario;      // empty selects every scenario
+    std::string table;         // csi_frame or csi_data; empty prefers csi_frame
+};
+
+class SqliteFrameSource {
+public:
+    // Opens the database read-only. Throws std::runtime_error if it holds no CSI
+    // table, or not the one the filter names.
+    explicit SqliteFrameSource(const std::string &path, const SqliteSourceFilter &filter = {});
+    ~SqliteFrameSource();
+
+    SqliteFrameSource(const SqliteFrameSource &) = delete;
+    SqliteFrameSource &operator=(const SqliteFrameSource &) = delete;
+
+    // Reads the next frame. host_time_s is the host receive time in seconds, or a
+    // negative value when the layout does not record one. Rows whose payload does
+    // not parse are skipped and counted in skipped(). Returns false at the end.
+    bool next(csi_frame_meta_t &meta, std::vector<int8_t> &payload, double &host_time_s);
+
+    // Restarts iteration from the first row.
+    void rewind();
+
+    // Number of rows matching the filter and the largest payload length among them.
+    uint64_t count_rows();
+    uint32_t max_len();
+
+    const std::string &table() const { return table_; }
+    uint64_t skipped() const { return skipped_; }
+
+private:
+    sqlite3_stmt *prepare(const std::string &sql);
+    std::string where_clause() const;
+
+    sqlite3 *db_ = nullptr;
+    sqlite3_stmt *stmt_ = nullptr;
+    SqliteSourceFilter filter_;
+    std::string table_;
+    std::string scenario_column_;
+    bool has_host_time_ = false;
+    uint64_t skipped_ = 0;
+};
+
+}  // namespace csi
@@ -0,0 +1,88 @@
+#include "csi/align.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace csi {
+
+void NodeClock::update(const csi_clock_report_t &report) {
+    report_ = report;
+    valid_ = true;
+}
+
+StreamAligner::StreamAligner(size_t streams, size_t width, int64_t period_us, int64_t max_gap_us,
+                             int64_t max_lag_us)
+    : width_(width), period_us_(period_us), max_gap_us_(max_gap_us), max_lag_us_(max_lag_us),
+      streams_(streams) {
+    if (streams == 0 || width == 0 || period_us <= 0) {
+        throw std::invalid_argument("StreamAligner needs streams, width and a positive period");
+    }
+}
+
+void StreamAligner::add(size_t stream, int64_t t_us, const float *values) {
+    Stream &s = streams_.at(stream);
+    if (!s.samples.empty() && t_us <= s.samples.back().t_us) {
+        late_++;
+        return;
+    }
+    if (!started_) {
+        // The grid starts at the first multiple of the period after the first sample.
+        next_us_ = (t_us / period_us_ + (t_us % period_us_ > 0)) * period_us_;
+        started_ = true;
+    }
+    s.samples.push_back(Sample{t_us, std::vector<float>(values, values + width_)});
+    newest_us_ = std::max(newest_us_, t_us);
+}
+
+size_t StreamAligner::drain(std::vector<AlignedRow> &out, bool flush) {
+    if (!started_) {
+        return 0;
+    }
+    int64_t horizon = newest_us_;
+    if (!flush) {
+        const int64_t lagging = newest_us_ - max_lag_us_;
+        for (const Stream &s : streams_) {
+            int64_t reached = s.samples.empty() ? lagging : std::max(s.samples.back().t_us, lagging);
+            horizon = std::min(horizon, reached);
+        }
+    }
+
+    size_t rows = 0;
+    for (; next_us_ <= horizon; next_us_ += period_us_, rows++) {
+        const int64_t t = next_us_;
+        AlignedRow row;
+        row.t_us = t;
+        row.values.assign(streams_.size() * width_, 0.0f);
+        row.valid.assign(streams_.size(), 0);
+        for (size_t i = 0; i < streams_.size(); i++) {
+            std::deque<Sample> &q = streams_[i].samples;
+            // Keep only the last sample at or before t as the left neighbour.
+            while (q.size() >= 2 && q[1].t_us <= t) {
+                q.pop_front();
+            }
+            if (q.empty() || q.front().t_us > t) {
+                continue;
+            }
+            float *dst = row.values.data() + i * width_;
+            const Sample &a = q.front();
+            if (a.t_us == t) {
+                std::copy(a.values.begin(), a.values.end(), dst);
+                row.valid[i] = 1;
+                continue;
+            }
+            if (q.size() < 2 || q[1].t_us - a.t_us > max_gap_us_) {
+                continue;
+            }
+            const Sample &b = q[1];
+            const float w = static_cast<float>(t - a.t_us) / static_cast<float>(b.t_us - a.t_us);
+            for (size_t k = 0; k < width_; k++) {
+                dst[k] = a.values[k] + w * (b.values[k] - a.values[k]);
+            }
+            row.valid[i] = 1;
+        }
+        out.push_back(std::move(row));
+    }
+    return rows;
+}
+
+}  // namespace csi
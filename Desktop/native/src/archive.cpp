@@ -0,0 +1,284 @@
+#include "csi/archive.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace csi {
+namespace {
+
+[[noreturn]] void throw_errno(const std::string &what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+uint64_t align_up(uint64_t offset) {
+    return (offset + kArchiveAlign - 1) & ~static_cast<uint64_t>(kArchiveAlign - 1);
+}
+
+}  // namespace
+
+ArchiveWriter::ArchiveWriter(const std::string &path, uint32_t width, uint32_t index_block)
+    : path_(path), width_(width), index_block_(index_block ? index_block : 1), row_(width) {
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+        throw_errno(path);
+    }
+    // The header is rewritten by close(); reserve its space now so the payload
+    // matrix can be streamed straight to disk.
+    ArchiveHeader blank = {};
+    write(&blank, sizeof(blank));
+    pad_to_alignment();
+}
+
+ArchiveWriter::~ArchiveWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void ArchiveWriter::write(const void *data, size_t len) {
+    if (len && std::fwrite(data, 1, len, file_) != len) {
+        throw_errno(path_);
+    }
+    offset_ += len;
+}
+
+void ArchiveWriter::pad_to_alignment() {
+    static const uint8_t zeros[kArchiveAlign] = {};
+    write(zeros, align_up(offset_) - offset_);
+}
+
+template <typename T>
+uint64_t ArchiveWriter::write_column(const std::vector<T> &column) {
+    pad_to_alignment();
+    uint64_t offset = offset_;
+    write(column.data(), column.size() * sizeof(T));
+    return offset;
+}
+
+void ArchiveWriter::append(const csi_frame_meta_t &meta, const int8_t *payload, int64_t time_us) {
+    if (!file_) {
+        throw std::logic_error("archive already closed");
+    }
+    if (meta.len > width_) {
+        throw std::invalid_argument("payload longer than archive width");
+    }
+    if (!time_us_.empty() && time_us < time_us_.back()) {
+        throw std::invalid_argument("archive time key must be non-decreasing");
+    }
+
+    Mac mac;
+    std::memcpy(mac.data(), meta.mac, mac.size());
+    auto it = std::find(nodes_.begin(), nodes_.end(), mac);
+    if (it == nodes_.end()) {
+        if (nodes_.size() > UINT16_MAX) {
+            throw std::invalid_argument("too many nodes for one archive");
+        }
+        it = nodes_.insert(nodes_.end(), mac);
+    }
+    uint16_t node = static_cast<uint16_t>(it - nodes_.begin());
+
+    std::memcpy(row_.data(), payload, meta.len);
+    std::memset(row_.data() + meta.len, 0, width_ - meta.len);
+    write(row_.data(), width_);
+
+    if (frames_ % index_block_ == 0) {
+        index_.push_back({frames_, time_us, meta.seq, meta.seq});
+    } else {
+        ArchiveIndexEntry &entry = index_.back();
+        entry.min_seq = std::min(entry.min_seq, meta.seq);
+        entry.max_seq = std::max(entry.max_seq, meta.seq);
+    }
+    time_us_.push_back(time_us);
+    local_ts_.push_back(meta.timestamp);
+    seq_.push_back(meta.seq);
+    len_.push_back(meta.len);
+    node_.push_back(node);
+    rssi_.push_back(meta.rssi);
+    noise_.push_back(meta.noise_floor);
+    channel_.push_back(meta.channel);
+    frames_++;
+}
+
+void ArchiveWriter::close() {
+    if (!file_) {
+        return;
+    }
+    ArchiveHeader header = {};
+    std::memcpy(header.magic, kArchiveMagic, sizeof(kArchiveMagic));
+    header.version = kArchiveVersion;
+    header.width = width_;
+    header.frames = frames_;
+    header.node_count = static_cast<uint32_t>(nodes_.size());
+    header.index_block = index_block_;
+    header.index_entries = index_.size();
+    header.off_payload = align_up(sizeof(ArchiveHeader));
+    header.off_time_us = write_column(time_us_);
+    header.off_local_ts = write_column(local_ts_);
+    header.off_seq = write_column(seq_);
+    header.off_len = write_column(len_);
+    header.off_node = write_column(node_);
+    header.off_rssi = write_column(rssi_);
+    header.off_noise = write_column(noise_);
+    header.off_channel = write_column(channel_);
+
+    std::vector<uint8_t> node_table(nodes_.size() * 8, 0);
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        std::memcpy(&node_table[i * 8], nodes_[i].data(), 6);
+    }
+    header.off_nodes = write_column(node_table);
+    header.off_index = write_column(index_);
+
+    std::FILE *file = file_;
+    file_ = nullptr;
+    bool ok = std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        throw_errno(path_);
+    }
+}
+
+ArchiveReader::ArchiveReader(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno(path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ < sizeof(ArchiveHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + ": not a CSI archive");
+    }
+    void *map = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        throw_errno(path);
+    }
+    base_ = static_cast<const uint8_t *>(map);
+    header_ = reinterpret_cast<const ArchiveHeader *>(base_);
+
+    try {
+        if (std::memcmp(header_->magic, kArchiveMagic, sizeof(kArchiveMagic)) != 0) {
+            throw std::runtime_error(path + ": not a CSI archive");
+        }
+        if (header_->version != kArchiveVersion) {
+            throw std::runtime_error(path + ": unsupported archive version");
+        }
+        uint64_t n = header_->frames;
+        all_.begin = 0;
+        all_.rows = static_cast<size_t>(n);
+        all_.width = header_->width;
+        all_.payload = column<int8_t>(header_->off_payload, n, header_->width);
+        all_.time_us = column<int64_t>(header_->off_time_us, n);
+        all_.local_ts = column<uint32_t>(header_->off_local_ts, n);
+        all_.seq = column<uint32_t>(header_->off_seq, n);
+        all_.len = column<uint16_t>(header_->off_len, n);
+        all_.node = column<uint16_t>(header_->off_node, n);
+        all_.rssi = column<int8_t>(header_->off_rssi, n);
+        all_.noise = column<int8_t>(header_->off_noise, n);
+        all_.channel = column<uint8_t>(header_->off_channel, n);
+        index_ = column<ArchiveIndexEntry>(header_->off_index, header_->index_entries);
+        const uint8_t *table = column<uint8_t>(header_->off_nodes, header_->node_count, 8);
+        for (uint32_t i = 0; i < header_->node_count; i++) {
+            Mac mac;
+            std::memcpy(mac.data(), table + i * 8, mac.size());
+            nodes_.push_back(mac);
+        }
+        if (header_->index_block == 0 ||
+            header_->index_entries != (n + header_->index_block - 1) / header_->index_block) {
+            throw std::runtime_error(path + ": archive index does not match frame count");
+        }
+    } catch (...) {
+        munmap(const_cast<uint8_t *>(base_), size_);
+        throw;
+    }
+}
+
+ArchiveReader::~ArchiveReader() {
+    munmap(const_cast<uint8_t *>(base_), size_);
+}
+
+template <typename T>
+const T *ArchiveReader::column(uint64_t offset, uint64_t count, size_t elem) const {
+    if (offset % alignof(T) != 0 || offset > size_ || (elem && count > (size_ - offset) / elem)) {
+        throw std::runtime_error("archive column out of bounds");
+    }
+    return reinterpret_cast<const T *>(base_ + offset);
+}
+
+ArchiveSlice ArchiveReader::slice(uint64_t begin, uint64_t end) const {
+    end = std::min<uint64_t>(end, frames());
+    begin = std::min(begin, end);
+    ArchiveSlice s = all_;
+    s.begin = begin;
+    s.rows = static_cast<size_t>(end - begin);
+    s.payload += begin * all_.width;
+    s.time_us += begin;
+    s.local_ts += begin;
+    s.seq += begin;
+    s.len += begin;
+    s.node += begin;
+    s.rssi += begin;
+    s.noise += begin;
+    s.channel += begin;
+    return s;
+}
+
+uint64_t ArchiveReader::lower_bound_time(int64_t t_us) const {
+    const ArchiveIndexEntry *first = index_;
+    const ArchiveIndexEntry *last = index_ + header_->index_entries;
+    // Last block whose first key is below t_us; the answer lies inside it or
+    // at the start of the next one.
+    auto block = std::lower_bound(first, last, t_us,
+                                  [](const ArchiveIndexEntry &e, int64_t t) { return e.first_time_us < t; });
+    if (block == first) {
+        return 0;
+    }
+    --block;
+    uint64_t lo = block->first_row;
+    uint64_t hi = std::min<uint64_t>(lo + header_->index_block, frames());
+    return static_cast<uint64_t>(std::lower_bound(all_.time_us + lo, all_.time_us + hi, t_us) - all_.time_us);
+}
+
+std::pair<uint64_t, uint64_t> ArchiveReader::time_range(int64_t t0_us, int64_t t1_us) const {
+    if (t1_us <= t0_us) {
+        uint64_t at = lower_bound_time(t0_us);
+        return {at, at};
+    }
+    return {lower_bound_time(t0_us), lower_bound_time(t1_us)};
+}
+
+uint64_t ArchiveReader::find_seq(uint16_t node, uint32_t seq) const {
+    for (uint64_t b = 0; b < header_->index_entries; b++) {
+        const ArchiveIndexEntry &entry = index_[b];
+        if (seq < entry.min_seq || seq > entry.max_seq) {
+            continue;
+        }
+        uint64_t end = std::min<uint64_t>(entry.first_row + header_->index_block, frames());
+        for (uint64_t row = entry.first_row; row < end; row++) {
+            if (all_.seq[row] == seq && all_.node[row] == node) {
+                return row;
+            }
+        }
+    }
+    return frames();
+}
+
+void ArchiveReader::prefetch() const {
+    madvise(const_cast<uint8_t *>(base_), size_, MADV_WILLNEED);
+}
+
+}  // namespace csi
@@ -0,0 +1,393 @@
+#include "csi/datagram.hpp"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__SSE2__)
+#define CSI_SCAN_SSE2 1
+#include <emmintrin.h>
+#else
+#define CSI_SCAN_SSE2 0
+#endif
+
+namespace csi {
+namespace {
+
+std::atomic<bool> g_simd_scan{CSI_SCAN_SSE2 != 0};
+
+// Minimal forward-only cursor over a CSI_DATA line.
+class Cursor {
+public:
+    explicit Cursor(std::string_view s) : p_(s.data()), end_(s.data() + s.size()) {}
+
+    bool int_field(int64_t &out) {
+        bool neg = false;
+        if (p_ < end_ && (*p_ == '-' || *p_ == '+')) {
+            neg = *p_ == '-';
+            p_++;
+        }
+        if (p_ == end_ || *p_ < '0' || *p_ > '9') {
+            return false;
+        }
+        int64_t v = 0;
+        while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+            v = v * 10 + (*p_ - '0');
+            if (v > 0xFFFFFFFFLL) {
+                return false;
+            }
+            p_++;
+        }
+        out = neg ? -v : v;
+        return true;
+    }
+
+    bool hex_byte(uint8_t &out) {
+        unsigned v = 0;
+        for (int i = 0; i < 2; i++) {
+            if (p_ == end_) {
+                return false;
+            }
+            char c = *p_++;
+            v <<= 4;
+            if (c >= '0' && c <= '9') {
+                v |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                v |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                v |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        out = static_cast<uint8_t>(v);
+        return true;
+    }
+
+    bool expect(char c) {
+        if (p_ < end_ && *p_ == c) {
+            p_++;
+            return true;
+        }
+        return false;
+    }
+
+    std::string_view rest() const { return std::string_view(p_, end_ - p_); }
+
+private:
+    const char *p_;
+    const char *end_;
+};
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t' || s.front() == '"' ||
+                          s.front() == '\r' || s.front() == '\n')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '"' ||
+                          s.back() == '\r' || s.back() == '\n' || s.back() == '\0')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// One list entry with optional spaces and sign, e.g. "-12" or " +7 ".
+bool entry_value_slow(const char *p, const char *end, int8_t &out) {
+    while (p < end && *p == ' ') {
+        p++;
+    }
+    while (end > p && end[-1] == ' ') {
+        end--;
+    }
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = *p == '-';
+        p++;
+    }
+    if (p == end) {
+        return false;
+    }
+    int v = 0;
+    for (; p < end; p++) {
+        unsigned d = static_cast<unsigned>(*p - '0');
+        if (d > 9 || (v = v * 10 + static_cast<int>(d)) > 128) {
+            return false;
+        }
+    }
+    v = neg ? -v : v;
+    if (v > 127) {
+        return false;
+    }
+    out = static_cast<int8_t>(v);
+    return true;
+}
+
+// The common entry, an optional '-' and one to three digits; anything else
+// takes the general path.
+inline bool entry_value(const char *p, const char *end, int8_t &out) {
+    bool neg = p < end && *p == '-';
+    const char *d = p + neg;
+    size_t n = static_cast<size_t>(end - d);
+    if (n - 1 >= 3) {
+        return entry_value_slow(p, end, out);
+    }
+    unsigned a = static_cast<unsigned>(d[0] - '0');
+    unsigned b = n > 1 ? static_cast<unsigned>(d[1] - '0') : 0;
+    unsigned c = n > 2 ? static_cast<unsigned>(d[2] - '0') : 0;
+    if ((a | b | c) > 9) {
+        return entry_value_slow(p, end, out);
+    }
+    int v = static_cast<int>(n == 1 ? a : n == 2 ? a * 10 + b : a * 100 + b * 10 + c);
+    v = neg ? -v : v;
+    if (v < -128 || v > 127) {
+        return false;
+    }
+    out = static_cast<int8_t>(v);
+    return true;
+}
+
+// Calls on_entry(begin, end) for each comma-separated entry of [p, end) and
+// stops at the first one it rejects.
+template <typename OnEntry>
+bool split_scalar(const char *p, const char *end, OnEntry &on_entry) {
+    const char *start = p;
+    for (; p < end; p++) {
+        if (*p == ',') {
+            if (!on_entry(start, p)) {
+                return false;
+            }
+            start = p + 1;
+        }
+    }
+    return on_entry(start, end);
+}
+
+#if CSI_SCAN_SSE2
+
+// Longest list body the vector scanner takes; longer ones go to split_scalar.
+constexpr size_t kSimdMaxBody = 8192;
+
+inline __m128i load16(const char *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+
+// Digit values (byte - '0') of b in v; returns the mask of the digit bytes.
+inline __m128i digits_sse2(__m128i b, __m128i &v) {
+    v = _mm_sub_epi8(b, _mm_set1_epi8('0'));
+    return _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(9)), v);
+}
+
+// Scans a list body made only of [-]d[d[d]] entries separated by commas, 16
+// bytes at a time. For every byte it computes, from overlapping loads of
+// the three bytes before and the one after, the value and sign of the number
+// that would end there, and checks the structure (no empty entries, no
+// stray '-', at most three digits, at most 199 before the sign); the values
+// at the last digit of each number are then picked out by bit mask. Returns
+// -2 for anything else (spaces, '+', leading zeros past three digits, bad
+// characters or values), for split_scalar to decide.
+long scan_sse2(const char *body, size_t len, int8_t *out, size_t cap) {
+    // Commas around the body stand for the list boundaries.
+    alignas(16) char buf[4 + kSimdMaxBody + 32];
+    std::memset(buf, ',', 4);
+    std::memcpy(buf + 4, body, len);
+    std::memset(buf + 4 + len, ',', 32);
+
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i minus = _mm_set1_epi8('-');
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i ones = _mm_set1_epi8(-1);
+    alignas(16) int8_t values[16];
+    long count = 0;
+    for (size_t k = 0; k < len; k += 16) {
+        const char *q = buf + 4 + k;
+        __m128i b0 = load16(q), b1 = load16(q - 1), b2 = load16(q - 2), b3 = load16(q - 3), bn = load16(q + 1);
+        __m128i v0, v1, v2, v3, vn;
+        __m128i d0 = digits_sse2(b0, v0), d1 = digits_sse2(b1, v1), d2 = digits_sse2(b2, v2);
+        __m128i d3 = digits_sse2(b3, v3), dn = digits_sse2(bn, vn);
+        __m128i c0 = _mm_cmpeq_epi8(b0, comma), c1 = _mm_cmpeq_epi8(b1, comma);
+        __m128i m0 = _mm_cmpeq_epi8(b0, minus), m1 = _mm_cmpeq_epi8(b1, minus);
+        __m128i m2 = _mm_cmpeq_epi8(b2, minus), m3 = _mm_cmpeq_epi8(b3, minus);
+        __m128i mn = _mm_cmpeq_epi8(bn, minus);
+        __m128i d01 = _mm_and_si128(d0, d1);
+        __m128i d12 = _mm_and_si128(d1, d2);
+
+        __m128i bad = _mm_xor_si128(_mm_or_si128(_mm_or_si128(d0, c0), m0), ones);
+        bad = _mm_or_si128(bad, _mm_and_si128(_mm_and_si128(d01, d2), d3));
+        bad = _mm_or_si128(bad, _mm_and_si128(_mm_and_si128(d01, d2), _mm_cmpgt_epi8(v2, one)));
+        bad = _mm_or_si128(bad, _mm_andnot_si128(dn, m0));
+        bad = _mm_or_si128(bad, _mm_andnot_si128(c1, m0));
+        bad = _mm_or_si128(bad, _mm_andnot_si128(d1, c0));
+        bad = _mm_or_si128(bad, _mm_andnot_si128(_mm_or_si128(dn, mn), c0));
+
+        // Ones, tens (x10 as x8 + x2) and hundreds (0 or 1) of the number ending here.
+        __m128i tens = _mm_and_si128(d1, v1);
+        __m128i x2 = _mm_add_epi8(tens, tens);
+        __m128i x8 = _mm_add_epi8(_mm_add_epi8(x2, x2), _mm_add_epi8(x2, x2));
+        __m128i hundreds = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(d12, v2), one), _mm_set1_epi8(100));
+        __m128i value = _mm_add_epi8(_mm_add_epi8(v0, _mm_add_epi8(x8, x2)), hundreds);
+        // The byte before the run of digits holds the sign.
+        __m128i neg = _mm_or_si128(_mm_andnot_si128(d1, m1),
+                                   _mm_or_si128(_mm_and_si128(_mm_andnot_si128(d2, d1), m2), _mm_and_si128(d12, m3)));
+        // At most 127, or 128 with a sign.
+        __m128i limit = _mm_sub_epi8(_mm_set1_epi8(127), neg);
+        __m128i ends = _mm_andnot_si128(dn, d0);
+        bad = _mm_or_si128(bad, _mm_andnot_si128(_mm_cmpeq_epi8(_mm_max_epu8(value, limit), limit), ends));
+
+        size_t rest = len - k;
+        unsigned live = rest >= 16 ? 0xFFFFu : (1u << rest) - 1;
+        if (_mm_movemask_epi8(bad) & live) {
+            return -2;
+        }
+        _mm_store_si128(reinterpret_cast<__m128i *>(values), _mm_sub_epi8(_mm_xor_si128(value, neg), neg));
+        for (unsigned e = static_cast<unsigned>(_mm_movemask_epi8(ends)) & live; e; e &= e - 1) {
+            if (static_cast<size_t>(count) < cap) {
+                out[count] = values[__builtin_ctz(e)];
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+#endif
+
+}  // namespace
+
+bool set_simd_scan(bool enabled) {
+    g_simd_scan = enabled && CSI_SCAN_SSE2;
+    return g_simd_scan;
+}
+
+bool simd_scan() {
+    return g_simd_scan;
+}
+
+long scan_payload_list(std::string_view text, int8_t *out, size_t cap) {
+    text = trim(text);
+    if (text.size() < 2 || text.front() != '[' || text.back() != ']') {
+        return -1;
+    }
+    const char *body = text.data() + 1;
+    const char *end = text.data() + text.size() - 1;
+    if (body == end) {
+        return 0;
+    }
+#if CSI_SCAN_SSE2
+    if (g_simd_scan.load(std::memory_order_relaxed) && static_cast<size_t>(end - body) <= kSimdMaxBody) {
+        long n = scan_sse2(body, end - body, out, cap);
+        if (n != -2) {
+            return n;
+        }
+    }
+#endif
+    long count = 0;
+    auto on_entry = [&count, out, cap](const char *p, const char *e) {
+        int8_t v;
+        if (!entry_value(p, e, v)) {
+            return false;
+        }
+        if (static_cast<size_t>(count) < cap) {
+            out[count] = v;
+        }
+        count++;
+        return true;
+    };
+    return split_scalar(body, end, on_entry) ? count : -1;
+}
+
+bool parse_payload_list(std::string_view text, std::vector<int8_t> &out) {
+    // Every value takes at least one digit and a separator.
+    out.resize(text.size() / 2 + 1);
+    long n = scan_payload_list(text, out.data(), out.size());
+    out.resize(n < 0 ? 0 : static_cast<size_t>(n));
+    return n >= 0;
+}
+
+bool parse_csi_line(std::string_view line, csi_frame_meta_t &meta, std::vector<int8_t> &payload) {
+    payload.resize(CSI_FRAME_MAX_PAYLOAD);
+    long n = parse_csi_line(line, meta, payload.data(), payload.size());
+    payload.resize(n < 0 ? 0 : static_cast<size_t>(n));
+    return n >= 0;
+}
+
+long parse_csi_line(std::string_view line, csi_frame_meta_t &meta, int8_t *row, size_t cap) {
+    static constexpr std::string_view kPrefix = "CSI_DATA,";
+    if (line.substr(0, kPrefix.size()) != kPrefix) {
+        return -1;
+    }
+    Cursor cur(line.substr(kPrefix.size()));
+    std::memset(&meta, 0, sizeof(meta));
+
+    int64_t v;
+    if (!cur.int_field(v) || !cur.expect(',')) {
+        return -1;
+    }
+    meta.seq = static_cast<uint32_t>(v);
+    for (int i = 0; i < 6; i++) {
+        if ((i && !cur.expect(':')) || !cur.hex_byte(meta.mac[i])) {
+            return -1;
+        }
+    }
+
+    // rssi .. first_word, in the order written by csi_frame_format_text.
+    int64_t f[21];
+    for (auto &field : f) {
+        if (!cur.expect(',') || !cur.int_field(field)) {
+            return -1;
+        }
+    }
+    if (!cur.expect(',')) {
+        return -1;
+    }
+    meta.rssi               = static_cast<int8_t>(f[0]);
+    meta.rate               = static_cast<uint8_t>(f[1]);
+    meta.sig_mode           = static_cast<uint8_t>(f[2]);
+    meta.mcs                = static_cast<uint8_t>(f[3]);
+    meta.cwb                = static_cast<uint8_t>(f[4]);
+    meta.smoothing          = static_cast<uint8_t>(f[5]);
+    meta.not_sounding       = static_cast<uint8_t>(f[6]);
+    meta.aggregation        = static_cast<uint8_t>(f[7]);
+    meta.stbc               = static_cast<uint8_t>(f[8]);
+    meta.fec_coding         = static_cast<uint8_t>(f[9]);
+    meta.sgi                = static_cast<uint8_t>(f[10]);
+    meta.noise_floor        = static_cast<int8_t>(f[11]);
+    meta.ampdu_cnt          = static_cast<uint8_t>(f[12]);
+    meta.channel            = static_cast<uint8_t>(f[13]);
+    meta.secondary_channel  = static_cast<uint8_t>(f[14]);
+    meta.timestamp          = static_cast<uint32_t>(f[15]);
+    meta.ant                = static_cast<uint8_t>(f[16]);
+    meta.sig_len            = static_cast<uint16_t>(f[17]);
+    meta.rx_state           = static_cast<uint8_t>(f[18]);
+    meta.first_word_invalid = static_cast<uint8_t>(f[20]);
+
+    long n = scan_payload_list(cur.rest(), row, cap);
+    if (n < 0 || n > CSI_FRAME_MAX_PAYLOAD) {
+        return -1;
+    }
+    meta.len = static_cast<uint16_t>(n);
+    return n;
+}
+
+bool DatagramDecoder::expand_delta(Frame &frame, uint32_t source) {
+    auto &dec = delta_[StreamKey{source, mac_key(frame.meta.mac)}];
+    if (!dec) {
+        dec = std::make_unique<csi_delta_dec_t>();
+        csi_delta_dec_init(dec.get());
+    }
+    scratch_.resize(CSI_DELTA_MAX_LEN);
+    uint16_t raw_len = 0;
+    int rc = csi_delta_decode(dec.get(), &frame.meta, frame.payload, scratch_.data(), &raw_len);
+    if (rc != CSI_DELTA_OK) {
+        if (rc == CSI_DELTA_ERR_NO_REF) {
+            delta_desync_++;
+        } else {
+            malformed_++;
+        }
+        return false;
+    }
+    frame.meta.flags &= static_cast<uint8_t>(~CSI_FRAME_FLAG_DELTA);
+    frame.meta.len = raw_len;
+    frame.payload = scratch_.data();
+    return true;
+}
+
+}  // namespace csi
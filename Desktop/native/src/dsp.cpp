@@ -0,0 +1,325 @@
+#include "csi/dsp.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CSI_DSP_X86 1
+#include <immintrin.h>
+#else
+#define CSI_DSP_X86 0
+#endif
+
+namespace csi::dsp {
+namespace {
+
+constexpr float kPi = 3.14159265358979f;
+constexpr float kHalfPi = 1.57079632679490f;
+constexpr float kTwoPi = 6.28318530717959f;
+
+// Minimax polynomial for atan(a), 0 <= a <= 1.
+constexpr float kAtan1 = 0.99997726f;
+constexpr float kAtan3 = -0.33262347f;
+constexpr float kAtan5 = 0.19354346f;
+constexpr float kAtan7 = -0.11643287f;
+constexpr float kAtan9 = 0.05265332f;
+constexpr float kAtan11 = -0.01172120f;
+
+// Frames gathered per kernel pass by Extractor.
+constexpr size_t kChunkFrames = 256;
+
+inline float atan2_poly(float y, float x) {
+    float ax = std::fabs(x);
+    float ay = std::fabs(y);
+    float a = std::min(ax, ay) / std::max(std::max(ax, ay), FLT_MIN);
+    float s = a * a;
+    float r = a * (kAtan1 + s * (kAtan3 + s * (kAtan5 + s * (kAtan7 + s * (kAtan9 + s * kAtan11)))));
+    if (ay > ax) {
+        r = kHalfPi - r;
+    }
+    if (x < 0) {
+        r = kPi - r;
+    }
+    return y < 0 ? -r : r;
+}
+
+void amplitude_scalar(const int8_t *iq, size_t n, float *out) {
+    for (size_t i = 0; i < n; i++) {
+        float im = iq[2 * i];
+        float re = iq[2 * i + 1];
+        out[i] = std::sqrt(re * re + im * im);
+    }
+}
+
+void phase_scalar(const int8_t *iq, size_t n, float *out) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = atan2_poly(iq[2 * i], iq[2 * i + 1]);
+    }
+}
+
+#if CSI_DSP_X86
+
+// Splits 4 pairs, sign-extended to int16 (one pair per 32-bit lane, imaginary
+// part low), into imaginary and real floats.
+inline void split_pairs_sse2(__m128i pairs16, __m128 &im, __m128 &re) {
+    im = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(pairs16, 16), 16));
+    re = _mm_cvtepi32_ps(_mm_srai_epi32(pairs16, 16));
+}
+
+inline __m128 atan2_sse2(__m128 y, __m128 x) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(sign, x);
+    __m128 ay = _mm_andnot_ps(sign, y);
+    __m128 a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(FLT_MIN)));
+    __m128 s = _mm_mul_ps(a, a);
+    __m128 p = _mm_set1_ps(kAtan11);
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(kAtan9));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(kAtan7));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(kAtan5));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(kAtan3));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(kAtan1));
+    __m128 r = _mm_mul_ps(a, p);
+    __m128 swap = _mm_cmpgt_ps(ay, ax);
+    r = _mm_or_ps(_mm_and_ps(swap, _mm_sub_ps(_mm_set1_ps(kHalfPi), r)), _mm_andnot_ps(swap, r));
+    __m128 neg_x = _mm_cmplt_ps(x, _mm_setzero_ps());
+    r = _mm_or_ps(_mm_and_ps(neg_x, _mm_sub_ps(_mm_set1_ps(kPi), r)), _mm_andnot_ps(neg_x, r));
+    return _mm_xor_ps(r, _mm_and_ps(sign, y));
+}
+
+template <bool kPhase>
+void kernel_sse2(const int8_t *iq, size_t n, float *out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(iq + 2 * i));
+        __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(raw, raw), 8);
+        __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(raw, raw), 8);
+        __m128 im0, re0, im1, re1;
+        split_pairs_sse2(lo, im0, re0);
+        split_pairs_sse2(hi, im1, re1);
+        if (kPhase) {
+            _mm_storeu_ps(out + i, atan2_sse2(im0, re0));
+            _mm_storeu_ps(out + i + 4, atan2_sse2(im1, re1));
+        } else {
+            _mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re0, re0), _mm_mul_ps(im0, im0))));
+            _mm_storeu_ps(out + i + 4, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re1, re1), _mm_mul_ps(im1, im1))));
+        }
+    }
+    if (kPhase) {
+        phase_scalar(iq + 2 * i, n - i, out + i);
+    } else {
+        amplitude_scalar(iq + 2 * i, n - i, out + i);
+    }
+}
+
+__attribute__((target("avx2"))) inline __m256 atan2_avx2(__m256 y, __m256 x) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 ax = _mm256_andnot_ps(sign, x);
+    __m256 ay = _mm256_andnot_ps(sign, y);
+    __m256 a = _mm256_div_ps(_mm256_min_ps(ax, ay),
+                             _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(FLT_MIN)));
+    __m256 s = _mm256_mul_ps(a, a);
+    __m256 p = _mm256_set1_ps(kAtan11);
+    p = _mm256_add_ps(_mm256_mul_ps(p, s), _mm256_set1_ps(kAtan9));
+    p = _mm256_add_ps(_mm256_mul_ps(p, s), _mm256_set1_ps(kAtan7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, s), _mm256_set1_ps(kAtan5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, s), _mm256_set1_ps(kAtan3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, s), _mm256_set1_ps(kAtan1));
+    __m256 r = _mm256_mul_ps(a, p);
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kHalfPi), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kPi), r),
+                         _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+    return _mm256_xor_ps(r, _mm256_and_ps(sign, y));
+}
+
+template <bool kPhase>
+__attribute__((target("avx2"))) void kernel_avx2(const int8_t *iq, size_t n, float *out) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // 8 pairs -> 16 int16 -> one pair per 32-bit lane, imaginary part low.
+        __m256i pairs = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(iq + 2 * i)));
+        __m256 im = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pairs, 16), 16));
+        __m256 re = _mm256_cvtepi32_ps(_mm256_srai_epi32(pairs, 16));
+        if (kPhase) {
+            _mm256_storeu_ps(out + i, atan2_avx2(im, re));
+        } else {
+            _mm256_storeu_ps(out + i, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im))));
+        }
+    }
+    if (kPhase) {
+        phase_scalar(iq + 2 * i, n - i, out + i);
+    } else {
+        amplitude_scalar(iq + 2 * i, n - i, out + i);
+    }
+}
+
+#endif  // CSI_DSP_X86
+
+// Appends the LLTF subcarriers in [lo, hi] (skipping those in `skip`) to mask.
+void add_range(SubcarrierMask &mask, size_t pairs, int lo, int hi, std::initializer_list<int> skip) {
+    int half = static_cast<int>(pairs / 2);
+    for (int k = lo; k <= hi; k++) {
+        if (std::find(skip.begin(), skip.end(), k) != skip.end()) {
+            continue;
+        }
+        mask.index.push_back(static_cast<uint16_t>(k >= 0 ? k : half * 2 + k));
+        mask.subcarrier.push_back(static_cast<int16_t>(k));
+    }
+}
+
+}  // namespace
+
+bool isa_supported(Isa isa) {
+#if CSI_DSP_X86
+    switch (isa) {
+    case Isa::Scalar:
+        return true;
+    case Isa::Sse2:
+        return __builtin_cpu_supports("sse2");
+    case Isa::Avx2:
+        return __builtin_cpu_supports("avx2");
+    }
+    return false;
+#else
+    return isa == Isa::Scalar;
+#endif
+}
+
+Isa best_isa() {
+    static const Isa best = isa_supported(Isa::Avx2) ? Isa::Avx2 : isa_supported(Isa::Sse2) ? Isa::Sse2 : Isa::Scalar;
+    return best;
+}
+
+const char *isa_name(Isa isa) {
+    switch (isa) {
+    case Isa::Scalar:
+        return "scalar";
+    case Isa::Sse2:
+        return "sse2";
+    case Isa::Avx2:
+        return "avx2";
+    }
+    return "?";
+}
+
+SubcarrierMask SubcarrierMask::lltf_all(size_t pairs) {
+    if (pairs != 64 && pairs != 128) {
+        throw std::invalid_argument("LLTF buffers carry 64 or 128 subcarriers");
+    }
+    int half = static_cast<int>(pairs / 2);
+    SubcarrierMask mask;
+    add_range(mask, pairs, -half, half - 1, {});
+    return mask;
+}
+
+SubcarrierMask SubcarrierMask::lltf(size_t pairs) {
+    SubcarrierMask mask;
+    if (pairs == 64) {
+        add_range(mask, pairs, -26, -1, {});
+        add_range(mask, pairs, 1, 26, {});
+    } else if (pairs == 128) {
+        // Legacy LLTF duplicated in both 20 MHz halves, centered on -32 and +32.
+        add_range(mask, pairs, -58, -6, {-32});
+        add_range(mask, pairs, 6, 58, {32});
+    } else {
+        throw std::invalid_argument("LLTF buffers carry 64 or 128 subcarriers");
+    }
+    return mask;
+}
+
+void amplitude(const int8_t *iq, size_t n, float *out, Isa isa) {
+#if CSI_DSP_X86
+    if (isa == Isa::Avx2) {
+        return kernel_avx2<false>(iq, n, out);
+    }
+    if (isa == Isa::Sse2) {
+        return kernel_sse2<false>(iq, n, out);
+    }
+#endif
+    (void)isa;
+    amplitude_scalar(iq, n, out);
+}
+
+void phase(const int8_t *iq, size_t n, float *out, Isa isa) {
+#if CSI_DSP_X86
+    if (isa == Isa::Avx2) {
+        return kernel_avx2<true>(iq, n, out);
+    }
+    if (isa == Isa::Sse2) {
+        return kernel_sse2<true>(iq, n, out);
+    }
+#endif
+    (void)isa;
+    phase_scalar(iq, n, out);
+}
+
+void unwrap(float *phase, size_t n) {
+    float offset = 0;
+    float prev = n ? phase[0] : 0;
+    for (size_t i = 1; i < n; i++) {
+        float raw = phase[i];
+        offset -= kTwoPi * std::nearbyint((raw - prev) / kTwoPi);
+        prev = raw;
+        phase[i] = raw + offset;
+    }
+}
+
+void remove_linear_phase(float *phase, const int16_t *subcarrier, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    float sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < n; i++) {
+        float x = subcarrier[i];
+        sx += x;
+        sy += phase[i];
+        sxx += x * x;
+        sxy += x * phase[i];
+    }
+    float count = static_cast<float>(n);
+    float denom = count * sxx - sx * sx;
+    float slope = denom != 0 ? (count * sxy - sx * sy) / denom : 0;
+    float offset = (sy - slope * sx) / count;
+    for (size_t i = 0; i < n; i++) {
+        phase[i] -= slope * subcarrier[i] + offset;
+    }
+}
+
+Extractor::Extractor(SubcarrierMask mask, Isa isa)
+    : mask_(std::move(mask)), isa_(isa_supported(isa) ? isa : best_isa()),
+      gathered_(kChunkFrames * mask_.size() * 2) {}
+
+void Extractor::run(const int8_t *frames, size_t count, size_t stride, float *amp, float *phase_out, bool sanitize) {
+    const size_t width = mask_.size();
+    if (width && stride < 2u * (*std::max_element(mask_.index.begin(), mask_.index.end()) + 1u)) {
+        throw std::invalid_argument("frame stride shorter than the subcarrier mask");
+    }
+    for (size_t first = 0; first < count; first += kChunkFrames) {
+        size_t chunk = std::min(kChunkFrames, count - first);
+        int8_t *dst = gathered_.data();
+        for (size_t f = 0; f < chunk; f++) {
+            const int8_t *src = frames + (first + f) * stride;
+            for (uint16_t idx : mask_.index) {
+                std::memcpy(dst, src + 2 * idx, 2);
+                dst += 2;
+            }
+        }
+        size_t pairs = chunk * width;
+        size_t out = first * width;
+        if (amp) {
+            amplitude(gathered_.data(), pairs, amp + out, isa_);
+        }
+        if (phase_out) {
+            phase(gathered_.data(), pairs, phase_out + out, isa_);
+            for (size_t f = 0; sanitize && f < chunk; f++) {
+                float *row = phase_out + out + f * width;
+                unwrap(row, width);
+                remove_linear_phase(row, mask_.subcarrier.data(), width);
+            }
+        }
+    }
+}
+
+}  // namespace csi::dsp
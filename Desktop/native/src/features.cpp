@@ -0,0 +1,332 @@
+#include "csi/features.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace csi {
+namespace {
+
+// MAD to standard deviation for normally distributed samples.
+constexpr float kMadScale = 1.4826f;
+
+// Inserts x into the n sorted values at s (room for one more).
+void insert_sorted(float *s, size_t n, float x) {
+    float *pos = std::upper_bound(s, s + n, x);
+    std::memmove(pos + 1, pos, static_cast<size_t>(s + n - pos) * sizeof(float));
+    *pos = x;
+}
+
+// Replaces one occurrence of old with x in the n sorted values at s.
+void replace_sorted(float *s, size_t n, float old, float x) {
+    size_t i = static_cast<size_t>(std::lower_bound(s, s + n, old) - s);
+    if (x > old) {
+        for (; i + 1 < n && s[i + 1] < x; i++) {
+            s[i] = s[i + 1];
+        }
+    } else {
+        for (; i > 0 && s[i - 1] > x; i--) {
+            s[i] = s[i - 1];
+        }
+    }
+    s[i] = x;
+}
+
+// Median absolute deviation of the 2 * half + 1 sorted values at s: the
+// deviations grow outwards from the median on both sides, so the half-th
+// smallest one (after the median's own zero) comes from merging the two runs.
+float sorted_mad(const float *s, size_t half) {
+    const float median = s[half];
+    size_t lo = half, hi = half;
+    float dev = 0;
+    for (size_t step = 0; step < half; step++) {
+        float below = median - s[lo - 1];
+        float above = s[hi + 1] - median;
+        if (below <= above) {
+            dev = below;
+            lo--;
+        } else {
+            dev = above;
+            hi++;
+        }
+    }
+    return dev;
+}
+
+// Adds x to a Welford mean and sum of squared deviations over count samples,
+// replacing the oldest sample when full (the window holds count already).
+inline void welford_slide(double &mean, double &m2, size_t count, size_t window, double x, double oldest) {
+    if (count < window) {
+        double d = x - mean;
+        mean += d / static_cast<double>(count + 1);
+        m2 += d * (x - mean);
+        return;
+    }
+    double d = x - oldest;
+    double next = mean + d / static_cast<double>(window);
+    m2 = std::max(0.0, m2 + d * (x - next + oldest - mean));
+    mean = next;
+}
+
+inline float dot(const float *a, const float *b, size_t n) {
+    float sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+}  // namespace
+
+FeaturePipeline::FeaturePipeline(const FeatureConfig &config)
+    : config_(config), extractor_(dsp::SubcarrierMask::lltf(config.pairs)), span_(2 * config.hampel_half + 1) {
+    if (config_.window == 0 || config_.hop == 0 || config_.smooth == 0 || config_.components == 0 ||
+        config_.pca_memory == 0 || config_.components > width()) {
+        throw std::invalid_argument("feature window, hop, smoothing, components and PCA memory must be positive");
+    }
+    const size_t w = width(), c = config_.components;
+    nodes_.reserve(config_.max_nodes);
+    amp_.resize(w);
+    filtered_.resize(w);
+    smoothed_.resize(w);
+    centred_.resize(w);
+    residual_.resize(w);
+    old_proj_.resize(c);
+    out_.mean.resize(w);
+    out_.variance.resize(w);
+    out_.eigenvalues.resize(c);
+    out_.pc_variance.resize(c);
+    out_.basis.resize(c * w);
+}
+
+FeaturePipeline::Node *FeaturePipeline::node_for(const StreamKey &key, int64_t t_us) {
+    auto it = nodes_.find(key);
+    if (it == nodes_.end()) {
+        if (nodes_.size() >= config_.max_nodes) {
+            overflow_++;
+            return nullptr;
+        }
+        const size_t w = width(), c = config_.components;
+        Node &node = nodes_[key];
+        node.raw.resize(span_ * w);
+        node.raw_t.resize(span_);
+        node.sorted.resize(w * span_);
+        node.lp.resize(config_.smooth * w);
+        node.lp_sum.resize(w);
+        node.win.resize(config_.window * w);
+        node.win_t.resize(config_.window);
+        node.mean.resize(w);
+        node.m2.resize(w);
+        node.proj.resize(config_.window * c);
+        node.proj_mean.resize(c);
+        node.proj_m2.resize(c);
+        node.v.resize(c * w);
+        restart(node);
+        node.last_us = t_us;
+        return &node;
+    }
+    Node &node = it->second;
+    if (t_us < node.last_us) {
+        late_++;
+        return nullptr;
+    }
+    if (t_us - node.last_us > config_.reset_gap_us) {
+        restart(node);
+        restarts_++;
+    }
+    node.last_us = t_us;
+    return &node;
+}
+
+void FeaturePipeline::restart(Node &node) {
+    node.windows = 0;
+    node.raw_count = node.raw_head = 0;
+    node.lp_count = node.lp_head = 0;
+    node.win_count = node.win_head = 0;
+    node.since_hop = 0;
+    node.pca_n = 0;
+    std::fill(node.lp_sum.begin(), node.lp_sum.end(), 0.0);
+    std::fill(node.mean.begin(), node.mean.end(), 0.0);
+    std::fill(node.m2.begin(), node.m2.end(), 0.0);
+    std::fill(node.proj_mean.begin(), node.proj_mean.end(), 0.0);
+    std::fill(node.proj_m2.begin(), node.proj_m2.end(), 0.0);
+    std::fill(node.v.begin(), node.v.end(), 0.0f);
+}
+
+void FeaturePipeline::reset() {
+    nodes_.clear();
+}
+
+const FeatureVector *FeaturePipeline::push(const csi_frame_meta_t &meta, const int8_t *payload, int64_t t_us,
+                                           uint32_t source) {
+    if (meta.len != 2 * config_.pairs || (meta.flags & CSI_FRAME_FLAG_AMPLITUDE)) {
+        rejected_++;
+        return nullptr;
+    }
+    const StreamKey key{source, mac_key(meta.mac)};
+    Node *node = node_for(key, t_us);
+    if (!node) {
+        return nullptr;
+    }
+    frames_++;
+    extractor_.run(payload, 1, meta.len, amp_.data(), nullptr, false);
+    hampel(*node, amp_.data(), t_us);
+    if (node->raw_count < span_) {
+        return nullptr;  // still filling the Hampel lookahead
+    }
+    size_t centre = (node->raw_head + config_.hampel_half) % span_;
+    smooth(*node, filtered_.data());
+    return slide(*node, key, smoothed_.data(), node->raw_t[centre]);
+}
+
+void FeaturePipeline::hampel(Node &node, const float *amp, int64_t t_us) {
+    const size_t w = width(), k = config_.hampel_half;
+    const bool full = node.raw_count == span_;
+    float *row = &node.raw[node.raw_head * w];
+    for (size_t j = 0; j < w; j++) {
+        float *sorted = &node.sorted[j * span_];
+        if (full) {
+            replace_sorted(sorted, span_, row[j], amp[j]);
+        } else {
+            insert_sorted(sorted, node.raw_count, amp[j]);
+        }
+        row[j] = amp[j];
+    }
+    node.raw_t[node.raw_head] = t_us;
+    node.raw_head = (node.raw_head + 1) % span_;
+    if (!full) {
+        node.raw_count++;
+    }
+    if (node.raw_count < span_) {
+        return;
+    }
+    // raw_head is now the oldest row; the centre is hampel_half rows later.
+    const float *centre = &node.raw[((node.raw_head + k) % span_) * w];
+    for (size_t j = 0; j < w; j++) {
+        const float *sorted = &node.sorted[j * span_];
+        float median = sorted[k];
+        float limit = config_.hampel_sigmas * kMadScale * sorted_mad(sorted, k);
+        if (std::fabs(centre[j] - median) > limit) {
+            filtered_[j] = median;
+            outliers_++;
+        } else {
+            filtered_[j] = centre[j];
+        }
+    }
+}
+
+void FeaturePipeline::smooth(Node &node, const float *filtered) {
+    const size_t w = width();
+    const bool full = node.lp_count == config_.smooth;
+    float *slot = &node.lp[node.lp_head * w];
+    for (size_t j = 0; j < w; j++) {
+        if (full) {
+            node.lp_sum[j] -= slot[j];
+        }
+        node.lp_sum[j] += filtered[j];
+        slot[j] = filtered[j];
+    }
+    node.lp_head = (node.lp_head + 1) % config_.smooth;
+    if (!full) {
+        node.lp_count++;
+    }
+    const double scale = 1.0 / static_cast<double>(node.lp_count);
+    for (size_t j = 0; j < w; j++) {
+        smoothed_[j] = static_cast<float>(node.lp_sum[j] * scale);
+    }
+}
+
+const FeatureVector *FeaturePipeline::slide(Node &node, const StreamKey &key, const float *y, int64_t t_us) {
+    const size_t w = width(), c = config_.components, window = config_.window;
+    float *slot = &node.win[node.win_head * w];
+    for (size_t j = 0; j < w; j++) {
+        welford_slide(node.mean[j], node.m2[j], node.win_count, window, y[j], slot[j]);
+        slot[j] = y[j];
+        centred_[j] = static_cast<float>(y[j] - node.mean[j]);
+    }
+    node.win_t[node.win_head] = t_us;
+
+    float *proj = &node.proj[node.win_head * c];
+    std::copy(proj, proj + c, old_proj_.begin());
+    pca(node, centred_.data(), proj);
+    for (size_t i = 0; i < c; i++) {
+        welford_slide(node.proj_mean[i], node.proj_m2[i], node.win_count, window, proj[i], old_proj_[i]);
+    }
+
+    node.win_head = (node.win_head + 1) % window;
+    if (node.win_count < window) {
+        if (++node.win_count < window) {
+            return nullptr;
+        }
+    } else if (++node.since_hop < config_.hop) {
+        return nullptr;
+    }
+    node.since_hop = 0;
+    publish(node, key);
+    return &out_;
+}
+
+// Candid covariance-free incremental PCA (Weng, Zhang and Hwang, 2003). The
+// estimate v_i of the i-th eigenvector, scaled by its eigenvalue, moves
+// towards u (u . v_i / |v_i|) at rate 1/n, then u loses its component along
+// v_i before it updates v_{i+1}. Capping n at pca_memory turns the average
+// over every sample into one that forgets, so the components track the room.
+void FeaturePipeline::pca(Node &node, const float *u, float *proj) {
+    const size_t w = width(), c = config_.components;
+    float *residual = residual_.data();
+    std::memcpy(residual, u, w * sizeof(float));
+    const uint64_t n = ++node.pca_n;
+    const float rate = 1.0f / static_cast<float>(std::min<uint64_t>(n, config_.pca_memory));
+    for (size_t i = 0; i < c; i++) {
+        float *v = &node.v[i * w];
+        float norm = std::sqrt(dot(v, v, w));
+        if (n <= i || norm == 0) {
+            // Component i starts from the residual of the sample it first sees.
+            std::memcpy(v, residual, w * sizeof(float));
+        } else {
+            float gain = rate * dot(residual, v, w) / norm;
+            for (size_t j = 0; j < w; j++) {
+                v[j] = (1 - rate) * v[j] + gain * residual[j];
+            }
+        }
+        norm = std::sqrt(dot(v, v, w));
+        if (norm == 0) {
+            proj[i] = 0;
+            continue;
+        }
+        proj[i] = dot(u, v, w) / norm;
+        float along = dot(residual, v, w) / (norm * norm);
+        for (size_t j = 0; j < w; j++) {
+            residual[j] -= along * v[j];
+        }
+    }
+}
+
+void FeaturePipeline::publish(Node &node, const StreamKey &key) {
+    const size_t w = width(), c = config_.components, window = config_.window;
+    out_.node = key.mac;
+    out_.source = key.source;
+    out_.index = node.windows++;
+    out_.start_us = node.win_t[node.win_head];  // the head is the oldest row once the ring is full
+    out_.end_us = node.win_t[(node.win_head + window - 1) % window];
+    double total = 0;
+    for (size_t j = 0; j < w; j++) {
+        out_.mean[j] = static_cast<float>(node.mean[j]);
+        out_.variance[j] = static_cast<float>(node.m2[j] / static_cast<double>(window));
+        total += out_.variance[j];
+    }
+    out_.motion = static_cast<float>(total / static_cast<double>(w));
+    for (size_t i = 0; i < c; i++) {
+        const float *v = &node.v[i * w];
+        float norm = std::sqrt(dot(v, v, w));
+        out_.eigenvalues[i] = norm;
+        out_.pc_variance[i] = static_cast<float>(node.proj_m2[i] / static_cast<double>(window));
+        for (size_t j = 0; j < w; j++) {
+            out_.basis[i * w + j] = norm > 0 ? v[j] / norm : 0.0f;
+        }
+    }
+    windows_++;
+}
+
+}  // namespace csi
@@ -0,0 +1,468 @@
+#include "csi/ingest.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+#include <system_error>
+
+namespace csi {
+namespace {
+
+constexpr size_t kMaxDatagram = 8192;
+constexpr size_t kLogBufferBytes = 1 << 20;
+
+[[noreturn]] void throw_errno(const char *what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+uint64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+// <node address>_<mac>.csilog
+std::string stream_file_name(uint32_t source, const uint8_t mac[6]) {
+    char ip[INET_ADDRSTRLEN];
+    struct in_addr addr = {source};
+    inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+    char name[64];
+    std::snprintf(name, sizeof(name), "%s_%02x-%02x-%02x-%02x-%02x-%02x.csilog", ip,
+                  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return name;
+}
+
+}  // namespace
+
+IngestServer::IngestServer(IngestConfig config) : config_(std::move(config)) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        throw_errno("epoll_create1");
+    }
+
+    udp_fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (udp_fd_ < 0) {
+        throw_errno("socket");
+    }
+    int one = 1;
+    setsockopt(udp_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // SO_RCVBUFFORCE ignores rmem_max but needs CAP_NET_ADMIN; fall back quietly.
+    if (setsockopt(udp_fd_, SOL_SOCKET, SO_RCVBUFFORCE, &config_.rcvbuf_bytes, sizeof(int)) != 0) {
+        setsockopt(udp_fd_, SOL_SOCKET, SO_RCVBUF, &config_.rcvbuf_bytes, sizeof(int));
+    }
+    socklen_t optlen = sizeof(rcvbuf_bytes_);
+    getsockopt(udp_fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf_bytes_, &optlen);
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config_.port);
+    if (inet_pton(AF_INET, config_.bind_addr.c_str(), &addr.sin_addr) != 1) {
+        throw std::system_error(EINVAL, std::generic_category(), "bind address");
+    }
+    if (bind(udp_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+        throw_errno("bind");
+    }
+    socklen_t addrlen = sizeof(addr);
+    getsockname(udp_fd_, reinterpret_cast<struct sockaddr *>(&addr), &addrlen);
+    port_ = ntohs(addr.sin_port);
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = udp_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, udp_fd_, &ev) != 0) {
+        throw_errno("epoll_ctl");
+    }
+
+    if (!config_.feed_path.empty()) {
+        feed_fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (feed_fd_ < 0) {
+            throw_errno("socket(AF_UNIX)");
+        }
+        struct sockaddr_un un = {};
+        un.sun_family = AF_UNIX;
+        if (config_.feed_path.size() >= sizeof(un.sun_path)) {
+            throw std::system_error(ENAMETOOLONG, std::generic_category(), "feed path");
+        }
+        std::strcpy(un.sun_path, config_.feed_path.c_str());
+        unlink(un.sun_path);
+        if (bind(feed_fd_, reinterpret_cast<struct sockaddr *>(&un), sizeof(un)) != 0) {
+            throw_errno("bind(feed)");
+        }
+        ev.data.fd = feed_fd_;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, feed_fd_, &ev) != 0) {
+            throw_errno("epoll_ctl(feed)");
+        }
+    }
+
+    if (!config_.out_dir.empty()) {
+        mkdir(config_.out_dir.c_str(), 0755);
+    }
+
+    unsigned n = config_.recv_batch ? config_.recv_batch : 1;
+    rx_buffers_.resize(static_cast<size_t>(n) * kMaxDatagram);
+    msgs_.resize(n);
+    iovs_.resize(n);
+    addrs_.resize(n);
+    for (unsigned i = 0; i < n; i++) {
+        iovs_[i].iov_base = rx_buffers_.data() + static_cast<size_t>(i) * kMaxDatagram;
+        iovs_[i].iov_len = kMaxDatagram;
+        msgs_[i].msg_hdr = {};
+        msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        msgs_[i].msg_hdr.msg_name = &addrs_[i];
+    }
+    record_.resize(kFeedRecordHeader + CSI_FRAME_BIN_SIZE(CSI_FRAME_MAX_PAYLOAD));
+}
+
+IngestServer::~IngestServer() {
+    for (auto &entry : nodes_) {
+        if (entry.second.log) {
+            std::fclose(entry.second.log);
+        }
+    }
+    if (feed_fd_ >= 0) {
+        close(feed_fd_);
+        unlink(config_.feed_path.c_str());
+    }
+    if (udp_fd_ >= 0) {
+        close(udp_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+size_t IngestServer::poll(int timeout_ms) {
+    struct epoll_event events[4];
+    int n = epoll_wait(epoll_fd_, events, 4, timeout_ms);
+    size_t ingested = 0;
+    for (int i = 0; i < n; i++) {
+        if (events[i].data.fd == udp_fd_) {
+            ingested += drain_udp();
+        } else if (events[i].data.fd == feed_fd_) {
+            drain_feed_control();
+        }
+    }
+    if (config_.nack) {
+        send_nacks(realtime_ns());
+    }
+    return ingested;
+}
+
+size_t IngestServer::drain_udp() {
+    size_t ingested = 0;
+    while (true) {
+        for (auto &msg : msgs_) {
+            msg.msg_hdr.msg_flags = 0;
+            msg.msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+        int n = recvmmsg(udp_fd_, msgs_.data(), static_cast<unsigned>(msgs_.size()), MSG_DONTWAIT, nullptr);
+        if (n <= 0) {
+            break;
+        }
+        // One clock read per recvmmsg call; all datagrams in it arrived together.
+        uint64_t now = realtime_ns();
+        for (int i = 0; i < n; i++) {
+            const uint8_t *data = static_cast<const uint8_t *>(iovs_[i].iov_base);
+            datagrams_++;
+            if (handle_traffic(data, msgs_[i].msg_len, addrs_[i], now)) {
+                continue;
+            }
+            ingested += decoder_.decode(
+                data, msgs_[i].msg_len, [&](const Frame &frame) { on_frame(frame, addrs_[i], now); },
+                addrs_[i].sin_addr.s_addr);
+        }
+        if (static_cast<size_t>(n) < msgs_.size()) {
+            break;
+        }
+    }
+    return ingested;
+}
+
+bool IngestServer::handle_traffic(const uint8_t *data, size_t len, const struct sockaddr_in &from,
+                                  uint64_t now_ns) {
+    static constexpr std::string_view kProbe = CSI_TRAFFIC_PROBE_PREFIX;
+    static constexpr std::string_view kReport = CSI_TRAFFIC_REPORT_PREFIX;
+    static constexpr std::string_view kStats = CSI_STATS_REPORT_PREFIX;
+    static constexpr std::string_view kSync = CSI_CLOCK_SYNC_PREFIX;
+    static constexpr std::string_view kClock = CSI_CLOCK_REPORT_PREFIX;
+    static constexpr std::string_view kWake = CSI_LINK_REPORT_PREFIX;
+    static constexpr std::string_view kSchedule = CSI_SCHEDULE_REPORT_PREFIX;
+    std::string_view text(reinterpret_cast<const char *>(data), len);
+    const uint64_t key = (static_cast<uint64_t>(from.sin_addr.s_addr) << 16) | from.sin_port;
+    if (text.substr(0, kSync.size()) == kSync) {
+        uint32_t seq;
+        int64_t t1;
+        if (csi_clock_parse_request(text.data(), text.size(), &seq, &t1)) {
+            // t2 is the read time of the batch, t3 is taken as late as possible.
+            char reply[CSI_CLOCK_MSG_MAX_LEN];
+            size_t n = csi_clock_format_reply(seq, t1, static_cast<int64_t>(now_ns / 1000),
+                                              static_cast<int64_t>(realtime_ns() / 1000), reply, sizeof(reply));
+            if (n && sendto(udp_fd_, reply, n, MSG_DONTWAIT, reinterpret_cast<const struct sockaddr *>(&from),
+                            sizeof(from)) == static_cast<ssize_t>(n)) {
+                syncs_answered_++;
+            }
+        }
+        return true;
+    }
+    if (text.substr(0, kClock.size()) == kClock) {
+        ClockReport entry;
+        if (csi_clock_parse_report(text.data(), text.size(), &entry.report)) {
+            entry.from = from;
+            entry.received_ns = now_ns;
+            clock_reports_[key] = entry;
+            clocks_[from.sin_addr.s_addr].update(entry.report);
+        }
+        return true;
+    }
+    if (text.substr(0, kWake.size()) == kWake) {
+        WakeReport entry;
+        if (csi_link_parse_report(text.data(), text.size(), &entry.report)) {
+            entry.from = from;
+            entry.received_ns = now_ns;
+            wake_reports_[key] = entry;
+        }
+        return true;
+    }
+    if (text.substr(0, kSchedule.size()) == kSchedule) {
+        ScheduleReport entry;
+        if (csi_schedule_parse_report(text.data(), text.size(), &entry.report)) {
+            entry.from = from;
+            entry.received_ns = now_ns;
+            schedule_reports_[key] = entry;
+        }
+        return true;
+    }
+    if (text.substr(0, kProbe.size()) == kProbe) {
+        // The echo is what makes the AP transmit to the node; losing one only costs a CSI frame.
+        if (sendto(udp_fd_, data, len, MSG_DONTWAIT, reinterpret_cast<const struct sockaddr *>(&from),
+                   sizeof(from)) == static_cast<ssize_t>(len)) {
+            probes_echoed_++;
+        }
+        return true;
+    }
+    if (text.substr(0, kStats.size()) == kStats) {
+        csi_stats_report_t report;
+        if (csi_stats_parse_report(text.data(), text.size(), &report)) {
+            HealthReport &entry = health_reports_[key];
+            entry.previous = entry.report;
+            entry.report = report;
+            entry.from = from;
+            entry.received_ns = now_ns;
+        }
+        return true;
+    }
+    if (text.substr(0, kReport.size()) != kReport) {
+        return false;
+    }
+    RateReport entry;
+    if (csi_traffic_parse_report(text.data(), text.size(), &entry.report)) {
+        entry.from = from;
+        entry.received_ns = now_ns;
+        rate_reports_[key] = entry;
+    }
+    return true;
+}
+
+void IngestServer::drain_feed_control() {
+    char buf[16];
+    struct sockaddr_un from;
+    while (true) {
+        socklen_t fromlen = sizeof(from);
+        ssize_t n = recvfrom(feed_fd_, buf, sizeof(buf), 0, reinterpret_cast<struct sockaddr *>(&from), &fromlen);
+        if (n < 0) {
+            break;
+        }
+        if (fromlen <= offsetof(struct sockaddr_un, sun_path)) {
+            continue;  // unnamed peer, nothing to reply to
+        }
+        auto same = [&](const struct sockaddr_un &s) { return std::strcmp(s.sun_path, from.sun_path) == 0; };
+        for (auto it = subscribers_.begin(); it != subscribers_.end();) {
+            it = same(*it) ? subscribers_.erase(it) : it + 1;
+        }
+        if (n >= 3 && std::memcmp(buf, "SUB", 3) == 0) {
+            subscribers_.push_back(from);
+        }
+    }
+}
+
+IngestServer::Node &IngestServer::node_for(uint32_t source, const uint8_t mac[6]) {
+    auto [it, inserted] = nodes_.try_emplace(StreamKey{source, mac_key(mac)});
+    Node &node = it->second;
+    if (inserted) {
+        node.stats.source = source;
+        std::memcpy(node.stats.mac, mac, 6);
+        csi_nack_init(&node.nack);
+        if (!config_.out_dir.empty()) {
+            std::string path = config_.out_dir + "/" + stream_file_name(source, mac);
+            node.log = std::fopen(path.c_str(), "ab");
+            if (node.log) {
+                std::setvbuf(node.log, nullptr, _IOFBF, kLogBufferBytes);
+                std::fseek(node.log, 0, SEEK_END);
+                if (std::ftell(node.log) == 0) {
+                    std::fwrite(kCsiLogMagic, 1, sizeof(kCsiLogMagic), node.log);
+                }
+            }
+        }
+    }
+    return node;
+}
+
+void IngestServer::send_nacks(uint64_t now_ns) {
+    char nack[CSI_HISTORY_NACK_MAX_LEN];
+    for (auto &entry : nodes_) {
+        Node &node = entry.second;
+        size_t len = csi_nack_poll(&node.nack, node.stats.mac, now_ns / 1000, nack, sizeof(nack));
+        if (len > 0 && sendto(udp_fd_, nack, len, MSG_DONTWAIT, reinterpret_cast<const struct sockaddr *>(&node.from),
+                              sizeof(node.from)) == static_cast<ssize_t>(len)) {
+            node.stats.nacks++;
+            nacks_sent_++;
+        }
+        node.stats.recovered = node.nack.recovered;
+        node.stats.abandoned = node.nack.abandoned;
+    }
+}
+
+void IngestServer::on_frame(const Frame &frame, const struct sockaddr_in &from, uint64_t now_ns) {
+    frames_++;
+    Node &node = node_for(from.sin_addr.s_addr, frame.meta.mac);
+    NodeStats &st = node.stats;
+    if (config_.nack) {
+        node.from = from;
+        csi_nack_on_frame(&node.nack, frame.meta.seq, now_ns / 1000);
+    }
+
+    if (st.frames == 0) {
+        st.first_ns = now_ns;
+        st.last_seq = frame.meta.seq;
+    } else {
+        int32_t delta = static_cast<int32_t>(frame.meta.seq - st.last_seq);
+        if (delta > 0) {
+            st.lost += static_cast<uint64_t>(delta - 1);
+            st.last_seq = frame.meta.seq;
+        } else if (delta < 0 && delta > -1024) {
+            // A late frame fills a gap that was already counted as lost.
+            st.reordered++;
+            if (st.lost) {
+                st.lost--;
+            }
+        } else if (delta <= -1024) {
+            st.restarts++;
+            st.last_seq = frame.meta.seq;
+        }
+    }
+    st.frames++;
+    st.last_rssi = frame.meta.rssi;
+    st.last_ns = now_ns;
+
+    if (!node.log && subscribers_.empty()) {
+        return;
+    }
+    put_u64(record_.data(), now_ns);
+    std::memcpy(record_.data() + kFeedRecordSource, &from.sin_addr.s_addr, 4);
+    auto clock = clocks_.find(from.sin_addr.s_addr);
+    int64_t capture_us = clock != clocks_.end() ? clock->second.to_shared(frame.meta.timestamp) : kNoCaptureTime;
+    put_u64(record_.data() + kFeedRecordCapture, static_cast<uint64_t>(capture_us));
+    size_t frame_len = csi_frame_encode(&frame.meta, frame.payload, record_.data() + kFeedRecordHeader,
+                                        record_.size() - kFeedRecordHeader);
+    if (frame_len == 0) {
+        return;
+    }
+    uint32_t rec_len = static_cast<uint32_t>(kFeedRecordHeader + frame_len);
+    if (node.log) {
+        uint8_t len_le[4] = {static_cast<uint8_t>(rec_len), static_cast<uint8_t>(rec_len >> 8),
+                             static_cast<uint8_t>(rec_len >> 16), static_cast<uint8_t>(rec_len >> 24)};
+        std::fwrite(len_le, 1, sizeof(len_le), node.log);
+        std::fwrite(record_.data(), 1, rec_len, node.log);
+    }
+    for (auto it = subscribers_.begin(); it != subscribers_.end();) {
+        ssize_t sent = sendto(feed_fd_, record_.data(), rec_len, MSG_DONTWAIT,
+                              reinterpret_cast<const struct sockaddr *>(&*it), sizeof(*it));
+        if (sent < 0 && (errno == ECONNREFUSED || errno == ENOENT)) {
+            it = subscribers_.erase(it);
+            continue;
+        }
+        if (sent < 0) {
+            feed_drops_++;
+        }
+        ++it;
+    }
+}
+
+void IngestServer::flush() {
+    for (auto &entry : nodes_) {
+        if (entry.second.log) {
+            std::fflush(entry.second.log);
+        }
+    }
+}
+
+std::vector<NodeStats> IngestServer::node_stats() const {
+    std::vector<NodeStats> out;
+    out.reserve(nodes_.size());
+    for (const auto &entry : nodes_) {
+        out.push_back(entry.second.stats);
+    }
+    return out;
+}
+
+std::vector<RateReport> IngestServer::rate_reports() const {
+    std::vector<RateReport> out;
+    out.reserve(rate_reports_.size());
+    for (const auto &entry : rate_reports_) {
+        out.push_back(entry.second);
+    }
+    return out;
+}
+
+std::vector<HealthReport> IngestServer::health_reports() const {
+    std::vector<HealthReport> out;
+    out.reserve(health_reports_.size());
+    for (const auto &entry : health_reports_) {
+        out.push_back(entry.second);
+    }
+    return out;
+}
+
+std::vector<ClockReport> IngestServer::clock_reports() const {
+    std::vector<ClockReport> out;
+    out.reserve(clock_reports_.size());
+    for (const auto &entry : clock_reports_) {
+        out.push_back(entry.second);
+    }
+    return out;
+}
+
+std::vector<WakeReport> IngestServer::wake_reports() const {
+    std::vector<WakeReport> out;
+    out.reserve(wake_reports_.size());
+    for (const auto &entry : wake_reports_) {
+        out.push_back(entry.second);
+    }
+    return out;
+}
+
+std::vector<ScheduleReport> IngestServer::schedule_reports() const {
+    std::vector<ScheduleReport> out;
+    out.reserve(schedule_reports_.size());
+    for (const auto &entry : schedule_reports_) {
+        out.push_back(entry.second);
+    }
+    return out;
+}
+
+}  // namespace csi
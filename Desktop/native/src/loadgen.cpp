@@ -0,0 +1,390 @@
+#include "csi/loadgen.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include "csi/sqlite_source.hpp"
+#include "csi_batch.h"
+
+namespace csi {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Same budget and deadline as CSI_BATCH_MAX_BYTES / CSI_BATCH_MAX_LATENCY_MS on the node.
+constexpr size_t kBatchBytes = 1400;
+constexpr uint64_t kBatchLatencyNs = 20000000;
+constexpr unsigned kBurst = 64;
+constexpr size_t kSlot = 8192;
+// Gaps shorter than this are sent late rather than slept through.
+constexpr uint64_t kMinSleepNs = 200000;
+
+uint64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Collects datagrams into sendmmsg bursts.
+class BurstSender {
+public:
+    static constexpr size_t kControl = CMSG_SPACE(sizeof(struct in_pktinfo));
+
+    explicit BurstSender(int fd)
+        : fd_(fd), bufs_(kBurst * kSlot), msgs_(kBurst), iovs_(kBurst), control_(kBurst * kControl) {}
+
+    uint8_t *slot() { return bufs_.data() + static_cast<size_t>(n_) * kSlot; }
+
+    // source, if not 0, is the local address the datagram is sent from.
+    void commit(size_t len, uint32_t source = 0) {
+        iovs_[n_].iov_base = slot();
+        iovs_[n_].iov_len = len;
+        msgs_[n_].msg_hdr = {};
+        msgs_[n_].msg_hdr.msg_iov = &iovs_[n_];
+        msgs_[n_].msg_hdr.msg_iovlen = 1;
+        if (source) {
+            struct msghdr &hdr = msgs_[n_].msg_hdr;
+            hdr.msg_control = control_.data() + static_cast<size_t>(n_) * kControl;
+            hdr.msg_controllen = kControl;
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = IPPROTO_IP;
+            cmsg->cmsg_type = IP_PKTINFO;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+            struct in_pktinfo info = {};
+            info.ipi_spec_dst.s_addr = source;
+            std::memcpy(CMSG_DATA(cmsg), &info, sizeof(info));
+        }
+        if (++n_ == kBurst) {
+            flush();
+        }
+    }
+
+    void flush() {
+        unsigned done = 0;
+        while (done < n_) {
+            int rc = sendmmsg(fd_, msgs_.data() + done, n_ - done, 0);
+            if (rc > 0) {
+                done += static_cast<unsigned>(rc);
+                datagrams += static_cast<unsigned>(rc);
+            } else if (errno == EAGAIN || errno == ENOBUFS || errno == EINTR) {
+                std::this_thread::yield();
+            } else {
+                // ECONNREFUSED and the like: nobody listening yet, the datagram is gone.
+                done++;
+                errors++;
+            }
+        }
+        n_ = 0;
+    }
+
+    uint64_t datagrams = 0;
+    uint64_t errors = 0;
+
+private:
+    int fd_;
+    unsigned n_ = 0;
+    std::vector<uint8_t> bufs_;
+    std::vector<struct mmsghdr> msgs_;
+    std::vector<struct iovec> iovs_;
+    std::vector<uint8_t> control_;
+};
+
+}  // namespace
+
+bool parse_wire_format(const std::string &name, WireFormat &format) {
+    if (name == "text") {
+        format = WireFormat::Text;
+    } else if (name == "binary") {
+        format = WireFormat::Binary;
+    } else if (name == "batch") {
+        format = WireFormat::Batch;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *wire_format_name(WireFormat format) {
+    switch (format) {
+    case WireFormat::Text: return "text";
+    case WireFormat::Binary: return "binary";
+    case WireFormat::Batch: return "batch";
+    }
+    return "?";
+}
+
+std::vector<FrameTemplate> synthetic_templates(size_t count, unsigned len) {
+    std::vector<FrameTemplate> out(count);
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    for (size_t f = 0; f < count; f++) {
+        FrameTemplate &t = out[f];
+        t.meta = {};
+        t.meta.rssi = static_cast<int8_t>(-40 - static_cast<int>(f % 5));
+        t.meta.rate = 11;
+        t.meta.sig_mode = 1;
+        t.meta.mcs = 7;
+        t.meta.cwb = 1;
+        t.meta.noise_floor = -93;
+        t.meta.channel = 6;
+        t.meta.sig_len = 67;
+        t.meta.first_word_invalid = 1;
+        t.meta.len = static_cast<uint16_t>(len);
+        t.payload.resize(len);
+        for (unsigned i = 0; i < len; i++) {
+            double v = (i / 2 % 32 < 5) ? 0 : 18 * std::sin(i * 0.37 + f * 0.01) + noise(rng);
+            t.payload[i] = static_cast<int8_t>(std::max(-128.0, std::min(127.0, std::round(v))));
+        }
+    }
+    return out;
+}
+
+std::vector<FrameTemplate> sqlite_templates(const std::string &path, size_t limit) {
+    SqliteFrameSource source(path);
+    std::vector<FrameTemplate> out;
+    FrameTemplate t;
+    double host_time;
+    while ((limit == 0 || out.size() < limit) && source.next(t.meta, t.payload, host_time)) {
+        out.push_back(t);
+    }
+    if (out.empty()) {
+        throw std::runtime_error(path + " holds no replayable frames");
+    }
+    return out;
+}
+
+uint32_t node_address(unsigned node) {
+    return htonl(0x7F010000u + node + 1);
+}
+
+void node_mac(unsigned node, uint8_t mac[6]) {
+    const uint8_t m[6] = {0x02, 0, 0, 0, static_cast<uint8_t>(node >> 8), static_cast<uint8_t>(node)};
+    std::memcpy(mac, m, 6);
+}
+
+std::vector<ScheduledFrame> build_schedule(const LoadProfile &profile) {
+    std::vector<ScheduledFrame> out;
+    out.reserve(static_cast<size_t>(profile.nodes) * profile.frames);
+    std::mt19937_64 rng(profile.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> jitter(0.0, profile.jitter_us > 0 ? profile.jitter_us * 1e3 : 1.0);
+
+    double period_ns = 1e9 / profile.rate_hz;
+    unsigned burst = std::max(1u, profile.burst);
+    // Gilbert model: leave the loss state after loss_burst frames on average,
+    // enter it often enough that the stationary loss fraction is profile.loss.
+    // A run length of 1 or less means independent losses.
+    bool independent = profile.loss_burst <= 1.0;
+    double p_exit = independent ? 1.0 - profile.loss : 1.0 / profile.loss_burst;
+    double p_enter = independent ? profile.loss
+                     : profile.loss < 1.0 ? std::min(1.0, profile.loss * p_exit / (1.0 - profile.loss)) : 1.0;
+
+    for (unsigned node = 0; node < profile.nodes; node++) {
+        double phase_ns = unit(rng) * period_ns * burst;
+        bool losing = unit(rng) < profile.loss;
+        double prev = 0;
+        for (uint32_t seq = 0; seq < profile.frames; seq++) {
+            double at = phase_ns + static_cast<double>(seq / burst) * burst * period_ns;
+            if (profile.jitter_us > 0) {
+                // A node never reorders its own frames, however large the jitter.
+                at = std::max(prev, at + jitter(rng));
+            }
+            prev = at;
+            if (profile.loss > 0 && seq > 0) {
+                losing = unit(rng) < (losing ? 1.0 - p_exit : p_enter);
+            }
+            out.push_back({static_cast<uint64_t>(std::max(0.0, at)), node, seq, profile.loss > 0 && losing});
+        }
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const ScheduledFrame &a, const ScheduledFrame &b) { return a.at_ns < b.at_ns; });
+    return out;
+}
+
+LoadGenerator::LoadGenerator(LoadProfile profile, std::vector<FrameTemplate> templates)
+    : profile_(std::move(profile)), templates_(std::move(templates)) {
+    if (templates_.empty()) {
+        throw std::invalid_argument("no frame templates");
+    }
+    if (profile_.nodes == 0 || profile_.nodes > 0xFFFF || !(profile_.rate_hz > 0) || profile_.loss < 0 ||
+        profile_.loss > 1) {
+        throw std::invalid_argument("bad load profile");
+    }
+    schedule_ = build_schedule(profile_);
+}
+
+LoadGenerator::~LoadGenerator() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void LoadGenerator::connect(const std::string &host, uint16_t port) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *res = nullptr;
+    int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res);
+    if (rc != 0) {
+        throw std::system_error(EHOSTUNREACH, std::generic_category(), host + ": " + gai_strerror(rc));
+    }
+    if (fd_ < 0) {
+        fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    }
+    if (fd_ < 0) {
+        freeaddrinfo(res);
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    int sndbuf = 4 << 20;
+    setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    // Every 127/8 address is local, so each node can send from its own.
+    node_sources_ = (ntohl(reinterpret_cast<const struct sockaddr_in *>(res->ai_addr)->sin_addr.s_addr) >> 24) == 127;
+    rc = ::connect(fd_, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc != 0) {
+        throw std::system_error(errno, std::generic_category(), "connect");
+    }
+}
+
+long LoadGenerator::node_of(uint32_t source, const uint8_t mac[6]) const {
+    if (profile_.keep_mac) {
+        return 0;  // a single node
+    }
+    if (!node_sources_) {
+        uint8_t expect[6];
+        unsigned node = static_cast<unsigned>(mac[4]) << 8 | mac[5];
+        node_mac(node, expect);
+        return node < profile_.nodes && std::memcmp(expect, mac, 6) == 0 ? static_cast<long>(node) : -1;
+    }
+    if (std::memcmp(mac, kLoadMac, 6) != 0) {
+        return -1;
+    }
+    if (source == 0) {
+        return profile_.nodes == 1 ? 0 : -1;
+    }
+    uint32_t node = ntohl(source) - ntohl(node_address(0));
+    return node < profile_.nodes ? static_cast<long>(node) : -1;
+}
+
+size_t LoadGenerator::encode(const ScheduledFrame &frame, uint8_t *out, size_t cap) const {
+    const FrameTemplate &t = templates_[(static_cast<size_t>(frame.node) * 7919 + frame.seq) % templates_.size()];
+    csi_frame_meta_t meta = t.meta;
+    meta.seq = frame.seq;
+    meta.timestamp = static_cast<uint32_t>(frame.at_ns / 1000);
+    meta.len = static_cast<uint16_t>(t.payload.size());
+    if (node_sources_) {
+        std::memcpy(meta.mac, kLoadMac, 6);
+    } else if (!profile_.keep_mac) {
+        node_mac(frame.node, meta.mac);
+    }
+    if (profile_.format == WireFormat::Text) {
+        return csi_frame_format_text(&meta, t.payload.data(), reinterpret_cast<char *>(out), cap);
+    }
+    return csi_frame_encode(&meta, t.payload.data(), out, cap);
+}
+
+LoadResult LoadGenerator::run(const std::atomic<bool> *stop) {
+    if (fd_ < 0) {
+        throw std::system_error(ENOTCONN, std::generic_category(), "load generator not connected");
+    }
+    LoadResult result;
+    BurstSender out(fd_);
+    bool batching = profile_.format == WireFormat::Batch;
+
+    // One pending batch per node, coalesced the way csi_sender_task does it.
+    std::vector<std::vector<uint8_t>> batch_bufs(batching ? profile_.nodes : 0, std::vector<uint8_t>(kBatchBytes));
+    std::vector<csi_batch_t> batches(batch_bufs.size());
+    std::vector<uint64_t> deadlines(batch_bufs.size(), UINT64_MAX);
+    for (size_t n = 0; n < batches.size(); n++) {
+        csi_batch_init(&batches[n], batch_bufs[n].data(), batch_bufs[n].size());
+    }
+    uint64_t next_deadline = UINT64_MAX;
+    auto source = [&](size_t node) { return node_sources_ ? node_address(static_cast<unsigned>(node)) : 0; };
+    auto emit_batch = [&](size_t node) {
+        size_t len = csi_batch_finish(&batches[node]);
+        if (len) {
+            std::memcpy(out.slot(), batch_bufs[node].data(), len);
+            out.commit(len, source(node));
+        }
+        csi_batch_reset(&batches[node]);
+        deadlines[node] = UINT64_MAX;
+    };
+    auto emit_due_batches = [&](uint64_t now) {
+        if (now < next_deadline) {
+            return;
+        }
+        next_deadline = UINT64_MAX;
+        for (size_t n = 0; n < batches.size(); n++) {
+            if (deadlines[n] <= now) {
+                emit_batch(n);
+            }
+            next_deadline = std::min(next_deadline, deadlines[n]);
+        }
+    };
+
+    std::vector<uint8_t> frame(kSlot);
+    auto t0 = Clock::now();
+    result.start_ns = realtime_ns();
+    for (size_t i = 0; i < schedule_.size();) {
+        if (stop && stop->load(std::memory_order_relaxed)) {
+            break;
+        }
+        uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - t0).count());
+        emit_due_batches(now);
+        const ScheduledFrame &f = schedule_[i];
+        if (f.at_ns > now + kMinSleepNs) {
+            out.flush();
+            uint64_t wake = std::min(f.at_ns, next_deadline);
+            std::this_thread::sleep_until(t0 + std::chrono::nanoseconds(wake));
+            continue;
+        }
+        if (f.at_ns < now) {
+            result.max_late_ns = std::max(result.max_late_ns, now - f.at_ns);
+        }
+        i++;
+        if (f.lost) {
+            result.frames_lost++;
+            continue;
+        }
+        result.frames_sent++;
+        if (!batching) {
+            out.commit(encode(f, out.slot(), kSlot), source(f.node));
+            continue;
+        }
+        uint16_t len = static_cast<uint16_t>(encode(f, frame.data(), frame.size()));
+        csi_batch_t &b = batches[f.node];
+        if (csi_batch_add(&b, f.seq, frame.data(), len) != 0) {
+            emit_batch(f.node);
+            csi_batch_add(&b, f.seq, frame.data(), len);
+        }
+        if (b.count == 1) {
+            deadlines[f.node] = f.at_ns + kBatchLatencyNs;
+            next_deadline = std::min(next_deadline, deadlines[f.node]);
+        }
+    }
+    for (size_t n = 0; n < batches.size(); n++) {
+        emit_batch(n);
+    }
+    out.flush();
+    result.elapsed_s = std::chrono::duration<double>(Clock::now() - t0).count();
+    result.datagrams = out.datagrams;
+    result.send_errors = out.errors;
+    return result;
+}
+
+}  // namespace csi
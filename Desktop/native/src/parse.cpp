@@ -0,0 +1,161 @@
+#include "csi/parse.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "csi/datagram.hpp"
+#include "csi/sqlite_source.hpp"
+
+struct csi_parse_db {
+    explicit csi_parse_db(const std::string &path, const csi::SqliteSourceFilter &filter) : source(path, filter) {}
+
+    csi::SqliteFrameSource source;
+    std::vector<int8_t> payload;
+    uint64_t skipped = 0;   // source.skipped() already passed on
+};
+
+namespace {
+
+void store_meta(csi_parse_out_t *out, const csi_frame_meta_t &m, long values, double host_time) {
+    uint64_t row = out->rows;
+    if (out->meta) {
+        int64_t *col = out->meta + row * CSI_PARSE_COLUMNS;
+        col[CSI_PARSE_SEQ]               = m.seq;
+        col[CSI_PARSE_RSSI]              = m.rssi;
+        col[CSI_PARSE_RATE]              = m.rate;
+        col[CSI_PARSE_SIG_MODE]          = m.sig_mode;
+        col[CSI_PARSE_MCS]               = m.mcs;
+        col[CSI_PARSE_CWB]               = m.cwb;
+        col[CSI_PARSE_SMOOTHING]         = m.smoothing;
+        col[CSI_PARSE_NOT_SOUNDING]      = m.not_sounding;
+        col[CSI_PARSE_AGGREGATION]       = m.aggregation;
+        col[CSI_PARSE_STBC]              = m.stbc;
+        col[CSI_PARSE_FEC_CODING]        = m.fec_coding;
+        col[CSI_PARSE_SGI]               = m.sgi;
+        col[CSI_PARSE_NOISE_FLOOR]       = m.noise_floor;
+        col[CSI_PARSE_AMPDU_CNT]         = m.ampdu_cnt;
+        col[CSI_PARSE_CHANNEL]           = m.channel;
+        col[CSI_PARSE_SECONDARY_CHANNEL] = m.secondary_channel;
+        col[CSI_PARSE_TIMESTAMP]         = m.timestamp;
+        col[CSI_PARSE_ANT]               = m.ant;
+        col[CSI_PARSE_SIG_LEN]           = m.sig_len;
+        col[CSI_PARSE_RX_STATE]          = m.rx_state;
+        col[CSI_PARSE_LEN]               = values;
+        col[CSI_PARSE_FIRST_WORD]        = m.first_word_invalid;
+    }
+    if (out->mac) {
+        out->mac[row] = csi::mac_key(m.mac);
+    }
+    if (out->host_time) {
+        out->host_time[row] = host_time;
+    }
+}
+
+// Zero-pads a row of which the first values entries were written.
+void finish_row(csi_parse_out_t *out, int8_t *row, long values) {
+    if (static_cast<uint64_t>(values) < out->width) {
+        std::memset(row + values, 0, out->width - values);
+    } else if (static_cast<uint64_t>(values) > out->width) {
+        out->truncated++;
+    }
+}
+
+}  // namespace
+
+extern "C" {
+
+int csi_parse_simd(int enable) {
+    return enable < 0 ? csi::simd_scan() : csi::set_simd_scan(enable != 0);
+}
+
+long csi_parse_payload(const char *text, size_t len, int8_t *out, size_t cap) {
+    return csi::scan_payload_list(std::string_view(text, len), out, cap);
+}
+
+size_t csi_parse_lines(const char *text, size_t len, csi_parse_out_t *out) {
+    static constexpr std::string_view kPrefix = "CSI_DATA,";
+    const char *p = text;
+    const char *end = text + len;
+    csi_frame_meta_t meta;
+    while (out->rows < out->capacity) {
+        auto nl = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (!nl) {
+            break;
+        }
+        std::string_view line(p, nl - p);
+        p = nl + 1;
+        if (line.substr(0, kPrefix.size()) != kPrefix) {
+            continue;
+        }
+        int8_t *row = out->payload + out->rows * out->width;
+        long values = csi::parse_csi_line(line, meta, row, out->width);
+        if (values < 0) {
+            out->skipped++;
+            continue;
+        }
+        finish_row(out, row, values);
+        store_meta(out, meta, values, NAN);
+        out->rows++;
+    }
+    return static_cast<size_t>(p - text);
+}
+
+csi_parse_db_t *csi_parse_db_open(const char *path, const char *table, const char *scenario, char *err,
+                                  size_t err_len) {
+    csi::SqliteSourceFilter filter;
+    filter.table = table ? table : "";
+    filter.scenario = scenario ? scenario : "";
+    try {
+        return new csi_parse_db(path, filter);
+    } catch (const std::exception &e) {
+        if (err && err_len) {
+            std::snprintf(err, err_len, "%s", e.what());
+        }
+        return nullptr;
+    }
+}
+
+uint64_t csi_parse_db_rows(csi_parse_db_t *db) {
+    try {
+        return db->source.count_rows();
+    } catch (const std::exception &) {
+        return 0;
+    }
+}
+
+uint32_t csi_parse_db_max_len(csi_parse_db_t *db) {
+    try {
+        return db->source.max_len();
+    } catch (const std::exception &) {
+        return 0;
+    }
+}
+
+uint64_t csi_parse_db_read(csi_parse_db_t *db, csi_parse_out_t *out) {
+    uint64_t first = out->rows;
+    csi_frame_meta_t meta;
+    double host_time;
+    while (out->rows < out->capacity && db->source.next(meta, db->payload, host_time)) {
+        int8_t *row = out->payload + out->rows * out->width;
+        long values = static_cast<long>(db->payload.size());
+        std::memcpy(row, db->payload.data(), std::min<size_t>(values, out->width));
+        finish_row(out, row, values);
+        store_meta(out, meta, values, host_time < 0 ? NAN : host_time);
+        out->rows++;
+    }
+    out->skipped += db->source.skipped() - db->skipped;
+    db->skipped = db->source.skipped();
+    return out->rows - first;
+}
+
+void csi_parse_db_close(csi_parse_db_t *db) {
+    delete db;
+}
+
+}  // extern "C"
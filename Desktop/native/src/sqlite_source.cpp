@@ -0,0 +1,188 @@
+#include "csi/sqlite_source.hpp"
+
+#include <sqlite3.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+#include "csi/datagram.hpp"
+
+namespace csi {
+namespace {
+
+constexpr const char *kColumns =
+    "seq, mac, rssi, rate, sig_mode, mcs, bandwidth, smoothing, not_sounding, aggregation, stbc, "
+    "fec_coding, sgi, noise_floor, ampdu_cnt, channel, secondary_channel, local_timestamp, ant, "
+    "sig_len, rx_state, len, first_word, data";
+
+int hex_digit(unsigned char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// "aa:bb:cc:dd:ee:ff", either case.
+bool parse_mac(const unsigned char *text, uint8_t mac[6]) {
+    if (!text) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++, text += 3) {
+        int hi = hex_digit(text[0]);
+        int lo = hi < 0 ? -1 : hex_digit(text[1]);
+        if (lo < 0 || (i < 5 && text[2] != ':')) {
+            return false;
+        }
+        mac[i] = static_cast<uint8_t>(hi << 4 | lo);
+    }
+    return true;
+}
+
+}  // namespace
+
+SqliteFrameSource::SqliteFrameSource(const std::string &path, const SqliteSourceFilter &filter)
+    : filter_(filter) {
+    if (sqlite3_open_v2(path.c_str(), &db_, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        std::string msg = db_ ? sqlite3_errmsg(db_) : "out of memory";
+        sqlite3_close(db_);
+        db_ = nullptr;
+        throw std::runtime_error("cannot open " + path + ": " + msg);
+    }
+    sqlite3_stmt *probe = prepare("SELECT name FROM sqlite_master WHERE type = 'table' AND name IN ('csi_frame', 'csi_data')");
+    while (sqlite3_step(probe) == SQLITE_ROW) {
+        std::string name = reinterpret_cast<const char *>(sqlite3_column_text(probe, 0));
+        if (filter_.table.empty() ? name == "csi_frame" || table_.empty() : name == filter_.table) {
+            table_ = name;
+        }
+    }
+    sqlite3_finalize(probe);
+    if (table_.empty()) {
+        sqlite3_close(db_);
+        db_ = nullptr;
+        throw std::runtime_error(path + " has no " +
+                                 (filter_.table.empty() ? std::string("csi_frame or csi_data") : filter_.table) +
+                                 " table");
+    }
+    has_host_time_ = table_ == "csi_frame";
+    if (!has_host_time_) {
+        // The desktop layout names the column "scenario", the Android one "cenario".
+        probe = prepare("SELECT 1 FROM pragma_table_info('csi_data') WHERE name = 'scenario'");
+        scenario_column_ = sqlite3_step(probe) == SQLITE_ROW ? "scenario" : "cenario";
+        sqlite3_finalize(probe);
+    }
+    rewind();
+}
+
+SqliteFrameSource::~SqliteFrameSource() {
+    sqlite3_finalize(stmt_);
+    sqlite3_close(db_);
+}
+
+sqlite3_stmt *SqliteFrameSource::prepare(const std::string &sql) {
+    sqlite3_stmt *stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error(std::string("sqlite: ") + sqlite3_errmsg(db_));
+    }
+    return stmt;
+}
+
+std::string SqliteFrameSource::where_clause() const {
+    std::string where;
+    auto add = [&where](const std::string &cond) { where += where.empty() ? " WHERE " + cond : " AND " + cond; };
+    if (table_ == "csi_frame") {
+        if (filter_.session_id >= 0) {
+            add("session_id = " + std::to_string(filter_.session_id));
+        }
+        if (!filter_.scenario.empty()) {
+            add("session_id IN (SELECT id FROM csi_session WHERE scenario = ?1)");
+        }
+    } else if (!filter_.scenario.empty()) {
+        add(scenario_column_ + " = ?1");
+    }
+    return where;
+}
+
+void SqliteFrameSource::rewind() {
+    sqlite3_finalize(stmt_);
+    std::string sql = std::string("SELECT ") + kColumns + (has_host_time_ ? ", host_time" : ", NULL") +
+                      " FROM " + table_ + where_clause() + " ORDER BY id";
+    stmt_ = prepare(sql);
+    if (!filter_.scenario.empty()) {
+        sqlite3_bind_text(stmt_, 1, filter_.scenario.c_str(), -1, SQLITE_TRANSIENT);
+    }
+}
+
+uint64_t SqliteFrameSource::count_rows() {
+    sqlite3_stmt *stmt = prepare("SELECT COUNT(*) FROM " + table_ + where_clause());
+    if (!filter_.scenario.empty()) {
+        sqlite3_bind_text(stmt, 1, filter_.scenario.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    uint64_t n = sqlite3_step(stmt) == SQLITE_ROW ? static_cast<uint64_t>(sqlite3_column_int64(stmt, 0)) : 0;
+    sqlite3_finalize(stmt);
+    return n;
+}
+
+uint32_t SqliteFrameSource::max_len() {
+    sqlite3_stmt *stmt = prepare("SELECT MAX(len) FROM " + table_ + where_clause());
+    if (!filter_.scenario.empty()) {
+        sqlite3_bind_text(stmt, 1, filter_.scenario.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    uint32_t n = sqlite3_step(stmt) == SQLITE_ROW ? static_cast<uint32_t>(sqlite3_column_int64(stmt, 0)) : 0;
+    sqlite3_finalize(stmt);
+    return n;
+}
+
+bool SqliteFrameSource::next(csi_frame_meta_t &meta, std::vector<int8_t> &payload, double &host_time_s) {
+    while (sqlite3_step(stmt_) == SQLITE_ROW) {
+        std::memset(&meta, 0, sizeof(meta));
+        if (!parse_mac(sqlite3_column_text(stmt_, 1), meta.mac)) {
+            skipped_++;
+            continue;
+        }
+        if (sqlite3_column_type(stmt_, 23) == SQLITE_BLOB) {
+            auto data = static_cast<const int8_t *>(sqlite3_column_blob(stmt_, 23));
+            payload.assign(data, data + sqlite3_column_bytes(stmt_, 23));
+        } else {
+            auto text = reinterpret_cast<const char *>(sqlite3_column_text(stmt_, 23));
+            std::string_view view = text ? std::string_view(text, sqlite3_column_bytes(stmt_, 23)) : std::string_view();
+            if (!parse_payload_list(view, payload)) {
+                skipped_++;
+                continue;
+            }
+        }
+        if (payload.size() > CSI_FRAME_MAX_PAYLOAD) {
+            skipped_++;
+            continue;
+        }
+        auto col = [this](int i) { return sqlite3_column_int64(stmt_, i); };
+        meta.seq                = static_cast<uint32_t>(col(0));
+        meta.rssi               = static_cast<int8_t>(col(2));
+        meta.rate               = static_cast<uint8_t>(sqlite3_column_double(stmt_, 3));
+        meta.sig_mode           = static_cast<uint8_t>(col(4));
+        meta.mcs                = static_cast<uint8_t>(col(5));
+        meta.cwb                = static_cast<uint8_t>(col(6));
+        meta.smoothing          = static_cast<uint8_t>(col(7));
+        meta.not_sounding       = static_cast<uint8_t>(col(8));
+        meta.aggregation        = static_cast<uint8_t>(col(9));
+        meta.stbc               = static_cast<uint8_t>(col(10));
+        meta.fec_coding         = static_cast<uint8_t>(col(11));
+        meta.sgi                = static_cast<uint8_t>(col(12));
+        meta.noise_floor        = static_cast<int8_t>(col(13));
+        meta.ampdu_cnt          = static_cast<uint8_t>(col(14));
+        meta.channel            = static_cast<uint8_t>(col(15));
+        meta.secondary_channel  = static_cast<uint8_t>(col(16));
+        meta.timestamp          = static_cast<uint32_t>(col(17));
+        meta.ant                = static_cast<uint8_t>(col(18));
+        meta.sig_len            = static_cast<uint16_t>(col(19));
+        meta.rx_state           = static_cast<uint8_t>(col(20));
+        meta.first_word_invalid = static_cast<uint8_t>(col(22));
+        meta.len                = static_cast<uint16_t>(payload.size());
+        host_time_s = sqlite3_column_type(stmt_, 24) == SQLITE_NULL ? -1.0 : sqlite3_column_double(stmt_, 24);
+        return true;
+    }
+    return false;
+}
+
+}  // namespace csi
@@ -0,0 +1,28 @@
+/*
+ * Minimal assertions for the host tests, usable from C and C++. A failed CHECK
+ * prints the expression and its location and marks the test failed; the test
+ * carries on so one run reports every broken case. main() returns
+ * check_result().
+ */
+#pragma once
+
+#include <stdio.h>
+
+static int check_failures;
+
+#define CHECK(expr)                                                                   \
+    do {                                                                              \
+        if (!(expr)) {                                                                \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr);  \
+            check_failures++;                                                         \
+        }                                                                             \
+    } while (0)
+
+static inline int check_result(const char *name) {
+    if (check_failures) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, check_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Round trips of the csi_frame codec: binary frames through csi_frame_encode
+// and csi_frame_decode, text lines through csi_frame_format_text and the host
+// line parser. Every header field and the payload must come back unchanged, up
+// to the longest payload the format allows; short, truncated, bad-magic and
+// bad-version buffers must be rejected with the matching error code.
+#include <cstring>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "check.h"
+#include "csi/datagram.hpp"
+#include "csi_frame.h"
+
+namespace {
+
+csi_frame_meta_t random_meta(std::mt19937 &rng, uint16_t len) {
+    auto byte = [&] { return static_cast<uint8_t>(rng()); };
+    csi_frame_meta_t m;
+    std::memset(&m, 0, sizeof(m));
+    m.seq = static_cast<uint32_t>(rng());
+    for (uint8_t &b : m.mac) {
+        b = byte();
+    }
+    m.flags = byte() & (CSI_FRAME_FLAG_AMPLITUDE | CSI_FRAME_FLAG_RETRANSMIT);
+    m.rssi = static_cast<int8_t>(byte());
+    m.rate = byte();
+    m.sig_mode = byte();
+    m.mcs = byte();
+    m.cwb = byte();
+    m.smoothing = byte();
+    m.not_sounding = byte();
+    m.aggregation = byte();
+    m.stbc = byte();
+    m.fec_coding = byte();
+    m.sgi = byte();
+    m.noise_floor = static_cast<int8_t>(byte());
+    m.ampdu_cnt = byte();
+    m.channel = byte();
+    m.secondary_channel = byte();
+    m.ant = byte();
+    m.timestamp = static_cast<uint32_t>(rng());
+    m.sig_len = static_cast<uint16_t>(rng());
+    m.rx_state = byte();
+    m.first_word_invalid = byte();
+    m.len = len;
+    return m;
+}
+
+// Every field the text line carries; the binary header adds flags.
+bool same_text_fields(const csi_frame_meta_t &a, const csi_frame_meta_t &b) {
+    return a.seq == b.seq && std::memcmp(a.mac, b.mac, 6) == 0 && a.rssi == b.rssi && a.rate == b.rate &&
+           a.sig_mode == b.sig_mode && a.mcs == b.mcs && a.cwb == b.cwb && a.smoothing == b.smoothing &&
+           a.not_sounding == b.not_sounding && a.aggregation == b.aggregation && a.stbc == b.stbc &&
+           a.fec_coding == b.fec_coding && a.sgi == b.sgi && a.noise_floor == b.noise_floor &&
+           a.ampdu_cnt == b.ampdu_cnt && a.channel == b.channel && a.secondary_channel == b.secondary_channel &&
+           a.ant == b.ant && a.timestamp == b.timestamp && a.sig_len == b.sig_len && a.rx_state == b.rx_state &&
+           a.first_word_invalid == b.first_word_invalid && a.len == b.len;
+}
+
+void binary_round_trip(const csi_frame_meta_t &meta, const std::vector<int8_t> &payload) {
+    std::vector<uint8_t> buf(CSI_FRAME_BIN_SIZE(meta.len));
+    CHECK(csi_frame_encode(&meta, payload.data(), buf.data(), buf.size() - 1) == 0);
+    size_t n = csi_frame_encode(&meta, payload.data(), buf.data(), buf.size());
+    CHECK(n == buf.size());
+    CHECK(csi_frame_is_binary(buf.data(), n));
+
+    csi_frame_meta_t out;
+    const int8_t *data = nullptr;
+    CHECK(csi_frame_decode(buf.data(), n, &out, &data) == CSI_FRAME_OK);
+    CHECK(same_text_fields(meta, out));
+    CHECK(out.flags == meta.flags);
+    CHECK(data == reinterpret_cast<const int8_t *>(buf.data() + CSI_FRAME_HDR_SIZE));
+    CHECK(meta.len == 0 || std::memcmp(data, payload.data(), meta.len) == 0);
+
+    uint8_t mac[6];
+    CHECK(csi_frame_peek_mac(buf.data(), n, mac) == 1 && std::memcmp(mac, meta.mac, 6) == 0);
+
+    // A buffer cut anywhere short of the full frame is rejected.
+    CHECK(csi_frame_decode(buf.data(), CSI_FRAME_HDR_SIZE - 1, &out, &data) == CSI_FRAME_ERR_SHORT);
+    if (meta.len) {
+        CHECK(csi_frame_decode(buf.data(), n - 1, &out, &data) == CSI_FRAME_ERR_LENGTH);
+    }
+    std::vector<uint8_t> bad = buf;
+    bad[0] ^= 0xff;
+    CHECK(!csi_frame_is_binary(bad.data(), bad.size()));
+    CHECK(csi_frame_decode(bad.data(), bad.size(), &out, &data) == CSI_FRAME_ERR_MAGIC);
+    bad = buf;
+    bad[2] = CSI_FRAME_VERSION + 1;
+    CHECK(csi_frame_decode(bad.data(), bad.size(), &out, &data) == CSI_FRAME_ERR_VERSION);
+}
+
+void text_round_trip(const csi_frame_meta_t &meta, const std::vector<int8_t> &payload) {
+    std::vector<char> line(CSI_FRAME_TEXT_MAX(meta.len));
+    CHECK(csi_frame_format_text(&meta, payload.data(), line.data(), line.size() - 1) == 0);
+    size_t n = csi_frame_format_text(&meta, payload.data(), line.data(), line.size());
+    CHECK(n > 0 && n < line.size() && line[n - 1] == '\n' && line[n] == '\0');
+    CHECK(!csi_frame_is_binary(reinterpret_cast<const uint8_t *>(line.data()), n));
+
+    csi_frame_meta_t out;
+    std::vector<int8_t> values;
+    CHECK(csi::parse_csi_line(std::string_view(line.data(), n), out, values));
+    CHECK(same_text_fields(meta, out));
+    CHECK(values == payload);
+
+    uint8_t mac[6];
+    CHECK(csi_frame_peek_mac(reinterpret_cast<const uint8_t *>(line.data()), n, mac) == 1 &&
+          std::memcmp(mac, meta.mac, 6) == 0);
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937 rng(1);
+    const uint16_t lengths[] = {0, 1, 2, 56, 128, 256, 384, CSI_FRAME_MAX_PAYLOAD - 1, CSI_FRAME_MAX_PAYLOAD};
+    for (uint16_t len : lengths) {
+        for (int round = 0; round < 50; round++) {
+            csi_frame_meta_t meta = random_meta(rng, len);
+            std::vector<int8_t> payload(len);
+            for (int8_t &v : payload) {
+                v = static_cast<int8_t>(rng());
+            }
+            // The extremes of every signed field at least once.
+            if (round == 0) {
+                meta.rssi = meta.noise_floor = -128;
+                meta.seq = meta.timestamp = UINT32_MAX;
+                std::fill(payload.begin(), payload.end(), int8_t(-128));
+            } else if (round == 1) {
+                meta.rssi = meta.noise_floor = 127;
+                meta.seq = meta.timestamp = 0;
+                std::fill(payload.begin(), payload.end(), int8_t(127));
+            }
+            binary_round_trip(meta, payload);
+            text_round_trip(meta, payload);
+        }
+    }
+
+    // Buffers too short to hold the magic at all.
+    csi_frame_meta_t out;
+    const int8_t *data;
+    const uint8_t magic_only[2] = {CSI_FRAME_MAGIC & 0xff, CSI_FRAME_MAGIC >> 8};
+    CHECK(csi_frame_is_binary(magic_only, 2));
+    CHECK(!csi_frame_is_binary(magic_only, 1));
+    CHECK(csi_frame_decode(magic_only, 2, &out, &data) == CSI_FRAME_ERR_SHORT);
+    CHECK(csi_frame_decode(magic_only, 0, &out, &data) == CSI_FRAME_ERR_SHORT);
+
+    // A line cut right after the MAC: the comma that would follow lies past len.
+    const std::string_view cut = "CSI_DATA,7,02:00:00:00:00:01,";
+    uint8_t mac[6];
+    CHECK(csi_frame_peek_mac(reinterpret_cast<const uint8_t *>(cut.data()), cut.size(), mac) == 1);
+    CHECK(csi_frame_peek_mac(reinterpret_cast<const uint8_t *>(cut.data()), cut.size() - 1, mac) == 0);
+    return check_result("test_csi_frame");
+}
@@ -0,0 +1,222 @@
+// The node's frame history and the collector's gap tracker (csi_history.c)
+// step by step: NACK parsing and range merging, frames overwritten in the
+// arena, NACKs naming a transmitter, a resent frame passing through the delta
+// decoder without disturbing its reference, and gap splitting, retries and
+// giving up in the tracker. csi_history_sim runs them over a lossy link.
+#include <cstring>
+#include <vector>
+
+#include "check.h"
+#include "csi/datagram.hpp"
+#include "csi_delta.h"
+#include "csi_frame.h"
+#include "csi_history.h"
+
+namespace {
+
+constexpr uint16_t kPayloadLen = 128;
+const uint8_t kOther[6] = {0x3c, 0x71, 0xbf, 0x10, 0x20, 0x30};
+
+csi_frame_meta_t make_meta(uint32_t seq, uint16_t len) {
+    csi_frame_meta_t meta = {};
+    meta.seq = seq;
+    const uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+    std::memcpy(meta.mac, mac, 6);
+    meta.rssi = -50;
+    meta.channel = 6;
+    meta.timestamp = seq * 10000;
+    meta.len = len;
+    return meta;
+}
+
+std::vector<uint8_t> encode(const csi_frame_meta_t &meta, const int8_t *payload) {
+    std::vector<uint8_t> out(CSI_FRAME_BIN_SIZE(meta.len));
+    out.resize(csi_frame_encode(&meta, payload, out.data(), out.size()));
+    return out;
+}
+
+void store(csi_history_t &h, const csi_frame_meta_t &meta, const int8_t *payload) {
+    std::vector<uint8_t> frame = encode(meta, payload);
+    csi_history_store(&h, meta.seq, frame.data(), static_cast<uint16_t>(frame.size()));
+}
+
+bool request(csi_history_t &h, const char *nack) {
+    return csi_history_request(&h, nack, std::strlen(nack)) >= 0;
+}
+
+std::vector<uint32_t> drain(csi_history_t &h) {
+    std::vector<uint32_t> seqs;
+    uint32_t seq;
+    uint16_t len;
+    while (csi_history_next(&h, &seq, &len)) {
+        seqs.push_back(seq);
+    }
+    return seqs;
+}
+
+void test_history() {
+    std::vector<uint8_t> arena(4096);
+    std::vector<csi_history_slot_t> slots(64);
+    csi_history_t h;
+    CHECK(csi_history_init(&h, arena.data(), 3000, slots.data(), 64) != 0);
+    CHECK(csi_history_init(&h, arena.data(), arena.size(), slots.data(), 64) == 0);
+
+    int8_t payload[kPayloadLen] = {};
+    for (uint32_t seq = 100; seq < 120; seq++) {
+        payload[0] = static_cast<int8_t>(seq);
+        store(h, make_meta(seq, kPayloadLen), payload);
+    }
+    CHECK(!request(h, "CSI_NACK,") && !request(h, "CSI_NACK,5-3") && !request(h, "CSI_NACK,5;6") &&
+          !request(h, "CSI_SYNC,1"));
+    // Overlapping ranges are merged and each frame is resent once.
+    CHECK(request(h, "CSI_NACK,105,110-112,106\n"));
+    CHECK(request(h, "CSI_NACK,111-113"));
+    CHECK(drain(h) == std::vector<uint32_t>({105, 106, 110, 111, 112, 113}));
+    CHECK(h.resent == 6 && h.expired == 0);
+
+    // A stored frame comes back flagged as a retransmission.
+    uint32_t seq = 0;
+    uint16_t len = 0;
+    request(h, "CSI_NACK,107");
+    const uint8_t *resent = csi_history_next(&h, &seq, &len);
+    csi_frame_meta_t meta;
+    const int8_t *resent_payload = nullptr;
+    CHECK(resent && csi_frame_decode(resent, len, &meta, &resent_payload) == CSI_FRAME_OK && meta.seq == 107 &&
+          (meta.flags & CSI_FRAME_FLAG_RETRANSMIT) && resent_payload[0] == 107);
+
+    // 4096 bytes hold 24 frames of 168: the first ones are overwritten and expire.
+    for (uint32_t s = 120; s < 140; s++) {
+        store(h, make_meta(s, kPayloadLen), payload);
+    }
+    request(h, "CSI_NACK,100-139");
+    std::vector<uint32_t> seqs = drain(h);
+    CHECK(!seqs.empty() && seqs.front() > 110 && seqs.back() == 139 && h.expired > 0);
+    request(h, "CSI_NACK,4000000000-4000000002");
+    CHECK(drain(h).empty());
+}
+
+// Two transmitters numbering their frames on their own.
+void test_sources() {
+    std::vector<uint8_t> arena(4096);
+    std::vector<csi_history_slot_t> slots(64);
+    csi_history_t h;
+    CHECK(csi_history_init(&h, arena.data(), arena.size(), slots.data(), 64) == 0);
+
+    int8_t payload[kPayloadLen] = {};
+    for (uint32_t s = 140; s < 146; s++) {
+        csi_frame_meta_t m = make_meta(s, kPayloadLen);
+        payload[0] = 1;
+        store(h, m, payload);
+        std::memcpy(m.mac, kOther, 6);
+        payload[0] = 2;
+        store(h, m, payload);
+    }
+    CHECK(request(h, "CSI_NACK,24:0a:c4:00:00:01,142") && request(h, "CSI_NACK,3c:71:bf:10:20:30,142-143"));
+    CHECK(!request(h, "CSI_NACK,24:0a:c4:00:00:01") && !request(h, "CSI_NACK,24:0a:c4:00:00,1"));
+    uint32_t seq;
+    uint16_t len;
+    const uint8_t *resent;
+    csi_frame_meta_t meta;
+    const int8_t *resent_payload = nullptr;
+    int from_first = 0, from_other = 0;
+    while ((resent = csi_history_next(&h, &seq, &len))) {
+        uint8_t mac[6];
+        CHECK(csi_frame_peek_mac(resent, len, mac) &&
+              csi_frame_decode(resent, len, &meta, &resent_payload) == CSI_FRAME_OK);
+        if (std::memcmp(mac, kOther, 6) == 0 && resent_payload[0] == 2) {
+            from_other++;
+        } else if (std::memcmp(mac, kOther, 6) != 0 && resent_payload[0] == 1) {
+            from_first++;
+        }
+    }
+    CHECK(from_first == 1 && from_other == 2);
+
+    // A NACK without a transmitter means the newest one's.
+    request(h, "CSI_NACK,145");
+    resent = csi_history_next(&h, &seq, &len);
+    CHECK(resent && csi_frame_decode(resent, len, &meta, &resent_payload) == CSI_FRAME_OK &&
+          std::memcmp(meta.mac, kOther, 6) == 0);
+    char line[CSI_FRAME_TEXT_MAX(kPayloadLen)];
+    size_t line_len = csi_frame_format_text(&meta, resent_payload, line, sizeof(line));
+    uint8_t text_mac[6] = {};
+    CHECK(line_len && csi_frame_peek_mac(reinterpret_cast<const uint8_t *>(line), line_len, text_mac) &&
+          std::memcmp(text_mac, kOther, 6) == 0);
+}
+
+// A delta stream with a resent keyframe in the middle: the resent frame is not a delta reference.
+void test_delta() {
+    csi_delta_enc_t enc;
+    csi_delta_enc_init(&enc, 10);
+    csi::DatagramDecoder decoder;
+    size_t decoded = 0;
+    bool intact = true;
+    std::vector<uint8_t> delta(CSI_DELTA_ENCODED_MAX(kPayloadLen));
+    std::vector<uint8_t> old_frame;
+    for (uint32_t s = 0; s < 6; s++) {
+        int8_t p[kPayloadLen];
+        for (int i = 0; i < kPayloadLen; i++) {
+            p[i] = static_cast<int8_t>(i + s);
+        }
+        csi_frame_meta_t m = make_meta(s, kPayloadLen);
+        if (s == 1) {
+            old_frame = encode(m, p);
+            old_frame[3] |= CSI_FRAME_FLAG_RETRANSMIT;
+        }
+        m.len = static_cast<uint16_t>(csi_delta_encode(&enc, s, p, kPayloadLen, delta.data(), delta.size(), &m.flags));
+        std::vector<uint8_t> frame = encode(m, reinterpret_cast<const int8_t *>(delta.data()));
+        decoded += decoder.decode(frame.data(), frame.size(), [&](const csi::Frame &f) {
+            intact = intact && f.meta.len == kPayloadLen && std::memcmp(f.payload, p, kPayloadLen) == 0;
+        });
+        if (s == 3) {
+            decoded += decoder.decode(old_frame.data(), old_frame.size(), [&](const csi::Frame &f) {
+                intact = intact && f.meta.seq == 1 && f.payload[0] == 1;
+            });
+        }
+    }
+    CHECK(decoded == 7 && intact && decoder.delta_desync() == 0);
+}
+
+void test_tracker() {
+    csi_nack_tracker_t t;
+    csi_nack_init(&t);
+    char nack[CSI_HISTORY_NACK_MAX_LEN];
+    csi_nack_on_frame(&t, 10, 0);
+    csi_nack_on_frame(&t, 11, 0);
+    csi_nack_on_frame(&t, 20, 1000);
+    csi_nack_on_frame(&t, 25, 2000);
+    CHECK(csi_nack_outstanding(&t) == 12 && t.count == 2);
+    // Only the gaps that are due are requested.
+    CHECK(csi_nack_poll(&t, nullptr, 2000, nack, sizeof(nack)) == 0);
+    size_t n = csi_nack_poll(&t, nullptr, 1000 + CSI_NACK_DELAY_US, nack, sizeof(nack));
+    CHECK(n > 0 && std::strcmp(nack, "CSI_NACK,12-19") == 0);
+    // A resent frame splits its gap; a duplicate is ignored.
+    CHECK(csi_nack_on_frame(&t, 15, 30000) == 1 && t.count == 3);
+    CHECK(csi_nack_on_frame(&t, 15, 30000) == 0);
+    n = csi_nack_poll(&t, nullptr, 2000 + CSI_NACK_DELAY_US, nack, sizeof(nack));
+    CHECK(n > 0 && std::strcmp(nack, "CSI_NACK,21-24") == 0);
+    // Given up after the last try.
+    for (int i = 0; i < CSI_NACK_MAX_TRIES + 1; i++) {
+        csi_nack_poll(&t, nullptr, 10000000 + static_cast<uint64_t>(i) * CSI_NACK_RETRY_US, nack, sizeof(nack));
+    }
+    CHECK(t.count == 0 && t.recovered == 1 && t.abandoned == 11);
+
+    csi_nack_on_frame(&t, 40, 20000000);
+    n = csi_nack_poll(&t, kOther, 20000000 + CSI_NACK_DELAY_US, nack, sizeof(nack));
+    CHECK(n > 0 && std::strcmp(nack, "CSI_NACK,3c:71:bf:10:20:30,26-39") == 0);
+    // A gap is capped to what a node can hold; a restart drops the gaps.
+    uint64_t before = csi_nack_outstanding(&t);
+    csi_nack_on_frame(&t, 41 + 5000, 0);
+    CHECK(csi_nack_outstanding(&t) - before == CSI_NACK_MAX_SPAN);
+    csi_nack_on_frame(&t, 3, 0);
+    CHECK(t.count == 0 && t.next_seq == 4);
+}
+
+}  // namespace
+
+int main() {
+    test_history();
+    test_sources();
+    test_delta();
+    test_tracker();
+    return check_result("test_csi_history");
+}
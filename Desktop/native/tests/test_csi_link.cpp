@@ -0,0 +1,78 @@
+// Step-by-step scenarios of the reconnect state machine (csi_link.c) against
+// the fake Wi-Fi layer of csi_link_sim, with PSK and PEAP authentication: cold
+// boot, fast resume, the access point moving to another channel, an expired
+// address, re-provisioned credentials, a link lost after a fast resume and an
+// unreachable access point.
+#include <random>
+
+#include "check.h"
+#include "csi_link.h"
+#include "csi_link_fake.hpp"
+
+namespace {
+
+using csi::tools::AccessPoint;
+using csi::tools::FakeWifi;
+using csi::tools::WakeResult;
+
+void run_scenarios(bool peap) {
+    std::mt19937_64 rng(1);
+    AccessPoint ap;
+    FakeWifi wifi(ap, rng, peap);
+    csi_link_retained_t retained = {};
+    const uint32_t creds = csi_link_hash(csi_link_hash(CSI_LINK_HASH_INIT, "lab"), "secret");
+    uint32_t now_s = 1700000000;
+
+    // Cold boot: full connect with DHCP; BSSID, channel and address retained.
+    WakeResult r = wifi.wake(retained, creds, now_s);
+    CHECK(!r.fast && r.last == CSI_LINK_ACT_READY);
+    CHECK(retained.valid && retained.channel == ap.channel);
+
+    // Resume: fast, with the retained address, and counted.
+    now_s += 5;
+    r = wifi.wake(retained, creds, now_s);
+    CHECK(r.fast && !r.fell_back && r.last == CSI_LINK_ACT_SET_STATIC_IP);
+    CHECK(retained.wakes == 2 && retained.fast_ok == 1);
+
+    // The AP changed channel: full connect after the fast timeout, new channel retained.
+    ap.channel = 11;
+    now_s += 5;
+    r = wifi.wake(retained, creds, now_s);
+    CHECK(r.fast && r.fell_back && r.last == CSI_LINK_ACT_READY);
+    CHECK(r.ready_ms > CSI_LINK_FAST_TIMEOUT_MS);
+    CHECK(retained.valid && retained.channel == 11 && retained.fast_failed == 1);
+    now_s += 5;
+    r = wifi.wake(retained, creds, now_s);
+    CHECK(r.fast && !r.fell_back);
+
+    // The address expired: a full connect renews it.
+    now_s += CSI_LINK_MAX_AGE_S;
+    r = wifi.wake(retained, creds, now_s);
+    CHECK(!r.fast && r.last == CSI_LINK_ACT_READY);
+
+    // Re-provisioned credentials reset the retained state.
+    const uint32_t other = csi_link_hash(csi_link_hash(CSI_LINK_HASH_INIT, "lab"), "new-secret");
+    now_s += 5;
+    r = wifi.wake(retained, other, now_s);
+    CHECK(!r.fast && retained.wakes == 1 && retained.fast_ok == 0);
+
+    // Lost right after a fast resume: reconnect with a full connect and DHCP.
+    now_s += 5;
+    r = wifi.wake(retained, other, now_s, true);
+    CHECK(r.fast && r.last == CSI_LINK_ACT_READY);
+
+    // Unreachable AP: give up after CSI_LINK_MAX_ATTEMPTS connects.
+    ap.reachable = false;
+    now_s += 5;
+    r = wifi.wake(retained, other, now_s);
+    CHECK(r.last == CSI_LINK_ACT_GIVE_UP);
+    CHECK(r.events == CSI_LINK_MAX_ATTEMPTS + 1);
+}
+
+}  // namespace
+
+int main() {
+    run_scenarios(false);
+    run_scenarios(true);
+    return check_result("test_csi_link");
+}
@@ -0,0 +1,171 @@
+/*
+ * Threaded stress test of csi_ring. One thread stands in for the Wi-Fi CSI
+ * callback: it never waits for room, writes a frame whose length and bytes
+ * derive from its sequence number straight into the acquired slot, and counts
+ * the frames the full ring turns away. The other stands in for the sender task and
+ * checks every frame it peeks: sequence numbers strictly increasing, length
+ * and bytes intact. A small ring wraps around many times, and the 32-bit
+ * indices are started near their own wraparound.
+ *
+ * At the end every frame the producer offered is either popped or counted as
+ * an overflow, and the ring's own counters agree.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "csi_ring.h"
+
+#define SLOT_DATA   200
+#define SLOT_COUNT  8
+#define FRAMES      500000u
+
+typedef struct {
+    csi_ring_t ring;
+    _Atomic int done;
+    uint32_t offered;
+    uint32_t rejected;
+    uint32_t popped;
+    uint32_t out_of_order;
+    uint32_t corrupt;
+} shared_t;
+
+static uint16_t frame_len(uint32_t seq) {
+    return (uint16_t)(1 + (seq * 2654435761u >> 8) % SLOT_DATA);
+}
+
+static uint8_t frame_byte(uint32_t seq, size_t i) {
+    return (uint8_t)(seq * 31u + i * 7u);
+}
+
+static void *producer(void *arg) {
+    shared_t *s = (shared_t *)arg;
+    for (uint32_t seq = 0; seq < FRAMES; seq++) {
+        s->offered++;
+        uint8_t *slot = csi_ring_acquire(&s->ring);
+        if (!slot) {
+            s->rejected++;
+            sched_yield();  /* the radio paces the callback; let the consumer drain */
+            continue;
+        }
+        uint16_t len = frame_len(seq);
+        for (size_t i = 0; i < len; i++) {
+            slot[i] = frame_byte(seq, i);
+        }
+        csi_ring_commit(&s->ring, seq, len);
+    }
+    atomic_store(&s->done, 1);
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    shared_t *s = (shared_t *)arg;
+    int64_t last = -1;
+    for (;;) {
+        uint32_t seq;
+        uint16_t len;
+        const uint8_t *data = csi_ring_peek(&s->ring, &seq, &len);
+        if (!data) {
+            if (atomic_load(&s->done) && csi_ring_depth(&s->ring) == 0) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        if ((int64_t)seq <= last) {
+            s->out_of_order++;
+        }
+        last = seq;
+        if (len != frame_len(seq)) {
+            s->corrupt++;
+        } else {
+            for (size_t i = 0; i < len; i++) {
+                if (data[i] != frame_byte(seq, i)) {
+                    s->corrupt++;
+                    break;
+                }
+            }
+        }
+        s->popped++;
+        csi_ring_release(&s->ring);
+    }
+    return NULL;
+}
+
+static void test_bad_arguments(void) {
+    static uint8_t storage[CSI_RING_STORAGE_SIZE(16, 4)];
+    csi_ring_t ring;
+    CHECK(csi_ring_init(&ring, storage, 16, 3) == -1);
+    CHECK(csi_ring_init(&ring, storage, 16, 0) == -1);
+    CHECK(csi_ring_init(&ring, storage, 0, 4) == -1);
+    CHECK(csi_ring_init(&ring, NULL, 16, 4) == -1);
+    CHECK(csi_ring_init(&ring, storage, 16, 4) == 0);
+}
+
+/* Fills and drains a ring on one thread: full at slot_count, FIFO, empty after. */
+static void test_single_thread(void) {
+    static uint8_t storage[CSI_RING_STORAGE_SIZE(16, 4)];
+    csi_ring_t ring;
+    csi_ring_init(&ring, storage, 16, 4);
+    for (uint32_t round = 0; round < 5; round++) {
+        for (uint32_t i = 0; i < 4; i++) {
+            uint8_t *slot = csi_ring_acquire(&ring);
+            CHECK(slot != NULL);
+            if (slot) {
+                memset(slot, (int)i, 16);
+                csi_ring_commit(&ring, round * 4 + i, (uint16_t)(i + 1));
+            }
+        }
+        CHECK(csi_ring_acquire(&ring) == NULL);
+        CHECK(csi_ring_depth(&ring) == 4);
+        for (uint32_t i = 0; i < 4; i++) {
+            uint32_t seq;
+            uint16_t len;
+            const uint8_t *data = csi_ring_peek(&ring, &seq, &len);
+            CHECK(data && seq == round * 4 + i && len == i + 1 && data[15] == i);
+            csi_ring_release(&ring);
+        }
+        CHECK(csi_ring_peek(&ring, NULL, NULL) == NULL);
+    }
+    CHECK(atomic_load(&ring.committed) == 20);
+    CHECK(atomic_load(&ring.overflows) == 5);
+    CHECK(atomic_load(&ring.high_water) == 4);
+}
+
+static void test_threads(void) {
+    static uint8_t storage[CSI_RING_STORAGE_SIZE(SLOT_DATA, SLOT_COUNT)];
+    static shared_t s;
+    CHECK(csi_ring_init(&s.ring, storage, SLOT_DATA, SLOT_COUNT) == 0);
+    /* Indices just short of 2^32, so head and tail wrap during the run. */
+    atomic_store(&s.ring.head, UINT32_MAX - 1000);
+    atomic_store(&s.ring.tail, UINT32_MAX - 1000);
+    atomic_init(&s.done, 0);
+
+    pthread_t prod, cons;
+    pthread_create(&cons, NULL, consumer, &s);
+    pthread_create(&prod, NULL, producer, &s);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+
+    printf("offered %u  popped %u  overflow %u  high water %u of %u\n", s.offered, s.popped,
+           atomic_load(&s.ring.overflows), atomic_load(&s.ring.high_water), SLOT_COUNT);
+    CHECK(s.offered == FRAMES);
+    CHECK(s.out_of_order == 0);
+    CHECK(s.corrupt == 0);
+    CHECK(s.offered == s.popped + atomic_load(&s.ring.overflows));
+    CHECK(s.rejected == atomic_load(&s.ring.overflows));
+    CHECK(atomic_load(&s.ring.committed) == s.popped);
+    CHECK(atomic_load(&s.ring.high_water) <= SLOT_COUNT);
+    CHECK(s.popped > SLOT_COUNT * 1000u);  /* wrapped around many times */
+    CHECK(csi_ring_depth(&s.ring) == 0);
+}
+
+int main(void) {
+    test_bad_arguments();
+    test_single_thread();
+    test_threads();
+    return check_result("test_csi_ring");
+}
@@ -0,0 +1,85 @@
+/*
+ * The plan arithmetic of csi_schedule step by step: command parsing and its
+ * errors, window selection, the drift allowance of the deep sleep, the
+ * adaptive wake lead and the CSI_SCHED report round trip. csi_schedule_sim
+ * runs whole plans on simulated nodes.
+ */
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "csi_schedule.h"
+
+#define T0 (1700000000LL * 1000000)
+
+static void test_parse(void) {
+    csi_schedule_t plan = {0}, other;
+    char command[160];
+    snprintf(command, sizeof(command), "schedule,7,%" PRId64 ",60,3,start,20,dec=2", (int64_t)T0);
+    CHECK(csi_schedule_parse(command, &plan) == CSI_SCHEDULE_OK);
+    CHECK(plan.id == 7 && plan.first_start_us == T0 && plan.interval_s == 60 && plan.count == 3 &&
+          plan.duration_s == 20 && strcmp(plan.start, "start,20,dec=2") == 0);
+
+    other = plan;
+    CHECK(csi_schedule_parse("schedule,cancel", &other) == CSI_SCHEDULE_CANCEL);
+    CHECK(csi_schedule_parse("start,20", &other) == CSI_SCHEDULE_ERR_COMMAND);
+    /* Overlapping windows, an empty plan and a bad start command. */
+    snprintf(command, sizeof(command), "schedule,7,%" PRId64 ",25,3,start,20", (int64_t)T0);
+    CHECK(csi_schedule_parse(command, &other) == CSI_SCHEDULE_ERR_PLAN);
+    snprintf(command, sizeof(command), "schedule,7,%" PRId64 ",60,0,start,20", (int64_t)T0);
+    CHECK(csi_schedule_parse(command, &other) == CSI_SCHEDULE_ERR_PLAN);
+    snprintf(command, sizeof(command), "schedule,7,%" PRId64 ",60,3,start,20,dec=0", (int64_t)T0);
+    CHECK(csi_schedule_parse(command, &other) == CSI_SCHEDULE_ERR_START);
+    /* The plan is untouched on error. */
+    CHECK(other.id == 7 && other.count == 3);
+}
+
+static void test_window(void) {
+    csi_schedule_t plan = {0};
+    char command[160];
+    snprintf(command, sizeof(command), "schedule,7,%" PRId64 ",60,3,start,20", (int64_t)T0);
+    CHECK(csi_schedule_parse(command, &plan) == CSI_SCHEDULE_OK);
+
+    uint32_t index = 99;
+    int64_t start = 0;
+    CHECK(csi_schedule_window(&plan, T0 - 1000000, &index, &start) && index == 0 && start == T0);
+    /* An open window is joined; the next one is picked once it ends. */
+    CHECK(csi_schedule_window(&plan, T0 + 19000000, &index, &start) && index == 0);
+    CHECK(csi_schedule_window(&plan, T0 + 20000000, &index, &start) && index == 1 && start == T0 + 60000000);
+    CHECK(!csi_schedule_window(&plan, T0 + 140000000, &index, &start));
+}
+
+static void test_sleep_and_lead(void) {
+    /* No sleep inside the lead or shorter than the minimum; longer ones leave the drift allowance. */
+    CHECK(csi_schedule_sleep_us(T0, T0 + 1000000, 1000) == 0);
+    CHECK(csi_schedule_sleep_us(T0, T0 + 1400000, 1000) == 0);
+    CHECK(csi_schedule_sleep_us(T0, T0 + 101000000, 1000) ==
+          100000000 - 100000 * CSI_SCHEDULE_SLEEP_DRIFT_PPM / 1000);
+
+    /* The lead grows at once after a slow wake and shrinks slowly after a fast one. */
+    uint32_t lead = csi_schedule_lead_ms(0, 500);
+    CHECK(lead == CSI_SCHEDULE_MIN_LEAD_MS);
+    lead = csi_schedule_lead_ms(lead, 4000);
+    CHECK(lead == 6250);
+    CHECK(csi_schedule_lead_ms(lead, 800) > 5500);
+    CHECK(csi_schedule_lead_ms(lead, 20000) == CSI_SCHEDULE_MAX_LEAD_MS);
+}
+
+static void test_report(void) {
+    csi_schedule_report_t report = {7, 1, 3, T0 + 60000000}, parsed = {0};
+    char line[CSI_SCHEDULE_REPORT_MAX_LEN];
+    size_t len = csi_schedule_format_report(&report, line, sizeof(line));
+    CHECK(len > 0 && csi_schedule_parse_report(line, len, &parsed));
+    CHECK(parsed.id == 7 && parsed.index == 1 && parsed.count == 3 && parsed.start_us == report.start_us);
+    CHECK(!csi_schedule_parse_report("CSI_SCHED,7,4,3,0", 17, &parsed));
+}
+
+int main(void) {
+    test_parse();
+    test_window();
+    test_sleep_and_lead();
+    test_report();
+    return check_result("test_csi_schedule");
+}
@@ -0,0 +1,106 @@
+/*
+ * The src option and the source table step by step: parsing of the
+ * allowlist, which transmitters each mode captures, sequence numbers kept
+ * across two captures, and promiscuous mode filling the table and counting
+ * the rest in overflow. csi_sources_sim runs them against simulated
+ * transmitters.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "check.h"
+#include "csi_capture.h"
+#include "csi_sources.h"
+
+static const uint8_t ap_mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+
+/* Transmitter i; stations of one vendor share the OUI. */
+static void transmitter_mac(unsigned i, uint8_t mac[6]) {
+    const uint8_t station[6] = {0x3c, 0x71, 0xbf, 0x00, (uint8_t)(i >> 8), (uint8_t)i};
+    memcpy(mac, station, 6);
+}
+
+static int parse(const char *cmd, csi_capture_config_t *cfg) {
+    return csi_capture_parse_start(cmd, cfg) == CSI_CAPTURE_OK;
+}
+
+static void test_parse(void) {
+    csi_capture_config_t cfg;
+    CHECK(parse("start,10", &cfg) && cfg.source_mode == CSI_CAPTURE_SRC_AP);
+    CHECK(parse("start,10,src=any", &cfg) && cfg.source_mode == CSI_CAPTURE_SRC_ANY);
+    CHECK(parse("start,10,src=3c:71:bf:00:00:07+ap+3C:71:BF:00:00:08,rate=20", &cfg) &&
+          cfg.source_mode == CSI_CAPTURE_SRC_LIST && cfg.source_ap && cfg.source_count == 2 &&
+          cfg.sources[1][5] == 0x08 && cfg.rate_hz == 20);
+
+    /* Malformed or too long allowlists. */
+    char too_long[16 + 18 * (CSI_CAPTURE_MAX_SOURCES + 1)];
+    size_t n = (size_t)snprintf(too_long, sizeof(too_long), "start,10,src=");
+    for (unsigned i = 1; i <= CSI_CAPTURE_MAX_SOURCES + 1; i++) {
+        uint8_t mac[6];
+        transmitter_mac(i, mac);
+        n += (size_t)snprintf(too_long + n, sizeof(too_long) - n, "%s%02x:%02x:%02x:%02x:%02x:%02x", i > 1 ? "+" : "",
+                              mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+    CHECK(!parse(too_long, &cfg));
+    CHECK(!parse("start,10,src=", &cfg) && !parse("start,10,src=3c:71:bf:00:00", &cfg) &&
+          !parse("start,10,src=3c:71:bf:00:00:07+", &cfg) && !parse("start,10,src=3c-71-bf-00-00-07", &cfg));
+}
+
+static void test_table(void) {
+    csi_capture_config_t cfg;
+    csi_sources_t t;
+    csi_sources_init(&t);
+    uint8_t station[6], other[6];
+    transmitter_mac(7, station);
+    transmitter_mac(9, other);
+
+    /* The access point only by default; other transmitters are rejected. */
+    parse("start,10", &cfg);
+    csi_sources_configure(&t, &cfg, ap_mac);
+    csi_source_t *ap = csi_sources_lookup(&t, ap_mac);
+    CHECK(ap && ap->ap && csi_sources_count(&t) == 1);
+    CHECK(!csi_sources_lookup(&t, station) && csi_sources_rejected(&t) == 1);
+    if (ap) {
+        ap->seq = 500;
+    }
+
+    /* An allowlist without the access point, then with it: a source left out of a capture starts over. */
+    parse("start,10,src=3c:71:bf:00:00:07", &cfg);
+    csi_sources_configure(&t, &cfg, ap_mac);
+    CHECK(!csi_sources_lookup(&t, ap_mac) && csi_sources_lookup(&t, station) && csi_sources_count(&t) == 1);
+    parse("start,10,src=ap+3c:71:bf:00:00:07", &cfg);
+    csi_sources_configure(&t, &cfg, ap_mac);
+    ap = csi_sources_lookup(&t, ap_mac);
+    CHECK(ap && ap->seq == 0 && csi_sources_count(&t) == 2);
+
+    /* Sources still allowed keep their sequence numbers; src=any adds transmitters as they are heard. */
+    csi_source_t *s = csi_sources_lookup(&t, station);
+    CHECK(s != NULL);
+    if (s) {
+        s->seq = 42;
+    }
+    parse("start,10,src=any", &cfg);
+    csi_sources_configure(&t, &cfg, ap_mac);
+    const csi_source_t *found = csi_sources_find(&t, station);
+    CHECK(found && found->seq == 42 && !found->ap);
+    CHECK(csi_sources_lookup(&t, other) && csi_sources_find(&t, other)->seq == 0 && csi_sources_count(&t) == 3);
+
+    /* Transmitters beyond the table are counted in overflow. */
+    for (unsigned i = 10; i < 10 + CSI_SOURCES_MAX; i++) {
+        uint8_t mac[6];
+        transmitter_mac(i, mac);
+        csi_sources_lookup(&t, mac);
+    }
+    CHECK(csi_sources_count(&t) == CSI_SOURCES_MAX && csi_sources_overflow(&t) == 3 &&
+          csi_sources_rejected(&t) == 0);
+    for (unsigned i = 0; i < csi_sources_count(&t); i++) {
+        CHECK(csi_sources_find(&t, t.entries[i].mac) == &t.entries[i]);
+    }
+}
+
+int main(void) {
+    test_parse();
+    test_table();
+    return check_result("test_csi_sources");
+}
@@ -0,0 +1,227 @@
+// csi_archive_bench: read throughput of a .csia archive versus the SQLite
+// database it was converted from.
+//
+// Both passes load every frame's payload and reduce it to a checksum, which
+// must match. The archive is additionally queried with random time windows to
+// measure index lookups. --synth N first writes N synthetic frames to --db in
+// the csi_data text layout, so the benchmark can run without captured data.
+#include <sqlite3.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csi/archive.hpp"
+#include "csi/sqlite_source.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s --db PATH --archive FILE.csia [--synth FRAMES] [--len BYTES]\n"
+                 "          [--queries N] [--window-ms MS]\n",
+                 argv0);
+}
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool exec(sqlite3 *db, const char *sql) {
+    char *err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::fprintf(stderr, "sqlite: %s\n", err);
+        sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
+
+// Writes frames at 100 Hz in the column layout of the older desktop collector.
+bool synthesize(const std::string &path, unsigned frames, unsigned len) {
+    std::remove(path.c_str());
+    sqlite3 *db = nullptr;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::fprintf(stderr, "cannot create %s\n", path.c_str());
+        sqlite3_close(db);
+        return false;
+    }
+    bool ok = exec(db,
+                   "CREATE TABLE csi_data (id INTEGER PRIMARY KEY AUTOINCREMENT, timestamp TEXT, scenario TEXT,"
+                   " type TEXT, seq INTEGER, mac TEXT, rssi INTEGER, rate REAL, sig_mode INTEGER, mcs INTEGER,"
+                   " bandwidth INTEGER, smoothing INTEGER, not_sounding INTEGER, aggregation INTEGER,"
+                   " stbc INTEGER, fec_coding INTEGER, sgi INTEGER, noise_floor INTEGER, ampdu_cnt INTEGER,"
+                   " channel INTEGER, secondary_channel INTEGER, local_timestamp INTEGER, ant INTEGER,"
+                   " sig_len INTEGER, rx_state INTEGER, len INTEGER, first_word INTEGER, data TEXT);"
+                   "BEGIN;");
+    sqlite3_stmt *stmt = nullptr;
+    ok = ok && sqlite3_prepare_v2(db,
+                                  "INSERT INTO csi_data (timestamp, scenario, type, seq, mac, rssi, rate, sig_mode,"
+                                  " mcs, bandwidth, smoothing, not_sounding, aggregation, stbc, fec_coding, sgi,"
+                                  " noise_floor, ampdu_cnt, channel, secondary_channel, local_timestamp, ant,"
+                                  " sig_len, rx_state, len, first_word, data) VALUES ('synthetic', 'bench',"
+                                  " 'CSI_DATA', ?1, '02:00:00:00:00:01', ?2, 11, 1, 0, 0, 0, 0, 0, 0, 0, 0, -93,"
+                                  " 0, 6, 1, ?3, 0, 60, 0, ?4, 0, ?5)",
+                                  -1, &stmt, nullptr) == SQLITE_OK;
+    std::string data;
+    for (unsigned seq = 0; ok && seq < frames; seq++) {
+        data = "[";
+        for (unsigned i = 0; i < len; i++) {
+            data += std::to_string(static_cast<int>((seq + i * 7) % 41) - 20);
+            data += i + 1 < len ? "," : "]";
+        }
+        sqlite3_bind_int64(stmt, 1, seq);
+        sqlite3_bind_int(stmt, 2, -40 - static_cast<int>(seq % 20));
+        sqlite3_bind_int64(stmt, 3, static_cast<uint32_t>(seq * 10000u));
+        sqlite3_bind_int(stmt, 4, static_cast<int>(len));
+        sqlite3_bind_text(stmt, 5, data.c_str(), static_cast<int>(data.size()), SQLITE_STATIC);
+        ok = sqlite3_step(stmt) == SQLITE_DONE;
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    ok = ok && exec(db, "COMMIT;");
+    sqlite3_close(db);
+    return ok;
+}
+
+int64_t checksum(const int8_t *data, size_t len) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string db_path;
+    std::string archive_path;
+    unsigned synth = 0;
+    unsigned len = 128;
+    unsigned queries = 10000;
+    double window_ms = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--db") {
+            db_path = value;
+        } else if (arg == "--archive") {
+            archive_path = value;
+        } else if (arg == "--synth") {
+            synth = static_cast<unsigned>(std::atoi(value));
+        } else if (arg == "--len") {
+            len = static_cast<unsigned>(std::atoi(value));
+        } else if (arg == "--queries") {
+            queries = static_cast<unsigned>(std::atoi(value));
+        } else if (arg == "--window-ms") {
+            window_ms = std::atof(value);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (db_path.empty() || archive_path.empty() || len == 0 || len > CSI_FRAME_MAX_PAYLOAD) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    try {
+        if (synth) {
+            auto start = Clock::now();
+            if (!synthesize(db_path, synth, len)) {
+                return 1;
+            }
+            std::printf("synthesized %u frames into %s in %.2f s\n", synth, db_path.c_str(), seconds_since(start));
+        }
+
+        csi::SqliteFrameSource source(db_path);
+        uint32_t width = source.max_len();
+        {
+            csi::ArchiveWriter writer(archive_path, width);
+            csi_frame_meta_t meta;
+            std::vector<int8_t> payload;
+            double host_time = 0;
+            int64_t key = INT64_MIN;
+            while (source.next(meta, payload, host_time)) {
+                int64_t t = host_time >= 0 ? static_cast<int64_t>(host_time * 1e6) : meta.timestamp;
+                key = t > key ? t : key;
+                writer.append(meta, payload.data(), key);
+            }
+            writer.close();
+        }
+
+        // SQLite: step through every row and parse the stored payload.
+        source.rewind();
+        auto start = Clock::now();
+        csi_frame_meta_t meta;
+        std::vector<int8_t> payload;
+        double host_time = 0;
+        uint64_t sql_frames = 0;
+        uint64_t sql_bytes = 0;
+        int64_t sql_sum = 0;
+        while (source.next(meta, payload, host_time)) {
+            sql_sum += checksum(payload.data(), payload.size());
+            sql_bytes += payload.size();
+            sql_frames++;
+        }
+        double sql_s = seconds_since(start);
+
+        // Archive: map the file and walk the payload matrix row by row.
+        start = Clock::now();
+        csi::ArchiveReader reader(archive_path);
+        csi::ArchiveSlice all = reader.slice(0, reader.frames());
+        int64_t arc_sum = 0;
+        uint64_t arc_bytes = 0;
+        for (size_t r = 0; r < all.rows; r++) {
+            arc_sum += checksum(all.row(r), all.len[r]);
+            arc_bytes += all.len[r];
+        }
+        double arc_s = seconds_since(start);
+
+        // Random time windows through the sparse index.
+        std::mt19937_64 rng(42);
+        int64_t t_first = all.rows ? all.time_us[0] : 0;
+        int64_t t_last = all.rows ? all.time_us[all.rows - 1] : 0;
+        std::uniform_int_distribution<int64_t> pick(t_first, t_last > t_first ? t_last : t_first);
+        int64_t window_us = static_cast<int64_t>(window_ms * 1000);
+        uint64_t window_rows = 0;
+        start = Clock::now();
+        for (unsigned q = 0; q < queries; q++) {
+            int64_t t0 = pick(rng);
+            auto range = reader.time_range(t0, t0 + window_us);
+            window_rows += range.second - range.first;
+        }
+        double query_s = seconds_since(start);
+
+        std::printf("frames %llu, width %u, payload %.1f MiB\n", (unsigned long long)reader.frames(), width,
+                    arc_bytes / 1048576.0);
+        std::printf("sqlite  (%s): %8.3f s  %12.0f frames/s  %8.1f MiB/s\n", source.table().c_str(), sql_s,
+                    sql_frames / sql_s, sql_bytes / 1048576.0 / sql_s);
+        std::printf("archive (mmap):     %8.3f s  %12.0f frames/s  %8.1f MiB/s  (%.1fx)\n", arc_s,
+                    reader.frames() / arc_s, arc_bytes / 1048576.0 / arc_s, sql_s / arc_s);
+        std::printf("time index: %u queries of %.0f ms in %.3f ms (%.2f us/query, %.1f rows/window)\n", queries,
+                    window_ms, query_s * 1e3, queries ? query_s * 1e6 / queries : 0.0,
+                    queries ? double(window_rows) / queries : 0.0);
+        if (sql_sum != arc_sum || sql_frames != reader.frames()) {
+            std::fprintf(stderr, "checksum mismatch: sqlite %lld/%llu, archive %lld/%llu\n", (long long)sql_sum,
+                         (unsigned long long)sql_frames, (long long)arc_sum,
+                         (unsigned long long)reader.frames());
+            return 1;
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "csi_archive_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
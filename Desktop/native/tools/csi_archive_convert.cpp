@@ -0,0 +1,127 @@
+// csi_archive_convert: builds a columnar .csia archive from a collector database.
+//
+// Reads csi_frame (current desktop collector) or csi_data (older desktop
+// collector and the Android app) through SqliteFrameSource. The time key is the
+// host receive time when the layout records it; otherwise it is the node
+// timestamp, unwrapped past its 32-bit rollover per node.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "csi/archive.hpp"
+#include "csi/datagram.hpp"
+#include "csi/sqlite_source.hpp"
+
+namespace {
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s --db PATH --out FILE.csia [--session ID] [--scenario NAME]\n"
+                 "          [--width BYTES] [--block FRAMES]\n",
+                 argv0);
+}
+
+// Extends the 32-bit microsecond node clock to 64 bits.
+struct NodeClock {
+    uint32_t last = 0;
+    int64_t base = 0;
+    bool started = false;
+
+    int64_t unwrap(uint32_t ts) {
+        if (started && ts < last && last - ts > 0x80000000u) {
+            base += int64_t(1) << 32;
+        }
+        started = true;
+        last = ts;
+        return base + ts;
+    }
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string db_path;
+    std::string out_path;
+    csi::SqliteSourceFilter filter;
+    uint32_t width = 0;
+    uint32_t block = 1024;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--db") {
+            db_path = value;
+        } else if (arg == "--out") {
+            out_path = value;
+        } else if (arg == "--session") {
+            filter.session_id = std::atoll(value);
+        } else if (arg == "--scenario") {
+            filter.scenario = value;
+        } else if (arg == "--width") {
+            width = static_cast<uint32_t>(std::atoi(value));
+        } else if (arg == "--block") {
+            block = static_cast<uint32_t>(std::atoi(value));
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (db_path.empty() || out_path.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    try {
+        csi::SqliteFrameSource source(db_path, filter);
+        if (width == 0) {
+            width = source.max_len();
+        }
+        csi::ArchiveWriter writer(out_path, width, block);
+
+        csi_frame_meta_t meta;
+        std::vector<int8_t> payload;
+        double host_time = 0;
+        std::unordered_map<uint64_t, NodeClock> clocks;
+        int64_t last_key = INT64_MIN;
+        uint64_t clamped = 0;
+        uint64_t too_long = 0;
+        while (source.next(meta, payload, host_time)) {
+            if (meta.len > width) {
+                too_long++;
+                continue;
+            }
+            int64_t key = host_time >= 0 ? std::llround(host_time * 1e6)
+                                         : clocks[csi::mac_key(meta.mac)].unwrap(meta.timestamp);
+            // Host clock steps and interleaved node clocks can go backwards;
+            // the archive key must not.
+            if (key < last_key) {
+                key = last_key;
+                clamped++;
+            }
+            last_key = key;
+            writer.append(meta, payload.data(), key);
+        }
+        writer.close();
+
+        std::printf("%s: %llu frames from %s, width %u, %zu node(s)\n", out_path.c_str(),
+                    (unsigned long long)writer.frames(), source.table().c_str(), width, writer.nodes());
+        if (source.skipped() || too_long || clamped) {
+            std::printf("skipped %llu malformed and %llu oversized rows, clamped %llu time keys\n",
+                        (unsigned long long)source.skipped(), (unsigned long long)too_long,
+                        (unsigned long long)clamped);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "csi_archive_convert: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,370 @@
+// csi_clock_sim: clock synchronization and multi-node alignment on simulated
+// clocks.
+//
+// N nodes capture the same transmissions of one access point. Each node runs
+// on its own crystal: a random initial offset, a constant drift of up to
+// --drift-ppm and a random walk of --wander-ppb per second on top of it, plus
+// a radio clock (rx_ctrl.timestamp) offset from its local clock. Every node
+// runs the firmware's estimator (csi_clock.c) against a simulated collector:
+// the burst of CSI_CLOCK_BURST exchanges at start, then one every --sync-ms
+// (CSI_CLOCK_PERIOD_MS by default), over a network with --delay-us one-way
+// base delay, exponential queuing delay of mean --jitter-us and --loss
+// exchange loss. The node reports its mapping after
+// every exchange; the collector converts each frame's radio timestamp with
+// the latest mapping it has received (csi::NodeClock), as a live collector
+// would.
+//
+// Reported after the first --warmup seconds, while the estimators converge:
+// the error of the shared timestamps against the true capture time, the
+// spread of one transmission's timestamps across nodes, the same for
+// stamping frames with their arrival time at the collector, the drift error,
+// and the RMS error of a 5 Hz signal resampled onto a common grid by
+// csi::StreamAligner. Exits with status 1 if the p99 cross-node spread
+// exceeds --max-spread-us.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csi/align.hpp"
+#include "csi_clock.h"
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr int64_t kHostEpochUs = 1700000000000000;  // the collector's wall clock at true time 0
+constexpr double kSignalHz = 5.0;
+
+struct Options {
+    unsigned nodes = 3;
+    double duration_s = 120;
+    double rate_hz = 100;
+    double drift_ppm = 40;
+    double wander_ppb = 20;
+    double delay_us = 1500;
+    double jitter_us = 1000;
+    double loss = 0.05;
+    double sync_ms = CSI_CLOCK_PERIOD_MS;
+    double max_spread_us = 1000;
+    double warmup_s = 30;
+    uint64_t seed = 1;
+};
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--nodes N] [--duration S] [--rate HZ] [--drift-ppm PPM] [--wander-ppb PPB]\n"
+                 "          [--delay-us US] [--jitter-us US] [--loss FRACTION] [--sync-ms MS]\n"
+                 "          [--warmup S] [--max-spread-us US] [--seed N]\n",
+                 argv0);
+}
+
+// Local clock of one node: piecewise linear in true time, one drift per second.
+class SimClock {
+public:
+    SimClock(std::mt19937_64 &rng, const Options &opt) {
+        std::uniform_real_distribution<double> boot(2e6, 8e6), drift(-opt.drift_ppm, opt.drift_ppm);
+        std::normal_distribution<double> wander(0.0, opt.wander_ppb);
+        std::uniform_int_distribution<int32_t> radio(-5000, 5000);
+        radio_offset_ = radio(rng);
+        const size_t seconds = static_cast<size_t>(opt.duration_s) + 2;
+        double d = drift(rng) * 1e-6, at = boot(rng);
+        for (size_t s = 0; s < seconds; s++) {
+            start_.push_back(at);
+            drift_.push_back(d);
+            at += 1e6 * (1.0 + d);
+            d += wander(rng) * 1e-9;
+        }
+    }
+
+    double local(double t_us) const {
+        size_t s = std::min(static_cast<size_t>(std::max(t_us, 0.0) / 1e6), start_.size() - 1);
+        return start_[s] + (t_us - 1e6 * static_cast<double>(s)) * (1.0 + drift_[s]);
+    }
+    uint32_t radio(double t_us) const {
+        return static_cast<uint32_t>(std::llround(local(t_us)) - radio_offset_);
+    }
+    int32_t radio_offset() const { return radio_offset_; }
+    double drift_ppb(double t_us) const {
+        return drift_[std::min(static_cast<size_t>(t_us / 1e6), drift_.size() - 1)] * 1e9;
+    }
+
+private:
+    std::vector<double> start_, drift_;
+    int32_t radio_offset_;
+};
+
+int64_t host(double t_us) { return kHostEpochUs + std::llround(t_us); }
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) {
+        return 0;
+    }
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(v.size())));
+    return v[std::min(std::max<size_t>(i, 1), v.size()) - 1];
+}
+
+void print_row(const char *name, const std::vector<double> &v) {
+    std::printf("  %-28s p50 %9.1f  p99 %9.1f  max %9.1f us\n", name, percentile(v, 50), percentile(v, 99),
+                percentile(v, 100));
+}
+
+struct Frame {
+    double arrival_us;   // true time the collector reads it
+    uint32_t node;
+    size_t index;        // transmission number
+    uint32_t radio_us;
+};
+
+struct Report {
+    double arrival_us;
+    csi_clock_report_t report;
+};
+
+// Resamples the signal stamped with stamp(frame) onto the grid and returns its
+// RMS error against the true signal, with the fraction of valid grid cells.
+template <typename Stamp>
+void align_error(const std::vector<Frame> &frames, const Options &opt, const std::vector<double> &tx, Stamp stamp,
+                 double &rms, double &coverage) {
+    const int64_t period = std::llround(1e6 / opt.rate_hz);
+    csi::StreamAligner aligner(opt.nodes, 1, period, 4 * period, 500000);
+    std::vector<csi::AlignedRow> rows;
+    for (const Frame &f : frames) {
+        int64_t t;
+        if (!stamp(f, t)) {
+            continue;
+        }
+        float value = static_cast<float>(std::sin(2 * kPi * kSignalHz * tx[f.index] / 1e6));
+        aligner.add(f.node, t, &value);
+        aligner.drain(rows);
+    }
+    aligner.drain(rows, true);
+    double sum = 0;
+    size_t valid = 0, cells = 0;
+    for (const csi::AlignedRow &row : rows) {
+        const double truth = std::sin(2 * kPi * kSignalHz * static_cast<double>(row.t_us - kHostEpochUs) / 1e6);
+        for (size_t i = 0; i < opt.nodes; i++, cells++) {
+            if (row.valid[i]) {
+                const double e = row.values[i] - truth;
+                sum += e * e;
+                valid++;
+            }
+        }
+    }
+    rms = valid ? std::sqrt(sum / static_cast<double>(valid)) : 0;
+    coverage = cells ? static_cast<double>(valid) / static_cast<double>(cells) : 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--nodes") {
+            opt.nodes = static_cast<unsigned>(std::atoi(value));
+        } else if (arg == "--duration") {
+            opt.duration_s = std::atof(value);
+        } else if (arg == "--rate") {
+            opt.rate_hz = std::atof(value);
+        } else if (arg == "--drift-ppm") {
+            opt.drift_ppm = std::atof(value);
+        } else if (arg == "--wander-ppb") {
+            opt.wander_ppb = std::atof(value);
+        } else if (arg == "--delay-us") {
+            opt.delay_us = std::atof(value);
+        } else if (arg == "--jitter-us") {
+            opt.jitter_us = std::atof(value);
+        } else if (arg == "--loss") {
+            opt.loss = std::atof(value);
+        } else if (arg == "--sync-ms") {
+            opt.sync_ms = std::atof(value);
+        } else if (arg == "--warmup") {
+            opt.warmup_s = std::atof(value);
+        } else if (arg == "--max-spread-us") {
+            opt.max_spread_us = std::atof(value);
+        } else if (arg == "--seed") {
+            opt.seed = std::strtoull(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opt.nodes == 0 || opt.duration_s < opt.warmup_s + 2 || opt.rate_hz <= 0 || opt.sync_ms <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::mt19937_64 rng(opt.seed);
+    std::exponential_distribution<double> queuing(opt.jitter_us > 0 ? 1.0 / opt.jitter_us : 1e9);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    auto one_way = [&] { return opt.delay_us + queuing(rng); };
+
+    // Transmissions of the access point, shared by every node.
+    std::vector<double> tx;
+    for (double t = 0.5e6; t < opt.duration_s * 1e6; t += 1e6 / opt.rate_hz) {
+        tx.push_back(t + (unit(rng) - 0.5) * 2000);
+    }
+
+    std::vector<SimClock> clocks;
+    std::vector<Frame> frames;
+    std::vector<std::vector<Report>> reports(opt.nodes);
+    std::vector<double> drift_error;
+    uint64_t exchanges = 0, lost = 0;
+    for (uint32_t n = 0; n < opt.nodes; n++) {
+        clocks.emplace_back(rng, opt);
+        const SimClock &clk = clocks.back();
+
+        // The node's radio offset estimate: smallest (local - radio) seen by
+        // the CSI callback since the last report, as in wifi_csi_rx_cb.
+        std::vector<double> callback(tx.size());
+        for (double &c : callback) {
+            c = 15 + std::exponential_distribution<double>(1.0 / 40)(rng);
+        }
+
+        csi_clock_t sync;
+        csi_clock_init(&sync);
+        int32_t radio_offset = 0;
+        bool have_offset = false;
+        size_t next_frame = 0;
+        double t = 0;
+        for (unsigned k = 0; t < opt.duration_s * 1e6; k++) {
+            const double burst_end = (CSI_CLOCK_BURST - 1) * CSI_CLOCK_BURST_SPACING_MS * 1e3;
+            t = k < CSI_CLOCK_BURST ? k * CSI_CLOCK_BURST_SPACING_MS * 1e3
+                                    : burst_end + (k - CSI_CLOCK_BURST + 1) * opt.sync_ms * 1e3;
+            exchanges++;
+            const double up = one_way(), processing = 20 + unit(rng) * 180, down = one_way();
+            const double done = t + up + processing + down;
+            if (unit(rng) < opt.loss) {
+                lost++;
+                continue;
+            }
+            int32_t window = std::numeric_limits<int32_t>::max();
+            for (; next_frame < tx.size() && tx[next_frame] < done; next_frame++) {
+                const double at = tx[next_frame] + callback[next_frame];
+                window = std::min(window, static_cast<int32_t>(static_cast<uint32_t>(std::llround(clk.local(at))) -
+                                                               clk.radio(tx[next_frame])));
+            }
+            if (window != std::numeric_limits<int32_t>::max()) {
+                radio_offset = window;
+                have_offset = true;
+            }
+            const int64_t t1 = std::llround(clk.local(t)), t2 = host(t + up), t3 = host(t + up + processing);
+            const int64_t t4 = std::llround(clk.local(done));
+            if (!csi_clock_add_exchange(&sync, t1, t2, t3, t4) || !have_offset) {
+                continue;
+            }
+            Report r;
+            r.arrival_us = done + one_way();
+            csi_clock_make_report(&sync, radio_offset, &r.report);
+            reports[n].push_back(r);
+        }
+        if (!reports[n].empty()) {
+            // The mapping corrects the rate, so it carries the crystal error negated.
+            drift_error.push_back(std::fabs(reports[n].back().report.drift_ppb + clk.drift_ppb(opt.duration_s * 1e6)));
+        }
+
+        // Frames reach the collector in order over the node's link, after the
+        // callback and up to one batching period of queuing on the node.
+        double previous = 0;
+        for (size_t i = 0; i < tx.size(); i++) {
+            double arrival = tx[i] + callback[i] + unit(rng) * 10000 + one_way();
+            previous = std::max(previous, arrival);
+            frames.push_back(Frame{previous, n, i, clk.radio(tx[i])});
+        }
+    }
+    std::sort(frames.begin(), frames.end(),
+              [](const Frame &a, const Frame &b) { return a.arrival_us < b.arrival_us; });
+
+    // The collector side: the latest mapping received before each frame.
+    std::vector<std::vector<int64_t>> shared(opt.nodes, std::vector<int64_t>(tx.size(), INT64_MIN));
+    std::vector<std::vector<int64_t>> arrived(opt.nodes, std::vector<int64_t>(tx.size(), INT64_MIN));
+    std::vector<csi::NodeClock> node_clocks(opt.nodes);
+    std::vector<size_t> next_report(opt.nodes, 0);
+    uint64_t unmapped = 0;
+    for (const Frame &f : frames) {
+        const std::vector<Report> &r = reports[f.node];
+        for (size_t &i = next_report[f.node]; i < r.size() && r[i].arrival_us <= f.arrival_us; i++) {
+            node_clocks[f.node].update(r[i].report);
+        }
+        arrived[f.node][f.index] = host(f.arrival_us);
+        if (node_clocks[f.node].valid()) {
+            shared[f.node][f.index] = node_clocks[f.node].to_shared(f.radio_us);
+        } else {
+            unmapped++;
+        }
+    }
+
+    std::vector<double> sync_error, arrival_error, sync_spread, arrival_spread, warmup_spread;
+    for (size_t i = 0; i < tx.size(); i++) {
+        const int64_t truth = host(tx[i]);
+        int64_t lo = INT64_MAX, hi = INT64_MIN, alo = INT64_MAX, ahi = INT64_MIN;
+        bool complete = true;
+        for (uint32_t n = 0; n < opt.nodes; n++) {
+            arrival_error.push_back(static_cast<double>(arrived[n][i] - truth));
+            alo = std::min(alo, arrived[n][i]);
+            ahi = std::max(ahi, arrived[n][i]);
+            if (shared[n][i] == INT64_MIN) {
+                complete = false;
+                continue;
+            }
+            if (tx[i] >= opt.warmup_s * 1e6) {
+                sync_error.push_back(std::fabs(static_cast<double>(shared[n][i] - truth)));
+            }
+            lo = std::min(lo, shared[n][i]);
+            hi = std::max(hi, shared[n][i]);
+        }
+        arrival_spread.push_back(static_cast<double>(ahi - alo));
+        if (complete) {
+            (tx[i] < opt.warmup_s * 1e6 ? warmup_spread : sync_spread).push_back(static_cast<double>(hi - lo));
+        }
+    }
+
+    double sync_rms, sync_cover, arrival_rms, arrival_cover;
+    align_error(frames, opt, tx,
+                [&](const Frame &f, int64_t &t) {
+                    t = shared[f.node][f.index];
+                    return t != INT64_MIN;
+                },
+                sync_rms, sync_cover);
+    align_error(frames, opt, tx,
+                [&](const Frame &f, int64_t &t) {
+                    t = arrived[f.node][f.index];
+                    return true;
+                },
+                arrival_rms, arrival_cover);
+
+    std::printf("%u nodes, %.0f s at %.0f Hz, drift up to %.0f ppm + %.0f ppb/s wander, delay %.0f us + %.0f us "
+                "queuing, %.0f%% exchange loss, sync every %.0f ms\n",
+                opt.nodes, opt.duration_s, opt.rate_hz, opt.drift_ppm, opt.wander_ppb, opt.delay_us, opt.jitter_us,
+                100 * opt.loss, opt.sync_ms);
+    std::printf("  exchanges %llu (%llu lost), frames %zu, before first mapping %llu\n",
+                (unsigned long long)exchanges, (unsigned long long)lost, frames.size(), (unsigned long long)unmapped);
+    print_row("synced spread, warm-up", warmup_spread);
+    print_row("synced |error|", sync_error);
+    print_row("synced cross-node spread", sync_spread);
+    print_row("arrival error", arrival_error);
+    print_row("arrival cross-node spread", arrival_spread);
+    std::printf("  drift error at end            p50 %9.1f  max %9.1f ppb\n", percentile(drift_error, 50),
+                percentile(drift_error, 100));
+    std::printf("  aligned %.0f Hz signal RMS error: synced %.4f (%.1f%% of grid)  arrival %.4f (%.1f%% of grid)\n",
+                kSignalHz, sync_rms, 100 * sync_cover, arrival_rms, 100 * arrival_cover);
+
+    const double spread = percentile(sync_spread, 99);
+    if (sync_spread.empty() || spread > opt.max_spread_us) {
+        std::printf("FAIL: p99 cross-node spread %.1f us exceeds %.1f us\n", spread, opt.max_spread_us);
+        return 1;
+    }
+    std::printf("OK: p99 cross-node spread %.1f us within %.1f us\n", spread, opt.max_spread_us);
+    return 0;
+}
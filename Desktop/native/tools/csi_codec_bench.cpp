@@ -0,0 +1,211 @@
+// csi_codec_bench: compression ratio and speed of the csi_delta codec.
+//
+// Frames come from a collector database (--db), a .csia archive (--archive) or
+// a synthetic static link. Each node gets its own encoder, exactly as on the
+// node. Every encoded frame is wrapped in a binary csi_frame, optionally dropped
+// (--loss) to exercise resynchronization, decoded again and compared with the
+// original payload. Any mismatch makes the tool exit non-zero.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "csi/archive.hpp"
+#include "csi/datagram.hpp"
+#include "csi/sqlite_source.hpp"
+#include "csi_delta.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Trace {
+    std::vector<csi_frame_meta_t> meta;
+    std::vector<std::vector<int8_t>> payload;
+};
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--db PATH | --archive FILE.csia | --frames N] [--keyframe N]\n"
+                 "          [--loss FRACTION] [--limit N]\n",
+                 argv0);
+}
+
+// Static link: fixed channel per subcarrier, +-1..2 LSB of noise, and a
+// person walking through for a tenth of the time.
+Trace synth_trace(size_t frames) {
+    Trace t;
+    std::mt19937 rng(3);
+    std::normal_distribution<double> noise(0.0, 0.9);
+    std::vector<double> base(128);
+    for (size_t i = 0; i < base.size(); i++) {
+        base[i] = (i / 2 % 32 < 5) ? 0 : 18 * std::sin(i * 0.37);
+    }
+    for (size_t f = 0; f < frames; f++) {
+        csi_frame_meta_t meta = {};
+        meta.seq = static_cast<uint32_t>(f);
+        meta.mac[0] = 0x02;
+        meta.mac[5] = 1;
+        meta.len = static_cast<uint16_t>(base.size());
+        bool moving = f % 1000 >= 900;
+        std::vector<int8_t> p(base.size());
+        for (size_t i = 0; i < p.size(); i++) {
+            double v = base[i] + noise(rng) + (moving ? 6 * std::sin(f * 0.2 + i * 0.1) : 0);
+            p[i] = static_cast<int8_t>(std::max(-128.0, std::min(127.0, std::round(v))));
+        }
+        t.meta.push_back(meta);
+        t.payload.push_back(std::move(p));
+    }
+    return t;
+}
+
+Trace load_db(const std::string &path, size_t limit) {
+    Trace t;
+    csi::SqliteFrameSource source(path);
+    csi_frame_meta_t meta;
+    std::vector<int8_t> payload;
+    double host_time = 0;
+    while (t.meta.size() < limit && source.next(meta, payload, host_time)) {
+        t.meta.push_back(meta);
+        t.payload.push_back(payload);
+    }
+    return t;
+}
+
+Trace load_archive(const std::string &path, size_t limit) {
+    Trace t;
+    csi::ArchiveReader reader(path);
+    csi::ArchiveSlice s = reader.slice(0, limit);
+    for (size_t r = 0; r < s.rows; r++) {
+        csi_frame_meta_t meta = {};
+        meta.seq = s.seq[r];
+        std::memcpy(meta.mac, reader.nodes()[s.node[r]].data(), 6);
+        meta.rssi = s.rssi[r];
+        meta.noise_floor = s.noise[r];
+        meta.channel = s.channel[r];
+        meta.timestamp = s.local_ts[r];
+        meta.len = s.len[r];
+        t.meta.push_back(meta);
+        t.payload.emplace_back(s.row(r), s.row(r) + s.len[r]);
+    }
+    return t;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string db_path;
+    std::string archive_path;
+    size_t frames = 100000;
+    size_t limit = SIZE_MAX;
+    unsigned keyframe = 50;
+    double loss = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--db") {
+            db_path = value;
+        } else if (arg == "--archive") {
+            archive_path = value;
+        } else if (arg == "--frames") {
+            frames = static_cast<size_t>(std::atoll(value));
+        } else if (arg == "--limit") {
+            limit = static_cast<size_t>(std::atoll(value));
+        } else if (arg == "--keyframe") {
+            keyframe = static_cast<unsigned>(std::atoi(value));
+        } else if (arg == "--loss") {
+            loss = std::atof(value);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    try {
+        Trace trace = !db_path.empty()        ? load_db(db_path, limit)
+                      : !archive_path.empty() ? load_archive(archive_path, limit)
+                                              : synth_trace(frames);
+        size_t n = trace.meta.size();
+
+        // Encode pass, timed on its own.
+        std::unordered_map<uint64_t, std::unique_ptr<csi_delta_enc_t>> encoders;
+        std::vector<std::vector<uint8_t>> wire(n);
+        std::vector<uint8_t> body(CSI_DELTA_ENCODED_MAX(CSI_FRAME_MAX_PAYLOAD));
+        uint64_t raw_bytes = 0, enc_bytes = 0, keyframes = 0;
+        double encode_s = 0;
+        for (size_t f = 0; f < n; f++) {
+            csi_frame_meta_t meta = trace.meta[f];
+            auto &enc = encoders[csi::mac_key(meta.mac)];
+            if (!enc) {
+                enc = std::make_unique<csi_delta_enc_t>();
+                csi_delta_enc_init(enc.get(), static_cast<uint16_t>(keyframe));
+            }
+            auto start = Clock::now();
+            size_t len = csi_delta_encode(enc.get(), meta.seq, trace.payload[f].data(), meta.len, body.data(),
+                                          body.size(), &meta.flags);
+            encode_s += std::chrono::duration<double>(Clock::now() - start).count();
+            keyframes += !(meta.flags & CSI_FRAME_FLAG_DELTA);
+            raw_bytes += trace.meta[f].len;
+            enc_bytes += len;
+            meta.len = static_cast<uint16_t>(len);
+            wire[f].resize(CSI_FRAME_BIN_SIZE(len));
+            csi_frame_encode(&meta, reinterpret_cast<const int8_t *>(body.data()), wire[f].data(), wire[f].size());
+        }
+
+        // Decode pass through the same DatagramDecoder the ingest daemon uses.
+        std::mt19937 rng(11);
+        std::bernoulli_distribution drop(loss);
+        csi::DatagramDecoder decoder;
+        uint64_t sent = 0, lost = 0, delivered = 0, mismatched = 0;
+        double decode_s = 0;
+        for (size_t f = 0; f < n; f++) {
+            if (loss > 0 && drop(rng)) {
+                lost++;
+                continue;
+            }
+            sent++;
+            auto start = Clock::now();
+            decoder.decode(wire[f].data(), wire[f].size(), [&](const csi::Frame &frame) {
+                decode_s += std::chrono::duration<double>(Clock::now() - start).count();
+                delivered++;
+                const std::vector<int8_t> &orig = trace.payload[f];
+                if (frame.meta.len != orig.size() || frame.meta.seq != trace.meta[f].seq ||
+                    std::memcmp(frame.payload, orig.data(), orig.size()) != 0) {
+                    mismatched++;
+                }
+            });
+        }
+
+        uint64_t wire_raw = raw_bytes + n * CSI_FRAME_HDR_SIZE;
+        uint64_t wire_enc = enc_bytes + n * CSI_FRAME_HDR_SIZE;
+        std::printf("%zu frames from %zu node(s), keyframe interval %u, %llu keyframes\n", n, encoders.size(),
+                    keyframe, (unsigned long long)keyframes);
+        std::printf("payload ratio %.2f (%.1f -> %.1f bytes/frame), on the wire %.2f with the %d-byte header\n",
+                    enc_bytes ? double(raw_bytes) / enc_bytes : 0.0, n ? double(raw_bytes) / n : 0.0,
+                    n ? double(enc_bytes) / n : 0.0, wire_enc ? double(wire_raw) / wire_enc : 0.0,
+                    CSI_FRAME_HDR_SIZE);
+        std::printf("encode %.0f ns/frame, decode %.0f ns/frame (host)\n", n ? encode_s * 1e9 / n : 0.0,
+                    delivered ? decode_s * 1e9 / delivered : 0.0);
+        std::printf("sent %llu, dropped %llu, decoded %llu, skipped until keyframe %llu, mismatched %llu\n",
+                    (unsigned long long)sent, (unsigned long long)lost, (unsigned long long)delivered,
+                    (unsigned long long)decoder.delta_desync(), (unsigned long long)mismatched);
+        if (mismatched || decoder.malformed() || delivered + decoder.delta_desync() != sent) {
+            std::fprintf(stderr, "csi_codec_bench: round trip failed\n");
+            return 1;
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "csi_codec_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,217 @@
+// csi_dsp_bench: correctness check and throughput of the amplitude/phase kernels.
+//
+// Every ISA the CPU supports is first checked against a double-precision
+// reference (std::hypot, std::atan2, textbook unwrap and least squares); any
+// mismatch makes the tool exit non-zero. Then each ISA is timed on a single
+// core, so the frames/s figures are per core. Input is synthetic LLTF frames
+// or the payload matrix of a .csia archive.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csi/archive.hpp"
+#include "csi/dsp.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using csi::dsp::Isa;
+
+constexpr double kTwoPi = 6.283185307179586;
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--frames N] [--pairs 64|128] [--archive FILE.csia]\n"
+                 "          [--isa all|scalar|sse2|avx2] [--repeat N]\n",
+                 argv0);
+}
+
+// Quantized channel response: smooth amplitude profile, random timing slope
+// and carrier offset per frame, a little noise, guard subcarriers left at zero.
+std::vector<int8_t> synth_frames(size_t frames, size_t pairs) {
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 0.8);
+    std::uniform_real_distribution<double> uni(-1.0, 1.0);
+    csi::dsp::SubcarrierMask valid = csi::dsp::SubcarrierMask::lltf(pairs);
+    std::vector<int8_t> out(frames * pairs * 2, 0);
+    for (size_t f = 0; f < frames; f++) {
+        double slope = 0.3 * uni(rng);
+        double offset = M_PI * uni(rng);
+        int8_t *row = out.data() + f * pairs * 2;
+        for (size_t i = 0; i < valid.size(); i++) {
+            int k = valid.subcarrier[i];
+            double mag = 20 + 8 * std::cos(k * 0.11 + f * 0.01);
+            double ph = slope * k + offset;
+            row[2 * valid.index[i]] = static_cast<int8_t>(std::lround(mag * std::sin(ph) + noise(rng)));
+            row[2 * valid.index[i] + 1] = static_cast<int8_t>(std::lround(mag * std::cos(ph) + noise(rng)));
+        }
+    }
+    return out;
+}
+
+// Returns false if a step between neighbours is so close to pi that float and
+// double rounding may legitimately unwrap it in opposite directions.
+bool reference_sanitize(const float *raw, const int16_t *k, size_t n, std::vector<double> &out) {
+    out.assign(raw, raw + n);
+    double offset = 0;
+    bool clear = true;
+    for (size_t i = 1; i < n; i++) {
+        double d = double(raw[i]) - raw[i - 1];
+        clear = clear && std::fabs(std::fabs(d) - M_PI) > 1e-4;
+        offset -= kTwoPi * std::nearbyint(d / kTwoPi);
+        out[i] = raw[i] + offset;
+    }
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < n; i++) {
+        sx += k[i];
+        sy += out[i];
+        sxx += double(k[i]) * k[i];
+        sxy += k[i] * out[i];
+    }
+    double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    double offset_b = (sy - slope * sx) / n;
+    for (size_t i = 0; i < n; i++) {
+        out[i] -= slope * k[i] + offset_b;
+    }
+    return clear;
+}
+
+// Returns the number of values outside tolerance and prints the worst errors.
+size_t verify(Isa isa, const std::vector<int8_t> &data, size_t frames, size_t stride,
+              const csi::dsp::SubcarrierMask &mask) {
+    csi::dsp::Extractor ex(mask, isa);
+    size_t width = ex.width();
+    std::vector<float> amp(frames * width), raw(frames * width), clean(frames * width);
+    ex.run(data.data(), frames, stride, amp.data(), raw.data(), false);
+    ex.run(data.data(), frames, stride, nullptr, clean.data(), true);
+
+    double amp_err = 0, phase_err = 0, clean_err = 0;
+    size_t bad = 0;
+    size_t ambiguous = 0;
+    std::vector<double> expect;
+    for (size_t f = 0; f < frames; f++) {
+        const int8_t *row = data.data() + f * stride;
+        for (size_t i = 0; i < width; i++) {
+            double im = row[2 * mask.index[i]];
+            double re = row[2 * mask.index[i] + 1];
+            double e_amp = std::fabs(amp[f * width + i] - std::hypot(re, im));
+            double e_ph = std::remainder(raw[f * width + i] - std::atan2(im, re), kTwoPi);
+            amp_err = std::max(amp_err, e_amp);
+            phase_err = std::max(phase_err, std::fabs(e_ph));
+            bad += e_amp > 1e-4 || std::fabs(e_ph) > 2e-5;
+        }
+        if (!reference_sanitize(&raw[f * width], mask.subcarrier.data(), width, expect)) {
+            ambiguous++;
+            continue;
+        }
+        for (size_t i = 0; i < width; i++) {
+            double e = std::fabs(clean[f * width + i] - expect[i]);
+            clean_err = std::max(clean_err, e);
+            bad += e > 1e-3;
+        }
+    }
+    std::printf("  %-6s max error: amplitude %.2e  phase %.2e rad  sanitized %.2e rad (%zu ambiguous rows)  -> %s\n",
+                csi::dsp::isa_name(isa), amp_err, phase_err, clean_err, ambiguous, bad ? "FAIL" : "ok");
+    return bad;
+}
+
+double bench(Isa isa, const std::vector<int8_t> &data, size_t frames, size_t stride,
+             const csi::dsp::SubcarrierMask &mask, unsigned repeat, bool amp, bool phase, bool sanitize) {
+    csi::dsp::Extractor ex(mask, isa);
+    std::vector<float> a(amp ? frames * ex.width() : 0), p(phase ? frames * ex.width() : 0);
+    auto start = Clock::now();
+    for (unsigned r = 0; r < repeat; r++) {
+        ex.run(data.data(), frames, stride, amp ? a.data() : nullptr, phase ? p.data() : nullptr, sanitize);
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    return frames * double(repeat) / secs;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    size_t frames = 100000;
+    size_t pairs = 64;
+    std::string archive;
+    std::string isa_arg = "all";
+    unsigned repeat = 5;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--frames") {
+            frames = static_cast<size_t>(std::atoll(value));
+        } else if (arg == "--pairs") {
+            pairs = static_cast<size_t>(std::atoi(value));
+        } else if (arg == "--archive") {
+            archive = value;
+        } else if (arg == "--isa") {
+            isa_arg = value;
+        } else if (arg == "--repeat") {
+            repeat = static_cast<unsigned>(std::atoi(value));
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Isa> isas;
+    for (Isa isa : {Isa::Scalar, Isa::Sse2, Isa::Avx2}) {
+        if ((isa_arg == "all" || isa_arg == csi::dsp::isa_name(isa)) && csi::dsp::isa_supported(isa)) {
+            isas.push_back(isa);
+        }
+    }
+    if (isas.empty() || repeat == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    try {
+        std::vector<int8_t> data;
+        size_t stride = pairs * 2;
+        if (!archive.empty()) {
+            csi::ArchiveReader reader(archive);
+            csi::ArchiveSlice all = reader.slice(0, reader.frames());
+            frames = all.rows;
+            stride = all.width;
+            pairs = stride / 2;
+            data.assign(all.payload, all.payload + frames * stride);
+        } else {
+            data = synth_frames(frames, pairs);
+        }
+        csi::dsp::SubcarrierMask mask = csi::dsp::SubcarrierMask::lltf(pairs);
+        std::printf("%zu frames, %zu pairs/frame, %zu masked subcarriers, best ISA %s\n", frames, pairs,
+                    mask.size(), csi::dsp::isa_name(csi::dsp::best_isa()));
+
+        size_t bad = 0;
+        for (Isa isa : isas) {
+            bad += verify(isa, data, frames, stride, mask);
+        }
+
+        std::printf("  %-6s %14s %14s %14s %14s   (frames/s, 1 core)\n", "isa", "amplitude", "phase", "sanitized",
+                    "all");
+        for (Isa isa : isas) {
+            std::printf("  %-6s %14.0f %14.0f %14.0f %14.0f\n", csi::dsp::isa_name(isa),
+                        bench(isa, data, frames, stride, mask, repeat, true, false, false),
+                        bench(isa, data, frames, stride, mask, repeat, false, true, false),
+                        bench(isa, data, frames, stride, mask, repeat, false, true, true),
+                        bench(isa, data, frames, stride, mask, repeat, true, true, true));
+        }
+        if (bad) {
+            std::fprintf(stderr, "csi_dsp_bench: %zu values outside tolerance\n", bad);
+            return 1;
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "csi_dsp_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,460 @@
+// csi_e2e_bench: end-to-end benchmark of a collector, from the wire to disk.
+//
+// Plays a LoadProfile (see csi_replay) towards the collector under test and
+// watches what it persists, either the csi_frame table of its SQLite database
+// (--db, the desktop collector and csi_listener.py) or the per-node .csilog
+// files of csi_ingestd (--csilog). The collector can be started by the bench
+// itself (--sut "command"), which is then stopped with SIGINT at the end.
+//
+// Reported: offered and persisted frames/s, frames never persisted, drops
+// inferred from sequence gaps (minus the losses injected by the profile), and
+// capture-to-disk latency percentiles. A frame's capture time is its scheduled
+// send time; it reaches disk when a poll (--poll-ms) first sees it, so the
+// latency includes up to one poll interval.
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sqlite3.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "csi/ingest.hpp"
+#include "csi/loadgen.hpp"
+#include "load_options.hpp"
+
+namespace {
+
+struct Observation {
+    uint32_t source;  // node address, network byte order; 0 if not recorded
+    uint8_t mac[6];
+    uint32_t seq;
+    uint64_t seen_ns;
+};
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s (--db PATH | --csilog DIR) [--sut COMMAND] [--host ADDR] [--port N]\n"
+                 "          [--warmup SECONDS] [--settle SECONDS] [--poll-ms MS]\n%s",
+                 argv0, csi::tools::kLoadOptionsUsage);
+}
+
+uint64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Something that reports the frames a collector has persisted since the last call.
+class DiskWatcher {
+public:
+    virtual ~DiskWatcher() = default;
+    // Skips whatever is already on disk before the run.
+    virtual void baseline() = 0;
+    virtual void poll(std::vector<Observation> &out, uint64_t now_ns) = 0;
+};
+
+// New rows of the csi_frame table written by csi_store.SessionWriter.
+class SqliteWatcher : public DiskWatcher {
+public:
+    explicit SqliteWatcher(std::string path) : path_(std::move(path)) {}
+
+    ~SqliteWatcher() override {
+        sqlite3_finalize(stmt_);
+        sqlite3_close(db_);
+    }
+
+    void baseline() override {
+        if (!open()) {
+            return;
+        }
+        sqlite3_stmt *max_id = nullptr;
+        if (sqlite3_prepare_v2(db_, "SELECT COALESCE(MAX(id), 0) FROM csi_frame", -1, &max_id, nullptr) == SQLITE_OK &&
+            sqlite3_step(max_id) == SQLITE_ROW) {
+            last_id_ = sqlite3_column_int64(max_id, 0);
+        }
+        sqlite3_finalize(max_id);
+    }
+
+    void poll(std::vector<Observation> &out, uint64_t now_ns) override {
+        if (!open()) {
+            return;
+        }
+        sqlite3_bind_int64(stmt_, 1, last_id_);
+        while (sqlite3_step(stmt_) == SQLITE_ROW) {
+            last_id_ = sqlite3_column_int64(stmt_, 0);
+            Observation obs;
+            const char *node = reinterpret_cast<const char *>(sqlite3_column_text(stmt_, 3));
+            struct in_addr addr = {};
+            obs.source = node && inet_pton(AF_INET, node, &addr) == 1 ? addr.s_addr : 0;
+            unsigned v[6];
+            const char *mac = reinterpret_cast<const char *>(sqlite3_column_text(stmt_, 1));
+            if (!mac || std::sscanf(mac, "%2x:%2x:%2x:%2x:%2x:%2x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6) {
+                continue;
+            }
+            for (int i = 0; i < 6; i++) {
+                obs.mac[i] = static_cast<uint8_t>(v[i]);
+            }
+            obs.seq = static_cast<uint32_t>(sqlite3_column_int64(stmt_, 2));
+            obs.seen_ns = now_ns;
+            out.push_back(obs);
+        }
+        sqlite3_reset(stmt_);
+    }
+
+private:
+    // The collector may create the database only once it starts.
+    bool open() {
+        if (stmt_) {
+            return true;
+        }
+        if (!db_ && sqlite3_open_v2(path_.c_str(), &db_, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            sqlite3_close(db_);
+            db_ = nullptr;
+            return false;
+        }
+        sqlite3_busy_timeout(db_, 100);
+        if (sqlite3_prepare_v2(db_,
+                               "SELECT f.id, f.mac, f.seq, s.node FROM csi_frame f "
+                               "LEFT JOIN csi_session s ON s.id = f.session_id WHERE f.id > ? ORDER BY f.id",
+                               -1, &stmt_, nullptr) != SQLITE_OK) {
+            stmt_ = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    std::string path_;
+    sqlite3 *db_ = nullptr;
+    sqlite3_stmt *stmt_ = nullptr;
+    int64_t last_id_ = 0;
+};
+
+// Records appended to the .csilog files of csi_ingestd (csi/ingest.hpp).
+class CsilogWatcher : public DiskWatcher {
+public:
+    explicit CsilogWatcher(std::string dir) : dir_(std::move(dir)) {}
+
+    ~CsilogWatcher() override {
+        for (auto &entry : files_) {
+            std::fclose(entry.second.file);
+        }
+    }
+
+    void baseline() override {
+        for_each_log([&](const std::string &path) {
+            Tail &t = tail(path);
+            if (t.file) {
+                std::fseek(t.file, 0, SEEK_END);
+                t.offset = std::ftell(t.file);
+            }
+        });
+    }
+
+    void poll(std::vector<Observation> &out, uint64_t now_ns) override {
+        for_each_log([&](const std::string &path) {
+            Tail &t = tail(path);
+            if (!t.file) {
+                return;
+            }
+            if (t.offset == 0) {
+                t.offset = sizeof(csi::kCsiLogMagic);
+            }
+            uint8_t len_le[4];
+            while (true) {
+                std::clearerr(t.file);
+                std::fseek(t.file, t.offset, SEEK_SET);
+                if (std::fread(len_le, 1, 4, t.file) != 4) {
+                    break;
+                }
+                uint32_t len = len_le[0] | len_le[1] << 8 | len_le[2] << 16 | static_cast<uint32_t>(len_le[3]) << 24;
+                record_.resize(len);
+                if (len < csi::kFeedRecordHeader || std::fread(record_.data(), 1, len, t.file) != len) {
+                    break;  // partially written record: retry on the next poll
+                }
+                t.offset += 4 + static_cast<long>(len);
+                csi_frame_meta_t meta;
+                const int8_t *payload;
+                if (csi_frame_decode(record_.data() + csi::kFeedRecordHeader, len - csi::kFeedRecordHeader, &meta,
+                                     &payload) != CSI_FRAME_OK) {
+                    continue;
+                }
+                Observation obs;
+                std::memcpy(&obs.source, record_.data() + csi::kFeedRecordSource, sizeof(obs.source));
+                std::memcpy(obs.mac, meta.mac, 6);
+                obs.seq = meta.seq;
+                obs.seen_ns = now_ns;
+                out.push_back(obs);
+            }
+        });
+    }
+
+private:
+    struct Tail {
+        std::FILE *file = nullptr;
+        long offset = 0;
+    };
+
+    template <typename Fn>
+    void for_each_log(Fn fn) {
+        DIR *d = opendir(dir_.c_str());
+        if (!d) {
+            return;
+        }
+        while (struct dirent *e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name.size() > 7 && name.compare(name.size() - 7, 7, ".csilog") == 0) {
+                fn(dir_ + "/" + name);
+            }
+        }
+        closedir(d);
+    }
+
+    Tail &tail(const std::string &path) {
+        Tail &t = files_[path];
+        if (!t.file) {
+            t.file = std::fopen(path.c_str(), "rb");
+        }
+        return t;
+    }
+
+    std::string dir_;
+    std::unordered_map<std::string, Tail> files_;
+    std::vector<uint8_t> record_;
+};
+
+pid_t start_sut(const std::string &command) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        setpgid(0, 0);
+        execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr));
+        _exit(127);
+    }
+    if (pid > 0) {
+        setpgid(pid, pid);
+    }
+    return pid;
+}
+
+void stop_sut(pid_t pid) {
+    kill(-pid, SIGINT);
+    for (int i = 0; i < 100; i++) {
+        if (waitpid(pid, nullptr, WNOHANG) == pid) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    std::fprintf(stderr, "csi_e2e_bench: collector ignored SIGINT, killing it\n");
+    kill(-pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+double percentile(const std::vector<uint64_t> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t idx = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)] / 1e6;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string host = "127.0.0.1";
+    uint16_t port = 50001;
+    std::string db_path, csilog_dir, sut;
+    double warmup_s = 1.0, settle_s = 2.0;
+    int poll_ms = 2;
+    csi::tools::LoadOptions load;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--host") {
+            host = value;
+        } else if (arg == "--port") {
+            port = static_cast<uint16_t>(std::atoi(value));
+        } else if (arg == "--db") {
+            db_path = value;
+        } else if (arg == "--csilog") {
+            csilog_dir = value;
+        } else if (arg == "--sut") {
+            sut = value;
+        } else if (arg == "--warmup") {
+            warmup_s = std::atof(value);
+        } else if (arg == "--settle") {
+            settle_s = std::atof(value);
+        } else if (arg == "--poll-ms") {
+            poll_ms = std::max(1, std::atoi(value));
+        } else if (!csi::tools::parse_load_option(arg, value, load)) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (db_path.empty() == csilog_dir.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::unique_ptr<DiskWatcher> watcher;
+    if (!db_path.empty()) {
+        watcher = std::make_unique<SqliteWatcher>(db_path);
+    } else {
+        watcher = std::make_unique<CsilogWatcher>(csilog_dir);
+    }
+
+    pid_t sut_pid = -1;
+    int rc = 0;
+    try {
+        csi::LoadGenerator gen(load.profile(), load.templates());
+        const csi::LoadProfile &profile = gen.profile();
+        gen.connect(host, port);
+        watcher->baseline();
+        if (!sut.empty()) {
+            sut_pid = start_sut(sut);
+            if (sut_pid < 0) {
+                std::perror("fork");
+                return 1;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(warmup_s));
+
+        // Expected frames per node, for the sequence accounting.
+        uint64_t expected = 0;
+        std::vector<std::vector<int64_t>> index(profile.nodes, std::vector<int64_t>(profile.frames, -1));
+        const auto &schedule = gen.schedule();
+        for (size_t i = 0; i < schedule.size(); i++) {
+            index[schedule[i].node][schedule[i].seq] = static_cast<int64_t>(i);
+            expected += schedule[i].lost ? 0 : 1;
+        }
+
+        std::atomic<bool> sending{true};
+        std::atomic<uint64_t> last_new_ns{0};
+        std::vector<Observation> seen;
+        std::thread observer([&] {
+            std::vector<Observation> batch;
+            uint64_t quiet_since = 0;
+            while (true) {
+                uint64_t now = realtime_ns();
+                batch.clear();
+                watcher->poll(batch, now);
+                if (!batch.empty()) {
+                    seen.insert(seen.end(), batch.begin(), batch.end());
+                    last_new_ns = now;
+                }
+                if (!sending.load()) {
+                    quiet_since = std::max(quiet_since, last_new_ns.load());
+                    if (seen.size() >= expected || now - quiet_since > static_cast<uint64_t>(settle_s * 1e9)) {
+                        break;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(poll_ms));
+            }
+        });
+
+        csi::LoadResult sent = gen.run();
+        last_new_ns = std::max(last_new_ns.load(), realtime_ns());
+        sending = false;
+        observer.join();
+        if (sut_pid > 0) {
+            // Whatever the collector flushes on its way out still counts, late.
+            stop_sut(sut_pid);
+            sut_pid = -1;
+            watcher->poll(seen, realtime_ns());
+        }
+
+        // Match what reached disk against the schedule.
+        std::vector<uint8_t> persisted(schedule.size(), 0);
+        std::vector<uint64_t> latency;
+        latency.reserve(seen.size());
+        uint64_t duplicates = 0, foreign = 0, last_seen = 0;
+        std::vector<std::vector<uint32_t>> seqs(profile.nodes);
+        for (const Observation &obs : seen) {
+            long found = gen.node_of(obs.source, obs.mac);
+            if (found < 0) {
+                foreign++;
+                continue;
+            }
+            uint32_t node = static_cast<uint32_t>(found);
+            if (obs.seq >= profile.frames || index[node][obs.seq] < 0) {
+                foreign++;
+                continue;
+            }
+            size_t i = static_cast<size_t>(index[node][obs.seq]);
+            if (persisted[i]) {
+                duplicates++;
+                continue;
+            }
+            persisted[i] = 1;
+            seqs[node].push_back(obs.seq);
+            uint64_t capture_ns = sent.start_ns + schedule[i].at_ns;
+            latency.push_back(obs.seen_ns > capture_ns ? obs.seen_ns - capture_ns : 0);
+            last_seen = std::max(last_seen, obs.seen_ns);
+        }
+
+        // Gaps inside each node's persisted range, as a collector would count them.
+        uint64_t gaps = 0, injected_in_gaps = 0;
+        for (uint32_t node = 0; node < profile.nodes; node++) {
+            auto &s = seqs[node];
+            if (s.empty()) {
+                continue;
+            }
+            std::sort(s.begin(), s.end());
+            gaps += (s.back() - s.front() + 1) - s.size();
+            for (uint32_t seq = s.front(); seq <= s.back(); seq++) {
+                injected_in_gaps += schedule[static_cast<size_t>(index[node][seq])].lost ? 1 : 0;
+            }
+        }
+
+        uint64_t persisted_count = latency.size();
+        uint64_t missing = sent.frames_sent - std::min<uint64_t>(sent.frames_sent, persisted_count);
+        double wall_s = last_seen > sent.start_ns ? (last_seen - sent.start_ns) / 1e9 : sent.elapsed_s;
+        std::sort(latency.begin(), latency.end());
+
+        std::printf("profile: %u nodes x %u frames at %.1f Hz, %s, jitter %.0f us, burst %u, loss %.3f (run %.1f), seed %llu\n",
+                    profile.nodes, profile.frames, profile.rate_hz, csi::wire_format_name(profile.format),
+                    profile.jitter_us, profile.burst, profile.loss, profile.loss_burst,
+                    (unsigned long long)profile.seed);
+        std::printf("offered  %llu frames in %llu datagrams over %.3f s (%.0f frames/s), injected loss %llu, "
+                    "send errors %llu\n",
+                    (unsigned long long)sent.frames_sent, (unsigned long long)sent.datagrams, sent.elapsed_s,
+                    sent.elapsed_s > 0 ? sent.frames_sent / sent.elapsed_s : 0.0,
+                    (unsigned long long)sent.frames_lost, (unsigned long long)sent.send_errors);
+        std::printf("persisted %llu frames (%.0f frames/s), missing %llu (%.3f%%), duplicates %llu, foreign %llu\n",
+                    (unsigned long long)persisted_count, wall_s > 0 ? persisted_count / wall_s : 0.0,
+                    (unsigned long long)missing, sent.frames_sent ? 100.0 * missing / sent.frames_sent : 0.0,
+                    (unsigned long long)duplicates, (unsigned long long)foreign);
+        std::printf("sequence gaps %llu: %llu injected, %llu dropped by the collector (%.3f%%)\n",
+                    (unsigned long long)gaps, (unsigned long long)injected_in_gaps,
+                    (unsigned long long)(gaps - injected_in_gaps),
+                    persisted_count + gaps ? 100.0 * (gaps - injected_in_gaps) / (persisted_count + gaps) : 0.0);
+        std::printf("capture-to-disk latency ms: p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n",
+                    percentile(latency, 50), percentile(latency, 90), percentile(latency, 99),
+                    percentile(latency, 99.9), percentile(latency, 100));
+        rc = persisted_count > 0 ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "csi_e2e_bench: %s\n", e.what());
+        rc = 1;
+    }
+    if (sut_pid > 0) {
+        stop_sut(sut_pid);
+    }
+    return rc;
+}
@@ -0,0 +1,671 @@
+// csi_feature_bench: correctness, latency and throughput of the streaming
+// feature pipeline (csi/features.hpp).
+//
+// A recorded session (--db, the csi_data or csi_frame table) is loaded into
+// memory and fed to the pipeline frame by frame, in row order, as a collector
+// would deliver it. Frame times are the host receive times when the table
+// records them, otherwise the receiver's timestamps, unwrapped. The tool
+// reports single-core frames/s and the compute latency of each push, and
+// the signal delay that the Hampel lookahead adds.
+//
+// First, for the first --verify frames, every published window is checked
+// against a from-scratch reference in double precision. The reference takes
+// a sorted median and MAD per Hampel window, then a direct moving average,
+// then a two-pass mean and variance. The CCIPCA direction must match the top
+// eigenvector of the covariance the component tracks, in the windows where
+// that eigenvector is well separated. Any mismatch makes the tool exit with
+// status 1.
+//
+// --synth N first writes N frames per transmitter to --db in the Android
+// csi_data layout. The session has idle stretches and stretches of
+// activity, plus impulsive outliers, so the tool also reports how well the
+// motion feature separates the two.
+//
+// --feed PATH instead subscribes to csi_ingestd's live feed and prints each
+// window as it completes. Frames are timed by their capture time on the
+// shared clock once their node has synced, by their receive time before. It
+// reports the latency from the receive time of the frame that completed the
+// window.
+#include <arpa/inet.h>
+#include <sqlite3.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "csi/datagram.hpp"
+#include "csi/features.hpp"
+#include "csi/ingest.hpp"
+#include "csi/sqlite_source.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr double kTwoPi = 6.283185307179586;
+constexpr float kMadScale = 1.4826f;
+// Synthetic sessions: activity during [kActiveFrom, kActiveTo) of every kCycle seconds.
+constexpr double kCycle = 20.0, kActiveFrom = 8.0, kActiveTo = 14.0;
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal(int) { g_stop = 1; }
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s --db PATH [--synth FRAMES] [--nodes N] [--scenario NAME] [--table NAME]\n"
+                 "          [--verify FRAMES] [--repeat N]\n"
+                 "       %s --feed PATH\n"
+                 "  pipeline: [--pairs 64|128] [--hampel HALF] [--sigmas S] [--smooth N] [--window N]\n"
+                 "            [--hop N] [--components N] [--memory N]\n",
+                 argv0, argv0);
+}
+
+bool exec(sqlite3 *db, const char *sql) {
+    char *err = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::fprintf(stderr, "sqlite: %s\n", err);
+        sqlite3_free(err);
+        return false;
+    }
+    return true;
+}
+
+bool active_at(double t_s) {
+    double phase = std::fmod(t_s, kCycle);
+    return phase >= kActiveFrom && phase < kActiveTo;
+}
+
+// Writes frames per transmitter at 100 Hz each, interleaved, in the Android
+// csi_data layout. During activity the amplitudes are modulated by two body
+// motions with their own subcarrier patterns; the phase carries a random
+// timing slope and carrier offset per frame as on real receivers. About one
+// frame in 200 has a spike on one subcarrier.
+bool synthesize(const std::string &path, unsigned frames, unsigned nodes, size_t pairs) {
+    std::remove(path.c_str());
+    sqlite3 *db = nullptr;
+    if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+        std::fprintf(stderr, "cannot create %s\n", path.c_str());
+        sqlite3_close(db);
+        return false;
+    }
+    bool ok = exec(db,
+                   "CREATE TABLE csi_data (id INTEGER PRIMARY KEY AUTOINCREMENT, data_hora TEXT, cenario TEXT,"
+                   " type TEXT, mac TEXT, seq INTEGER, rssi INTEGER, rate REAL, sig_mode INTEGER, mcs INTEGER,"
+                   " bandwidth INTEGER, smoothing INTEGER, not_sounding INTEGER, aggregation INTEGER,"
+                   " stbc INTEGER, fec_coding INTEGER, sgi INTEGER, noise_floor INTEGER, ampdu_cnt INTEGER,"
+                   " channel INTEGER, secondary_channel INTEGER, local_timestamp INTEGER, ant INTEGER,"
+                   " sig_len INTEGER, rx_state INTEGER, len INTEGER, first_word INTEGER, data TEXT);"
+                   "BEGIN;");
+    sqlite3_stmt *stmt = nullptr;
+    ok = ok && sqlite3_prepare_v2(db,
+                                  "INSERT INTO csi_data (data_hora, cenario, type, mac, seq, rssi, rate, sig_mode,"
+                                  " mcs, bandwidth, smoothing, not_sounding, aggregation, stbc, fec_coding, sgi,"
+                                  " noise_floor, ampdu_cnt, channel, secondary_channel, local_timestamp, ant,"
+                                  " sig_len, rx_state, len, first_word, data) VALUES ('2024-01-01 00:00:00',"
+                                  " 'bench', 'CSI_DATA', ?1, ?2, -50, 11, 1, 0, ?3, 0, 0, 0, 0, 0, 0, -93,"
+                                  " 0, 6, 0, ?4, 0, 60, 0, ?5, 0, ?6)",
+                                  -1, &stmt, nullptr) == SQLITE_OK;
+    std::mt19937 rng(11);
+    std::normal_distribution<double> noise(0.0, 0.8);
+    std::uniform_real_distribution<double> uni(-1.0, 1.0);
+    std::uniform_int_distribution<int> spike_bin(0, 1 << 30);
+    csi::dsp::SubcarrierMask valid = csi::dsp::SubcarrierMask::lltf(pairs);
+    std::vector<int> iq(pairs * 2);
+    std::string data;
+    for (unsigned f = 0; ok && f < frames; f++) {
+        for (unsigned n = 0; ok && n < nodes; n++) {
+            uint32_t ts = static_cast<uint32_t>(f * 10000u + n * 10000u / nodes);
+            double t = ts * 1e-6;
+            bool active = active_at(t);
+            double breath = std::sin(kTwoPi * 0.9 * t + n);
+            double sway = std::sin(kTwoPi * 2.3 * t + 0.5 * n) * std::sin(kTwoPi * 0.13 * t);
+            double slope = 0.3 * uni(rng);
+            double offset = M_PI * uni(rng);
+            int spike = spike_bin(rng) % 200 == 0 ? spike_bin(rng) % static_cast<int>(valid.size()) : -1;
+            std::fill(iq.begin(), iq.end(), 0);
+            for (size_t i = 0; i < valid.size(); i++) {
+                int k = valid.subcarrier[i];
+                double mag = 20 + 8 * std::cos(k * 0.11 + n);
+                if (active) {
+                    mag *= 1 + 0.25 * breath * std::cos(0.2 * k) + 0.15 * sway * std::sin(0.35 * k + n);
+                }
+                if (static_cast<int>(i) == spike) {
+                    mag *= 3;
+                }
+                double ph = slope * k + offset;
+                auto q = [](double v) { return static_cast<int>(std::max(-128.0, std::min(127.0, std::round(v)))); };
+                iq[2 * valid.index[i]] = q(mag * std::sin(ph) + noise(rng));
+                iq[2 * valid.index[i] + 1] = q(mag * std::cos(ph) + noise(rng));
+            }
+            data = "[";
+            for (size_t i = 0; i < iq.size(); i++) {
+                data += std::to_string(iq[i]);
+                data += i + 1 < iq.size() ? "," : "]";
+            }
+            char mac[18];
+            std::snprintf(mac, sizeof(mac), "02:00:00:00:%02x:%02x", (n + 1) >> 8 & 0xff, (n + 1) & 0xff);
+            sqlite3_bind_text(stmt, 1, mac, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 2, f);
+            sqlite3_bind_int(stmt, 3, pairs == 128);
+            sqlite3_bind_int64(stmt, 4, ts);
+            sqlite3_bind_int(stmt, 5, static_cast<int>(iq.size()));
+            sqlite3_bind_text(stmt, 6, data.c_str(), static_cast<int>(data.size()), SQLITE_STATIC);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+    }
+    sqlite3_finalize(stmt);
+    ok = ok && exec(db, "COMMIT;");
+    sqlite3_close(db);
+    return ok;
+}
+
+struct Session {
+    std::vector<csi_frame_meta_t> meta;
+    std::vector<int64_t> t_us;
+    std::vector<size_t> offset;
+    std::vector<int8_t> payload;
+
+    size_t size() const { return meta.size(); }
+    const int8_t *row(size_t i) const { return payload.data() + offset[i]; }
+};
+
+Session load(const std::string &path, const csi::SqliteSourceFilter &filter) {
+    csi::SqliteFrameSource source(path, filter);
+    Session s;
+    csi_frame_meta_t meta;
+    std::vector<int8_t> payload;
+    double host_s;
+    int64_t t = 0;
+    uint32_t last_ts = 0;
+    while (source.next(meta, payload, host_s)) {
+        if (host_s >= 0) {
+            t = static_cast<int64_t>(host_s * 1e6);
+        } else {
+            // One receiver stamps every row; unwrap its 32-bit microsecond clock.
+            t += s.meta.empty() ? meta.timestamp : static_cast<int32_t>(meta.timestamp - last_ts);
+            last_ts = meta.timestamp;
+        }
+        s.meta.push_back(meta);
+        s.t_us.push_back(t);
+        s.offset.push_back(s.payload.size());
+        s.payload.insert(s.payload.end(), payload.begin(), payload.end());
+    }
+    if (source.skipped()) {
+        std::printf("%llu malformed rows skipped\n", (unsigned long long)source.skipped());
+    }
+    return s;
+}
+
+// --- Reference ------------------------------------------------------------
+
+// Recomputes each transmitter's chain over its whole history, in double
+// precision where the pipeline runs sums incrementally. The Hampel decision
+// is made in float with the same expression, so both take the same branch.
+struct Reference {
+    const csi::FeatureConfig &cfg;
+    size_t width;
+    std::vector<float> raw;       // frames * width amplitudes
+    std::vector<int64_t> raw_t;
+    std::vector<double> smoothed; // one row per Hampel output
+    std::vector<int64_t> smoothed_t;
+    std::vector<double> centred;  // rows of smoothed minus the window mean at the time
+
+    Reference(const csi::FeatureConfig &c, size_t w) : cfg(c), width(w) {}
+
+    void add(const float *amp, int64_t t_us) {
+        raw.insert(raw.end(), amp, amp + width);
+        raw_t.push_back(t_us);
+        size_t k = cfg.hampel_half, span = 2 * k + 1, n = raw_t.size();
+        if (n < span) {
+            return;
+        }
+        size_t c = n - 1 - k;
+        std::vector<float> win(span), dev(span);
+        std::vector<double> filtered(width);
+        for (size_t j = 0; j < width; j++) {
+            for (size_t i = 0; i < span; i++) {
+                win[i] = raw[(c - k + i) * width + j];
+            }
+            std::sort(win.begin(), win.end());
+            float median = win[k];
+            for (size_t i = 0; i < span; i++) {
+                dev[i] = std::fabs(win[i] - median);
+            }
+            std::sort(dev.begin(), dev.end());
+            float x = raw[c * width + j];
+            filtered[j] = std::fabs(x - median) > cfg.hampel_sigmas * kMadScale * dev[k] ? median : x;
+        }
+        filtered_rows.insert(filtered_rows.end(), filtered.begin(), filtered.end());
+        size_t m = filtered_rows.size() / width;
+        size_t first = m > cfg.smooth ? m - cfg.smooth : 0;
+        for (size_t j = 0; j < width; j++) {
+            double sum = 0;
+            for (size_t r = first; r < m; r++) {
+                sum += filtered_rows[r * width + j];
+            }
+            smoothed.push_back(sum / static_cast<double>(m - first));
+        }
+        smoothed_t.push_back(raw_t[c]);
+        size_t rows = smoothed_t.size();
+        size_t from = rows > cfg.window ? rows - cfg.window : 0;
+        for (size_t j = 0; j < width; j++) {
+            double mean = 0;
+            for (size_t r = from; r < rows; r++) {
+                mean += smoothed[r * width + j];
+            }
+            mean /= static_cast<double>(rows - from);
+            centred.push_back(smoothed[(rows - 1) * width + j] - mean);
+        }
+    }
+    std::vector<double> filtered_rows;
+
+    // Window mean and variance per subcarrier over the newest window rows.
+    void window_stats(std::vector<double> &mean, std::vector<double> &var) const {
+        size_t rows = smoothed_t.size(), from = rows - cfg.window;
+        mean.assign(width, 0);
+        var.assign(width, 0);
+        for (size_t j = 0; j < width; j++) {
+            for (size_t r = from; r < rows; r++) {
+                mean[j] += smoothed[r * width + j];
+            }
+            mean[j] /= static_cast<double>(cfg.window);
+            for (size_t r = from; r < rows; r++) {
+                double d = smoothed[r * width + j] - mean[j];
+                var[j] += d * d;
+            }
+            var[j] /= static_cast<double>(cfg.window);
+        }
+    }
+
+    // Top two eigenvalues and the top eigenvector of the mean of u u^T over
+    // the newest pca_memory centred rows, which is what CCIPCA averages.
+    void top_components(std::vector<double> &v1, double &l1, double &l2) const {
+        size_t rows = centred.size() / width;
+        size_t from = rows > cfg.pca_memory ? rows - cfg.pca_memory : 0;
+        std::vector<double> cov(width * width, 0);
+        for (size_t r = from; r < rows; r++) {
+            const double *u = &centred[r * width];
+            for (size_t a = 0; a < width; a++) {
+                for (size_t b = 0; b < width; b++) {
+                    cov[a * width + b] += u[a] * u[b];
+                }
+            }
+        }
+        for (double &x : cov) {
+            x /= static_cast<double>(rows - from);
+        }
+        auto power = [&](std::vector<double> &v, double &lambda) {
+            v.assign(width, 1.0);
+            std::vector<double> next(width);
+            for (int it = 0; it < 500; it++) {
+                double norm = 0;
+                for (size_t a = 0; a < width; a++) {
+                    double s = 0;
+                    for (size_t b = 0; b < width; b++) {
+                        s += cov[a * width + b] * v[b];
+                    }
+                    next[a] = s;
+                    norm += s * s;
+                }
+                norm = std::sqrt(norm);
+                if (norm == 0) {
+                    break;
+                }
+                for (size_t a = 0; a < width; a++) {
+                    v[a] = next[a] / norm;
+                }
+                lambda = norm;
+            }
+        };
+        l1 = l2 = 0;
+        power(v1, l1);
+        for (size_t a = 0; a < width; a++) {
+            for (size_t b = 0; b < width; b++) {
+                cov[a * width + b] -= l1 * v1[a] * v1[b];
+            }
+        }
+        std::vector<double> v2;
+        power(v2, l2);
+    }
+};
+
+struct VerifyResult {
+    size_t windows = 0;
+    size_t bad = 0;
+    size_t separated = 0;  // windows with a well separated top component
+    size_t aligned = 0;    // ... where CCIPCA's first component matches it
+    double worst_mean = 0, worst_var = 0;
+};
+
+VerifyResult verify(const Session &s, const csi::FeatureConfig &cfg, size_t limit) {
+    csi::FeaturePipeline pipeline(cfg);
+    const size_t width = pipeline.width();
+    std::unordered_map<uint64_t, Reference> refs;
+    csi::dsp::Extractor extractor(pipeline.mask(), csi::dsp::Isa::Scalar);
+    std::vector<float> amp(width);
+    std::vector<double> mean, var, v1;
+    VerifyResult r;
+    for (size_t i = 0; i < s.size() && i < limit; i++) {
+        const csi_frame_meta_t &meta = s.meta[i];
+        const csi::FeatureVector *fv = pipeline.push(meta, s.row(i), s.t_us[i]);
+        if (meta.len != 2 * cfg.pairs || (meta.flags & CSI_FRAME_FLAG_AMPLITUDE)) {
+            continue;
+        }
+        uint64_t key = csi::mac_key(meta.mac);
+        Reference &ref = refs.try_emplace(key, cfg, width).first->second;
+        if (!ref.raw_t.empty() && (s.t_us[i] < ref.raw_t.back() || s.t_us[i] - ref.raw_t.back() > cfg.reset_gap_us)) {
+            return r;  // the reference does not model drops or restarts: stop checking here
+        }
+        extractor.run(s.row(i), 1, meta.len, amp.data(), nullptr, false);
+        ref.add(amp.data(), s.t_us[i]);
+        if (!fv) {
+            continue;
+        }
+        r.windows++;
+        ref.window_stats(mean, var);
+        bool ok = fv->node == key && fv->end_us == ref.smoothed_t.back() &&
+                  fv->start_us == ref.smoothed_t[ref.smoothed_t.size() - cfg.window];
+        for (size_t j = 0; j < width; j++) {
+            double e_mean = std::fabs(fv->mean[j] - mean[j]);
+            double e_var = std::fabs(fv->variance[j] - var[j]) / std::max(1.0, var[j]);
+            r.worst_mean = std::max(r.worst_mean, e_mean);
+            r.worst_var = std::max(r.worst_var, e_var);
+            ok = ok && e_mean < 1e-3 && e_var < 1e-3;
+        }
+        r.bad += !ok;
+        double l1, l2;
+        ref.top_components(v1, l1, l2);
+        if (l1 >= 4 * l2 && l1 > 0) {
+            double cosine = 0;
+            for (size_t j = 0; j < width; j++) {
+                cosine += v1[j] * fv->basis[j];
+            }
+            r.separated++;
+            r.aligned += std::fabs(cosine) >= 0.9;
+        }
+    }
+    return r;
+}
+
+// --- Timing -----------------------------------------------------------------
+
+double percentile(std::vector<double> &v, double p) {
+    if (v.empty()) {
+        return 0;
+    }
+    size_t k = std::min(v.size() - 1, static_cast<size_t>(p / 100.0 * v.size()));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+struct Detection {
+    double active = 0, idle = 0;
+    size_t n_active = 0, n_idle = 0;
+};
+
+int run_session(const std::string &db_path, const csi::SqliteSourceFilter &filter, const csi::FeatureConfig &cfg,
+                size_t verify_frames, unsigned repeat, bool synthetic) {
+    Session s = load(db_path, filter);
+    if (s.size() == 0) {
+        std::fprintf(stderr, "csi_feature_bench: no frames in %s\n", db_path.c_str());
+        return 1;
+    }
+    csi::FeaturePipeline probe(cfg);
+    std::printf("%zu frames, %zu subcarriers, window %zu, hop %zu, Hampel %zu+1+%zu, smoothing %zu, "
+                "%zu components\n",
+                s.size(), probe.width(), cfg.window, cfg.hop, cfg.hampel_half, cfg.hampel_half, cfg.smooth,
+                cfg.components);
+
+    VerifyResult vr = verify(s, cfg, verify_frames);
+    bool pca_ok = vr.separated == 0 || vr.aligned >= 0.9 * vr.separated;
+    std::printf("  verify  %zu windows  max error: mean %.2e  variance %.2e (relative)  -> %s\n", vr.windows,
+                vr.worst_mean, vr.worst_var, vr.bad ? "FAIL" : "ok");
+    std::printf("  verify  CCIPCA first component within 26 deg of the covariance's in %zu of %zu separated "
+                "windows  -> %s\n",
+                vr.aligned, vr.separated, pca_ok ? "ok" : "FAIL");
+
+    std::vector<double> push_ns, window_ns;
+    push_ns.reserve(s.size() * repeat);
+    double total_s = 0;
+    Detection det;
+    // The counters printed below are those of the first pass.
+    csi::FeaturePipeline pipeline(cfg), rerun(cfg);
+    for (unsigned rep = 0; rep < repeat; rep++) {
+        csi::FeaturePipeline &p = rep == 0 ? pipeline : rerun;
+        p.reset();
+        auto start = Clock::now();
+        for (size_t i = 0; i < s.size(); i++) {
+            auto t0 = Clock::now();
+            const csi::FeatureVector *fv = p.push(s.meta[i], s.row(i), s.t_us[i]);
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+            push_ns.push_back(ns);
+            if (!fv) {
+                continue;
+            }
+            window_ns.push_back(ns);
+            if (synthetic && rep == 0) {
+                bool a = active_at(fv->start_us * 1e-6), b = active_at(fv->end_us * 1e-6);
+                if (a && b) {
+                    det.active += fv->motion;
+                    det.n_active++;
+                } else if (!a && !b) {
+                    det.idle += fv->motion;
+                    det.n_idle++;
+                }
+            }
+        }
+        total_s += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    // Untimed pass for the throughput figure without the clock reads around each push.
+    auto start = Clock::now();
+    for (unsigned rep = 0; rep < repeat; rep++) {
+        rerun.reset();
+        for (size_t i = 0; i < s.size(); i++) {
+            rerun.push(s.meta[i], s.row(i), s.t_us[i]);
+        }
+    }
+    double bare_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double span_s = (s.t_us.back() - s.t_us.front()) * 1e-6;
+    double per_node_hz = span_s > 0 ? s.size() / span_s / std::max<size_t>(1, pipeline.nodes()) : 0;
+    std::printf("  throughput  %.0f frames/s (1 core), %.0f with per-push timing\n", s.size() * repeat / bare_s,
+                s.size() * repeat / total_s);
+    // The maximum includes each transmitter's first frame, which allocates its rings.
+    std::printf("  push        p50 %.0f ns  p99 %.0f ns  p99.9 %.0f ns  max %.0f ns\n", percentile(push_ns, 50),
+                percentile(push_ns, 99), percentile(push_ns, 99.9), percentile(push_ns, 100));
+    std::printf("  window push p50 %.0f ns  p99 %.0f ns  max %.0f ns  (%llu windows)\n",
+                percentile(window_ns, 50), percentile(window_ns, 99), percentile(window_ns, 100),
+                (unsigned long long)(pipeline.windows()));
+    if (per_node_hz > 0) {
+        std::printf("  signal delay %zu frames of Hampel lookahead, %.1f ms at %.0f Hz per transmitter\n",
+                    cfg.hampel_half, cfg.hampel_half * 1000.0 / per_node_hz, per_node_hz);
+    }
+    std::printf("  transmitters %zu  rejected %llu  late %llu  restarts %llu  outliers replaced %llu\n",
+                pipeline.nodes(), (unsigned long long)pipeline.rejected(), (unsigned long long)pipeline.late(),
+                (unsigned long long)pipeline.restarts(), (unsigned long long)pipeline.outliers());
+    if (det.n_active && det.n_idle) {
+        double active = det.active / det.n_active, idle = det.idle / det.n_idle;
+        std::printf("  detection   motion %.3f active vs %.3f idle (%.1fx) over %zu + %zu windows\n", active, idle,
+                    idle > 0 ? active / idle : 0.0, det.n_active, det.n_idle);
+    }
+    if (vr.bad || !pca_ok) {
+        std::fprintf(stderr, "csi_feature_bench: pipeline disagrees with the reference\n");
+        return 1;
+    }
+    return 0;
+}
+
+int64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+int run_feed(const std::string &feed_path, const csi::FeatureConfig &cfg) {
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    struct sockaddr_un self = {}, feed = {};
+    self.sun_family = feed.sun_family = AF_UNIX;
+    std::snprintf(self.sun_path, sizeof(self.sun_path), "/tmp/csi_feature_bench.%d", static_cast<int>(getpid()));
+    std::snprintf(feed.sun_path, sizeof(feed.sun_path), "%s", feed_path.c_str());
+    unlink(self.sun_path);
+    struct timeval tv = {0, 200000};
+    if (fd < 0 || bind(fd, reinterpret_cast<struct sockaddr *>(&self), sizeof(self)) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0 ||
+        sendto(fd, "SUB", 3, 0, reinterpret_cast<struct sockaddr *>(&feed), sizeof(feed)) != 3) {
+        std::perror("csi_feature_bench: feed");
+        if (fd >= 0) {
+            close(fd);
+        }
+        unlink(self.sun_path);
+        return 1;
+    }
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    csi::FeaturePipeline pipeline(cfg);
+    std::vector<uint8_t> buf(csi::kFeedRecordHeader + CSI_FRAME_BIN_SIZE(CSI_FRAME_MAX_PAYLOAD));
+    std::vector<double> latency_ms;
+    uint64_t records = 0, malformed = 0;
+    while (!g_stop) {
+        ssize_t n = recv(fd, buf.data(), buf.size(), 0);
+        if (n < static_cast<ssize_t>(csi::kFeedRecordHeader)) {
+            continue;
+        }
+        uint64_t host_ns = 0;
+        for (int i = 7; i >= 0; i--) {
+            host_ns = host_ns << 8 | buf[i];
+        }
+        uint32_t source;
+        std::memcpy(&source, buf.data() + csi::kFeedRecordSource, sizeof(source));
+        // Capture time on the shared clock once the node has synced, receive time before.
+        uint64_t capture = 0;
+        for (int i = 7; i >= 0; i--) {
+            capture = capture << 8 | buf[csi::kFeedRecordCapture + i];
+        }
+        int64_t t_us = static_cast<int64_t>(capture);
+        if (t_us == csi::kNoCaptureTime) {
+            t_us = static_cast<int64_t>(host_ns / 1000);
+        }
+        csi_frame_meta_t meta;
+        const int8_t *payload;
+        if (csi_frame_decode(buf.data() + csi::kFeedRecordHeader, n - csi::kFeedRecordHeader, &meta, &payload) !=
+            CSI_FRAME_OK) {
+            malformed++;
+            continue;
+        }
+        records++;
+        const csi::FeatureVector *fv = pipeline.push(meta, payload, t_us, source);
+        if (!fv) {
+            continue;
+        }
+        double ms = (realtime_ns() - static_cast<int64_t>(host_ns)) / 1e6;
+        latency_ms.push_back(ms);
+        float top = 0;
+        for (float v : fv->pc_variance) {
+            top = std::max(top, v);
+        }
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &source, ip, sizeof(ip));
+        std::printf("%-15s %02x:%02x:%02x:%02x:%02x:%02x  window %6llu  motion %8.3f  pc variance %8.3f  "
+                    "latency %.2f ms\n",
+                    ip, meta.mac[0], meta.mac[1], meta.mac[2], meta.mac[3], meta.mac[4], meta.mac[5],
+                    (unsigned long long)fv->index, fv->motion, top, ms);
+        std::fflush(stdout);
+    }
+    sendto(fd, "UNSUB", 5, 0, reinterpret_cast<struct sockaddr *>(&feed), sizeof(feed));
+    close(fd);
+    unlink(self.sun_path);
+    std::fprintf(stderr, "%llu records (%llu malformed), %llu windows, rejected %llu, late %llu, "
+                         "latency p50 %.2f ms p99 %.2f ms\n",
+                 (unsigned long long)records, (unsigned long long)malformed,
+                 (unsigned long long)pipeline.windows(), (unsigned long long)pipeline.rejected(),
+                 (unsigned long long)pipeline.late(), percentile(latency_ms, 50), percentile(latency_ms, 99));
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    std::string db_path, feed_path;
+    csi::SqliteSourceFilter filter;
+    csi::FeatureConfig cfg;
+    unsigned synth = 0, nodes = 2, repeat = 3;
+    size_t verify_frames = 20000;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        size_t n = static_cast<size_t>(std::atoll(value));
+        if (arg == "--db") {
+            db_path = value;
+        } else if (arg == "--feed") {
+            feed_path = value;
+        } else if (arg == "--synth") {
+            synth = static_cast<unsigned>(n);
+        } else if (arg == "--nodes") {
+            nodes = static_cast<unsigned>(n);
+        } else if (arg == "--scenario") {
+            filter.scenario = value;
+        } else if (arg == "--table") {
+            filter.table = value;
+        } else if (arg == "--verify") {
+            verify_frames = n;
+        } else if (arg == "--repeat") {
+            repeat = static_cast<unsigned>(n);
+        } else if (arg == "--pairs") {
+            cfg.pairs = n;
+        } else if (arg == "--hampel") {
+            cfg.hampel_half = n;
+        } else if (arg == "--sigmas") {
+            cfg.hampel_sigmas = static_cast<float>(std::atof(value));
+        } else if (arg == "--smooth") {
+            cfg.smooth = n;
+        } else if (arg == "--window") {
+            cfg.window = n;
+        } else if (arg == "--hop") {
+            cfg.hop = n;
+        } else if (arg == "--components") {
+            cfg.components = n;
+        } else if (arg == "--memory") {
+            cfg.pca_memory = n;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (db_path.empty() == feed_path.empty() || repeat == 0 || nodes == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    try {
+        if (!feed_path.empty()) {
+            return run_feed(feed_path, cfg);
+        }
+        if (synth && !synthesize(db_path, synth, nodes, cfg.pairs)) {
+            return 1;
+        }
+        return run_session(db_path, filter, cfg, verify_frames, repeat, synth != 0);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "csi_feature_bench: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,380 @@
+// csi_history_sim: the node's frame history and the collector's NACKs
+// (csi_history.c) over a simulated lossy link.
+//
+// A node captures --seconds of frames at --rate-hz and streams them the way
+// csi_sender_task in app_main.c does: each frame is stored in the history
+// before it is delta compressed (csi_delta.h) and sent, and every
+// CSI_HISTORY_POLL_MS the node takes the NACKs that arrived and resends at
+// most --budget requested frames.
+// The collector decodes the stream with csi::DatagramDecoder and runs
+// csi_nack_tracker_t on it every 10 ms, as csi_ingestd --nack does.
+//
+// The link is a Gilbert-Elliott channel in 1 ms slots: it loses everything
+// in its bad state, which it enters so that --loss of the time is bad in
+// bursts of --burst-ms on average, plus one outage of --outage-ms halfway
+// through. The state applies to both directions, so NACKs and resent frames
+// are lost too. Datagrams queue for --airtime-us each on the way to the
+// collector and take --delay-ms plus up to --jitter-ms.
+//
+// The same capture also runs without NACKs over the same channel. Reported
+// are the share of the frames lost live that were recovered, the latency a
+// recovered frame arrived with beyond its live delay, and the live latency
+// in both runs (resends queue behind and between live frames). Exits with
+// status 1 if a payload arrives corrupted, the recovered share is below
+// --min-recovered or resent frames cost delta frames (the delta desync must
+// match that of the live frames decoded on their own). The history and the gap
+// tracker are checked step by step in tests/test_csi_history.cpp.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csi/datagram.hpp"
+#include "csi_delta.h"
+#include "csi_frame.h"
+#include "csi_history.h"
+
+namespace {
+
+// Firmware constants of app_main.c.
+constexpr uint32_t kHistoryBytes = 32 * 1024;       // CSI_HISTORY_BYTES (no PSRAM)
+constexpr uint32_t kHistorySlots = 1024;            // CSI_HISTORY_SLOTS
+constexpr int64_t kServeUs = 10000;                 // CSI_HISTORY_POLL_MS
+constexpr int64_t kHostPollUs = 10000;
+constexpr int64_t kDrainUs = 2000000;               // run on after the last frame
+constexpr uint16_t kPayloadLen = 128;
+
+struct Options {
+    unsigned seconds = 60;
+    unsigned rate_hz = 100;
+    double loss = 0.05;
+    double burst_ms = 30;
+    unsigned outage_ms = 500;
+    double delay_ms = 5;
+    double jitter_ms = 3;
+    unsigned airtime_us = 300;
+    unsigned budget = 8;
+    unsigned keyframe_interval = 50;  // CSI_KEYFRAME_INTERVAL; 1 sends every frame whole
+    double min_recovered = 0.98;
+    uint64_t seed = 1;
+};
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--seconds S] [--rate-hz N] [--loss P] [--burst-ms MS] [--outage-ms MS]\n"
+                 "          [--delay-ms MS] [--jitter-ms MS] [--airtime-us US] [--budget N] [--keyframe-interval N]\n"
+                 "          [--min-recovered R] [--seed N]\n",
+                 argv0);
+}
+
+csi_frame_meta_t make_meta(uint32_t seq, uint16_t len) {
+    csi_frame_meta_t meta = {};
+    meta.seq = seq;
+    const uint8_t mac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+    std::memcpy(meta.mac, mac, 6);
+    meta.rssi = -50;
+    meta.channel = 6;
+    meta.timestamp = seq * 10000;
+    meta.len = len;
+    return meta;
+}
+
+std::vector<uint8_t> encode(const csi_frame_meta_t &meta, const int8_t *payload) {
+    std::vector<uint8_t> out(CSI_FRAME_BIN_SIZE(meta.len));
+    out.resize(csi_frame_encode(&meta, payload, out.data(), out.size()));
+    return out;
+}
+
+// Link state per 1 ms slot, shared by both runs and both directions.
+std::vector<bool> make_channel(const Options &opt, int64_t total_us) {
+    std::mt19937_64 rng(opt.seed);
+    std::uniform_real_distribution<double> u(0.0, 1.0);
+    const double leave_bad = 1.0 / std::max(opt.burst_ms, 1.0);
+    const double enter_bad = opt.loss >= 1 ? 1.0 : opt.loss * leave_bad / (1.0 - opt.loss);
+    std::vector<bool> bad(static_cast<size_t>(total_us / 1000 + 1));
+    bool state = false;
+    for (size_t i = 0; i < bad.size(); i++) {
+        state = state ? u(rng) >= leave_bad : u(rng) < enter_bad;
+        bad[i] = state;
+    }
+    const size_t outage = bad.size() / 2 - kDrainUs / 2000;
+    for (size_t i = outage; i < std::min(bad.size(), outage + opt.outage_ms); i++) {
+        bad[i] = true;
+    }
+    return bad;
+}
+
+struct Datagram {
+    int64_t arrival_us;
+    std::vector<uint8_t> bytes;
+    bool operator>(const Datagram &o) const { return arrival_us > o.arrival_us; }
+};
+
+using Arrivals = std::priority_queue<Datagram, std::vector<Datagram>, std::greater<Datagram>>;
+
+struct Link {
+    const Options &opt;
+    const std::vector<bool> &bad;
+    std::mt19937_64 rng;
+    int64_t free_us = 0;  // the node's radio is busy until then
+
+    Link(const Options &o, const std::vector<bool> &b, uint64_t seed) : opt(o), bad(b), rng(seed) {}
+
+    bool lost(int64_t t_us) const { return bad[std::min(bad.size() - 1, static_cast<size_t>(t_us / 1000))]; }
+
+    int64_t latency_us() {
+        return static_cast<int64_t>(opt.delay_ms * 1000 +
+                                    std::uniform_real_distribution<double>(0.0, opt.jitter_ms * 1000)(rng));
+    }
+
+    // Node to collector: queued behind the datagrams before it.
+    void send(int64_t t_us, const uint8_t *data, size_t len, Arrivals &to) {
+        const int64_t start = std::max(t_us, free_us);
+        free_us = start + opt.airtime_us;
+        if (!lost(start)) {
+            to.push({free_us + latency_us(), std::vector<uint8_t>(data, data + len)});
+        }
+    }
+
+    // Collector to node.
+    void reply(int64_t t_us, const char *data, size_t len, Arrivals &to) {
+        if (!lost(t_us)) {
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+            to.push({t_us + latency_us(), std::vector<uint8_t>(p, p + len)});
+        }
+    }
+};
+
+struct Result {
+    uint64_t frames = 0;
+    uint64_t live = 0;           // arrived without being resent
+    uint64_t recovered = 0;      // arrived only as a resend
+    uint64_t duplicates = 0;
+    uint64_t corrupted = 0;
+    uint64_t delta_desync = 0;
+    uint64_t live_desync = 0;    // of a decoder fed the live datagrams only
+    uint64_t nacks = 0;
+    uint64_t resent = 0;
+    uint64_t expired = 0;
+    uint64_t abandoned = 0;
+    std::vector<double> live_ms;
+    std::vector<double> added_ms;  // recovered frames, beyond the live delay
+};
+
+void run(const Options &opt, const std::vector<bool> &bad, bool nack, Result &out) {
+    Link link(opt, bad, opt.seed * 7 + 1);
+    Arrivals to_host, to_node;
+    std::mt19937_64 rng(opt.seed * 7 + 2);
+    std::normal_distribution<double> walk(0.0, 1.5);
+
+    std::vector<uint8_t> arena(kHistoryBytes);
+    std::vector<csi_history_slot_t> slots(kHistorySlots);
+    csi_history_t history;
+    csi_history_init(&history, arena.data(), arena.size(), slots.data(), kHistorySlots);
+    csi_delta_enc_t enc;
+    csi_delta_enc_init(&enc, static_cast<uint16_t>(opt.keyframe_interval));
+    csi::DatagramDecoder decoder, live_decoder;
+    csi_nack_tracker_t tracker;
+    csi_nack_init(&tracker);
+
+    const int64_t period_us = 1000000 / opt.rate_hz;
+    const uint32_t count = opt.seconds * opt.rate_hz;
+    const int64_t end_us = int64_t{count} * period_us + kDrainUs;
+    // Capture goes on while the run drains, so the gaps at the end are noticed
+    // too; only the first count frames are scored.
+    const uint32_t captured = static_cast<uint32_t>(end_us / period_us) + 1;
+    std::vector<std::vector<int8_t>> payloads(captured, std::vector<int8_t>(kPayloadLen));
+    std::vector<uint8_t> received(captured, 0);
+    std::vector<double> state(kPayloadLen, 0.0);
+    std::vector<uint8_t> delta(CSI_DELTA_ENCODED_MAX(kPayloadLen));
+    char nack_buf[CSI_HISTORY_NACK_MAX_LEN];
+    uint32_t seq = 0;
+
+    for (int64_t t = 0; t <= end_us; t += 1000) {
+        // Capture and live send.
+        while (seq < captured && int64_t{seq} * period_us <= t) {
+            std::vector<int8_t> &p = payloads[seq];
+            for (int i = 0; i < kPayloadLen; i++) {
+                state[i] = std::clamp(state[i] * 0.98 + walk(rng), -100.0, 100.0);
+                p[i] = static_cast<int8_t>(std::lround(state[i]) + (i % 16) * 2);
+            }
+            csi_frame_meta_t meta = make_meta(seq, kPayloadLen);
+            std::vector<uint8_t> raw = encode(meta, p.data());
+            if (nack) {
+                csi_history_store(&history, seq, raw.data(), static_cast<uint16_t>(raw.size()));
+            }
+            meta.len = static_cast<uint16_t>(
+                csi_delta_encode(&enc, seq, p.data(), kPayloadLen, delta.data(), delta.size(), &meta.flags));
+            std::vector<uint8_t> live = encode(meta, reinterpret_cast<const int8_t *>(delta.data()));
+            link.send(t, live.data(), live.size(), to_host);
+            seq++;
+        }
+
+        // The sender task's history pass.
+        if (nack && t % kServeUs == 0) {
+            while (!to_node.empty() && to_node.top().arrival_us <= t) {
+                const Datagram &d = to_node.top();
+                csi_history_request(&history, reinterpret_cast<const char *>(d.bytes.data()), d.bytes.size());
+                to_node.pop();
+            }
+            uint32_t s;
+            uint16_t len;
+            const uint8_t *frame;
+            for (unsigned i = 0; i < opt.budget && (frame = csi_history_next(&history, &s, &len)); i++) {
+                link.send(t, frame, len, to_host);
+            }
+        }
+
+        // The collector.
+        while (!to_host.empty() && to_host.top().arrival_us <= t) {
+            const Datagram d = to_host.top();
+            to_host.pop();
+            if (!(d.bytes[3] & CSI_FRAME_FLAG_RETRANSMIT)) {
+                live_decoder.decode(d.bytes.data(), d.bytes.size(), [](const csi::Frame &) {});
+            }
+            decoder.decode(d.bytes.data(), d.bytes.size(), [&](const csi::Frame &f) {
+                const uint32_t s = f.meta.seq;
+                if (s >= captured) {
+                    out.corrupted++;
+                    return;
+                }
+                if (nack) {
+                    csi_nack_on_frame(&tracker, s, static_cast<uint64_t>(d.arrival_us));
+                }
+                if (s >= count) {
+                    return;
+                }
+                if (received[s]) {
+                    out.duplicates++;
+                    return;
+                }
+                received[s] = 1;
+                if (f.meta.len != kPayloadLen || std::memcmp(f.payload, payloads[s].data(), kPayloadLen) != 0) {
+                    out.corrupted++;
+                }
+                const double ms = (d.arrival_us - int64_t{s} * period_us) / 1000.0;
+                if (f.meta.flags & CSI_FRAME_FLAG_RETRANSMIT) {
+                    out.recovered++;
+                    out.added_ms.push_back(ms - opt.delay_ms - opt.jitter_ms / 2);
+                } else {
+                    out.live++;
+                    out.live_ms.push_back(ms);
+                }
+            });
+        }
+        if (nack && t % kHostPollUs == 0) {
+            size_t len = csi_nack_poll(&tracker, nullptr, static_cast<uint64_t>(t), nack_buf, sizeof(nack_buf));
+            if (len > 0) {
+                link.reply(t, nack_buf, len, to_node);
+            }
+        }
+    }
+    out.frames = count;
+    out.delta_desync = decoder.delta_desync();
+    out.live_desync = live_decoder.delta_desync();
+    out.nacks = tracker.nacks;
+    out.resent = history.resent;
+    out.expired = history.expired;
+    out.abandoned = tracker.abandoned;
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) {
+        return 0;
+    }
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(p / 100.0 * (v.size() - 1) + 0.5);
+    return v[std::min(i, v.size() - 1)];
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--seconds") {
+            opt.seconds = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--rate-hz") {
+            opt.rate_hz = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--loss") {
+            opt.loss = std::atof(value);
+        } else if (arg == "--burst-ms") {
+            opt.burst_ms = std::atof(value);
+        } else if (arg == "--outage-ms") {
+            opt.outage_ms = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--delay-ms") {
+            opt.delay_ms = std::atof(value);
+        } else if (arg == "--jitter-ms") {
+            opt.jitter_ms = std::atof(value);
+        } else if (arg == "--airtime-us") {
+            opt.airtime_us = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--budget") {
+            opt.budget = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--keyframe-interval") {
+            opt.keyframe_interval = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--min-recovered") {
+            opt.min_recovered = std::atof(value);
+        } else if (arg == "--seed") {
+            opt.seed = std::strtoull(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opt.seconds == 0 || opt.rate_hz == 0 || opt.rate_hz > 1000 || opt.loss < 0 || opt.loss >= 1 ||
+        opt.delay_ms < 0 || opt.jitter_ms < 0 || opt.budget == 0 || opt.keyframe_interval > 65535) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const int64_t total_us = int64_t{opt.seconds} * 1000000 + kDrainUs;
+    const std::vector<bool> channel = make_channel(opt, total_us);
+    Result plain, reliable;
+    run(opt, channel, false, plain);
+    run(opt, channel, true, reliable);
+
+    const uint64_t lost_live = reliable.frames - reliable.live;
+    const double ratio = lost_live ? static_cast<double>(reliable.recovered) / lost_live : 1.0;
+    std::printf("%u s at %u Hz, keyframe every %u, %.1f%% loss in %.0f ms bursts, %u ms outage, %.0f+%.0f ms delay:\n",
+                opt.seconds, opt.rate_hz, opt.keyframe_interval, opt.loss * 100, opt.burst_ms, opt.outage_ms,
+                opt.delay_ms, opt.jitter_ms);
+    std::printf("  without NACKs  %llu/%llu frames  live latency p50 %.1f  p99 %.1f ms  delta desync %llu\n",
+                (unsigned long long)plain.live, (unsigned long long)plain.frames, percentile(plain.live_ms, 50),
+                percentile(plain.live_ms, 99), (unsigned long long)plain.delta_desync);
+    std::printf("  with NACKs     %llu/%llu frames  live latency p50 %.1f  p99 %.1f ms  delta desync %llu\n",
+                (unsigned long long)(reliable.live + reliable.recovered), (unsigned long long)reliable.frames,
+                percentile(reliable.live_ms, 50), percentile(reliable.live_ms, 99),
+                (unsigned long long)reliable.delta_desync);
+    std::printf("  recovered %llu/%llu lost live (%.2f%%)  added latency p50 %.1f  p99 %.1f  max %.1f ms\n",
+                (unsigned long long)reliable.recovered, (unsigned long long)lost_live, ratio * 100,
+                percentile(reliable.added_ms, 50), percentile(reliable.added_ms, 99),
+                percentile(reliable.added_ms, 100));
+    std::printf("  %llu NACKs  %llu resent  %llu no longer held  %llu given up  %llu duplicates\n",
+                (unsigned long long)reliable.nacks, (unsigned long long)reliable.resent,
+                (unsigned long long)reliable.expired, (unsigned long long)reliable.abandoned,
+                (unsigned long long)reliable.duplicates);
+
+    const char *failure =
+        plain.corrupted != 0 || reliable.corrupted != 0 ? "a payload arrived corrupted"
+        : ratio < opt.min_recovered                     ? "recovered share below --min-recovered"
+        : reliable.delta_desync != reliable.live_desync ? "resent frames cost delta frames"
+                                                        : nullptr;
+    if (failure) {
+        std::printf("FAIL: %s\n", failure);
+        return 1;
+    }
+    std::printf("OK: %.2f%% of the frames lost live recovered\n", ratio * 100);
+    return 0;
+}
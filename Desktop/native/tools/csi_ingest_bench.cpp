@@ -0,0 +1,247 @@
+// csi_ingest_bench: loopback throughput benchmark for IngestServer.
+//
+// A sender thread plays N synthetic nodes over loopback with sendmmsg while
+// the main thread runs the ingest loop; the report gives sustained frames/s
+// and the loss seen by the per-node sequence accounting. Like nodes on one AP,
+// every node reports the same MAC and sends from its own address
+// (csi::node_address).
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "csi/ingest.hpp"
+#include "csi/loadgen.hpp"
+
+namespace {
+
+struct BenchConfig {
+    unsigned nodes = 8;
+    unsigned frames = 20000;   // per node
+    double rate = 0;           // per node, frames/s; 0 = as fast as possible
+    unsigned len = 128;
+    std::string format = "text";
+};
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--nodes N] [--frames PER_NODE] [--rate HZ_PER_NODE]\n"
+                 "          [--len PAYLOAD_BYTES] [--format text|binary|batch]\n",
+                 argv0);
+}
+
+// Serializes one synthetic frame in the requested wire format (batch uses binary frames).
+size_t make_frame(const BenchConfig &cfg, uint32_t seq, std::vector<int8_t> &payload, uint8_t *out, size_t cap) {
+    csi_frame_meta_t meta = {};
+    meta.seq = seq;
+    std::memcpy(meta.mac, csi::kLoadMac, sizeof(meta.mac));
+    meta.rssi = -40;
+    meta.noise_floor = -93;
+    meta.channel = 6;
+    meta.timestamp = seq * 10000u;
+    meta.len = static_cast<uint16_t>(payload.size());
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = static_cast<int8_t>((seq + i * 7) % 41 - 20);
+    }
+    if (cfg.format == "text") {
+        return csi_frame_format_text(&meta, payload.data(), reinterpret_cast<char *>(out), cap);
+    }
+    return csi_frame_encode(&meta, payload.data(), out, cap);
+}
+
+// Collects datagrams into sendmmsg bursts.
+class BurstSender {
+public:
+    static constexpr unsigned kBurst = 64;
+    static constexpr size_t kSlot = 8192;
+
+    static constexpr size_t kControl = CMSG_SPACE(sizeof(struct in_pktinfo));
+
+    explicit BurstSender(int fd)
+        : fd_(fd), bufs_(kBurst * kSlot), msgs_(kBurst), iovs_(kBurst), control_(kBurst * kControl) {}
+
+    uint8_t *slot() { return bufs_.data() + static_cast<size_t>(n_) * kSlot; }
+
+    // Sends the datagram from the local address source (network byte order).
+    void commit(size_t len, uint32_t source) {
+        iovs_[n_].iov_base = slot();
+        iovs_[n_].iov_len = len;
+        struct msghdr &hdr = msgs_[n_].msg_hdr;
+        hdr = {};
+        hdr.msg_iov = &iovs_[n_];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = control_.data() + static_cast<size_t>(n_) * kControl;
+        hdr.msg_controllen = kControl;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+        cmsg->cmsg_level = IPPROTO_IP;
+        cmsg->cmsg_type = IP_PKTINFO;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+        struct in_pktinfo info = {};
+        info.ipi_spec_dst.s_addr = source;
+        std::memcpy(CMSG_DATA(cmsg), &info, sizeof(info));
+        if (++n_ == kBurst) {
+            flush();
+        }
+    }
+
+    void flush() {
+        unsigned done = 0;
+        while (done < n_) {
+            int rc = sendmmsg(fd_, msgs_.data() + done, n_ - done, 0);
+            if (rc <= 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            done += static_cast<unsigned>(rc);
+        }
+        n_ = 0;
+    }
+
+private:
+    int fd_;
+    unsigned n_ = 0;
+    std::vector<uint8_t> bufs_;
+    std::vector<struct mmsghdr> msgs_;
+    std::vector<struct iovec> iovs_;
+    std::vector<uint8_t> control_;
+};
+
+void run_sender(const BenchConfig &cfg, uint16_t port, std::atomic<bool> &done) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int sndbuf = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    struct sockaddr_in dst = {};
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(port);
+    dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&dst), sizeof(dst)) != 0) {
+        std::perror("connect");
+        close(fd);
+        done = true;
+        return;
+    }
+
+    BurstSender out(fd);
+    std::vector<int8_t> payload(cfg.len);
+    bool batch = cfg.format == "batch";
+    // One pending batch per node, coalesced the way csi_sender_task does it.
+    std::vector<std::vector<uint8_t>> batch_bufs(batch ? cfg.nodes : 0, std::vector<uint8_t>(1400));
+    std::vector<csi_batch_t> batches(batch ? cfg.nodes : 0);
+    for (unsigned n = 0; n < batches.size(); n++) {
+        csi_batch_init(&batches[n], batch_bufs[n].data(), batch_bufs[n].size());
+    }
+    auto emit_batch = [&](unsigned node) {
+        size_t len = csi_batch_finish(&batches[node]);
+        if (len) {
+            std::memcpy(out.slot(), batch_bufs[node].data(), len);
+            out.commit(len, csi::node_address(node));
+        }
+        csi_batch_reset(&batches[node]);
+    };
+
+    std::vector<uint8_t> frame(BurstSender::kSlot);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t seq = 0; seq < cfg.frames; seq++) {
+        for (unsigned node = 0; node < cfg.nodes; node++) {
+            if (!batch) {
+                out.commit(make_frame(cfg, seq, payload, out.slot(), BurstSender::kSlot), csi::node_address(node));
+                continue;
+            }
+            size_t len = make_frame(cfg, seq, payload, frame.data(), frame.size());
+            if (csi_batch_add(&batches[node], seq, frame.data(), static_cast<uint16_t>(len)) != 0) {
+                emit_batch(node);
+                csi_batch_add(&batches[node], seq, frame.data(), static_cast<uint16_t>(len));
+            }
+        }
+        if (cfg.rate > 0) {
+            out.flush();
+            std::this_thread::sleep_until(start + std::chrono::duration<double>((seq + 1) / cfg.rate));
+        }
+    }
+    for (unsigned node = 0; node < batches.size(); node++) {
+        emit_batch(node);
+    }
+    out.flush();
+    close(fd);
+    done = true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    BenchConfig cfg;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        const char *value = argv[i + 1];
+        if (arg == "--nodes") {
+            cfg.nodes = static_cast<unsigned>(std::atoi(value));
+        } else if (arg == "--frames") {
+            cfg.frames = static_cast<unsigned>(std::atoi(value));
+        } else if (arg == "--rate") {
+            cfg.rate = std::atof(value);
+        } else if (arg == "--len") {
+            cfg.len = static_cast<unsigned>(std::atoi(value));
+        } else if (arg == "--format") {
+            cfg.format = value;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (cfg.nodes == 0 || cfg.len > CSI_FRAME_MAX_PAYLOAD ||
+        (cfg.format != "text" && cfg.format != "binary" && cfg.format != "batch")) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    csi::IngestConfig icfg;
+    icfg.bind_addr = "127.0.0.1";
+    icfg.port = 0;
+    csi::IngestServer server(icfg);
+
+    std::atomic<bool> sent_all{false};
+    auto start = std::chrono::steady_clock::now();
+    std::thread sender(run_sender, std::cref(cfg), server.port(), std::ref(sent_all));
+
+    uint64_t total = static_cast<uint64_t>(cfg.nodes) * cfg.frames;
+    auto last_rx = std::chrono::steady_clock::now();
+    while (true) {
+        if (server.poll(50) > 0) {
+            last_rx = std::chrono::steady_clock::now();
+        }
+        if (server.frames() >= total) {
+            break;
+        }
+        if (sent_all.load() && std::chrono::steady_clock::now() - last_rx > std::chrono::milliseconds(500)) {
+            break;
+        }
+    }
+    auto end = last_rx;
+    sender.join();
+
+    double secs = std::chrono::duration<double>(end - start).count();
+    uint64_t received = server.frames();
+    uint64_t lost = total > received ? total - received : 0;
+    uint64_t gap_lost = 0;
+    for (const auto &st : server.node_stats()) {
+        gap_lost += st.lost;
+    }
+    std::printf("format=%s nodes=%u len=%u rcvbuf=%d\n", cfg.format.c_str(), cfg.nodes, cfg.len,
+                server.rcvbuf_bytes());
+    std::printf("sent %llu frames, received %llu in %llu datagrams over %.3f s\n",
+                (unsigned long long)total, (unsigned long long)received,
+                (unsigned long long)server.datagrams(), secs);
+    std::printf("sustained %.0f frames/s, loss %llu (%.3f%%, %llu from sequence gaps), malformed %llu\n",
+                received / secs, (unsigned long long)lost, total ? 100.0 * lost / total : 0.0,
+                (unsigned long long)gap_lost, (unsigned long long)server.malformed());
+    return 0;
+}
@@ -0,0 +1,201 @@
+// csi_ingestd: standalone multi-node CSI ingest daemon.
+//
+// Receives the node UDP stream (CSI_DATA text, binary frames or batches),
+// demultiplexes it per stream (node address and transmitter MAC), appends
+// per-stream .csilog files and serves a local AF_UNIX feed for live consumers
+// such as the desktop UI. UDP traffic probes and clock sync requests from the
+// nodes are answered; their rate, health, clock, wake and schedule reports are
+// printed. With --nack, lost frames are asked for again (csi_history.h).
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <unordered_map>
+
+#include "csi/ingest.hpp"
+
+namespace {
+
+volatile std::sig_atomic_t g_stop = 0;
+
+void on_signal(int) { g_stop = 1; }
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--port N] [--bind ADDR] [--out DIR] [--feed PATH]\n"
+                 "          [--rcvbuf BYTES] [--batch N] [--report SECONDS] [--nack]\n",
+                 argv0);
+}
+
+double monotonic_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The shared clock of csi_clock.h and csi_schedule.h.
+int64_t realtime_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// One line per node: where the frames of the last report interval went, and
+// the callback duration and inter-frame interval percentiles over it.
+void print_health(const csi::HealthReport &hr) {
+    const csi_stats_report_t &r = hr.report, &p = hr.previous;
+    uint32_t cb[CSI_STATS_HIST_BINS], gap[CSI_STATS_HIST_BINS];
+    for (int i = 0; i < CSI_STATS_HIST_BINS; i++) {
+        cb[i] = r.callback_us[i] - p.callback_us[i];
+        gap[i] = r.interval_us[i] - p.interval_us[i];
+    }
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &hr.from.sin_addr, ip, sizeof(ip));
+    std::fprintf(stderr,
+                 "  node %s  seen %u  filtered %u  truncated %u  decimated %u  ring full %u  sent %u  "
+                 "send failed %u  resent %u  queue %u/%u  callback p50/p99 <%u/<%u us  interval p50/p99 <%u/<%u us\n",
+                 ip, (unsigned)(r.seen - p.seen), (unsigned)(r.filtered - p.filtered),
+                 (unsigned)(r.truncated - p.truncated), (unsigned)(r.decimated - p.decimated),
+                 (unsigned)(r.ring_full - p.ring_full), (unsigned)(r.sent - p.sent),
+                 (unsigned)(r.send_failed - p.send_failed), (unsigned)(r.resent - p.resent),
+                 (unsigned)r.queue_depth, (unsigned)r.queue_high,
+                 (unsigned)csi_stats_hist_percentile(cb, 50), (unsigned)csi_stats_hist_percentile(cb, 99),
+                 (unsigned)csi_stats_hist_percentile(gap, 50), (unsigned)csi_stats_hist_percentile(gap, 99));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    csi::IngestConfig config;
+    double report_s = 5.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--nack") {
+            config.nack = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--port") {
+            config.port = static_cast<uint16_t>(std::atoi(value));
+        } else if (arg == "--bind") {
+            config.bind_addr = value;
+        } else if (arg == "--out") {
+            config.out_dir = value;
+        } else if (arg == "--feed") {
+            config.feed_path = value;
+        } else if (arg == "--rcvbuf") {
+            config.rcvbuf_bytes = std::atoi(value);
+        } else if (arg == "--batch") {
+            config.recv_batch = static_cast<unsigned>(std::atoi(value));
+        } else if (arg == "--report") {
+            report_s = std::atof(value);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    try {
+        csi::IngestServer server(config);
+        std::fprintf(stderr, "csi_ingestd: listening on %s:%u (rcvbuf %d bytes)%s%s\n",
+                     config.bind_addr.c_str(), server.port(), server.rcvbuf_bytes(),
+                     config.feed_path.empty() ? "" : ", feed ", config.feed_path.c_str());
+
+        std::unordered_map<csi::StreamKey, uint64_t, csi::StreamKeyHash> last_frames;
+        double last_report = monotonic_s();
+        while (!g_stop) {
+            server.poll(200);
+            double now = monotonic_s();
+            if (report_s <= 0 || now - last_report < report_s) {
+                continue;
+            }
+            double elapsed = now - last_report;
+            last_report = now;
+            server.flush();
+            for (const auto &st : server.node_stats()) {
+                uint64_t &prev = last_frames[csi::StreamKey{st.source, csi::mac_key(st.mac)}];
+                uint64_t expected = st.frames + st.lost;
+                char ip[INET_ADDRSTRLEN];
+                struct in_addr source = {st.source};
+                inet_ntop(AF_INET, &source, ip, sizeof(ip));
+                std::fprintf(stderr,
+                             "  %s %02x:%02x:%02x:%02x:%02x:%02x  %8.1f fps  frames %llu  lost %llu (%.2f%%)  rssi %d\n",
+                             ip, st.mac[0], st.mac[1], st.mac[2], st.mac[3], st.mac[4], st.mac[5],
+                             (st.frames - prev) / elapsed, (unsigned long long)st.frames,
+                             (unsigned long long)st.lost, expected ? 100.0 * st.lost / expected : 0.0,
+                             st.last_rssi);
+                prev = st.frames;
+                if (config.nack) {
+                    std::fprintf(stderr, "    recovered %llu  abandoned %llu  nacks %llu\n",
+                                 (unsigned long long)st.recovered, (unsigned long long)st.abandoned,
+                                 (unsigned long long)st.nacks);
+                }
+            }
+            for (const auto &rr : server.rate_reports()) {
+                char ip[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &rr.from.sin_addr, ip, sizeof(ip));
+                std::fprintf(stderr, "  node %s  csi %.1f/%u Hz  jitter %.0f us  %s probe every %u us\n", ip,
+                             rr.report.achieved_hz, (unsigned)rr.report.target_hz, rr.report.jitter_us,
+                             rr.report.probe == CSI_TRAFFIC_PROBE_UDP ? "udp" : "icmp",
+                             (unsigned)rr.report.interval_us);
+            }
+            for (const auto &hr : server.health_reports()) {
+                print_health(hr);
+            }
+            for (const auto &cr : server.clock_reports()) {
+                char ip[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &cr.from.sin_addr, ip, sizeof(ip));
+                std::fprintf(stderr, "  node %s  clock rate correction %+.2f ppm  error <%u us  %u exchanges\n", ip,
+                             cr.report.drift_ppb / 1000.0, (unsigned)cr.report.error_us,
+                             (unsigned)cr.report.samples);
+            }
+            for (const auto &wr : server.wake_reports()) {
+                char ip[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &wr.from.sin_addr, ip, sizeof(ip));
+                const csi_wake_report_t &w = wr.report;
+                std::fprintf(stderr, "  node %s  wake %u %s%s  ip %u ms  first frame %u ms  fast %u/%u\n", ip,
+                             (unsigned)w.wakes, w.fast ? "fast" : "full", w.fell_back ? " (fell back)" : "",
+                             (unsigned)w.marks_ms[CSI_WAKE_IP], (unsigned)w.marks_ms[CSI_WAKE_FIRST_FRAME],
+                             (unsigned)w.fast_ok, (unsigned)(w.fast_ok + w.fast_failed));
+            }
+            for (const auto &sr : server.schedule_reports()) {
+                char ip[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &sr.from.sin_addr, ip, sizeof(ip));
+                const csi_schedule_report_t &p = sr.report;
+                if (p.count == 0) {
+                    std::fprintf(stderr, "  node %s  plan %u cancelled\n", ip, (unsigned)p.id);
+                } else if (p.index >= p.count) {
+                    std::fprintf(stderr, "  node %s  plan %u done (%u windows)\n", ip, (unsigned)p.id, (unsigned)p.count);
+                } else {
+                    std::fprintf(stderr, "  node %s  plan %u  window %u/%u in %.1f s\n", ip, (unsigned)p.id,
+                                 (unsigned)p.index + 1, (unsigned)p.count,
+                                 (p.start_us - realtime_us()) / 1e6);
+                }
+            }
+            std::fprintf(stderr, "  datagrams %llu  malformed %llu  delta desync %llu  subscribers %zu  feed drops %llu  probes echoed %llu  syncs %llu\n",
+                         (unsigned long long)server.datagrams(), (unsigned long long)server.malformed(),
+                         (unsigned long long)server.delta_desync(),
+                         server.subscribers(), (unsigned long long)server.feed_drops(),
+                         (unsigned long long)server.probes_echoed(),
+                         (unsigned long long)server.syncs_answered());
+        }
+        server.flush();
+    } catch (const std::system_error &e) {
+        std::fprintf(stderr, "csi_ingestd: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
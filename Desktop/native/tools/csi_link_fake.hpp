@@ -0,0 +1,157 @@
+// FakeWifi plays the ESP-IDF side of the reconnect state machine (csi_link.c)
+// for csi_link_sim and test_csi_link: it carries out the actions the state
+// machine returns and answers with the events a real station would see, after
+// a simulated delay. A full connect scans every channel, associates (plus the
+// EAP exchange on enterprise networks) and runs DHCP; a fast connect
+// associates to the retained BSSID on the retained channel and succeeds only
+// if the access point is still there, otherwise the CSI_LINK_FAST_TIMEOUT_MS
+// timer fires.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "csi_link.h"
+
+namespace csi::tools {
+
+struct AccessPoint {
+    uint8_t bssid[6] = {0x24, 0x0a, 0xc4, 0x11, 0x22, 0x33};
+    uint8_t channel = 6;
+    bool reachable = true;
+    uint32_t next_ip = 0x0a00a8c0;  // 192.168.0.10, network byte order on a little-endian host
+};
+
+struct WakeResult {
+    csi_link_action_t last = CSI_LINK_ACT_NONE;  // SET_STATIC_IP, READY or GIVE_UP
+    bool fast = false;
+    bool fell_back = false;
+    uint32_t ready_ms = 0;                       // from Wi-Fi start to a usable address
+    uint32_t events = 0;
+};
+
+// The ESP-IDF station as seen by the state machine: actions in, delayed events out.
+class FakeWifi {
+public:
+    FakeWifi(AccessPoint &ap, std::mt19937_64 &rng, bool peap) : ap_(ap), rng_(rng), peap_(peap) {}
+
+    // Runs one wake from csi_link_begin until the link is up or given up. With
+    // drop_after_up, the link is lost once right after it comes up.
+    WakeResult wake(csi_link_retained_t &retained, uint32_t creds_hash, uint32_t now_s, bool drop_after_up = false) {
+        WakeResult result;
+        pending_.clear();
+        now_ms_ = 0;
+        bssid_set_ = false;
+        csi_link_t link;
+        csi_link_action_t action = csi_link_begin(&link, &retained, creds_hash, now_s, now_ms_);
+        result.fast = link.fast;
+        while (true) {
+            apply(action, retained);
+            if (action == CSI_LINK_ACT_GIVE_UP) {
+                result.last = action;
+                break;
+            }
+            if (action == CSI_LINK_ACT_SET_STATIC_IP || action == CSI_LINK_ACT_READY) {
+                result.last = action;
+                result.ready_ms = now_ms_;
+                if (!drop_after_up) {
+                    break;
+                }
+                drop_after_up = false;
+                schedule(50, CSI_LINK_EV_DISCONNECTED);
+            }
+            if (pending_.empty()) {
+                break;
+            }
+            auto next = std::min_element(pending_.begin(), pending_.end(),
+                                         [](const Pending &a, const Pending &b) { return a.at_ms < b.at_ms; });
+            Pending ev = *next;
+            pending_.erase(next);
+            now_ms_ = ev.at_ms;
+            result.events++;
+            action = csi_link_on_event(&link, ev.event, &ev.info, now_s + now_ms_ / 1000, now_ms_);
+        }
+        result.fell_back = link.fell_back;
+        return result;
+    }
+
+private:
+    struct Pending {
+        uint32_t at_ms;
+        csi_link_event_t event;
+        csi_link_info_t info;
+    };
+
+    uint32_t uniform(uint32_t lo, uint32_t hi) {
+        return std::uniform_int_distribution<uint32_t>(lo, hi)(rng_);
+    }
+
+    void schedule(uint32_t delay_ms, csi_link_event_t event, const csi_link_info_t &info = {}) {
+        pending_.push_back(Pending{now_ms_ + delay_ms, event, info});
+    }
+
+    // Association, plus the EAP exchange on enterprise networks.
+    uint32_t associate_ms() { return uniform(30, 90) + (peap_ ? uniform(500, 1200) : 0); }
+
+    void connect(bool fast, const csi_link_retained_t &retained) {
+        csi_link_info_t info = {};
+        std::memcpy(info.bssid, ap_.bssid, sizeof(info.bssid));
+        info.channel = ap_.channel;
+        if (fast) {
+            // Only the retained channel is probed: a moved or replaced AP is simply not there.
+            pending_.push_back(Pending{now_ms_ + CSI_LINK_FAST_TIMEOUT_MS, CSI_LINK_EV_TIMEOUT, {}});
+            if (ap_.reachable && retained.channel == ap_.channel &&
+                std::memcmp(retained.bssid, ap_.bssid, sizeof(ap_.bssid)) == 0) {
+                schedule(uniform(20, 60) + associate_ms(), CSI_LINK_EV_CONNECTED, info);
+            }
+            return;
+        }
+        const uint32_t scan = uniform(1200, 2200);  // active scan of channels 1-13
+        if (!ap_.reachable) {
+            schedule(scan, CSI_LINK_EV_DISCONNECTED);
+            return;
+        }
+        const uint32_t assoc = scan + associate_ms();
+        schedule(assoc, CSI_LINK_EV_CONNECTED, info);
+        csi_link_info_t ip = {};
+        ip.ip = ap_.next_ip;
+        ip.netmask = 0x00ffffff;
+        ip.gw = 0x0100a8c0;
+        schedule(assoc + uniform(300, 2500), CSI_LINK_EV_GOT_IP, ip);
+    }
+
+    void apply(csi_link_action_t action, const csi_link_retained_t &retained) {
+        switch (action) {
+        case CSI_LINK_ACT_CONNECT_FAST:
+            bssid_set_ = true;
+            connect(true, retained);
+            break;
+        case CSI_LINK_ACT_CONNECT_FULL:
+            // Leaving the fast configuration cancels the attempt and its timer.
+            pending_.clear();
+            bssid_set_ = false;
+            connect(false, retained);
+            break;
+        case CSI_LINK_ACT_RECONNECT:
+            connect(bssid_set_, retained);
+            break;
+        case CSI_LINK_ACT_SET_STATIC_IP:
+            pending_.clear();  // the fast timer is stopped
+            break;
+        default:
+            break;
+        }
+    }
+
+    AccessPoint &ap_;
+    std::mt19937_64 &rng_;
+    bool peap_;
+    bool bssid_set_ = false;
+    uint32_t now_ms_ = 0;
+    std::vector<Pending> pending_;
+};
+
+}  // namespace csi::tools
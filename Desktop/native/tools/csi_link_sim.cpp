@@ -0,0 +1,127 @@
+// csi_link_sim: the firmware's reconnect state machine (csi_link.c) against a
+// fake Wi-Fi layer (csi_link_fake.hpp; the EAP exchange with --auth peap).
+//
+// Runs --wakes wake cycles --sleep-s apart, with the access point changing
+// channel with probability --move-prob before each wake, twice: with the
+// retained state, and with it wiped on every wake as the firmware did before.
+// Reports the time from Wi-Fi start to a usable address for both. Exits with
+// status 1 if fast resume is not faster at the median. The step-by-step
+// scenarios are in tests/test_csi_link.cpp.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csi_link.h"
+#include "csi_link_fake.hpp"
+
+namespace {
+
+using csi::tools::AccessPoint;
+using csi::tools::FakeWifi;
+using csi::tools::WakeResult;
+
+struct Options {
+    unsigned wakes = 1000;
+    double move_prob = 0.02;
+    double sleep_s = 5;
+    bool peap = false;
+    uint64_t seed = 1;
+};
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--wakes N] [--move-prob P] [--sleep-s S] [--auth psk|peap] [--seed N]\n", argv0);
+}
+
+double percentile(std::vector<uint32_t> v, double p) {
+    if (v.empty()) {
+        return 0;
+    }
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(p / 100.0 * static_cast<double>(v.size()));
+    return v[std::min(i, v.size() - 1)];
+}
+
+// Wake cycles with the access point occasionally moving; returns the time to an address of each wake.
+std::vector<uint32_t> run_cycles(const Options &opt, bool retain, unsigned *fast, unsigned *fell_back) {
+    std::mt19937_64 rng(opt.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    AccessPoint ap;
+    FakeWifi wifi(ap, rng, opt.peap);
+    csi_link_retained_t retained = {};
+    const uint32_t creds = csi_link_hash(CSI_LINK_HASH_INIT, "lab");
+    double now_s = 1700000000;
+    std::vector<uint32_t> ready;
+    *fast = *fell_back = 0;
+    for (unsigned i = 0; i < opt.wakes; i++) {
+        if (unit(rng) < opt.move_prob) {
+            ap.channel = static_cast<uint8_t>(ap.channel % 13 + 1);
+        }
+        if (!retain) {
+            retained = {};
+        }
+        WakeResult r = wifi.wake(retained, creds, static_cast<uint32_t>(now_s));
+        ready.push_back(r.ready_ms);
+        *fast += r.fast && !r.fell_back;
+        *fell_back += r.fell_back;
+        now_s += opt.sleep_s + r.ready_ms / 1000.0;
+    }
+    return ready;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--wakes") {
+            opt.wakes = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--move-prob") {
+            opt.move_prob = std::atof(value);
+        } else if (arg == "--sleep-s") {
+            opt.sleep_s = std::atof(value);
+        } else if (arg == "--auth") {
+            if (std::strcmp(value, "psk") != 0 && std::strcmp(value, "peap") != 0) {
+                usage(argv[0]);
+                return 2;
+            }
+            opt.peap = std::strcmp(value, "peap") == 0;
+        } else if (arg == "--seed") {
+            opt.seed = std::strtoull(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opt.wakes == 0 || opt.move_prob < 0 || opt.move_prob > 1 || opt.sleep_s < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    unsigned fast, fell_back, baseline_fast, baseline_fell_back;
+    std::vector<uint32_t> resumed = run_cycles(opt, true, &fast, &fell_back);
+    std::vector<uint32_t> baseline = run_cycles(opt, false, &baseline_fast, &baseline_fell_back);
+    std::printf("%u wakes %.0f s apart, AP moves with probability %.3f per wake:\n", opt.wakes, opt.sleep_s,
+                opt.move_prob);
+    std::printf("  %-24s p50 %6.0f  p99 %6.0f  max %6.0f ms  (%u fast, %u fell back)\n", "retained state",
+                percentile(resumed, 50), percentile(resumed, 99), percentile(resumed, 100), fast, fell_back);
+    std::printf("  %-24s p50 %6.0f  p99 %6.0f  max %6.0f ms\n", "full connect every wake", percentile(baseline, 50),
+                percentile(baseline, 99), percentile(baseline, 100));
+    if (percentile(resumed, 50) >= percentile(baseline, 50)) {
+        std::printf("FAIL: fast resume not faster at the median\n");
+        return 1;
+    }
+    std::printf("OK: fast resume faster at the median\n");
+    return 0;
+}
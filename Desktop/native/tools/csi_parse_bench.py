@@ -0,0 +1,240 @@
+#!/usr/bin/env python3
+# csi_parse_bench: the native text parser (libcsi_parse through
+# Desktop/csi_fastparse.py) against the Python path it replaces.
+#
+# Writes N synthetic frames as a log of CSI_DATA lines and as csi_data tables
+# in both legacy layouts (older desktop: timestamp/scenario, Android:
+# data_hora/cenario), with a few malformed entries mixed in. Then it loads
+# them:
+#   python lines   csi_store.parse_csi_line on every line (split and int)
+#   python table   SELECT, then ast.literal_eval of every data column
+#   native lines   csi_fastparse.iter_lines, SSE2 and scalar scanners
+#   native table   csi_fastparse.load_table, SSE2 and scalar, both layouts
+# Every native result must match the Python one value for value, and the
+# malformed entries must be skipped by both. Before timing, --fuzz random
+# lists (valid, and mutated with spaces, signs, long digit runs and stray
+# characters) must get the same values or the same rejection from both
+# scanners and from Python's int(). Exits 1 on a mismatch.
+import argparse
+import ast
+import os
+import random
+import sqlite3
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..'))
+
+import csi_fastparse  # noqa: E402
+from csi_store import parse_csi_line  # noqa: E402
+
+LEGACY_COLUMNS = ('seq, mac, rssi, rate, sig_mode, mcs, bandwidth, smoothing, not_sounding, aggregation, stbc, '
+                  'fec_coding, sgi, noise_floor, ampdu_cnt, channel, secondary_channel, local_timestamp, ant, '
+                  'sig_len, rx_state, len, first_word, data')
+LAYOUTS = {'desktop': ('timestamp', 'scenario'), 'android': ('data_hora', 'cenario')}
+
+failures = 0
+
+
+def expect(ok, scenario, what):
+    global failures
+    if not ok:
+        print(f"  FAIL {scenario}: {what}")
+        failures += 1
+
+
+def synthesize(frames, values, malformed_every):
+    """CSI_DATA lines of frames frames at 100 Hz from two transmitters, one in malformed_every broken."""
+    rng = random.Random(1)
+    lines = []
+    for i in range(frames):
+        mac = 'aa:bb:cc:dd:ee:%02x' % (1 + i % 2)
+        payload = ','.join(str(rng.randint(-128, 127)) for _ in range(values))
+        if malformed_every and i % malformed_every == malformed_every - 1:
+            payload += ',x'
+        lines.append(f'CSI_DATA,{i // 2},{mac},{rng.randint(-90, -30)},11,1,7,0,1,1,0,0,0,0,{rng.randint(-97, -90)},'
+                     f'0,6,0,{10000 * i},0,{values},0,{values},0,"[{payload}]"')
+    return lines
+
+
+def write_table(path, layout, lines):
+    time_col, scenario_col = LAYOUTS[layout]
+    conn = sqlite3.connect(path)
+    conn.execute(f'CREATE TABLE csi_data (id INTEGER PRIMARY KEY AUTOINCREMENT, {time_col} TEXT, '
+                 f'{scenario_col} TEXT, type TEXT, seq INTEGER, mac TEXT, rssi INTEGER, rate REAL, '
+                 'sig_mode INTEGER, mcs INTEGER, bandwidth INTEGER, smoothing INTEGER, not_sounding INTEGER, '
+                 'aggregation INTEGER, stbc INTEGER, fec_coding INTEGER, sgi INTEGER, noise_floor INTEGER, '
+                 'ampdu_cnt INTEGER, channel INTEGER, secondary_channel INTEGER, local_timestamp INTEGER, '
+                 'ant INTEGER, sig_len INTEGER, rx_state INTEGER, len INTEGER, first_word INTEGER, data TEXT)')
+    rows = []
+    for line in lines:
+        parts = line.split(',', 24)
+        # save_to_db stripped the quotes, addCsiData removed them.
+        rows.append(['2024-01-01 00:00:00', 'bench', 'CSI_DATA'] + parts[1:24] + [parts[24].replace('"', '')])
+    conn.executemany(f'INSERT INTO csi_data ({time_col}, {scenario_col}, type, {LEGACY_COLUMNS}) '
+                     'VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)', rows)
+    conn.commit()
+    conn.close()
+
+
+def python_payload(text):
+    body = text.strip().strip('"')
+    if len(body) < 2 or body[0] != '[' or body[-1] != ']':
+        return None
+    body = body[1:-1]
+    try:
+        values = [int(v) for v in body.split(',')] if body else []
+    except ValueError:
+        return None
+    return values if all(-128 <= v <= 127 for v in values) else None
+
+
+def fuzz(count, simd):
+    rng = random.Random(2)
+    for i in range(count):
+        entries = [str(rng.randint(-128, 127)) for _ in range(rng.randint(0, 80))]
+        text = '[' + ','.join(entries) + ']'
+        if i % 2:
+            chars = list(text)
+            for _ in range(rng.randint(1, 3)):
+                pos = rng.randrange(1, len(chars))
+                chars.insert(pos, rng.choice(' -+,0123456789a'))
+            text = ''.join(chars)
+        expected = python_payload(text)
+        for isa in ([True, False] if simd else [False]):
+            csi_fastparse.use_simd(isa)
+            try:
+                got = list(csi_fastparse.parse_payload(text))
+            except ValueError:
+                got = None
+            if got != expected:
+                expect(False, f"fuzz/{'sse2' if isa else 'scalar'}", f"{text!r}: {got}, python {expected}")
+                return
+    csi_fastparse.use_simd(simd)
+
+
+def python_lines(path):
+    frames = []
+    with open(path) as f:
+        for line in f:
+            frame = parse_csi_line(line.rstrip('\n'))
+            if frame is not None:
+                frames.append(frame)
+    return frames
+
+
+def python_table(path):
+    frames = []
+    conn = sqlite3.connect(path)
+    for row in conn.execute(f'SELECT {LEGACY_COLUMNS} FROM csi_data ORDER BY id'):
+        try:
+            values = ast.literal_eval(row[23])
+        except (ValueError, SyntaxError):
+            continue
+        frames.append(row[:23] + (values,))
+    conn.close()
+    return frames
+
+
+def native_lines(path, width):
+    return list(csi_fastparse.iter_lines(path, width))
+
+
+def compare(scenario, reference, chunks, width):
+    """reference: tuples as returned by parse_csi_line (payload as bytes) or python_table (list)."""
+    rows = sum(c.rows for c in chunks)
+    expect(rows == len(reference), scenario, f"{rows} frames, python {len(reference)}")
+    seq, rssi, timestamp, length = (csi_fastparse.COLUMNS.index(c) for c in ('seq', 'rssi', 'timestamp', 'len'))
+    columns = len(csi_fastparse.COLUMNS)
+    i = 0
+    for chunk in chunks:
+        for r in range(chunk.rows):
+            if i >= len(reference):
+                return
+            ref = reference[i]
+            payload = ref[23]
+            values = list(payload) if isinstance(payload, list) else [b - 256 if b > 127 else b for b in payload]
+            meta = chunk.meta[r * columns:(r + 1) * columns]
+            ok = (meta[seq] == ref[0] and chunk.mac_text(r) == ref[1] and meta[rssi] == ref[2]
+                  and meta[timestamp] == ref[17] and meta[length] == len(values)
+                  and list(chunk.row(r)) == (values + [0] * width)[:width])
+            if not ok:
+                expect(False, scenario, f"frame {i} differs")
+                return
+            i += 1
+
+
+def timed(fn, *args):
+    start = time.perf_counter()
+    result = fn(*args)
+    return result, time.perf_counter() - start
+
+
+def report(name, frames, seconds, baseline=None):
+    speedup = f"  {baseline / seconds:6.1f}x" if baseline else ""
+    print(f"{name:30s} {frames / seconds:12.0f} frames/s  {seconds:8.3f} s{speedup}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--frames', type=int, default=100000)
+    parser.add_argument('--values', type=int, default=128, help="payload values per frame")
+    parser.add_argument('--malformed-every', type=int, default=1000)
+    parser.add_argument('--fuzz', type=int, default=20000, help="random lists checked against Python")
+    parser.add_argument('--lib', help="path to libcsi_parse.so")
+    args = parser.parse_args()
+    if args.frames <= 0 or not 0 < args.values <= csi_fastparse.MAX_PAYLOAD:
+        parser.print_usage(sys.stderr)
+        return 2
+    if args.lib:
+        os.environ['CSI_PARSE_LIB'] = args.lib
+    try:
+        csi_fastparse.load_library()
+    except OSError as e:
+        print(e, file=sys.stderr)
+        return 2
+    simd = csi_fastparse.use_simd()
+    fuzz(args.fuzz, simd)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        lines = synthesize(args.frames, args.values, args.malformed_every)
+        log = os.path.join(tmp, 'capture.log')
+        with open(log, 'w') as f:
+            f.write('I (312) wifi: boot\n' + '\n'.join(lines) + '\n')
+        dbs = {layout: os.path.join(tmp, f'{layout}.db') for layout in LAYOUTS}
+        for layout, path in dbs.items():
+            write_table(path, layout, lines)
+        print(f"{args.frames} frames of {args.values} values, scanner {'sse2' if simd else 'scalar'}")
+
+        reference, py_lines_s = timed(python_lines, log)
+        report("python lines (split)", args.frames, py_lines_s)
+        table_reference, py_table_s = timed(python_table, dbs['desktop'])
+        report("python table (literal_eval)", args.frames, py_table_s)
+        expect(len(reference) == len(table_reference), "python", "lines and table disagree")
+
+        for isa in ([True, False] if simd else [False]):
+            csi_fastparse.use_simd(isa)
+            name = 'sse2' if isa else 'scalar'
+            chunks, seconds = timed(native_lines, log, args.values)
+            report(f"native lines ({name})", args.frames, seconds, py_lines_s)
+            compare(f"lines/{name}", reference, chunks, args.values)
+            expect(sum(c.skipped for c in chunks) == args.frames - len(reference), f"lines/{name}",
+                   "malformed lines not skipped")
+            for layout, path in dbs.items():
+                frames, seconds = timed(csi_fastparse.load_table, path)
+                report(f"native table {layout} ({name})", args.frames, seconds, py_table_s)
+                compare(f"table/{layout}/{name}", table_reference, [frames], args.values)
+                expect(frames.skipped == args.frames - len(table_reference), f"table/{layout}/{name}",
+                       "malformed rows not skipped")
+        csi_fastparse.use_simd(simd)
+
+    if failures:
+        print(f"{failures} check(s) failed")
+        return 1
+    print("OK: native parser matches the Python path")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,332 @@
+// csi_schedule_sim: the firmware's scheduled acquisition (csi_schedule.c)
+// against simulated nodes.
+//
+// --nodes nodes run a plan of --windows windows of --duration-s every
+// --interval-s, the way run_schedule in app_main.c does: sync, pick the next
+// window, deep sleep until its lead or wait for its start, capture, listen,
+// sleep to the next lead. The plan arithmetic itself is checked step by step
+// in tests/test_csi_schedule.c.
+//
+// Each node has its own RTC slow clock error (uniform within --rtc-ppm),
+// which is what its system time drifts by in deep sleep, and a sync that
+// leaves an error of --sync-error-us (standard deviation) or fails with
+// probability --sync-fail-prob. Boot, fast resume or full connect
+// (csi_link.h; the retained state expires after CSI_LINK_MAX_AGE_S and the
+// access point moves with probability --move-prob per wake) and the sync
+// burst take randomised times. The start error of a window is when the node
+// really began capturing minus the planned start.
+//
+// The same plan is also run against the start command cycle the node used
+// before: wake every DEEP_SLEEP_INTERVAL_S, listen UDP_LISTEN_WINDOW_S,
+// with the collector sending "start" every 3 s from the planned start. Both
+// report the start error, windows missed and the radio time outside the
+// windows. Exits with status 1 if a scheduled window is missed, the scheduled
+// p95 start error exceeds --max-start-error-ms or the schedule keeps the radio
+// on longer outside the windows than the start command cycle. (A wake whose
+// fast resume fails needs seconds more than its lead and starts late; those
+// are counted as late, and --move-prob 0 shows the schedule without them.)
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csi_clock.h"
+#include "csi_link.h"
+#include "csi_schedule.h"
+
+namespace {
+
+// Firmware constants of app_main.c.
+constexpr int64_t kDeepSleepIntervalUs = 5000000;   // DEEP_SLEEP_INTERVAL_S
+constexpr int64_t kListenWindowUs = 10000000;       // UDP_LISTEN_WINDOW_S
+constexpr int64_t kSleepFlushUs = 100000;           // log flush before deep sleep
+constexpr int64_t kCommandResendUs = 3000000;       // csi_listener.py start command resend
+constexpr int64_t kEpochUs = 1700000000LL * 1000000;
+
+struct Options {
+    unsigned nodes = 8;
+    unsigned windows = 24;
+    unsigned interval_s = 300;
+    unsigned duration_s = 30;
+    unsigned first_in_s = 60;
+    double rtc_ppm = 1500;
+    double sync_error_us = 500;
+    double sync_fail_prob = 0;
+    double move_prob = 0.02;
+    double max_start_error_ms = 20;
+    uint64_t seed = 1;
+};
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--nodes N] [--windows N] [--interval-s S] [--duration-s S] [--first-in-s S]\n"
+                 "          [--rtc-ppm P] [--sync-error-us U] [--sync-fail-prob P] [--move-prob P]\n"
+                 "          [--max-start-error-ms MS] [--seed N]\n",
+                 argv0);
+}
+
+struct Result {
+    std::vector<double> start_error_ms;  // per captured window
+    unsigned missed = 0;
+    unsigned wakes = 0;
+    double awake_s = 0;                  // radio on, whole run
+    double captured_s = 0;               // of which inside windows
+};
+
+struct NodeState {
+    std::mt19937_64 rng;
+    double rate;                         // RTC slow clock error, fraction
+    int64_t error_us;                    // system time minus shared time
+    csi_link_retained_t retained = {};
+    uint32_t lead_ms = 0;
+
+    explicit NodeState(uint64_t seed) : rng(seed), rate(0), error_us(0) {}
+
+    int64_t uniform(int64_t lo, int64_t hi) { return std::uniform_int_distribution<int64_t>(lo, hi)(rng); }
+    bool chance(double p) { return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < p; }
+};
+
+constexpr uint32_t kCreds = 0x5eed;
+
+// Boot plus connect, in microseconds; updates the retained state as csi_link does.
+int64_t wake_connect_us(NodeState &node, int64_t sys_us, double move_prob) {
+    int64_t t = node.uniform(180000, 260000);  // boot to Wi-Fi start
+    const uint32_t sys_s = static_cast<uint32_t>(sys_us / 1000000);
+    if (csi_link_retained_valid(&node.retained, kCreds, sys_s) && !node.chance(move_prob)) {
+        return t + node.uniform(60000, 160000);
+    }
+    if (csi_link_retained_valid(&node.retained, kCreds, sys_s)) {
+        t += CSI_LINK_FAST_TIMEOUT_MS * 1000;  // the fast resume timed out
+    }
+    t += node.uniform(1500000, 4700000);       // scan, associate, DHCP
+    node.retained.magic = CSI_LINK_MAGIC;
+    node.retained.creds_hash = kCreds;
+    node.retained.valid = 1;
+    node.retained.channel = 6;
+    node.retained.ip = 0x0a00a8c0;
+    node.retained.learned_s = static_cast<uint32_t>((sys_us + t) / 1000000);
+    return t;
+}
+
+// schedule_lead_ms of app_main.c.
+uint32_t lead_for(const NodeState &node, int64_t start_us) {
+    const uint32_t wake_s = static_cast<uint32_t>((start_us - int64_t{CSI_SCHEDULE_MAX_LEAD_MS} * 1000) / 1000000);
+    return csi_link_retained_valid(&node.retained, kCreds, wake_s) ? node.lead_ms : CSI_SCHEDULE_MAX_LEAD_MS;
+}
+
+// Deep sleep of sleep_us as measured by the RTC; the system time advances by
+// that much while the real time passes at the slow clock's rate.
+void deep_sleep(NodeState &node, int64_t &true_us, int64_t sleep_us) {
+    const int64_t real = static_cast<int64_t>(static_cast<double>(sleep_us) / (1.0 + node.rate));
+    node.error_us += sleep_us - real;
+    true_us += real;
+}
+
+void run_scheduled(const Options &opt, const csi_schedule_t &plan, int64_t begin_us, uint64_t seed, Result &out) {
+    NodeState node(seed);
+    node.rate = (static_cast<double>(node.uniform(-1000000, 1000000)) / 1e6) * opt.rtc_ppm * 1e-6;
+    node.error_us = node.uniform(-2000000, 2000000);  // not synced yet
+    std::normal_distribution<double> sync_error(0.0, opt.sync_error_us);
+    std::vector<bool> captured(plan.count, false);
+
+    // The plan arrives in a listen window some time before the first window.
+    int64_t true_us = begin_us + node.uniform(0, (plan.first_start_us - begin_us) / 2);
+    int64_t boot_us = wake_connect_us(node, true_us + node.error_us, opt.move_prob);
+    true_us += boot_us;
+    for (;;) {
+        out.wakes++;
+        const int64_t awake_from = true_us - boot_us;
+        // csi_clock_sync_now: a burst of exchanges, then settimeofday.
+        const int64_t sync_us = CSI_CLOCK_BURST * (CSI_CLOCK_BURST_SPACING_MS * 1000 + node.uniform(2000, 20000));
+        true_us += sync_us;
+        if (!node.chance(opt.sync_fail_prob)) {
+            node.error_us = static_cast<int64_t>(sync_error(node.rng));
+        }
+        node.lead_ms = csi_schedule_lead_ms(node.lead_ms, static_cast<uint32_t>((boot_us + sync_us) / 1000));
+
+        uint32_t index;
+        int64_t start_us, now_us = true_us + node.error_us;
+        if (!csi_schedule_window(&plan, now_us, &index, &start_us)) {
+            out.awake_s += (true_us - awake_from + kSleepFlushUs) / 1e6;
+            break;
+        }
+        int64_t sleep_us = static_cast<int64_t>(csi_schedule_sleep_us(now_us, start_us, lead_for(node, start_us)));
+        if (sleep_us == 0) {
+            // Wait for the start on the crystal, or join the open window.
+            true_us += std::max<int64_t>(0, start_us - now_us);
+            const int64_t planned_true_us = start_us;  // the shared clock is true time
+            out.start_error_ms.push_back((true_us - planned_true_us) / 1000.0);
+            captured[index] = true;
+            const int64_t end_us = start_us + int64_t{plan.duration_s} * 1000000;
+            const int64_t capture_us = end_us - (true_us + node.error_us);
+            true_us += capture_us;
+            out.captured_s += capture_us / 1e6;
+            true_us += CSI_SCHEDULE_LISTEN_S * 1000000LL;
+            now_us = true_us + node.error_us;
+            int64_t next_start_us;
+            sleep_us = 1000;
+            if (csi_schedule_window(&plan, now_us, &index, &next_start_us)) {
+                sleep_us = std::max<int64_t>(1000, static_cast<int64_t>(csi_schedule_sleep_us(
+                                                       now_us, next_start_us, lead_for(node, next_start_us))));
+            }
+        }
+        // enter_deep_sleep_us: the flush is part of the requested time.
+        out.awake_s += (true_us - awake_from) / 1e6 + std::min(sleep_us, kSleepFlushUs) / 1e6;
+        true_us += std::min(sleep_us, kSleepFlushUs);
+        deep_sleep(node, true_us, std::max<int64_t>(0, sleep_us - kSleepFlushUs));
+        boot_us = wake_connect_us(node, true_us + node.error_us, opt.move_prob);
+        true_us += boot_us;
+    }
+    out.missed += static_cast<unsigned>(std::count(captured.begin(), captured.end(), false));
+}
+
+// The start command cycle: the collector sends start at the planned start and
+// every kCommandResendUs after, until the node's first frame.
+void run_polling(const Options &opt, const csi_schedule_t &plan, int64_t begin_us, uint64_t seed, Result &out) {
+    NodeState node(seed ^ 0x9e3779b97f4a7c15ULL);
+    const int64_t duration_us = int64_t{plan.duration_s} * 1000000;
+    const int64_t end_us = plan.first_start_us + int64_t{plan.interval_s} * 1000000 * (plan.count - 1) + duration_us;
+    uint32_t index = 0;
+    int64_t true_us = begin_us + node.uniform(0, kDeepSleepIntervalUs);
+    while (true_us < end_us && index < plan.count) {
+        out.wakes++;
+        const int64_t awake_from = true_us;
+        true_us += wake_connect_us(node, true_us, opt.move_prob);
+        const int64_t listen_end = true_us + kListenWindowUs;
+        const int64_t start_us = plan.first_start_us + int64_t{index} * plan.interval_s * 1000000;
+        // First command at or after the node starts listening.
+        int64_t command_us = start_us;
+        if (command_us < true_us) {
+            command_us += (true_us - start_us + kCommandResendUs - 1) / kCommandResendUs * kCommandResendUs;
+        }
+        if (command_us < listen_end && command_us < start_us + duration_us) {
+            true_us = command_us + 5000;
+            out.start_error_ms.push_back((true_us - start_us) / 1000.0);
+            true_us += duration_us;
+            out.captured_s += duration_us / 1e6;
+            index++;
+        } else {
+            true_us = listen_end;
+            if (start_us + duration_us <= true_us) {
+                out.missed++;  // the whole window went by while the node slept
+                index++;
+            }
+        }
+        out.awake_s += (true_us - awake_from + kSleepFlushUs) / 1e6;
+        true_us += kDeepSleepIntervalUs;
+    }
+    out.missed += plan.count - index;
+}
+
+double percentile(std::vector<double> v, double p) {
+    if (v.empty()) {
+        return 0;
+    }
+    std::sort(v.begin(), v.end());
+    size_t i = static_cast<size_t>(p / 100.0 * static_cast<double>(v.size()));
+    return v[std::min(i, v.size() - 1)];
+}
+
+std::vector<double> magnitudes(const Result &r) {
+    std::vector<double> magnitude(r.start_error_ms.size());
+    std::transform(r.start_error_ms.begin(), r.start_error_ms.end(), magnitude.begin(),
+                   [](double e) { return std::fabs(e); });
+    return magnitude;
+}
+
+void print_result(const char *name, const Result &r, unsigned windows, double late_ms) {
+    std::vector<double> magnitude = magnitudes(r);
+    std::printf("  %-20s %4zu/%-4u windows  |start error| p50 %8.1f  p95 %8.1f  p99 %8.1f  max %8.1f ms\n", name,
+                r.start_error_ms.size(), windows, percentile(magnitude, 50), percentile(magnitude, 95),
+                percentile(magnitude, 99), percentile(magnitude, 100));
+    std::printf("  %-20s %4u missed  %4zu late  %5.1f wakes/window  %6.1f s awake outside windows per window\n",
+                "", r.missed,
+                static_cast<size_t>(std::count_if(magnitude.begin(), magnitude.end(),
+                                                  [late_ms](double e) { return e > late_ms; })),
+                static_cast<double>(r.wakes) / windows, (r.awake_s - r.captured_s) / windows);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--nodes") {
+            opt.nodes = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--windows") {
+            opt.windows = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--interval-s") {
+            opt.interval_s = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--duration-s") {
+            opt.duration_s = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--first-in-s") {
+            opt.first_in_s = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--rtc-ppm") {
+            opt.rtc_ppm = std::atof(value);
+        } else if (arg == "--sync-error-us") {
+            opt.sync_error_us = std::atof(value);
+        } else if (arg == "--sync-fail-prob") {
+            opt.sync_fail_prob = std::atof(value);
+        } else if (arg == "--move-prob") {
+            opt.move_prob = std::atof(value);
+        } else if (arg == "--max-start-error-ms") {
+            opt.max_start_error_ms = std::atof(value);
+        } else if (arg == "--seed") {
+            opt.seed = std::strtoull(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opt.nodes == 0 || opt.windows == 0 || opt.duration_s == 0 || opt.first_in_s < 20 || opt.rtc_ppm < 0 ||
+        opt.sync_error_us < 0 || opt.sync_fail_prob < 0 || opt.sync_fail_prob > 1 || opt.move_prob < 0 ||
+        opt.move_prob > 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    char command[160];
+    csi_schedule_t plan = {};
+    const int64_t begin_us = kEpochUs;
+    std::snprintf(command, sizeof(command), "schedule,1,%" PRId64 ",%u,%u,start,%u",
+                  begin_us + int64_t{opt.first_in_s} * 1000000, opt.interval_s, opt.windows, opt.duration_s);
+    if (csi_schedule_parse(command, &plan) != CSI_SCHEDULE_OK) {
+        std::fprintf(stderr, "invalid plan: %s\n", command);
+        return 2;
+    }
+
+    Result scheduled, polling;
+    for (unsigned n = 0; n < opt.nodes; n++) {
+        run_scheduled(opt, plan, begin_us, opt.seed * 1000 + n, scheduled);
+        run_polling(opt, plan, begin_us, opt.seed * 1000 + n, polling);
+    }
+    const unsigned windows = opt.nodes * opt.windows;
+    std::printf("%u nodes, %u windows of %u s every %u s, RTC within %.0f ppm, sync error %.0f us:\n", opt.nodes,
+                opt.windows, opt.duration_s, opt.interval_s, opt.rtc_ppm, opt.sync_error_us);
+    print_result("scheduled", scheduled, windows, opt.max_start_error_ms);
+    print_result("start command cycle", polling, windows, opt.max_start_error_ms);
+
+    const char *failure =
+        scheduled.missed != 0 ? "a scheduled window was missed"
+        : percentile(magnitudes(scheduled), 95) > opt.max_start_error_ms ? "scheduled p95 start error above the limit"
+        : scheduled.awake_s - scheduled.captured_s >= polling.awake_s - polling.captured_s
+            ? "no less radio time outside the windows than the start command cycle"
+            : nullptr;
+    if (failure) {
+        std::printf("FAIL: %s\n", failure);
+        return 1;
+    }
+    std::printf("OK: every window captured, p95 start error within %.0f ms\n", opt.max_start_error_ms);
+    return 0;
+}
@@ -0,0 +1,302 @@
+// csi_sources_sim: multi-source capture (csi_sources.c) against simulated
+// transmitters.
+//
+// --transmitters transmitters send frames for --seconds, each at its own rate
+// around --rate-hz with arrival jitter, and a node captures them the way
+// wifi_csi_rx_cb and wifi_csi_process in app_main.c do: look the transmitter
+// up, apply dec and rate to its own decimator, number the frame in its own
+// sequence and serialize it. The
+// collector decodes the stream with csi::DatagramDecoder and follows the
+// sequence numbers per transmitter, as csi_ingestd does.
+//
+// The capture runs once with src=any, once with an allowlist of --allow of
+// the transmitters, and once more with src=any numbering every frame from a
+// single counter, as the node did before, to show the losses the collector
+// would then see on each transmitter. Reported are the frames kept and
+// rejected, the rate of each stream against the rate limit and the cost of a
+// lookup in the CSI callback. Exits with status 1 if a run does not capture
+// one stream per allowed transmitter, a stream of the per-source runs shows a
+// gap or a stream exceeds the rate limit. The src option and the source table
+// are checked step by step in tests/test_csi_sources.c.
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "csi/datagram.hpp"
+#include "csi_capture.h"
+#include "csi_frame.h"
+#include "csi_sources.h"
+
+namespace {
+
+constexpr uint16_t kPayloadLen = 128;
+constexpr uint8_t kApMac[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+
+struct Options {
+    unsigned seconds = 20;
+    unsigned transmitters = 24;
+    unsigned rate_hz = 50;
+    unsigned limit_hz = 20;
+    unsigned allow = 3;
+    unsigned lookups = 10000000;
+    uint64_t seed = 1;
+};
+
+void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--seconds S] [--transmitters N] [--rate-hz N] [--limit-hz N] [--allow N]\n"
+                 "          [--lookups N] [--seed N]\n",
+                 argv0);
+}
+
+// Transmitter i; 0 is the access point. Stations of one vendor share the OUI.
+void transmitter_mac(unsigned i, uint8_t mac[6]) {
+    std::memcpy(mac, kApMac, 6);
+    if (i > 0) {
+        mac[0] = 0x3c;
+        mac[1] = 0x71;
+        mac[2] = 0xbf;
+        mac[3] = 0x00;
+        mac[4] = static_cast<uint8_t>(i >> 8);
+        mac[5] = static_cast<uint8_t>(i);
+    }
+}
+
+std::string mac_text(const uint8_t mac[6]) {
+    char buf[18];
+    std::snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return buf;
+}
+
+bool parse(const std::string &cmd, csi_capture_config_t &cfg) {
+    return csi_capture_parse_start(cmd.c_str(), &cfg) == CSI_CAPTURE_OK;
+}
+
+struct Event {
+    int64_t us;
+    unsigned tx;
+};
+
+struct Stream {
+    uint64_t frames = 0;
+    uint64_t lost = 0;
+    uint32_t next_seq = 0;
+    int64_t first_us = -1;
+    int64_t last_us = 0;
+};
+
+struct Result {
+    uint64_t offered = 0;
+    uint64_t kept = 0;
+    uint64_t limited = 0;
+    uint32_t rejected = 0;
+    uint32_t overflow = 0;
+    std::map<std::string, Stream> streams;
+    double max_rate_hz = 0;
+};
+
+std::vector<Event> make_arrivals(const Options &opt) {
+    std::mt19937_64 rng(opt.seed);
+    std::uniform_real_distribution<double> spread(0.5, 1.5), jitter(-0.3, 0.3);
+    std::vector<Event> events;
+    const int64_t total_us = int64_t{opt.seconds} * 1000000;
+    for (unsigned tx = 0; tx < opt.transmitters; tx++) {
+        const double period_us = 1e6 / (opt.rate_hz * spread(rng));
+        int64_t us = static_cast<int64_t>(period_us * (0.5 + jitter(rng)));
+        while (us < total_us) {
+            events.push_back({us, tx});
+            us += static_cast<int64_t>(period_us * (1 + jitter(rng)));
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.us < b.us; });
+    return events;
+}
+
+void run(const std::vector<Event> &events, const std::string &command, bool one_counter, Result &out) {
+    csi_capture_config_t cfg;
+    parse(command, cfg);
+    csi_sources_t sources;
+    csi_sources_init(&sources);
+    csi_sources_configure(&sources, &cfg, kApMac);
+    uint32_t counter = 0;
+    int8_t payload[kPayloadLen] = {};
+    std::vector<uint8_t> datagram(CSI_FRAME_BIN_SIZE(kPayloadLen));
+    csi::DatagramDecoder decoder;
+    for (const Event &e : events) {
+        out.offered++;
+        uint8_t mac[6];
+        transmitter_mac(e.tx, mac);
+        csi_source_t *src = csi_sources_lookup(&sources, mac);
+        if (!src) {
+            continue;
+        }
+        if (!csi_capture_keep_frame(&cfg, &src->dec, static_cast<uint32_t>(e.us))) {
+            src->limited++;
+            continue;
+        }
+        csi_frame_meta_t meta = {};
+        meta.seq = one_counter ? counter++ : src->seq++;
+        std::memcpy(meta.mac, mac, 6);
+        meta.timestamp = static_cast<uint32_t>(e.us);
+        meta.len = kPayloadLen;
+        payload[0] = static_cast<int8_t>(e.tx);
+        src->frames++;
+        out.kept++;
+        size_t len = csi_frame_encode(&meta, payload, datagram.data(), datagram.size());
+        decoder.decode(datagram.data(), len, [&](const csi::Frame &f) {
+            Stream &s = out.streams[mac_text(f.meta.mac)];
+            if (s.frames && f.meta.seq != s.next_seq) {
+                s.lost += f.meta.seq - s.next_seq;
+            }
+            s.next_seq = f.meta.seq + 1;
+            s.frames++;
+            if (s.first_us < 0) {
+                s.first_us = f.meta.timestamp;
+            }
+            s.last_us = f.meta.timestamp;
+        });
+    }
+    for (unsigned i = 0; i < csi_sources_count(&sources); i++) {
+        out.limited += sources.entries[i].limited;
+    }
+    out.rejected = csi_sources_rejected(&sources);
+    out.overflow = csi_sources_overflow(&sources);
+    for (const auto &entry : out.streams) {
+        const Stream &s = entry.second;
+        if (s.frames > 1) {
+            out.max_rate_hz = std::max(out.max_rate_hz, (s.frames - 1) * 1e6 / (s.last_us - s.first_us));
+        }
+    }
+}
+
+uint64_t total_lost(const Result &r) {
+    uint64_t lost = 0;
+    for (const auto &entry : r.streams) {
+        lost += entry.second.lost;
+    }
+    return lost;
+}
+
+void report(const char *name, const Result &r) {
+    std::printf("  %-14s %2zu streams  %llu/%llu frames kept  %llu rate limited  %u rejected  %u overflow  "
+                "max %.1f Hz  %llu seen lost\n",
+                name, r.streams.size(), (unsigned long long)r.kept, (unsigned long long)r.offered,
+                (unsigned long long)r.limited, r.rejected, r.overflow, r.max_rate_hz,
+                (unsigned long long)total_lost(r));
+}
+
+// ns per lookup over a stream of transmitters, hits and misses as they come.
+double lookup_ns(const Options &opt, csi_sources_t &t) {
+    std::mt19937_64 rng(opt.seed + 1);
+    std::vector<std::array<uint8_t, 6>> macs(4096);
+    for (auto &mac : macs) {
+        transmitter_mac(static_cast<unsigned>(rng() % opt.transmitters), mac.data());
+    }
+    uintptr_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < opt.lookups; i++) {
+        sink += reinterpret_cast<uintptr_t>(csi_sources_lookup(&t, macs[i & 4095].data()));
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (sink == 1) {
+        std::printf(" ");
+    }
+    return ns / opt.lookups;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        const char *value = argv[++i];
+        if (arg == "--seconds") {
+            opt.seconds = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--transmitters") {
+            opt.transmitters = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--rate-hz") {
+            opt.rate_hz = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--limit-hz") {
+            opt.limit_hz = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--allow") {
+            opt.allow = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--lookups") {
+            opt.lookups = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--seed") {
+            opt.seed = std::strtoull(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opt.seconds == 0 || opt.transmitters < 2 || opt.transmitters > 4096 || opt.rate_hz == 0 ||
+        opt.rate_hz > 1000 || opt.limit_hz > 65535 || opt.allow == 0 || opt.allow > CSI_CAPTURE_MAX_SOURCES ||
+        opt.allow >= opt.transmitters || opt.lookups == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const std::vector<Event> events = make_arrivals(opt);
+    const std::string limit = opt.limit_hz ? ",rate=" + std::to_string(opt.limit_hz) : "";
+    std::string allowlist = ",src=ap";
+    for (unsigned i = 1; i < opt.allow; i++) {
+        uint8_t mac[6];
+        transmitter_mac(i * 2, mac);
+        allowlist += "+" + mac_text(mac);
+    }
+    Result any, listed, shared;
+    run(events, "start,10,src=any" + limit, false, any);
+    run(events, "start,10" + allowlist + limit, false, listed);
+    run(events, "start,10,src=any" + limit, true, shared);
+
+    std::printf("%u s, %u transmitters at %u Hz +-50%%, rate limit %u Hz:\n", opt.seconds, opt.transmitters,
+                opt.rate_hz, opt.limit_hz);
+    report("src=any", any);
+    report("allowlist", listed);
+    report("one counter", shared);
+
+    const unsigned expected_any = std::min<unsigned>(opt.transmitters, CSI_SOURCES_MAX);
+    const char *failure =
+        any.streams.size() != expected_any || listed.streams.size() != opt.allow
+            ? "not one stream per captured transmitter"
+        : (opt.transmitters > CSI_SOURCES_MAX) != (any.overflow > 0) || any.rejected != 0
+            ? "src=any overflowed before the table was full"
+        : listed.rejected + listed.kept + listed.limited != listed.offered || listed.overflow != 0
+            ? "allowlist let other transmitters through"
+        : total_lost(any) != 0 || total_lost(listed) != 0 ? "gaps in the per-source sequence numbers"
+        : opt.limit_hz && (any.max_rate_hz > opt.limit_hz * 1.01 || listed.max_rate_hz > opt.limit_hz * 1.01)
+            ? "a stream above the rate limit"
+            : nullptr;
+
+    csi_capture_config_t cfg;
+    parse("start,10,src=any", cfg);
+    csi_sources_t table;
+    csi_sources_init(&table);
+    csi_sources_configure(&table, &cfg, kApMac);
+    const double ns_any = lookup_ns(opt, table);
+    parse("start,10" + allowlist, cfg);
+    csi_sources_configure(&table, &cfg, kApMac);
+    const double ns_list = lookup_ns(opt, table);
+    std::printf("  lookup %.1f ns (src=any, %u sources), %.1f ns (allowlist, mostly misses)\n", ns_any,
+                expected_any, ns_list);
+
+    if (failure) {
+        std::printf("FAIL: %s\n", failure);
+        return 1;
+    }
+    std::printf("OK: %zu streams without gaps, none above %.1f Hz\n", any.streams.size(), any.max_rate_hz);
+    return 0;
+}
@@ -0,0 +1,101 @@
+// Command-line options shared by csi_replay and csi_e2e_bench to describe a
+// LoadProfile and its frame source.
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "csi/loadgen.hpp"
+
+namespace csi::tools {
+
+inline constexpr const char *kLoadOptionsUsage =
+    "          [--nodes N] [--rate HZ_PER_NODE] [--frames PER_NODE | --duration SECONDS]\n"
+    "          [--jitter-us US] [--burst N] [--loss FRACTION] [--loss-burst MEAN_RUN]\n"
+    "          [--seed N] [--format text|binary|batch] [--len PAYLOAD_BYTES]\n"
+    "          [--replay DB [--replay-limit N]]\n";
+
+struct LoadOptions {
+    csi::LoadProfile base;
+    double duration_s = 0;        // overrides base.frames when set
+    unsigned len = 128;
+    std::string replay_path;
+    size_t replay_limit = 0;
+
+    csi::LoadProfile profile() const {
+        csi::LoadProfile p = base;
+        if (duration_s > 0) {
+            p.frames = static_cast<uint32_t>(duration_s * p.rate_hz + 0.5);
+        }
+        // A single replayed node keeps the recorded MAC, so the stream is byte-exact.
+        p.keep_mac = !replay_path.empty() && p.nodes == 1;
+        return p;
+    }
+
+    // Throws std::runtime_error if the replay database cannot be used.
+    std::vector<csi::FrameTemplate> templates() const {
+        if (!replay_path.empty()) {
+            return csi::sqlite_templates(replay_path, replay_limit);
+        }
+        return csi::synthetic_templates(256, len);
+    }
+};
+
+// Applies one "--name value" pair. Returns false for an unknown option or a bad value.
+inline bool parse_load_option(const std::string &arg, const char *value, LoadOptions &opts) {
+    if (arg == "--nodes") {
+        opts.base.nodes = static_cast<unsigned>(std::atoi(value));
+        return opts.base.nodes > 0;
+    }
+    if (arg == "--rate") {
+        opts.base.rate_hz = std::atof(value);
+        return opts.base.rate_hz > 0;
+    }
+    if (arg == "--frames") {
+        opts.base.frames = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        return true;
+    }
+    if (arg == "--duration") {
+        opts.duration_s = std::atof(value);
+        return opts.duration_s > 0;
+    }
+    if (arg == "--jitter-us") {
+        opts.base.jitter_us = std::atof(value);
+        return opts.base.jitter_us >= 0;
+    }
+    if (arg == "--burst") {
+        opts.base.burst = static_cast<unsigned>(std::atoi(value));
+        return opts.base.burst > 0;
+    }
+    if (arg == "--loss") {
+        opts.base.loss = std::atof(value);
+        return opts.base.loss >= 0 && opts.base.loss < 1;
+    }
+    if (arg == "--loss-burst") {
+        opts.base.loss_burst = std::atof(value);
+        return opts.base.loss_burst >= 1;
+    }
+    if (arg == "--seed") {
+        opts.base.seed = std::strtoull(value, nullptr, 10);
+        return true;
+    }
+    if (arg == "--format") {
+        return csi::parse_wire_format(value, opts.base.format);
+    }
+    if (arg == "--len") {
+        opts.len = static_cast<unsigned>(std::atoi(value));
+        return opts.len > 0 && opts.len <= CSI_FRAME_MAX_PAYLOAD;
+    }
+    if (arg == "--replay") {
+        opts.replay_path = value;
+        return true;
+    }
+    if (arg == "--replay-limit") {
+        opts.replay_limit = std::strtoull(value, nullptr, 10);
+        return true;
+    }
+    return false;
+}
+
+}  // namespace csi::tools
@@ -0,0 +1,84 @@
+#include <string.h>
+#include "csi_batch.h"
+
+void csi_batch_init(csi_batch_t *batch, uint8_t *buf, size_t cap) {
+    batch->buf = buf;
+    batch->cap = cap;
+    csi_batch_reset(batch);
+}
+
+void csi_batch_reset(csi_batch_t *batch) {
+    batch->used = CSI_BATCH_HDR_SIZE;
+    batch->first_seq = 0;
+    batch->count = 0;
+}
+
+int csi_batch_add(csi_batch_t *batch, uint32_t seq, const uint8_t *frame, uint16_t len) {
+    if (batch->count == CSI_BATCH_MAX_FRAMES ||
+        batch->used + CSI_BATCH_ENTRY_HDR_SIZE + len > batch->cap) {
+        return -1;
+    }
+    if (batch->count == 0) {
+        batch->first_seq = seq;
+    }
+    uint8_t *p = batch->buf + batch->used;
+    p[0] = (uint8_t)len;
+    p[1] = (uint8_t)(len >> 8);
+    memcpy(p + CSI_BATCH_ENTRY_HDR_SIZE, frame, len);
+    batch->used += CSI_BATCH_ENTRY_HDR_SIZE + len;
+    batch->count++;
+    return 0;
+}
+
+size_t csi_batch_finish(csi_batch_t *batch) {
+    if (batch->count == 0) {
+        return 0;
+    }
+    uint8_t *p = batch->buf;
+    p[0] = (uint8_t)CSI_BATCH_MAGIC;
+    p[1] = (uint8_t)(CSI_BATCH_MAGIC >> 8);
+    p[2] = CSI_BATCH_VERSION;
+    p[3] = batch->count;
+    p[4] = (uint8_t)batch->first_seq;
+    p[5] = (uint8_t)(batch->first_seq >> 8);
+    p[6] = (uint8_t)(batch->first_seq >> 16);
+    p[7] = (uint8_t)(batch->first_seq >> 24);
+    return batch->used;
+}
+
+int csi_batch_is_batch(const uint8_t *data, size_t len) {
+    return len >= 2 && (uint16_t)(data[0] | (data[1] << 8)) == CSI_BATCH_MAGIC;
+}
+
+int csi_batch_open(csi_batch_reader_t *reader, const uint8_t *data, size_t len) {
+    if (len < CSI_BATCH_HDR_SIZE || !csi_batch_is_batch(data, len) || data[2] != CSI_BATCH_VERSION) {
+        return -1;
+    }
+    reader->data = data;
+    reader->len = len;
+    reader->offset = CSI_BATCH_HDR_SIZE;
+    reader->count = data[3];
+    reader->remaining = data[3];
+    reader->first_seq = (uint32_t)data[4] | ((uint32_t)data[5] << 8) |
+                        ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+    return 0;
+}
+
+int csi_batch_next(csi_batch_reader_t *reader, const uint8_t **frame, uint16_t *len) {
+    if (reader->remaining == 0) {
+        return 0;
+    }
+    if (reader->offset + CSI_BATCH_ENTRY_HDR_SIZE > reader->len) {
+        return -1;
+    }
+    const uint8_t *p = reader->data + reader->offset;
+    uint16_t n = (uint16_t)(p[0] | (p[1] << 8));
+    if (reader->offset + CSI_BATCH_ENTRY_HDR_SIZE + n > reader->len) {
+        return -1;
+    }
+    *frame = p + CSI_BATCH_ENTRY_HDR_SIZE;
+    *len = n;
+    reader->offset += CSI_BATCH_ENTRY_HDR_SIZE + n;
+    reader->remaining--;
+    return 1;
+}
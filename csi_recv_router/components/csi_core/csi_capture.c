@@ -0,0 +1,258 @@
+#include <string.h>
+#include "csi_capture.h"
+#include "csi_traffic.h"
+
+static int parse_uint(const char *s, size_t n, uint32_t max, uint32_t *out) {
+    uint32_t v = 0;
+    if (n == 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return 0;
+        }
+        v = v * 10 + (uint32_t)(s[i] - '0');
+        if (v > max) {
+            return 0;
+        }
+    }
+    *out = v;
+    return 1;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Parses a big-endian hex number into a little-endian bit array. */
+static int parse_mask(const char *s, size_t n, uint8_t *mask) {
+    if (n > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        s += 2;
+        n -= 2;
+    }
+    while (n > 1 && s[0] == '0') {
+        s++;
+        n--;
+    }
+    if (n == 0 || n > CSI_CAPTURE_MASK_BYTES * 2) {
+        return 0;
+    }
+    uint8_t any = 0;
+    memset(mask, 0, CSI_CAPTURE_MASK_BYTES);
+    for (size_t i = 0; i < n; i++) {
+        int d = hex_digit(s[n - 1 - i]);
+        if (d < 0) {
+            return 0;
+        }
+        mask[i / 2] |= (uint8_t)(d << ((i & 1) * 4));
+        any |= (uint8_t)d;
+    }
+    return any != 0;
+}
+
+/* aa:bb:cc:dd:ee:ff, either case. */
+static int parse_mac(const char *s, size_t n, uint8_t mac[6]) {
+    if (n != 17) {
+        return 0;
+    }
+    for (int i = 0; i < 6; i++) {
+        int hi = hex_digit(s[3 * i]), lo = hex_digit(s[3 * i + 1]);
+        if (hi < 0 || lo < 0 || (i < 5 && s[3 * i + 2] != ':')) {
+            return 0;
+        }
+        mac[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return 1;
+}
+
+static int parse_sources(const char *v, size_t n, csi_capture_config_t *cfg) {
+    cfg->source_ap = 0;
+    cfg->source_count = 0;
+    if (n == 3 && !memcmp(v, "any", 3)) {
+        cfg->source_mode = CSI_CAPTURE_SRC_ANY;
+        return 1;
+    }
+    if (n == 2 && !memcmp(v, "ap", 2)) {
+        cfg->source_mode = CSI_CAPTURE_SRC_AP;
+        return 1;
+    }
+    cfg->source_mode = CSI_CAPTURE_SRC_LIST;
+    const char *end = v + n;
+    while (v <= end) {
+        const char *plus = memchr(v, '+', (size_t)(end - v));
+        size_t len = (size_t)((plus ? plus : end) - v);
+        if (len == 2 && !memcmp(v, "ap", 2)) {
+            cfg->source_ap = 1;
+        } else if (cfg->source_count == CSI_CAPTURE_MAX_SOURCES ||
+                   !parse_mac(v, len, cfg->sources[cfg->source_count++])) {
+            return 0;
+        }
+        v += len + 1;
+    }
+    return 1;
+}
+
+static int parse_option(const char *s, size_t n, csi_capture_config_t *cfg) {
+    const char *eq = memchr(s, '=', n);
+    if (!eq) {
+        return 0;
+    }
+    size_t klen = (size_t)(eq - s);
+    const char *v = eq + 1;
+    size_t vlen = n - klen - 1;
+    uint32_t u;
+    if (klen == 2 && !memcmp(s, "sc", 2)) {
+        cfg->sc_mask_set = 1;
+        return parse_mask(v, vlen, cfg->sc_mask);
+    }
+    if (klen == 3 && !memcmp(s, "dec", 3)) {
+        if (!parse_uint(v, vlen, UINT16_MAX, &u) || u == 0) {
+            return 0;
+        }
+        cfg->decimation = (uint16_t)u;
+        return 1;
+    }
+    if (klen == 4 && !memcmp(s, "rate", 4)) {
+        if (!parse_uint(v, vlen, UINT16_MAX, &u)) {
+            return 0;
+        }
+        cfg->rate_hz = (uint16_t)u;
+        return 1;
+    }
+    if (klen == 4 && !memcmp(s, "mode", 4)) {
+        if (vlen == 3 && !memcmp(v, "raw", 3)) {
+            cfg->payload_mode = CSI_CAPTURE_MODE_RAW;
+        } else if (vlen == 3 && !memcmp(v, "amp", 3)) {
+            cfg->payload_mode = CSI_CAPTURE_MODE_AMPLITUDE;
+        } else {
+            return 0;
+        }
+        return 1;
+    }
+    if (klen == 6 && !memcmp(s, "target", 6)) {
+        if (!parse_uint(v, vlen, UINT16_MAX, &u) || u == 0) {
+            return 0;
+        }
+        cfg->target_hz = (uint16_t)u;
+        return 1;
+    }
+    if (klen == 5 && !memcmp(s, "probe", 5)) {
+        if (vlen == 4 && !memcmp(v, "icmp", 4)) {
+            cfg->probe = CSI_TRAFFIC_PROBE_ICMP;
+        } else if (vlen == 3 && !memcmp(v, "udp", 3)) {
+            cfg->probe = CSI_TRAFFIC_PROBE_UDP;
+        } else {
+            return 0;
+        }
+        return 1;
+    }
+    if (klen == 3 && !memcmp(s, "src", 3)) {
+        return parse_sources(v, vlen, cfg);
+    }
+    return 0;
+}
+
+void csi_capture_config_init(csi_capture_config_t *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->decimation = 1;
+    cfg->payload_mode = CSI_CAPTURE_MODE_RAW;
+    cfg->probe = CSI_TRAFFIC_PROBE_ICMP;
+}
+
+int csi_capture_parse_start(const char *cmd, csi_capture_config_t *cfg) {
+    if (strncmp(cmd, "start,", 6) != 0) {
+        return CSI_CAPTURE_ERR_COMMAND;
+    }
+    const char *p = cmd + 6;
+    size_t n = strlen(p);
+    /* Tolerate a trailing newline from hand-typed commands (nc, socat). */
+    while (n > 0 && (p[n - 1] == '\n' || p[n - 1] == '\r' || p[n - 1] == ' ')) {
+        n--;
+    }
+
+    csi_capture_config_t parsed;
+    csi_capture_config_init(&parsed);
+    const char *end = p + n;
+    const char *comma = memchr(p, ',', n);
+    const char *tok_end = comma ? comma : end;
+    if (!parse_uint(p, (size_t)(tok_end - p), UINT32_MAX / 1000, &parsed.duration_s)) {
+        return CSI_CAPTURE_ERR_COMMAND;
+    }
+    while (tok_end < end) {
+        p = tok_end + 1;
+        comma = memchr(p, ',', (size_t)(end - p));
+        tok_end = comma ? comma : end;
+        if (!parse_option(p, (size_t)(tok_end - p), &parsed)) {
+            return CSI_CAPTURE_ERR_OPTION;
+        }
+    }
+    *cfg = parsed;
+    return CSI_CAPTURE_OK;
+}
+
+int csi_capture_is_passthrough(const csi_capture_config_t *cfg) {
+    return !cfg->sc_mask_set && cfg->payload_mode == CSI_CAPTURE_MODE_RAW;
+}
+
+void csi_decimator_init(csi_decimator_t *dec) {
+    dec->count = 0;
+    dec->next_us = 0;
+    dec->started = 0;
+}
+
+int csi_capture_keep_frame(const csi_capture_config_t *cfg, csi_decimator_t *dec, uint32_t timestamp_us) {
+    if (cfg->decimation > 1 && dec->count++ % cfg->decimation != 0) {
+        return 0;
+    }
+    if (cfg->rate_hz == 0) {
+        return 1;
+    }
+    uint32_t period = 1000000u / cfg->rate_hz;
+    if (dec->started && (int32_t)(timestamp_us - dec->next_us) < 0) {
+        return 0;
+    }
+    /* Advance by whole periods so the mean rate is exact despite arrival
+     * jitter, but restart the schedule after a gap instead of bursting. */
+    dec->next_us = dec->started ? dec->next_us + period : timestamp_us + period;
+    if ((int32_t)(timestamp_us - dec->next_us) >= 0) {
+        dec->next_us = timestamp_us + period;
+    }
+    dec->started = 1;
+    return 1;
+}
+
+static inline uint8_t amplitude_i8(int8_t im, int8_t re) {
+    uint32_t s = (uint32_t)(im * im + re * re);
+    uint32_t r = 0;
+    for (uint32_t bit = 1u << 14; bit; bit >>= 2) {
+        if (s >= r + bit) {
+            s -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+    }
+    /* s is now the remainder n - r^2; round half up. */
+    r += s > r;
+    return (uint8_t)(r > 127 ? 127 : r);
+}
+
+uint16_t csi_capture_reduce(const csi_capture_config_t *cfg, const int8_t *in, uint16_t len, int8_t *out) {
+    uint16_t pairs = len / 2;
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < pairs; i++) {
+        if (cfg->sc_mask_set && (i >= CSI_CAPTURE_MAX_PAIRS || !(cfg->sc_mask[i >> 3] & (1u << (i & 7))))) {
+            continue;
+        }
+        if (cfg->payload_mode == CSI_CAPTURE_MODE_AMPLITUDE) {
+            out[n++] = (int8_t)amplitude_i8(in[2 * i], in[2 * i + 1]);
+        } else {
+            out[n++] = in[2 * i];
+            out[n++] = in[2 * i + 1];
+        }
+    }
+    return n;
+}
@@ -0,0 +1,191 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csi_clock.h"
+
+/* Round-trip excess over the best exchange that still counts as a good one. */
+#define CLOCK_DELAY_SLACK_US   100
+/* Crystals are specified to tens of ppm; anything larger is a bad fit. */
+#define CLOCK_MAX_DRIFT_PPB    500000
+
+void csi_clock_init(csi_clock_t *clock) {
+    memset(clock, 0, sizeof(*clock));
+}
+
+static void clock_estimate(csi_clock_t *clock) {
+    uint32_t min_delay = UINT32_MAX;
+    const csi_clock_sample_t *best = NULL;
+    for (uint32_t i = 0; i < clock->count; i++) {
+        if (clock->samples[i].delay_us < min_delay) {
+            min_delay = clock->samples[i].delay_us;
+            best = &clock->samples[i];
+        }
+    }
+
+    /* Weighted least squares of offset against local time, relative to the
+     * best exchange to keep the sums small. Queuing delay beyond the best
+     * round trip turns into offset error, so the weight falls with its square. */
+    const int64_t x0 = best->local_us, y0 = best->offset_us;
+    double w = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int64_t first = INT64_MAX, last = INT64_MIN;
+    for (uint32_t i = 0; i < clock->count; i++) {
+        const csi_clock_sample_t *s = &clock->samples[i];
+        const double excess = (double)(s->delay_us - min_delay) + CLOCK_DELAY_SLACK_US;
+        const double k = 1.0 / (excess * excess);
+        const double x = (double)(s->local_us - x0), y = (double)(s->offset_us - y0);
+        w += k;
+        sx += k * x;
+        sy += k * y;
+        sxx += k * x * x;
+        sxy += k * x * y;
+        first = s->local_us < first ? s->local_us : first;
+        last = s->local_us > last ? s->local_us : last;
+    }
+
+    const double var = sxx - sx * sx / w;
+    if (last - first >= CSI_CLOCK_MIN_SPAN_US && var > 0) {
+        const double slope = (sxy - sx * sy / w) / var;
+        if (slope * 1e9 > -CLOCK_MAX_DRIFT_PPB && slope * 1e9 < CLOCK_MAX_DRIFT_PPB) {
+            /* The fitted line goes through the weighted mean of the samples. */
+            const int64_t local = x0 + (int64_t)(sx / w);
+            clock->anchor_local_us = local;
+            clock->anchor_shared_us = local + y0 + (int64_t)(sy / w);
+            clock->drift_ppb = (int32_t)(slope * 1e9);
+            clock->error_us = min_delay / 2;
+            clock->valid = 1;
+            return;
+        }
+    }
+    clock->anchor_local_us = best->local_us;
+    clock->anchor_shared_us = best->local_us + best->offset_us;
+    clock->error_us = min_delay / 2;
+    clock->valid = 1;
+}
+
+int csi_clock_add_exchange(csi_clock_t *clock, int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+    const int64_t delay = (t4 - t1) - (t3 - t2);
+    if (t4 < t1 || t3 < t2) {
+        return clock->valid;
+    }
+    csi_clock_sample_t sample;
+    sample.local_us = t1 + (t4 - t1) / 2;
+    sample.offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    sample.delay_us = delay < 0 ? 0 : delay > UINT32_MAX ? UINT32_MAX : (uint32_t)delay;
+
+    /* One slot per bucket, holding its best exchange so far. */
+    if (clock->count && sample.local_us - clock->bucket_start_us < CSI_CLOCK_BUCKET_US) {
+        csi_clock_sample_t *newest = &clock->samples[(clock->next + CSI_CLOCK_SAMPLES - 1) % CSI_CLOCK_SAMPLES];
+        if (sample.delay_us >= newest->delay_us) {
+            return clock->valid;
+        }
+        *newest = sample;
+    } else {
+        clock->samples[clock->next] = sample;
+        clock->next = (clock->next + 1) % CSI_CLOCK_SAMPLES;
+        clock->bucket_start_us = sample.local_us;
+        if (clock->count < CSI_CLOCK_SAMPLES) {
+            clock->count++;
+        }
+    }
+    clock_estimate(clock);
+    return 1;
+}
+
+int64_t csi_clock_to_shared(const csi_clock_t *clock, int64_t local_us) {
+    if (!clock->valid) {
+        return local_us;
+    }
+    const int64_t d = local_us - clock->anchor_local_us;
+    return clock->anchor_shared_us + d + d * clock->drift_ppb / 1000000000;
+}
+
+void csi_clock_make_report(const csi_clock_t *clock, int32_t radio_offset_us, csi_clock_report_t *report) {
+    report->radio_anchor_us = (uint32_t)(clock->anchor_local_us - radio_offset_us);
+    report->shared_anchor_us = clock->anchor_shared_us;
+    report->drift_ppb = clock->drift_ppb;
+    report->error_us = clock->error_us;
+    report->samples = clock->count;
+}
+
+int64_t csi_clock_report_to_shared(const csi_clock_report_t *report, uint32_t radio_us) {
+    const int64_t d = (int32_t)(radio_us - report->radio_anchor_us);
+    return report->shared_anchor_us + d + d * report->drift_ppb / 1000000000;
+}
+
+size_t csi_clock_format_request(uint32_t seq, int64_t t1, char *out, size_t cap) {
+    int n = snprintf(out, cap, CSI_CLOCK_SYNC_PREFIX "%" PRIu32 ",%" PRId64, seq, t1);
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+size_t csi_clock_format_reply(uint32_t seq, int64_t t1, int64_t t2, int64_t t3, char *out, size_t cap) {
+    int n = snprintf(out, cap, CSI_CLOCK_SYNC_PREFIX "%" PRIu32 ",%" PRId64 ",%" PRId64 ",%" PRId64,
+                     seq, t1, t2, t3);
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+size_t csi_clock_format_report(const csi_clock_report_t *report, char *out, size_t cap) {
+    int n = snprintf(out, cap, CSI_CLOCK_REPORT_PREFIX "%" PRIu32 ",%" PRId64 ",%" PRId32 ",%" PRIu32 ",%" PRIu32,
+                     report->radio_anchor_us, report->shared_anchor_us, report->drift_ppb,
+                     report->error_us, report->samples);
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+/* Parses exactly count comma-separated integers after prefix. */
+static int parse_fields(const char *data, size_t len, const char *prefix, int64_t *values, size_t count) {
+    const size_t prefix_len = strlen(prefix);
+    char line[CSI_CLOCK_MSG_MAX_LEN];
+    if (len < prefix_len || len >= sizeof(line) || memcmp(data, prefix, prefix_len) != 0) {
+        return 0;
+    }
+    memcpy(line, data, len);
+    line[len] = '\0';
+
+    char *p = line + prefix_len;
+    for (size_t i = 0; i < count; i++) {
+        char *end;
+        long long v = strtoll(p, &end, 10);
+        if (end == p || *end != (i + 1 < count ? ',' : '\0')) {
+            return 0;
+        }
+        values[i] = (int64_t)v;
+        p = end + 1;
+    }
+    return 1;
+}
+
+int csi_clock_parse_request(const char *data, size_t len, uint32_t *seq, int64_t *t1) {
+    int64_t v[2];
+    if (!parse_fields(data, len, CSI_CLOCK_SYNC_PREFIX, v, 2) || v[0] < 0 || v[0] > UINT32_MAX) {
+        return 0;
+    }
+    *seq = (uint32_t)v[0];
+    *t1 = v[1];
+    return 1;
+}
+
+int csi_clock_parse_reply(const char *data, size_t len, uint32_t *seq, int64_t *t1, int64_t *t2, int64_t *t3) {
+    int64_t v[4];
+    if (!parse_fields(data, len, CSI_CLOCK_SYNC_PREFIX, v, 4) || v[0] < 0 || v[0] > UINT32_MAX) {
+        return 0;
+    }
+    *seq = (uint32_t)v[0];
+    *t1 = v[1];
+    *t2 = v[2];
+    *t3 = v[3];
+    return 1;
+}
+
+int csi_clock_parse_report(const char *data, size_t len, csi_clock_report_t *report) {
+    int64_t v[5];
+    if (!parse_fields(data, len, CSI_CLOCK_REPORT_PREFIX, v, 5) || v[0] < 0 || v[0] > UINT32_MAX ||
+        v[2] < INT32_MIN || v[2] > INT32_MAX || v[3] < 0 || v[3] > UINT32_MAX || v[4] < 0 || v[4] > UINT32_MAX) {
+        return 0;
+    }
+    report->radio_anchor_us = (uint32_t)v[0];
+    report->shared_anchor_us = v[1];
+    report->drift_ppb = (int32_t)v[2];
+    report->error_us = (uint32_t)v[3];
+    report->samples = (uint32_t)v[4];
+    return 1;
+}
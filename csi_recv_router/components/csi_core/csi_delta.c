@@ -0,0 +1,157 @@
+#include <string.h>
+#include "csi_delta.h"
+
+static inline size_t put_varint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+/* Returns the number of bytes consumed, or 0 if the varint is truncated or too long. */
+static inline size_t get_varint(const uint8_t *p, size_t avail, uint32_t *v) {
+    uint32_t result = 0;
+    for (size_t n = 0; n < avail && n < 5; n++) {
+        result |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+        if (!(p[n] & 0x80)) {
+            *v = result;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+/* Nibble k of buf, low nibble of each byte first. */
+static inline void put_nibble(uint8_t *buf, size_t k, uint8_t v) {
+    if (k & 1) {
+        buf[k >> 1] |= (uint8_t)(v << 4);
+    } else {
+        buf[k >> 1] = v;
+    }
+}
+
+static inline uint8_t get_nibble(const uint8_t *buf, size_t k) {
+    return (uint8_t)((buf[k >> 1] >> ((k & 1) * 4)) & 0x0F);
+}
+
+void csi_delta_enc_init(csi_delta_enc_t *enc, uint16_t keyframe_interval) {
+    enc->keyframe_interval = keyframe_interval;
+    csi_delta_enc_reset(enc);
+}
+
+void csi_delta_enc_reset(csi_delta_enc_t *enc) {
+    enc->has_prev = 0;
+    enc->prev_len = 0;
+    enc->since_key = 0;
+}
+
+size_t csi_delta_encode(csi_delta_enc_t *enc, uint32_t seq, const int8_t *payload, uint16_t len,
+                        uint8_t *out, size_t out_cap, uint8_t *flags) {
+    if (len > CSI_DELTA_MAX_LEN || out_cap < CSI_DELTA_ENCODED_MAX(len)) {
+        return 0;
+    }
+    size_t n = 0;
+    int key = !enc->has_prev || len != enc->prev_len || enc->since_key + 1u >= enc->keyframe_interval;
+    if (!key) {
+        n = put_varint(out, seq - enc->prev_seq);
+        key = n >= len;
+        uint8_t *body = out + n;
+        size_t nib = 0;
+        for (uint16_t i = 0; !key && i < len; i++) {
+            int d = payload[i] - enc->prev[i];
+            uint32_t zz = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+            while (zz >= 8) {
+                put_nibble(body, nib++, (uint8_t)((zz & 7) | 8));
+                zz >>= 3;
+            }
+            put_nibble(body, nib++, (uint8_t)zz);
+            /* Not paying off: give up early and send a keyframe instead. */
+            key = n + (nib + 1) / 2 >= len;
+        }
+        n += (nib + 1) / 2;
+    }
+    if (key) {
+        memcpy(out, payload, len);
+        n = len;
+        enc->since_key = 0;
+        *flags &= (uint8_t)~CSI_FRAME_FLAG_DELTA;
+    } else {
+        enc->since_key++;
+        *flags |= CSI_FRAME_FLAG_DELTA;
+    }
+    memcpy(enc->prev, payload, len);
+    enc->prev_len = len;
+    enc->prev_seq = seq;
+    enc->has_prev = 1;
+    return n;
+}
+
+void csi_delta_dec_init(csi_delta_dec_t *dec) {
+    dec->has_prev = 0;
+    dec->prev_len = 0;
+}
+
+int csi_delta_decode(csi_delta_dec_t *dec, const csi_frame_meta_t *meta, const int8_t *payload,
+                     int8_t *out, uint16_t *out_len) {
+    if (!(meta->flags & CSI_FRAME_FLAG_DELTA)) {
+        if (meta->len > CSI_DELTA_MAX_LEN) {
+            return CSI_DELTA_ERR_LENGTH;
+        }
+        if (meta->flags & CSI_FRAME_FLAG_RETRANSMIT) {
+            /* An old frame sent again: the live stream's reference stays. */
+            memcpy(out, payload, meta->len);
+            *out_len = meta->len;
+            return CSI_DELTA_OK;
+        }
+        memcpy(dec->prev, payload, meta->len);
+        dec->prev_len = meta->len;
+        dec->prev_seq = meta->seq;
+        dec->has_prev = 1;
+        memcpy(out, payload, meta->len);
+        *out_len = meta->len;
+        return CSI_DELTA_OK;
+    }
+
+    const uint8_t *p = (const uint8_t *)payload;
+    size_t avail = meta->len;
+    uint32_t back;
+    size_t used = get_varint(p, avail, &back);
+    if (!used) {
+        return CSI_DELTA_ERR_CORRUPT;
+    }
+    if (!dec->has_prev || meta->seq - back != dec->prev_seq) {
+        dec->has_prev = 0;
+        return CSI_DELTA_ERR_NO_REF;
+    }
+    const uint8_t *body = p + used;
+    size_t nibbles = (avail - used) * 2;
+    size_t nib = 0;
+    for (uint16_t i = 0; i < dec->prev_len; i++) {
+        uint32_t zz = 0;
+        unsigned shift = 0;
+        uint8_t v;
+        do {
+            /* A delta of an int8 needs at most 9 bits, i.e. three nibbles. */
+            if (nib >= nibbles || shift > 6) {
+                dec->has_prev = 0;
+                return CSI_DELTA_ERR_CORRUPT;
+            }
+            v = get_nibble(body, nib++);
+            zz |= (uint32_t)(v & 7) << shift;
+            shift += 3;
+        } while (v & 8);
+        int d = (int)(zz >> 1) ^ -(int)(zz & 1);
+        out[i] = (int8_t)(dec->prev[i] + d);
+    }
+    if (nibbles - nib > 1 || (nib < nibbles && get_nibble(body, nib) != 0)) {
+        dec->has_prev = 0;
+        return CSI_DELTA_ERR_CORRUPT;
+    }
+    memcpy(dec->prev, out, dec->prev_len);
+    dec->prev_seq = meta->seq;
+    *out_len = dec->prev_len;
+    return CSI_DELTA_OK;
+}
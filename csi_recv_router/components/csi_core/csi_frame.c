@@ -0,0 +1,227 @@
+#include <string.h>
+#include "csi_frame.h"
+
+static inline void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int csi_frame_is_binary(const uint8_t *data, size_t len) {
+    return len >= 2 && get_u16(data) == CSI_FRAME_MAGIC;
+}
+
+size_t csi_frame_encode(const csi_frame_meta_t *meta, const int8_t *payload,
+                        uint8_t *out, size_t out_cap) {
+    size_t total = CSI_FRAME_BIN_SIZE(meta->len);
+    if (out_cap < total) {
+        return 0;
+    }
+    put_u16(out + 0, CSI_FRAME_MAGIC);
+    out[2] = CSI_FRAME_VERSION;
+    out[3] = meta->flags;
+    put_u32(out + 4, meta->seq);
+    memcpy(out + 8, meta->mac, 6);
+    out[14] = (uint8_t)meta->rssi;
+    out[15] = meta->rate;
+    out[16] = meta->sig_mode;
+    out[17] = meta->mcs;
+    out[18] = meta->cwb;
+    out[19] = meta->smoothing;
+    out[20] = meta->not_sounding;
+    out[21] = meta->aggregation;
+    out[22] = meta->stbc;
+    out[23] = meta->fec_coding;
+    out[24] = meta->sgi;
+    out[25] = (uint8_t)meta->noise_floor;
+    out[26] = meta->ampdu_cnt;
+    out[27] = meta->channel;
+    out[28] = meta->secondary_channel;
+    out[29] = meta->ant;
+    put_u32(out + 30, meta->timestamp);
+    put_u16(out + 34, meta->sig_len);
+    out[36] = meta->rx_state;
+    out[37] = meta->first_word_invalid;
+    put_u16(out + 38, meta->len);
+    if (meta->len) {
+        memcpy(out + CSI_FRAME_HDR_SIZE, payload, meta->len);
+    }
+    return total;
+}
+
+int csi_frame_decode(const uint8_t *data, size_t len,
+                     csi_frame_meta_t *meta, const int8_t **payload) {
+    if (len < CSI_FRAME_HDR_SIZE) {
+        return CSI_FRAME_ERR_SHORT;
+    }
+    if (get_u16(data) != CSI_FRAME_MAGIC) {
+        return CSI_FRAME_ERR_MAGIC;
+    }
+    if (data[2] != CSI_FRAME_VERSION) {
+        return CSI_FRAME_ERR_VERSION;
+    }
+    meta->flags              = data[3];
+    meta->seq                = get_u32(data + 4);
+    memcpy(meta->mac, data + 8, 6);
+    meta->rssi               = (int8_t)data[14];
+    meta->rate               = data[15];
+    meta->sig_mode           = data[16];
+    meta->mcs                = data[17];
+    meta->cwb                = data[18];
+    meta->smoothing          = data[19];
+    meta->not_sounding       = data[20];
+    meta->aggregation        = data[21];
+    meta->stbc               = data[22];
+    meta->fec_coding         = data[23];
+    meta->sgi                = data[24];
+    meta->noise_floor        = (int8_t)data[25];
+    meta->ampdu_cnt          = data[26];
+    meta->channel            = data[27];
+    meta->secondary_channel  = data[28];
+    meta->ant                = data[29];
+    meta->timestamp          = get_u32(data + 30);
+    meta->sig_len            = get_u16(data + 34);
+    meta->rx_state           = data[36];
+    meta->first_word_invalid = data[37];
+    meta->len                = get_u16(data + 38);
+    if (len < CSI_FRAME_BIN_SIZE(meta->len)) {
+        return CSI_FRAME_ERR_LENGTH;
+    }
+    if (payload) {
+        *payload = (const int8_t *)(data + CSI_FRAME_HDR_SIZE);
+    }
+    return CSI_FRAME_OK;
+}
+
+/* Writes the decimal form of v and returns the advanced pointer. */
+static char *put_uint(char *p, uint32_t v) {
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) {
+        *p++ = tmp[--n];
+    }
+    return p;
+}
+
+static char *put_int(char *p, int32_t v) {
+    if (v < 0) {
+        *p++ = '-';
+        return put_uint(p, (uint32_t)(-(int64_t)v));
+    }
+    return put_uint(p, (uint32_t)v);
+}
+
+static char *put_hex8(char *p, uint8_t v) {
+    static const char digits[] = "0123456789abcdef";
+    *p++ = digits[v >> 4];
+    *p++ = digits[v & 0x0f];
+    return p;
+}
+
+size_t csi_frame_format_text(const csi_frame_meta_t *meta, const int8_t *payload,
+                             char *out, size_t out_cap) {
+    if (out_cap < CSI_FRAME_TEXT_MAX(meta->len)) {
+        return 0;
+    }
+    char *p = out;
+    memcpy(p, "CSI_DATA,", 9);
+    p += 9;
+    p = put_uint(p, meta->seq);
+    *p++ = ',';
+    for (int i = 0; i < 6; i++) {
+        if (i) {
+            *p++ = ':';
+        }
+        p = put_hex8(p, meta->mac[i]);
+    }
+    const int32_t fields[] = {
+        meta->rssi, meta->rate, meta->sig_mode, meta->mcs, meta->cwb, meta->smoothing,
+        meta->not_sounding, meta->aggregation, meta->stbc, meta->fec_coding, meta->sgi,
+        meta->noise_floor, meta->ampdu_cnt, meta->channel, meta->secondary_channel,
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        *p++ = ',';
+        p = put_int(p, fields[i]);
+    }
+    *p++ = ',';
+    p = put_uint(p, meta->timestamp);
+    *p++ = ',';
+    p = put_uint(p, meta->ant);
+    *p++ = ',';
+    p = put_uint(p, meta->sig_len);
+    *p++ = ',';
+    p = put_uint(p, meta->rx_state);
+    *p++ = ',';
+    p = put_uint(p, meta->len);
+    *p++ = ',';
+    p = put_uint(p, meta->first_word_invalid);
+    *p++ = ',';
+    *p++ = '"';
+    *p++ = '[';
+    for (uint16_t i = 0; i < meta->len; i++) {
+        if (i) {
+            *p++ = ',';
+        }
+        p = put_int(p, payload[i]);
+    }
+    *p++ = ']';
+    *p++ = '"';
+    *p++ = '\n';
+    *p = '\0';
+    return (size_t)(p - out);
+}
+
+static int hex_value(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int csi_frame_peek_mac(const uint8_t *data, size_t len, uint8_t mac[6]) {
+    if (csi_frame_is_binary(data, len)) {
+        if (len < CSI_FRAME_HDR_SIZE) {
+            return 0;
+        }
+        memcpy(mac, data + 8, 6);
+        return 1;
+    }
+    /* CSI_DATA,<seq>,aa:bb:cc:dd:ee:ff, */
+    if (len < 9 || memcmp(data, "CSI_DATA,", 9) != 0) {
+        return 0;
+    }
+    size_t i = 9;
+    while (i < len && data[i] != ',') {
+        i++;
+    }
+    if (len - i < 19) {  /* the separator and "aa:bb:cc:dd:ee:ff," */
+        return 0;
+    }
+    const uint8_t *p = data + i + 1;
+    for (int k = 0; k < 6; k++) {
+        int hi = hex_value(p[3 * k]), lo = hex_value(p[3 * k + 1]);
+        if (hi < 0 || lo < 0 || p[3 * k + 2] != (k < 5 ? ':' : ',')) {
+            return 0;
+        }
+        mac[k] = (uint8_t)(hi << 4 | lo);
+    }
+    return 1;
+}
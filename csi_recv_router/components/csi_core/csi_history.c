@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <string.h>
+#include "csi_frame.h"
+#include "csi_history.h"
+
+/* Offset of the flags byte in a binary frame (csi_frame.h). */
+#define FRAME_FLAGS_OFFSET  3
+
+static int is_pow2(size_t n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+/* Spreads the sources over the index so their sequence numbers, which often
+ * run close together, do not keep landing in each other's slots. */
+static csi_history_slot_t *slot_of(const csi_history_t *h, const uint8_t mac[6], uint32_t seq) {
+    uint32_t spread = (((uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5]) * 0x9E3779B1u) >> 16;
+    return &h->slots[(seq + spread) & h->slot_mask];
+}
+
+int csi_history_init(csi_history_t *h, void *arena, size_t arena_size, csi_history_slot_t *slots,
+                     uint32_t slot_count) {
+    if (!arena || !slots || !is_pow2(arena_size) || arena_size > (1u << 30) || !is_pow2(slot_count)) {
+        return -1;
+    }
+    memset(h, 0, sizeof(*h));
+    memset(slots, 0, sizeof(*slots) * slot_count);
+    h->arena = arena;
+    h->arena_mask = (uint32_t)arena_size - 1;
+    h->slots = slots;
+    h->slot_mask = slot_count - 1;
+    return 0;
+}
+
+void csi_history_store(csi_history_t *h, uint32_t seq, const uint8_t *frame, uint16_t len) {
+    const uint32_t size = h->arena_mask + 1;
+    if (len == 0 || len > size / 4) {
+        return;
+    }
+    /* Frames stay contiguous: skip the end of the arena if this one does not fit there. */
+    uint32_t offset = h->write & h->arena_mask;
+    if (offset + len > size) {
+        h->write += size - offset;
+    }
+    uint8_t *dst = h->arena + (h->write & h->arena_mask);
+    memcpy(dst, frame, len);
+    if (csi_frame_is_binary(dst, len)) {
+        dst[FRAME_FLAGS_OFFSET] |= CSI_FRAME_FLAG_RETRANSMIT;
+    }
+    if (!csi_frame_peek_mac(frame, len, h->last_mac)) {
+        memset(h->last_mac, 0, sizeof(h->last_mac));
+    }
+    csi_history_slot_t *slot = slot_of(h, h->last_mac, seq);
+    memcpy(slot->mac, h->last_mac, sizeof(slot->mac));
+    slot->seq = seq;
+    slot->pos = h->write;
+    slot->len = len;
+    slot->valid = 1;
+    h->write += len;
+}
+
+static const uint8_t *history_find(const csi_history_t *h, const uint8_t mac[6], uint32_t seq, uint16_t *len) {
+    const csi_history_slot_t *slot = slot_of(h, mac, seq);
+    /* Overwritten once the log has advanced a whole arena past the frame's start. */
+    if (!slot->valid || slot->seq != seq || memcmp(slot->mac, mac, 6) != 0 ||
+        h->write - slot->pos > h->arena_mask + 1) {
+        return NULL;
+    }
+    *len = slot->len;
+    return h->arena + (slot->pos & h->arena_mask);
+}
+
+static int read_seq(const char **p, const char *end, uint32_t *seq) {
+    uint64_t v = 0;
+    const char *s = *p;
+    while (s < end && *s >= '0' && *s <= '9') {
+        v = v * 10 + (uint64_t)(*s - '0');
+        if (v > UINT32_MAX) {
+            return 0;
+        }
+        s++;
+    }
+    if (s == *p) {
+        return 0;
+    }
+    *seq = (uint32_t)v;
+    *p = s;
+    return 1;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* An optional "aa:bb:cc:dd:ee:ff," ahead of the ranges. */
+static int read_mac(const char **p, const char *end, uint8_t mac[6]) {
+    const char *s = *p;
+    if (end - s < 18 || s[17] != ',') {
+        return 0;
+    }
+    for (int i = 0; i < 6; i++) {
+        int hi = hex_digit(s[3 * i]), lo = hex_digit(s[3 * i + 1]);
+        if (hi < 0 || lo < 0 || (i < 5 && s[3 * i + 2] != ':')) {
+            return 0;
+        }
+        mac[i] = (uint8_t)(hi << 4 | lo);
+    }
+    *p = s + 18;
+    return 1;
+}
+
+/* Adds a range to the queue, merging it with an overlapping or adjacent one
+ * of the same transmitter. */
+static int history_queue(csi_history_t *h, const uint8_t mac[6], csi_seq_range_t r) {
+    for (uint8_t i = 0; i < h->pending_count; i++) {
+        csi_seq_range_t *q = &h->pending[i].range;
+        if (memcmp(h->pending[i].mac, mac, 6) == 0 && (int32_t)(r.first - (q->last + 1)) <= 0 && (int32_t)(q->first - (r.last + 1)) <= 0) {
+            if ((int32_t)(r.first - q->first) < 0) {
+                q->first = r.first;
+            }
+            if ((int32_t)(r.last - q->last) > 0) {
+                q->last = r.last;
+            }
+            return 1;
+        }
+    }
+    if (h->pending_count == CSI_HISTORY_MAX_RANGES) {
+        h->dropped++;
+        return 0;
+    }
+    memcpy(h->pending[h->pending_count].mac, mac, 6);
+    h->pending[h->pending_count++].range = r;
+    return 1;
+}
+
+int csi_history_request(csi_history_t *h, const char *data, size_t len) {
+    const size_t prefix_len = sizeof(CSI_HISTORY_NACK_PREFIX) - 1;
+    if (len < prefix_len || len > CSI_HISTORY_NACK_MAX_LEN || memcmp(data, CSI_HISTORY_NACK_PREFIX, prefix_len) != 0) {
+        return -1;
+    }
+    const char *p = data + prefix_len, *end = data + len;
+    while (end > p && (end[-1] == '\0' || end[-1] == '\n')) {
+        end--;
+    }
+    uint8_t mac[6];
+    if (!read_mac(&p, end, mac)) {
+        memcpy(mac, h->last_mac, sizeof(mac));
+    }
+    csi_seq_range_t ranges[CSI_HISTORY_MAX_RANGES];
+    int n = 0;
+    while (p < end) {
+        csi_seq_range_t r;
+        if (n == CSI_HISTORY_MAX_RANGES || !read_seq(&p, end, &r.first)) {
+            return -1;
+        }
+        r.last = r.first;
+        if (p < end && *p == '-') {
+            p++;
+            if (!read_seq(&p, end, &r.last) || (int32_t)(r.last - r.first) < 0) {
+                return -1;
+            }
+        }
+        if (p < end && *p++ != ',') {
+            return -1;
+        }
+        /* Nothing older than a full index can still be held. */
+        if (r.last - r.first > h->slot_mask) {
+            r.first = r.last - h->slot_mask;
+        }
+        ranges[n++] = r;
+    }
+    if (n == 0) {
+        return -1;
+    }
+    h->nacks++;
+    int queued = 0;
+    for (int i = 0; i < n; i++) {
+        queued += history_queue(h, mac, ranges[i]);
+    }
+    return queued;
+}
+
+const uint8_t *csi_history_next(csi_history_t *h, uint32_t *seq, uint16_t *len) {
+    while (h->pending_count) {
+        csi_history_request_t *r = &h->pending[0];
+        uint8_t mac[6];
+        memcpy(mac, r->mac, sizeof(mac));
+        uint32_t s = r->range.first;
+        if (r->range.first == r->range.last) {
+            memmove(&h->pending[0], &h->pending[1], sizeof(h->pending[0]) * --h->pending_count);
+        } else {
+            r->range.first++;
+        }
+        const uint8_t *frame = history_find(h, mac, s, len);
+        if (frame) {
+            *seq = s;
+            h->resent++;
+            return frame;
+        }
+        h->expired++;
+    }
+    return NULL;
+}
+
+void csi_nack_init(csi_nack_tracker_t *t) {
+    memset(t, 0, sizeof(*t));
+}
+
+static uint64_t gap_frames(const csi_nack_gap_t *g) {
+    return (uint64_t)(g->range.last - g->range.first) + 1;
+}
+
+static void gap_remove(csi_nack_tracker_t *t, uint32_t i) {
+    memmove(&t->gaps[i], &t->gaps[i + 1], sizeof(t->gaps[0]) * (t->count - i - 1));
+    t->count--;
+}
+
+/* Makes room for one more gap by giving up the oldest. */
+static void gap_reserve(csi_nack_tracker_t *t) {
+    if (t->count == CSI_NACK_MAX_GAPS) {
+        t->abandoned += gap_frames(&t->gaps[0]);
+        gap_remove(t, 0);
+    }
+}
+
+int csi_nack_on_frame(csi_nack_tracker_t *t, uint32_t seq, uint64_t now_us) {
+    if (!t->started) {
+        t->started = 1;
+        t->next_seq = seq + 1;
+        return 0;
+    }
+    int32_t d = (int32_t)(seq - t->next_seq);
+    if (d >= 0) {
+        if (d > 0) {
+            csi_nack_gap_t g = {{t->next_seq, seq - 1}, now_us + CSI_NACK_DELAY_US, 0};
+            if (gap_frames(&g) > CSI_NACK_MAX_SPAN) {
+                t->abandoned += gap_frames(&g) - CSI_NACK_MAX_SPAN;
+                g.range.first = seq - CSI_NACK_MAX_SPAN;
+            }
+            gap_reserve(t);
+            t->gaps[t->count++] = g;
+        }
+        t->next_seq = seq + 1;
+        return 0;
+    }
+    if (d < -CSI_NACK_MAX_SPAN) {
+        /* The node restarted its sequence: nothing before can be asked for. */
+        t->abandoned += csi_nack_outstanding(t);
+        t->count = 0;
+        t->next_seq = seq + 1;
+        return 0;
+    }
+    for (uint32_t i = 0; i < t->count; i++) {
+        csi_nack_gap_t *g = &t->gaps[i];
+        if ((int32_t)(seq - g->range.first) < 0 || (int32_t)(seq - g->range.last) > 0) {
+            continue;
+        }
+        t->recovered++;
+        if (g->range.first == g->range.last) {
+            gap_remove(t, i);
+        } else if (seq == g->range.first) {
+            g->range.first++;
+        } else if (seq == g->range.last) {
+            g->range.last--;
+        } else {
+            csi_nack_gap_t upper = *g;
+            upper.range.first = seq + 1;
+            g->range.last = seq - 1;
+            if (t->count == CSI_NACK_MAX_GAPS) {
+                if (i == 0) {
+                    /* The split gap is the oldest: give up its lower part. */
+                    t->abandoned += gap_frames(g);
+                    *g = upper;
+                    return 1;
+                }
+                gap_reserve(t);
+                i--;
+            }
+            memmove(&t->gaps[i + 2], &t->gaps[i + 1], sizeof(t->gaps[0]) * (t->count - i - 1));
+            t->gaps[i + 1] = upper;
+            t->count++;
+        }
+        return 1;
+    }
+    return 0;  /* a duplicate */
+}
+
+size_t csi_nack_poll(csi_nack_tracker_t *t, const uint8_t *mac, uint64_t now_us, char *out, size_t cap) {
+    const size_t prefix_len = sizeof(CSI_HISTORY_NACK_PREFIX) - 1;
+    if (cap <= prefix_len + 18) {
+        return 0;
+    }
+    memcpy(out, CSI_HISTORY_NACK_PREFIX, prefix_len);
+    size_t used = prefix_len;
+    if (mac) {
+        used += (size_t)snprintf(out + used, cap - used, "%02x:%02x:%02x:%02x:%02x:%02x,", mac[0], mac[1], mac[2],
+                                 mac[3], mac[4], mac[5]);
+    }
+    int ranges = 0;
+    for (uint32_t i = 0; i < t->count;) {
+        csi_nack_gap_t *g = &t->gaps[i];
+        if (g->due_us > now_us) {
+            i++;
+            continue;
+        }
+        if (g->tries >= CSI_NACK_MAX_TRIES) {
+            t->abandoned += gap_frames(g);
+            gap_remove(t, i);
+            continue;
+        }
+        if (ranges < CSI_HISTORY_MAX_RANGES) {
+            char item[24];
+            int n = g->range.first == g->range.last
+                        ? snprintf(item, sizeof(item), "%s%u", ranges ? "," : "", (unsigned)g->range.first)
+                        : snprintf(item, sizeof(item), "%s%u-%u", ranges ? "," : "", (unsigned)g->range.first,
+                                   (unsigned)g->range.last);
+            if (n > 0 && used + (size_t)n < cap) {
+                memcpy(out + used, item, (size_t)n);
+                used += (size_t)n;
+                ranges++;
+                g->tries++;
+                g->due_us = now_us + CSI_NACK_RETRY_US;
+            }
+        }
+        i++;
+    }
+    if (!ranges) {
+        return 0;
+    }
+    out[used] = '\0';
+    t->nacks++;
+    return used;
+}
+
+uint64_t csi_nack_outstanding(const csi_nack_tracker_t *t) {
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < t->count; i++) {
+        n += gap_frames(&t->gaps[i]);
+    }
+    return n;
+}
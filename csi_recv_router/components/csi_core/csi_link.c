@@ -0,0 +1,192 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csi_link.h"
+
+/* fell_back, five marks, wakes, fast_ok, fast_failed */
+#define LINK_REPORT_FIELDS  9
+
+uint32_t csi_link_hash(uint32_t h, const char *s) {
+    for (; s && *s; s++) {
+        h = (h ^ (uint8_t)*s) * 16777619u;
+    }
+    /* The terminating NUL, hashed like any other byte. */
+    return h * 16777619u;
+}
+
+int csi_link_retained_valid(const csi_link_retained_t *retained, uint32_t creds_hash, uint32_t now_s) {
+    return retained->magic == CSI_LINK_MAGIC && retained->creds_hash == creds_hash && retained->valid &&
+           retained->channel != 0 && retained->ip != 0 &&
+           now_s >= retained->learned_s && now_s - retained->learned_s < CSI_LINK_MAX_AGE_S;
+}
+
+csi_link_action_t csi_link_begin(csi_link_t *link, csi_link_retained_t *retained, uint32_t creds_hash,
+                                 uint32_t now_s, uint32_t uptime_ms) {
+    memset(link, 0, sizeof(*link));
+    link->retained = retained;
+    if (retained->magic != CSI_LINK_MAGIC || retained->creds_hash != creds_hash) {
+        /* First boot (RTC memory is zeroed or garbage) or re-provisioned. */
+        memset(retained, 0, sizeof(*retained));
+        retained->magic = CSI_LINK_MAGIC;
+        retained->creds_hash = creds_hash;
+    }
+    retained->wakes++;
+    csi_link_mark(link, CSI_WAKE_WIFI, uptime_ms);
+
+    if (csi_link_retained_valid(retained, creds_hash, now_s)) {
+        link->fast = 1;
+        link->phase = CSI_LINK_FAST;
+        return CSI_LINK_ACT_CONNECT_FAST;
+    }
+    retained->valid = 0;
+    link->phase = CSI_LINK_FULL;
+    return CSI_LINK_ACT_CONNECT_FULL;
+}
+
+static csi_link_action_t link_retry(csi_link_t *link, csi_link_action_t action) {
+    if (++link->attempts >= CSI_LINK_MAX_ATTEMPTS) {
+        link->phase = CSI_LINK_FAILED;
+        return CSI_LINK_ACT_GIVE_UP;
+    }
+    link->phase = CSI_LINK_FULL;
+    return action;
+}
+
+csi_link_action_t csi_link_on_event(csi_link_t *link, csi_link_event_t event, const csi_link_info_t *info,
+                                    uint32_t now_s, uint32_t uptime_ms) {
+    csi_link_retained_t *r = link->retained;
+    switch (link->phase) {
+    case CSI_LINK_FAST:
+        if (event == CSI_LINK_EV_CONNECTED) {
+            csi_link_mark(link, CSI_WAKE_ASSOC, uptime_ms);
+            csi_link_mark(link, CSI_WAKE_IP, uptime_ms);
+            link->phase = CSI_LINK_UP;
+            link->attempts = 0;
+            r->fast_ok++;
+            return CSI_LINK_ACT_SET_STATIC_IP;
+        }
+        if (event == CSI_LINK_EV_DISCONNECTED || event == CSI_LINK_EV_TIMEOUT) {
+            /* The AP moved, changed channel or dropped us: relearn everything. */
+            r->valid = 0;
+            r->fast_failed++;
+            link->fell_back = 1;
+            link->phase = CSI_LINK_FULL;
+            return CSI_LINK_ACT_CONNECT_FULL;
+        }
+        return CSI_LINK_ACT_NONE;
+
+    case CSI_LINK_FULL:
+        if (event == CSI_LINK_EV_CONNECTED) {
+            csi_link_mark(link, CSI_WAKE_ASSOC, uptime_ms);
+            memcpy(r->bssid, info->bssid, sizeof(r->bssid));
+            r->channel = info->channel;
+            link->phase = CSI_LINK_WAIT_IP;
+            return CSI_LINK_ACT_NONE;
+        }
+        if (event == CSI_LINK_EV_DISCONNECTED) {
+            return link_retry(link, CSI_LINK_ACT_RECONNECT);
+        }
+        return CSI_LINK_ACT_NONE;
+
+    case CSI_LINK_WAIT_IP:
+        if (event == CSI_LINK_EV_GOT_IP) {
+            csi_link_mark(link, CSI_WAKE_IP, uptime_ms);
+            r->ip = info->ip;
+            r->netmask = info->netmask;
+            r->gw = info->gw;
+            r->learned_s = now_s;
+            r->valid = 1;
+            link->phase = CSI_LINK_UP;
+            link->attempts = 0;
+            return CSI_LINK_ACT_READY;
+        }
+        if (event == CSI_LINK_EV_DISCONNECTED) {
+            return link_retry(link, CSI_LINK_ACT_RECONNECT);
+        }
+        return CSI_LINK_ACT_NONE;
+
+    case CSI_LINK_UP:
+        if (event == CSI_LINK_EV_DISCONNECTED) {
+            /* Lost mid-session; the fast configuration may be why, so scan and use DHCP. */
+            return link_retry(link, CSI_LINK_ACT_CONNECT_FULL);
+        }
+        return CSI_LINK_ACT_NONE;
+
+    default:
+        return CSI_LINK_ACT_NONE;
+    }
+}
+
+void csi_link_mark(csi_link_t *link, csi_wake_mark_t mark, uint32_t uptime_ms) {
+    if (mark < CSI_WAKE_MARKS && link->marks_ms[mark] == 0) {
+        /* 0 means not reached, so a stamp at boot counts as 1 ms. */
+        link->marks_ms[mark] = uptime_ms ? uptime_ms : 1;
+    }
+}
+
+void csi_link_make_report(const csi_link_t *link, csi_wake_report_t *report) {
+    report->fast = link->fast;
+    report->fell_back = link->fell_back;
+    memcpy(report->marks_ms, link->marks_ms, sizeof(report->marks_ms));
+    report->wakes = link->retained ? link->retained->wakes : 0;
+    report->fast_ok = link->retained ? link->retained->fast_ok : 0;
+    report->fast_failed = link->retained ? link->retained->fast_failed : 0;
+}
+
+size_t csi_link_format_report(const csi_wake_report_t *report, char *out, size_t cap) {
+    int n = snprintf(out, cap,
+                     CSI_LINK_REPORT_PREFIX "%s,%u,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32
+                     ",%" PRIu32 ",%" PRIu32 ",%" PRIu32,
+                     report->fast ? "fast" : "full", (unsigned)report->fell_back,
+                     report->marks_ms[CSI_WAKE_WIFI], report->marks_ms[CSI_WAKE_ASSOC],
+                     report->marks_ms[CSI_WAKE_IP], report->marks_ms[CSI_WAKE_START],
+                     report->marks_ms[CSI_WAKE_FIRST_FRAME], report->wakes, report->fast_ok,
+                     report->fast_failed);
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+int csi_link_parse_report(const char *data, size_t len, csi_wake_report_t *report) {
+    const size_t prefix_len = sizeof(CSI_LINK_REPORT_PREFIX) - 1;
+    char line[CSI_LINK_REPORT_MAX_LEN];
+    if (len < prefix_len || len >= sizeof(line) || memcmp(data, CSI_LINK_REPORT_PREFIX, prefix_len) != 0) {
+        return 0;
+    }
+    memcpy(line, data, len);
+    line[len] = '\0';
+
+    char *p = line + prefix_len;
+    if (strncmp(p, "fast,", 5) == 0) {
+        report->fast = 1;
+    } else if (strncmp(p, "full,", 5) == 0) {
+        report->fast = 0;
+    } else {
+        return 0;
+    }
+    p += 5;
+
+    uint32_t v[LINK_REPORT_FIELDS];
+    for (size_t i = 0; i < LINK_REPORT_FIELDS; i++) {
+        char *end;
+        if (*p < '0' || *p > '9') {
+            return 0;
+        }
+        unsigned long long x = strtoull(p, &end, 10);
+        if (end == p || x > UINT32_MAX || *end != (i + 1 < LINK_REPORT_FIELDS ? ',' : '\0')) {
+            return 0;
+        }
+        v[i] = (uint32_t)x;
+        p = end + 1;
+    }
+    if (v[0] > 1) {
+        return 0;
+    }
+    report->fell_back = (uint8_t)v[0];
+    for (size_t i = 0; i < CSI_WAKE_MARKS; i++) {
+        report->marks_ms[i] = v[1 + i];
+    }
+    report->wakes = v[6];
+    report->fast_ok = v[7];
+    report->fast_failed = v[8];
+    return 1;
+}
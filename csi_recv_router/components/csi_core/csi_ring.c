@@ -0,0 +1,73 @@
+#include "csi_ring.h"
+
+static inline csi_ring_slot_hdr_t *slot_at(csi_ring_t *ring, uint32_t index) {
+    return (csi_ring_slot_hdr_t *)(ring->storage + (size_t)(index & ring->mask) * ring->stride);
+}
+
+int csi_ring_init(csi_ring_t *ring, void *storage, size_t slot_data_size, uint32_t slot_count) {
+    if (!ring || !storage || slot_data_size == 0 || slot_data_size > UINT16_MAX ||
+        slot_count == 0 || (slot_count & (slot_count - 1)) != 0) {
+        return -1;
+    }
+    ring->storage = (uint8_t *)storage;
+    ring->stride = CSI_RING_SLOT_STRIDE(slot_data_size);
+    ring->slot_data_size = slot_data_size;
+    ring->mask = slot_count - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->committed, 0);
+    atomic_init(&ring->overflows, 0);
+    atomic_init(&ring->high_water, 0);
+    return 0;
+}
+
+uint8_t *csi_ring_acquire(csi_ring_t *ring) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail > ring->mask) {
+        atomic_fetch_add_explicit(&ring->overflows, 1, memory_order_relaxed);
+        return NULL;
+    }
+    return (uint8_t *)(slot_at(ring, head) + 1);
+}
+
+void csi_ring_commit(csi_ring_t *ring, uint32_t seq, uint16_t len) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    csi_ring_slot_hdr_t *slot = slot_at(ring, head);
+    slot->seq = seq;
+    slot->len = len;
+
+    uint32_t depth = head + 1 - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (depth > atomic_load_explicit(&ring->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&ring->high_water, depth, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&ring->committed, 1, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+const uint8_t *csi_ring_peek(csi_ring_t *ring, uint32_t *seq, uint16_t *len) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    const csi_ring_slot_hdr_t *slot = slot_at(ring, tail);
+    if (seq) {
+        *seq = slot->seq;
+    }
+    if (len) {
+        *len = slot->len;
+    }
+    return (const uint8_t *)(slot + 1);
+}
+
+void csi_ring_release(csi_ring_t *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+uint32_t csi_ring_depth(csi_ring_t *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - tail;
+}
@@ -0,0 +1,128 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csi_capture.h"
+#include "csi_schedule.h"
+
+/* Reads one unsigned decimal field followed by ','; advances *p past the comma. */
+static int read_field(const char **p, unsigned long long *value) {
+    char *end;
+    if (**p < '0' || **p > '9') {
+        return 0;
+    }
+    *value = strtoull(*p, &end, 10);
+    if (*end != ',') {
+        return 0;
+    }
+    *p = end + 1;
+    return 1;
+}
+
+int csi_schedule_parse(const char *command, csi_schedule_t *plan) {
+    const size_t prefix_len = sizeof(CSI_SCHEDULE_COMMAND_PREFIX) - 1;
+    if (strncmp(command, CSI_SCHEDULE_COMMAND_PREFIX, prefix_len) != 0) {
+        return CSI_SCHEDULE_ERR_COMMAND;
+    }
+    const char *p = command + prefix_len;
+    if (strcmp(p, "cancel") == 0) {
+        return CSI_SCHEDULE_CANCEL;
+    }
+
+    unsigned long long id, first, interval, count;
+    if (!read_field(&p, &id) || !read_field(&p, &first) || !read_field(&p, &interval) ||
+        !read_field(&p, &count)) {
+        return CSI_SCHEDULE_ERR_COMMAND;
+    }
+    if (id > UINT32_MAX || first == 0 || first > INT64_MAX / 2 || interval > UINT32_MAX || count == 0 ||
+        count > UINT32_MAX) {
+        return CSI_SCHEDULE_ERR_PLAN;
+    }
+    if (strlen(p) >= CSI_SCHEDULE_START_MAX_LEN) {
+        return CSI_SCHEDULE_ERR_START;
+    }
+    csi_capture_config_t capture;
+    if (csi_capture_parse_start(p, &capture) != CSI_CAPTURE_OK) {
+        return CSI_SCHEDULE_ERR_START;
+    }
+    if (count > 1 && interval < (unsigned long long)capture.duration_s + CSI_SCHEDULE_MIN_GAP_S) {
+        return CSI_SCHEDULE_ERR_PLAN;
+    }
+
+    plan->id = (uint32_t)id;
+    plan->first_start_us = (int64_t)first;
+    plan->interval_s = (uint32_t)interval;
+    plan->count = (uint32_t)count;
+    plan->duration_s = capture.duration_s;
+    strcpy(plan->start, p);
+    return CSI_SCHEDULE_OK;
+}
+
+int csi_schedule_window(const csi_schedule_t *plan, int64_t now_us, uint32_t *index, int64_t *start_us) {
+    const int64_t interval_us = (int64_t)plan->interval_s * 1000000;
+    const int64_t duration_us = (int64_t)plan->duration_s * 1000000;
+    int64_t i = 0;
+    if (now_us >= plan->first_start_us + duration_us) {
+        if (interval_us == 0) {
+            return 0;
+        }
+        i = (now_us - plan->first_start_us - duration_us) / interval_us + 1;
+    }
+    if (i >= plan->count) {
+        return 0;
+    }
+    *index = (uint32_t)i;
+    *start_us = plan->first_start_us + i * interval_us;
+    return 1;
+}
+
+uint64_t csi_schedule_sleep_us(int64_t now_us, int64_t start_us, uint32_t lead_ms) {
+    int64_t wait = start_us - now_us - (int64_t)lead_ms * 1000;
+    if (wait <= 0) {
+        return 0;
+    }
+    /* A slow clock running fast would wake us late; assume it does. */
+    wait -= wait / 1000000 * CSI_SCHEDULE_SLEEP_DRIFT_PPM + wait % 1000000 * CSI_SCHEDULE_SLEEP_DRIFT_PPM / 1000000;
+    return wait < (int64_t)CSI_SCHEDULE_MIN_SLEEP_MS * 1000 ? 0 : (uint64_t)wait;
+}
+
+uint32_t csi_schedule_lead_ms(uint32_t previous_ms, uint32_t ready_ms) {
+    uint32_t target = ready_ms + ready_ms / 2 + 250;
+    uint32_t lead = previous_ms == 0 || target >= previous_ms ? target : previous_ms - (previous_ms - target) / 8;
+    if (lead < CSI_SCHEDULE_MIN_LEAD_MS) {
+        return CSI_SCHEDULE_MIN_LEAD_MS;
+    }
+    return lead > CSI_SCHEDULE_MAX_LEAD_MS ? CSI_SCHEDULE_MAX_LEAD_MS : lead;
+}
+
+size_t csi_schedule_format_report(const csi_schedule_report_t *report, char *out, size_t cap) {
+    int n = snprintf(out, cap, CSI_SCHEDULE_REPORT_PREFIX "%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRId64,
+                     report->id, report->index, report->count, report->start_us);
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+int csi_schedule_parse_report(const char *data, size_t len, csi_schedule_report_t *report) {
+    const size_t prefix_len = sizeof(CSI_SCHEDULE_REPORT_PREFIX) - 1;
+    char line[CSI_SCHEDULE_REPORT_MAX_LEN];
+    if (len < prefix_len || len >= sizeof(line) || memcmp(data, CSI_SCHEDULE_REPORT_PREFIX, prefix_len) != 0) {
+        return 0;
+    }
+    memcpy(line, data, len);
+    line[len] = '\0';
+
+    const char *p = line + prefix_len;
+    unsigned long long id, index, count;
+    if (!read_field(&p, &id) || !read_field(&p, &index) || !read_field(&p, &count)) {
+        return 0;
+    }
+    char *end;
+    long long start = strtoll(p, &end, 10);
+    if (end == p || *end != '\0' || id > UINT32_MAX || index > UINT32_MAX || count > UINT32_MAX || index > count) {
+        return 0;
+    }
+    report->id = (uint32_t)id;
+    report->index = (uint32_t)index;
+    report->count = (uint32_t)count;
+    report->start_us = (int64_t)start;
+    return 1;
+}
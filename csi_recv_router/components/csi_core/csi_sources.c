@@ -0,0 +1,134 @@
+#include <string.h>
+#include "csi_sources.h"
+
+#define BUCKET_MASK  (CSI_SOURCES_BUCKETS - 1)
+
+/* The low bytes vary most between devices; the OUI is often shared. */
+static uint32_t mac_hash(const uint8_t mac[6]) {
+    uint32_t h = (uint32_t)mac[5] | (uint32_t)mac[4] << 8 | (uint32_t)mac[3] << 16;
+    return (h * 0x9E3779B1u) >> 16;
+}
+
+/* Entry of a bucket, or NULL if it is empty; acquire pairs with the release in add. */
+static csi_source_t *bucket_entry(const csi_sources_t *t, uint32_t b) {
+    uint8_t idx = atomic_load_explicit(&t->buckets[b], memory_order_acquire);
+    return idx ? (csi_source_t *)&t->entries[idx - 1] : NULL;
+}
+
+/* Bucket holding mac, or the empty bucket where it would go. */
+static uint32_t find_bucket(const csi_sources_t *t, const uint8_t mac[6]) {
+    uint32_t b = mac_hash(mac) & BUCKET_MASK;
+    const csi_source_t *s;
+    while ((s = bucket_entry(t, b)) && memcmp(s->mac, mac, 6) != 0) {
+        b = (b + 1) & BUCKET_MASK;
+    }
+    return b;
+}
+
+/* Fills the entry first, then publishes count and the bucket. */
+static csi_source_t *add(csi_sources_t *t, uint32_t bucket, const uint8_t mac[6], uint32_t seq, uint8_t ap) {
+    uint8_t n = atomic_load_explicit(&t->count, memory_order_relaxed);
+    if (n == CSI_SOURCES_MAX) {
+        return NULL;
+    }
+    csi_source_t *s = &t->entries[n];
+    memset(s, 0, sizeof(*s));
+    memcpy(s->mac, mac, 6);
+    s->ap = ap;
+    s->seq = seq;
+    csi_decimator_init(&s->dec);
+    atomic_store_explicit(&t->count, (uint8_t)(n + 1), memory_order_release);
+    atomic_store_explicit(&t->buckets[bucket], (uint8_t)(n + 1), memory_order_release);
+    return s;
+}
+
+static csi_source_t *add_once(csi_sources_t *t, const uint8_t mac[6], const uint8_t ap_bssid[6]) {
+    uint32_t b = find_bucket(t, mac);
+    csi_source_t *s = bucket_entry(t, b);
+    return s ? s : add(t, b, mac, 0, memcmp(mac, ap_bssid, 6) == 0);
+}
+
+void csi_sources_init(csi_sources_t *t) {
+    for (uint32_t b = 0; b < CSI_SOURCES_BUCKETS; b++) {
+        atomic_store_explicit(&t->buckets[b], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&t->count, 0, memory_order_release);
+    memset(t->entries, 0, sizeof(t->entries));
+    t->mode = 0;
+    atomic_store_explicit(&t->rejected, 0, memory_order_relaxed);
+    atomic_store_explicit(&t->overflow, 0, memory_order_relaxed);
+}
+
+static int allowed(const csi_capture_config_t *cfg, const uint8_t ap_bssid[6], const uint8_t mac[6]) {
+    int is_ap = memcmp(mac, ap_bssid, 6) == 0;
+    if (cfg->source_mode == CSI_CAPTURE_SRC_ANY || (is_ap && cfg->source_mode == CSI_CAPTURE_SRC_AP) ||
+        (is_ap && cfg->source_ap)) {
+        return 1;
+    }
+    if (cfg->source_mode == CSI_CAPTURE_SRC_AP) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < cfg->source_count; i++) {
+        if (memcmp(mac, cfg->sources[i], 6) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void csi_sources_configure(csi_sources_t *t, const csi_capture_config_t *cfg, const uint8_t ap_bssid[6]) {
+    csi_source_t kept[CSI_SOURCES_MAX];
+    uint8_t n = 0;
+    uint8_t count = csi_sources_count(t);
+    for (uint8_t i = 0; i < count; i++) {
+        if (allowed(cfg, ap_bssid, t->entries[i].mac)) {
+            kept[n++] = t->entries[i];
+        }
+    }
+    csi_sources_init(t);
+    t->mode = cfg->source_mode;
+    for (uint8_t i = 0; i < n; i++) {
+        add(t, find_bucket(t, kept[i].mac), kept[i].mac, kept[i].seq, memcmp(kept[i].mac, ap_bssid, 6) == 0);
+    }
+    if (cfg->source_mode != CSI_CAPTURE_SRC_LIST || cfg->source_ap) {
+        add_once(t, ap_bssid, ap_bssid);
+    }
+    if (cfg->source_mode == CSI_CAPTURE_SRC_LIST) {
+        for (uint8_t i = 0; i < cfg->source_count; i++) {
+            add_once(t, cfg->sources[i], ap_bssid);
+        }
+    }
+}
+
+csi_source_t *csi_sources_lookup(csi_sources_t *t, const uint8_t mac[6]) {
+    uint32_t b = find_bucket(t, mac);
+    csi_source_t *s = bucket_entry(t, b);
+    if (s) {
+        return s;
+    }
+    if (t->mode != CSI_CAPTURE_SRC_ANY) {
+        atomic_fetch_add_explicit(&t->rejected, 1, memory_order_relaxed);
+        return NULL;
+    }
+    s = add(t, b, mac, 0, 0);  /* the AP is added by configure when it may pass */
+    if (!s) {
+        atomic_fetch_add_explicit(&t->overflow, 1, memory_order_relaxed);
+    }
+    return s;
+}
+
+const csi_source_t *csi_sources_find(const csi_sources_t *t, const uint8_t mac[6]) {
+    return bucket_entry(t, find_bucket(t, mac));
+}
+
+uint8_t csi_sources_count(const csi_sources_t *t) {
+    return atomic_load_explicit(&t->count, memory_order_acquire);
+}
+
+uint32_t csi_sources_overflow(const csi_sources_t *t) {
+    return atomic_load_explicit(&t->overflow, memory_order_relaxed);
+}
+
+uint32_t csi_sources_rejected(const csi_sources_t *t) {
+    return atomic_load_explicit(&t->rejected, memory_order_relaxed);
+}
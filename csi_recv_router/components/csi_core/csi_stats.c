@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csi_stats.h"
+
+/* uptime and the 12 counters that precede the histograms on the wire */
+#define STATS_SCALAR_FIELDS  13
+
+void csi_stats_init(csi_stats_t *stats) {
+    atomic_init(&stats->seen, 0);
+    atomic_init(&stats->filtered, 0);
+    atomic_init(&stats->accepted, 0);
+    atomic_init(&stats->truncated, 0);
+    atomic_init(&stats->decimated, 0);
+    atomic_init(&stats->serialized, 0);
+    atomic_init(&stats->sent, 0);
+    atomic_init(&stats->send_failed, 0);
+    atomic_init(&stats->resent, 0);
+    for (int i = 0; i < CSI_STATS_HIST_BINS; i++) {
+        atomic_init(&stats->callback_us.bins[i], 0);
+        atomic_init(&stats->interval_us.bins[i], 0);
+    }
+    stats->last_rx_us = 0;
+    stats->has_last_rx = 0;
+}
+
+void csi_stats_rx_interval(csi_stats_t *stats, uint32_t timestamp_us) {
+    if (stats->has_last_rx) {
+        csi_hist_add(&stats->interval_us, (uint32_t)(timestamp_us - stats->last_rx_us));
+    }
+    stats->last_rx_us = timestamp_us;
+    stats->has_last_rx = 1;
+}
+
+static uint32_t load(_Atomic uint32_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void csi_stats_snapshot(csi_stats_t *stats, csi_stats_report_t *report) {
+    report->seen = load(&stats->seen);
+    report->filtered = load(&stats->filtered);
+    report->accepted = load(&stats->accepted);
+    report->truncated = load(&stats->truncated);
+    report->decimated = load(&stats->decimated);
+    report->serialized = load(&stats->serialized);
+    report->sent = load(&stats->sent);
+    report->send_failed = load(&stats->send_failed);
+    report->resent = load(&stats->resent);
+    for (int i = 0; i < CSI_STATS_HIST_BINS; i++) {
+        report->callback_us[i] = load(&stats->callback_us.bins[i]);
+        report->interval_us[i] = load(&stats->interval_us.bins[i]);
+    }
+}
+
+uint32_t csi_stats_hist_percentile(const uint32_t bins[CSI_STATS_HIST_BINS], float p) {
+    uint64_t total = 0;
+    for (int i = 0; i < CSI_STATS_HIST_BINS; i++) {
+        total += bins[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)((double)p / 100.0 * (double)total + 0.5);
+    rank = rank < 1 ? 1 : rank > total ? total : rank;
+    uint64_t seen = 0;
+    int bin = 0;
+    for (; bin < CSI_STATS_HIST_BINS - 1; bin++) {
+        seen += bins[bin];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    if (bin == 0) {
+        return 0;
+    }
+    return bin == CSI_STATS_HIST_BINS - 1 ? 1u << (bin - 1) : 1u << bin;
+}
+
+size_t csi_stats_format_report(const csi_stats_report_t *report, char *out, size_t cap) {
+    int n = snprintf(out, cap, CSI_STATS_REPORT_PREFIX "%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u",
+                     (unsigned)report->uptime_ms, (unsigned)report->seen, (unsigned)report->accepted,
+                     (unsigned)report->filtered, (unsigned)report->truncated, (unsigned)report->decimated,
+                     (unsigned)report->ring_full, (unsigned)report->serialized, (unsigned)report->sent,
+                     (unsigned)report->send_failed, (unsigned)report->resent, (unsigned)report->queue_depth,
+                     (unsigned)report->queue_high);
+    for (int h = 0; h < 2 && n > 0 && (size_t)n < cap; h++) {
+        const uint32_t *bins = h == 0 ? report->callback_us : report->interval_us;
+        for (int i = 0; i < CSI_STATS_HIST_BINS && n > 0 && (size_t)n < cap; i++) {
+            int m = snprintf(out + n, cap - (size_t)n, ",%u", (unsigned)bins[i]);
+            n = m < 0 ? -1 : n + m;
+        }
+    }
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+int csi_stats_parse_report(const char *data, size_t len, csi_stats_report_t *report) {
+    static const size_t prefix_len = sizeof(CSI_STATS_REPORT_PREFIX) - 1;
+    char line[CSI_STATS_REPORT_MAX_LEN];
+    if (len < prefix_len || len >= sizeof(line) || memcmp(data, CSI_STATS_REPORT_PREFIX, prefix_len) != 0) {
+        return 0;
+    }
+    memcpy(line, data, len);
+    line[len] = '\0';
+
+    uint32_t values[STATS_SCALAR_FIELDS + 2 * CSI_STATS_HIST_BINS];
+    const size_t count = sizeof(values) / sizeof(values[0]);
+    char *p = line + prefix_len;
+    for (size_t i = 0; i < count; i++) {
+        char *end;
+        unsigned long v = strtoul(p, &end, 10);
+        if (end == p || v > UINT32_MAX || *end != (i + 1 < count ? ',' : '\0')) {
+            return 0;
+        }
+        values[i] = (uint32_t)v;
+        p = end + 1;
+    }
+    report->uptime_ms = values[0];
+    report->seen = values[1];
+    report->accepted = values[2];
+    report->filtered = values[3];
+    report->truncated = values[4];
+    report->decimated = values[5];
+    report->ring_full = values[6];
+    report->serialized = values[7];
+    report->sent = values[8];
+    report->send_failed = values[9];
+    report->resent = values[10];
+    report->queue_depth = values[11];
+    report->queue_high = values[12];
+    memcpy(report->callback_us, values + STATS_SCALAR_FIELDS, sizeof(report->callback_us));
+    memcpy(report->interval_us, values + STATS_SCALAR_FIELDS + CSI_STATS_HIST_BINS, sizeof(report->interval_us));
+    return 1;
+}
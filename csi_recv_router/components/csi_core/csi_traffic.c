@@ -0,0 +1,152 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "csi_traffic.h"
+
+#define PACER_DEADBAND     0.02f
+#define PACER_MAX_STEP     2.0f
+
+void csi_rate_meter_init(csi_rate_meter_t *meter) {
+    memset(meter, 0, sizeof(*meter));
+}
+
+void csi_rate_meter_add(csi_rate_meter_t *meter, uint32_t timestamp_us) {
+    meter->frames++;
+    if (meter->started) {
+        uint64_t gap = (uint32_t)(timestamp_us - meter->last_us);
+        meter->gaps++;
+        meter->gap_sum_us += gap;
+        meter->gap_sq_sum_us += gap * gap;
+    }
+    meter->last_us = timestamp_us;
+    meter->started = 1;
+}
+
+void csi_rate_meter_stats(const csi_rate_meter_t *meter, uint32_t elapsed_us, csi_rate_stats_t *stats) {
+    stats->frames = meter->frames;
+    stats->achieved_hz = elapsed_us ? (float)((double)meter->frames * 1e6 / elapsed_us) : 0.0f;
+    stats->jitter_us = 0.0f;
+    if (meter->gaps > 1) {
+        double mean = (double)meter->gap_sum_us / meter->gaps;
+        double var = (double)meter->gap_sq_sum_us / meter->gaps - mean * mean;
+        stats->jitter_us = var > 0 ? (float)sqrt(var) : 0.0f;
+    }
+}
+
+void csi_rate_meter_window(const csi_rate_meter_t *now, const csi_rate_meter_t *before, csi_rate_meter_t *window) {
+    window->frames = now->frames - before->frames;
+    window->gaps = now->gaps - before->gaps;
+    window->gap_sum_us = now->gap_sum_us - before->gap_sum_us;
+    window->gap_sq_sum_us = now->gap_sq_sum_us - before->gap_sq_sum_us;
+    window->last_us = now->last_us;
+    window->started = now->started;
+}
+
+void csi_rate_feed_init(csi_rate_feed_t *feed) {
+    csi_rate_meter_init(&feed->totals);
+    atomic_init(&feed->version, 0);
+    atomic_init(&feed->rearm, 0);
+}
+
+void csi_rate_feed_add(csi_rate_feed_t *feed, uint32_t timestamp_us) {
+    uint32_t version = atomic_load_explicit(&feed->version, memory_order_relaxed);
+    atomic_store_explicit(&feed->version, version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    if (atomic_exchange_explicit(&feed->rearm, 0, memory_order_relaxed)) {
+        feed->totals.started = 0;
+    }
+    csi_rate_meter_add(&feed->totals, timestamp_us);
+    atomic_store_explicit(&feed->version, version + 2, memory_order_release);
+}
+
+void csi_rate_feed_snapshot(csi_rate_feed_t *feed, csi_rate_meter_t *out) {
+    uint32_t before, after;
+    do {
+        before = atomic_load_explicit(&feed->version, memory_order_acquire);
+        *out = feed->totals;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&feed->version, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+void csi_rate_feed_rearm(csi_rate_feed_t *feed) {
+    atomic_store_explicit(&feed->rearm, 1, memory_order_relaxed);
+}
+
+static uint32_t clamp_interval(const csi_pacer_t *pacer, float interval_us) {
+    if (interval_us < (float)pacer->min_interval_us) {
+        return pacer->min_interval_us;
+    }
+    if (interval_us > (float)pacer->max_interval_us) {
+        return pacer->max_interval_us;
+    }
+    return (uint32_t)interval_us;
+}
+
+void csi_pacer_init(csi_pacer_t *pacer, uint32_t target_hz, uint32_t min_interval_us, uint32_t max_interval_us) {
+    pacer->target_hz = target_hz ? target_hz : 1;
+    pacer->min_interval_us = min_interval_us;
+    pacer->max_interval_us = max_interval_us > min_interval_us ? max_interval_us : min_interval_us;
+    pacer->interval_us = clamp_interval(pacer, 1e6f / (float)pacer->target_hz);
+}
+
+uint32_t csi_pacer_update(csi_pacer_t *pacer, const csi_rate_stats_t *stats) {
+    float target = (float)pacer->target_hz;
+    float step;
+    if (stats->frames == 0) {
+        step = PACER_MAX_STEP;  /* nothing came back: probe harder */
+    } else {
+        if (fabsf(stats->achieved_hz - target) <= target * PACER_DEADBAND) {
+            return pacer->interval_us;
+        }
+        step = sqrtf(target / stats->achieved_hz);
+        if (step > PACER_MAX_STEP) {
+            step = PACER_MAX_STEP;
+        } else if (step < 1.0f / PACER_MAX_STEP) {
+            step = 1.0f / PACER_MAX_STEP;
+        }
+    }
+    pacer->interval_us = clamp_interval(pacer, (float)pacer->interval_us / step);
+    return pacer->interval_us;
+}
+
+size_t csi_traffic_format_report(const csi_traffic_report_t *report, char *out, size_t cap) {
+    /* Fixed-point tenths: keeps float formatting out of the node's printf. */
+    uint32_t tenths = (uint32_t)(report->achieved_hz * 10.0f + 0.5f);
+    int n = snprintf(out, cap, CSI_TRAFFIC_REPORT_PREFIX "%u,%u.%u,%u,%u,%s,%u",
+                     (unsigned)report->target_hz, (unsigned)(tenths / 10), (unsigned)(tenths % 10),
+                     (unsigned)(report->jitter_us + 0.5f), (unsigned)report->interval_us,
+                     report->probe == CSI_TRAFFIC_PROBE_UDP ? "udp" : "icmp", (unsigned)report->sent);
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+int csi_traffic_parse_report(const char *data, size_t len, csi_traffic_report_t *report) {
+    static const size_t prefix_len = sizeof(CSI_TRAFFIC_REPORT_PREFIX) - 1;
+    char line[CSI_TRAFFIC_REPORT_MAX_LEN];
+    if (len < prefix_len || len >= sizeof(line) || memcmp(data, CSI_TRAFFIC_REPORT_PREFIX, prefix_len) != 0) {
+        return 0;
+    }
+    memcpy(line, data, len);
+    line[len] = '\0';
+
+    unsigned target, jitter, interval, sent;
+    float achieved;
+    char probe[8];
+    if (sscanf(line + prefix_len, "%u,%f,%u,%u,%7[a-z],%u", &target, &achieved, &jitter, &interval, probe,
+               &sent) != 6) {
+        return 0;
+    }
+    if (strcmp(probe, "icmp") == 0) {
+        report->probe = CSI_TRAFFIC_PROBE_ICMP;
+    } else if (strcmp(probe, "udp") == 0) {
+        report->probe = CSI_TRAFFIC_PROBE_UDP;
+    } else {
+        return 0;
+    }
+    report->target_hz = target;
+    report->achieved_hz = achieved;
+    report->jitter_us = (float)jitter;
+    report->interval_us = interval;
+    report->sent = sent;
+    return 1;
+}
@@ -0,0 +1,90 @@
+/*
+ * =================================================================================
+ * CSI DATAGRAM BATCHING
+ * =================================================================================
+ *
+ * Coalesces several serialized frames (text or binary) into one UDP datagram.
+ *
+ * Batch layout (all fields little-endian):
+ *
+ *   off  size  field
+ *     0     2  magic (CSI_BATCH_MAGIC)
+ *     2     1  version (CSI_BATCH_VERSION)
+ *     3     1  count (frames in this datagram)
+ *     4     4  first_seq (sequence number of the first frame)
+ *     8     -  count x { uint16 len, len bytes of frame }
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_BATCH_MAGIC            0xC5B7u
+#define CSI_BATCH_VERSION          1
+#define CSI_BATCH_HDR_SIZE         8
+#define CSI_BATCH_ENTRY_HDR_SIZE   2
+#define CSI_BATCH_MAX_FRAMES       255
+
+typedef struct {
+    uint8_t  *buf;
+    size_t    cap;
+    size_t    used;
+    uint32_t  first_seq;
+    uint8_t   count;
+} csi_batch_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t         len;
+    size_t         offset;
+    uint32_t       first_seq;
+    uint8_t        count;
+    uint8_t        remaining;
+} csi_batch_reader_t;
+
+/**
+ * Binds the builder to buf; cap is the datagram byte budget.
+ */
+void csi_batch_init(csi_batch_t *batch, uint8_t *buf, size_t cap);
+
+/**
+ * Empties the batch so a new datagram can be assembled in the same buffer.
+ */
+void csi_batch_reset(csi_batch_t *batch);
+
+/**
+ * Appends a frame. Returns 0 on success, or -1 if it would exceed the budget
+ * or the frame count limit; the batch is left unchanged in that case.
+ */
+int csi_batch_add(csi_batch_t *batch, uint32_t seq, const uint8_t *frame, uint16_t len);
+
+/**
+ * Writes the batch header and returns the datagram length (0 if empty).
+ */
+size_t csi_batch_finish(csi_batch_t *batch);
+
+/**
+ * Returns non-zero if the datagram starts with the batch magic.
+ */
+int csi_batch_is_batch(const uint8_t *data, size_t len);
+
+/**
+ * Validates the batch header and prepares reader for csi_batch_next.
+ * Returns 0 on success, -1 if the datagram is not a well-formed batch.
+ */
+int csi_batch_open(csi_batch_reader_t *reader, const uint8_t *data, size_t len);
+
+/**
+ * Yields the next frame of the batch. Returns 1 with frame and len set,
+ * 0 when all frames were consumed, or -1 if the batch is truncated.
+ */
+int csi_batch_next(csi_batch_reader_t *reader, const uint8_t **frame, uint16_t *len);
+
+#ifdef __cplusplus
+}
+#endif
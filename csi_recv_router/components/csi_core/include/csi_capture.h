@@ -0,0 +1,122 @@
+/*
+ * =================================================================================
+ * CSI CAPTURE OPTIONS
+ * =================================================================================
+ *
+ * Parsing of the collector's start command and the per-frame reductions it
+ * requests, applied by the node before a frame is serialized.
+ *
+ * Start command (ASCII, one UDP datagram):
+ *
+ *   start,<seconds>[,sc=<hex>][,dec=<n>][,rate=<hz>][,mode=raw|amp]
+ *         [,target=<hz>][,probe=icmp|udp][,src=ap|any|<source>[+<source>...]]
+ *
+ *   sc    subcarrier bitmask in hex, most significant digit first. Bit i keeps
+ *         the i-th (imag, real) pair of the CSI buffer, i.e. buffer order, not
+ *         frequency order: with LLTF only, pairs 0..31 are subcarriers 0..31 and
+ *         pairs 32..63 are -32..-1 (0..63 and -64..-1 at 40 MHz). At most
+ *         CSI_CAPTURE_MAX_PAIRS bits; pairs past the end of a buffer are ignored.
+ *         Default: every pair.
+ *   dec   keep one frame out of n. Default 1.
+ *   rate  keep at most this many frames per second, paced on the radio
+ *         timestamp. Default 0 (no limit). Applied after dec.
+ *   mode  raw: (imag, real) int8 pairs as delivered by the driver (default).
+ *         amp:  one int8 per kept pair, round(sqrt(imag^2 + real^2)) clamped
+ *               to 127; binary frames carry CSI_FRAME_FLAG_AMPLITUDE.
+ *   target CSI rate the traffic generator steers towards (csi_traffic.h),
+ *         counted before dec and rate. Default 0 (the firmware default).
+ *   probe icmp: echo requests to the gateway (default).
+ *         udp:  datagrams to the collector, which echoes them back.
+ *   src   the transmitters whose frames are captured (csi_sources.h).
+ *         ap:  the access point the node is associated with (default).
+ *         any: every transmitter heard on the channel, in promiscuous mode.
+ *         Otherwise up to CSI_CAPTURE_MAX_SOURCES sources joined by '+', each
+ *         a MAC (aa:bb:cc:dd:ee:ff) or "ap".
+ *
+ * "start,<seconds>" alone keeps the historical behaviour. dec and rate apply
+ * to each transmitter separately, and each one numbers its frames on its own.
+ * Frames dropped by dec or rate do not consume a sequence number, so gaps
+ * seen by the host are still losses.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_CAPTURE_MAX_PAIRS      128
+#define CSI_CAPTURE_MASK_BYTES     (CSI_CAPTURE_MAX_PAIRS / 8)
+
+#define CSI_CAPTURE_MODE_RAW       0
+#define CSI_CAPTURE_MODE_AMPLITUDE 1
+
+#define CSI_CAPTURE_MAX_SOURCES    8
+#define CSI_CAPTURE_SRC_AP         0
+#define CSI_CAPTURE_SRC_LIST       1
+#define CSI_CAPTURE_SRC_ANY        2
+
+#define CSI_CAPTURE_OK             0
+#define CSI_CAPTURE_ERR_COMMAND   -1   /* not a start command, or no duration */
+#define CSI_CAPTURE_ERR_OPTION    -2   /* unknown option or malformed value */
+
+typedef struct {
+    uint32_t duration_s;
+    uint8_t  sc_mask[CSI_CAPTURE_MASK_BYTES];  /* bit i of byte i / 8 = pair i */
+    uint8_t  sc_mask_set;                      /* 0: keep every pair */
+    uint16_t decimation;
+    uint16_t rate_hz;
+    uint8_t  payload_mode;
+    uint16_t target_hz;                        /* 0: firmware default */
+    uint8_t  probe;                            /* CSI_TRAFFIC_PROBE_* */
+    uint8_t  source_mode;                      /* CSI_CAPTURE_SRC_* */
+    uint8_t  source_ap;                        /* SRC_LIST: the access point too */
+    uint8_t  source_count;
+    uint8_t  sources[CSI_CAPTURE_MAX_SOURCES][6];
+} csi_capture_config_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t next_us;
+    uint8_t  started;
+} csi_decimator_t;
+
+/**
+ * Fills cfg with the defaults: every pair, every frame, raw payload, ICMP probes
+ * at the firmware's default rate.
+ */
+void csi_capture_config_init(csi_capture_config_t *cfg);
+
+/**
+ * Parses a NUL-terminated start command into cfg. Returns CSI_CAPTURE_OK or a
+ * negative CSI_CAPTURE_ERR_* code; cfg is only written on success.
+ */
+int csi_capture_parse_start(const char *cmd, csi_capture_config_t *cfg);
+
+/**
+ * True if the config leaves payloads untouched (no mask, raw mode), so the
+ * caller can skip csi_capture_reduce.
+ */
+int csi_capture_is_passthrough(const csi_capture_config_t *cfg);
+
+void csi_decimator_init(csi_decimator_t *dec);
+
+/**
+ * Decides whether the frame received at timestamp_us (the 32-bit local radio
+ * clock, wrap-safe) is kept under the config's decimation and rate limit.
+ */
+int csi_capture_keep_frame(const csi_capture_config_t *cfg, csi_decimator_t *dec, uint32_t timestamp_us);
+
+/**
+ * Applies the subcarrier mask and payload mode to len bytes of raw I/Q and
+ * writes the result to out, which must hold len bytes (the output is never
+ * longer). Returns the number of bytes written. in and out must not overlap.
+ */
+uint16_t csi_capture_reduce(const csi_capture_config_t *cfg, const int8_t *in, uint16_t len, int8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
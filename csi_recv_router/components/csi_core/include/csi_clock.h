@@ -0,0 +1,134 @@
+/*
+ * =================================================================================
+ * CSI CLOCK SYNCHRONIZATION
+ * =================================================================================
+ *
+ * Lightweight NTP-style exchange that puts every node on the collector's
+ * clock, so frames from several receivers can be aligned to well under a
+ * millisecond instead of to the UDP arrival jitter.
+ *
+ * The node sends a request stamped with its local clock (t1); the collector
+ * stamps its receive (t2) and send (t3) times on its own clock, the shared
+ * timebase, and echoes the request; the node stamps the reply on receipt (t4):
+ *
+ *   CSI_SYNC,<seq>,<t1>                     node -> collector
+ *   CSI_SYNC,<seq>,<t1>,<t2>,<t3>           collector -> node
+ *
+ *   offset = ((t2 - t1) + (t3 - t4)) / 2    shared - local
+ *   delay  = (t4 - t1) - (t3 - t2)          round trip on the network
+ *
+ * All times are microseconds; shared time is the collector's wall clock
+ * (Unix epoch). csi_clock_t keeps the best exchange of every CSI_CLOCK_BUCKET_US
+ * of local time, for the last CSI_CLOCK_SAMPLES buckets, and fits offset
+ * against local time by weighted least squares. Queuing only ever adds delay,
+ * so an exchange's weight falls with its round trip in excess of the best one.
+ * The fit gives the offset at an anchor and the drift of the node's crystal;
+ * until the history spans CSI_CLOCK_MIN_SPAN_US the best exchange is used and
+ * the drift is kept.
+ *
+ * Frames keep their local radio timestamp (csi_frame.h) so every collector
+ * format stays unchanged. Instead the node publishes the mapping, anchored on
+ * the radio clock, after every exchange:
+ *
+ *   CSI_CLOCK,<radio_anchor_us>,<shared_anchor_us>,<drift_ppb>,<error_us>,<samples>
+ *
+ *   shared(ts) = shared_anchor + d + d * drift_ppb / 1e9,
+ *   d = (int32_t)(ts - radio_anchor)        wrap-safe within +-35 minutes
+ *
+ * drift_ppb is how much faster shared time runs than the node's clock, i.e. the
+ * node crystal's error negated. error_us is half the smallest round trip, a
+ * bound on the offset error at the anchor.
+ * Collectors that only look for CSI_DATA lines ignore both datagrams.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_CLOCK_SYNC_PREFIX      "CSI_SYNC,"
+#define CSI_CLOCK_REPORT_PREFIX    "CSI_CLOCK,"
+#define CSI_CLOCK_MSG_MAX_LEN      96
+/* Exchange schedule: a burst when capture starts, then a steady period. */
+#define CSI_CLOCK_BURST            8
+#define CSI_CLOCK_BURST_SPACING_MS 50
+#define CSI_CLOCK_PERIOD_MS        1000
+#define CSI_CLOCK_SAMPLES          64
+/* Exchanges are kept as the best one per bucket of local time. */
+#define CSI_CLOCK_BUCKET_US        2000000
+/* History needed before the drift is re-estimated. */
+#define CSI_CLOCK_MIN_SPAN_US      2000000
+
+typedef struct {
+    int64_t  local_us;     /* midpoint of t1 and t4 */
+    int64_t  offset_us;
+    uint32_t delay_us;
+} csi_clock_sample_t;
+
+typedef struct {
+    csi_clock_sample_t samples[CSI_CLOCK_SAMPLES];
+    uint32_t count;
+    uint32_t next;
+    int64_t  bucket_start_us;
+    int64_t  anchor_local_us;
+    int64_t  anchor_shared_us;
+    int32_t  drift_ppb;
+    uint32_t error_us;
+    uint8_t  valid;
+} csi_clock_t;
+
+typedef struct {
+    uint32_t radio_anchor_us;
+    int64_t  shared_anchor_us;
+    int32_t  drift_ppb;
+    uint32_t error_us;
+    uint32_t samples;
+} csi_clock_report_t;
+
+void csi_clock_init(csi_clock_t *clock);
+
+/**
+ * Feeds one completed exchange. Returns 1 once the clock has an estimate.
+ */
+int csi_clock_add_exchange(csi_clock_t *clock, int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+
+/**
+ * Local time to shared time with the current estimate (local_us unchanged
+ * until the clock is valid).
+ */
+int64_t csi_clock_to_shared(const csi_clock_t *clock, int64_t local_us);
+
+/**
+ * Builds the CSI_CLOCK report. radio_offset_us is local time minus radio
+ * time (the clock of rx_ctrl.timestamp), as observed by the node.
+ */
+void csi_clock_make_report(const csi_clock_t *clock, int32_t radio_offset_us, csi_clock_report_t *report);
+
+/**
+ * Host side: radio timestamp of a frame to shared time.
+ */
+int64_t csi_clock_report_to_shared(const csi_clock_report_t *report, uint32_t radio_us);
+
+/**
+ * Request and reply lines (no newline, NUL-terminated). Return the length, or
+ * 0 if cap is too small.
+ */
+size_t csi_clock_format_request(uint32_t seq, int64_t t1, char *out, size_t cap);
+size_t csi_clock_format_reply(uint32_t seq, int64_t t1, int64_t t2, int64_t t3, char *out, size_t cap);
+size_t csi_clock_format_report(const csi_clock_report_t *report, char *out, size_t cap);
+
+/**
+ * Parse a CSI_SYNC request, a CSI_SYNC reply or a CSI_CLOCK report of len
+ * bytes. Return 1 on success, 0 otherwise.
+ */
+int csi_clock_parse_request(const char *data, size_t len, uint32_t *seq, int64_t *t1);
+int csi_clock_parse_reply(const char *data, size_t len, uint32_t *seq, int64_t *t1, int64_t *t2, int64_t *t3);
+int csi_clock_parse_report(const char *data, size_t len, csi_clock_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
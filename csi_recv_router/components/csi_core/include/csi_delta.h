@@ -0,0 +1,110 @@
+/*
+ * =================================================================================
+ * CSI DELTA COMPRESSION
+ * =================================================================================
+ *
+ * Lossless inter-frame compression of the I/Q payload for links where
+ * consecutive frames are strongly correlated.
+ *
+ * A compressed stream is a sequence of binary frames (csi_frame.h):
+ *
+ * - Keyframe: CSI_FRAME_FLAG_DELTA clear, the payload is the raw int8 I/Q
+ *   buffer. Any uncompressed frame is a keyframe, so old decoders only lose
+ *   the delta frames.
+ * - Delta frame: CSI_FRAME_FLAG_DELTA set; meta.len counts the encoded bytes:
+ *
+ *       varint   back   seq of this frame minus seq of its reference frame
+ *       nibbles zz[n]   zigzag(payload[i] - reference[i]) for each of the n
+ *                       bytes of the reference payload
+ *
+ *   back is a little-endian base-128 varint (7 bits per byte, high bit = more).
+ *   The deltas use the same scheme on 4-bit nibbles (3 value bits, bit 3 =
+ *   more), packed low nibble first and padded with a zero nibble to a whole
+ *   byte. A delta of -4..3 costs half a byte, -32..31 one byte, and the worst
+ *   case is a byte and a half. Byte-sized varints would never beat the raw
+ *   int8 values, whose deltas on a static link are mostly a few LSB.
+ *
+ * The reference is the previous frame handed to the encoder, which is not
+ * always seq - 1 (frames dropped on the node never reach the encoder). A
+ * decoder that did not see the reference reports CSI_DELTA_ERR_NO_REF and
+ * resynchronizes on the next keyframe. Frames resent from the node's history
+ * (CSI_FRAME_FLAG_RETRANSMIT, csi_history.h) are full frames that the
+ * decoder passes through without making them the reference.
+ *
+ * The encoder emits a keyframe on the first frame, every keyframe_interval
+ * frames, when the payload length changes and whenever the delta encoding
+ * would not be smaller than the raw payload.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "csi_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CSI_DELTA_MAX_LEN
+#define CSI_DELTA_MAX_LEN          CSI_FRAME_MAX_PAYLOAD
+#endif
+
+/* Output buffer size that always fits an encoded payload of n bytes. */
+#define CSI_DELTA_ENCODED_MAX(n)   ((size_t)(n) + 5)
+
+#define CSI_DELTA_OK               0
+#define CSI_DELTA_ERR_NO_REF      -1   /* reference frame missing: wait for a keyframe */
+#define CSI_DELTA_ERR_CORRUPT     -2   /* truncated or inconsistent delta payload */
+#define CSI_DELTA_ERR_LENGTH      -3   /* payload longer than CSI_DELTA_MAX_LEN */
+
+typedef struct {
+    int8_t   prev[CSI_DELTA_MAX_LEN];
+    uint16_t prev_len;
+    uint32_t prev_seq;
+    uint16_t keyframe_interval;
+    uint16_t since_key;
+    uint8_t  has_prev;
+} csi_delta_enc_t;
+
+typedef struct {
+    int8_t   prev[CSI_DELTA_MAX_LEN];
+    uint16_t prev_len;
+    uint32_t prev_seq;
+    uint8_t  has_prev;
+} csi_delta_dec_t;
+
+/**
+ * Resets the encoder. keyframe_interval is the maximum distance between
+ * keyframes in frames; 0 and 1 both make every frame a keyframe.
+ */
+void csi_delta_enc_init(csi_delta_enc_t *enc, uint16_t keyframe_interval);
+
+/**
+ * Forces the next frame to be a keyframe.
+ */
+void csi_delta_enc_reset(csi_delta_enc_t *enc);
+
+/**
+ * Encodes len payload bytes of frame seq into out and sets or clears
+ * CSI_FRAME_FLAG_DELTA in *flags. Returns the number of bytes written, or 0 if
+ * len exceeds CSI_DELTA_MAX_LEN or out_cap is below CSI_DELTA_ENCODED_MAX(len).
+ */
+size_t csi_delta_encode(csi_delta_enc_t *enc, uint32_t seq, const int8_t *payload, uint16_t len,
+                        uint8_t *out, size_t out_cap, uint8_t *flags);
+
+void csi_delta_dec_init(csi_delta_dec_t *dec);
+
+/**
+ * Reconstructs the raw payload of a frame from the stream. meta and payload
+ * are the decoded binary frame (csi_frame_decode); out must hold
+ * CSI_DELTA_MAX_LEN bytes. On CSI_DELTA_OK, *out_len is the raw length.
+ * Keyframes always decode and re-establish the reference.
+ */
+int csi_delta_decode(csi_delta_dec_t *dec, const csi_frame_meta_t *meta, const int8_t *payload,
+                     int8_t *out, uint16_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
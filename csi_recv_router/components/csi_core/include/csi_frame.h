@@ -0,0 +1,139 @@
+/*
+ * =================================================================================
+ * CSI FRAME WIRE FORMAT
+ * =================================================================================
+ *
+ * Encoders and decoders for the two CSI frame representations sent by the node:
+ *
+ * 1.  Text: the legacy "CSI_DATA,..." line consumed by the existing collectors.
+ * 2.  Binary: a versioned, packed little-endian header followed by the raw int8
+ *     I/Q payload exactly as delivered in wifi_csi_info_t::buf.
+ *
+ * This module is plain C with no ESP-IDF dependencies so the same code is used
+ * by the firmware and by the host-side tools.
+ *
+ * Binary header layout (CSI_FRAME_HDR_SIZE bytes, all fields little-endian):
+ *
+ *   off  size  field
+ *     0     2  magic (CSI_FRAME_MAGIC)
+ *     2     1  version (CSI_FRAME_VERSION)
+ *     3     1  flags (CSI_FRAME_FLAG_*)
+ *     4     4  seq
+ *     8     6  mac
+ *    14     1  rssi (int8)
+ *    15     1  rate
+ *    16     1  sig_mode
+ *    17     1  mcs
+ *    18     1  cwb
+ *    19     1  smoothing
+ *    20     1  not_sounding
+ *    21     1  aggregation
+ *    22     1  stbc
+ *    23     1  fec_coding
+ *    24     1  sgi
+ *    25     1  noise_floor (int8)
+ *    26     1  ampdu_cnt
+ *    27     1  channel
+ *    28     1  secondary_channel
+ *    29     1  ant
+ *    30     4  timestamp (local, microseconds)
+ *    34     2  sig_len
+ *    36     1  rx_state
+ *    37     1  first_word_invalid
+ *    38     2  len (payload bytes that follow)
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_FRAME_MAGIC            0xC51Fu
+#define CSI_FRAME_VERSION          1
+#define CSI_FRAME_HDR_SIZE         40
+#define CSI_FRAME_MAX_PAYLOAD      1024
+
+/* Worst case text line for a payload of n bytes: fixed fields plus "-128," per byte. */
+#define CSI_FRAME_TEXT_MAX(n)      (192 + (size_t)(n) * 5)
+#define CSI_FRAME_BIN_SIZE(n)      (CSI_FRAME_HDR_SIZE + (size_t)(n))
+
+/* Payload is delta-encoded against an earlier frame (csi_delta.h). */
+#define CSI_FRAME_FLAG_DELTA       0x01
+/* Payload holds one amplitude byte per kept subcarrier instead of I/Q pairs (csi_capture.h). */
+#define CSI_FRAME_FLAG_AMPLITUDE   0x02
+/* Sent again on the collector's request (csi_history.h); never a delta reference. */
+#define CSI_FRAME_FLAG_RETRANSMIT  0x04
+
+#define CSI_FRAME_OK               0
+#define CSI_FRAME_ERR_SHORT       -1
+#define CSI_FRAME_ERR_MAGIC       -2
+#define CSI_FRAME_ERR_VERSION     -3
+#define CSI_FRAME_ERR_LENGTH      -4
+
+typedef struct {
+    uint32_t seq;
+    uint8_t  mac[6];
+    uint8_t  flags;
+    int8_t   rssi;
+    uint8_t  rate;
+    uint8_t  sig_mode;
+    uint8_t  mcs;
+    uint8_t  cwb;
+    uint8_t  smoothing;
+    uint8_t  not_sounding;
+    uint8_t  aggregation;
+    uint8_t  stbc;
+    uint8_t  fec_coding;
+    uint8_t  sgi;
+    int8_t   noise_floor;
+    uint8_t  ampdu_cnt;
+    uint8_t  channel;
+    uint8_t  secondary_channel;
+    uint8_t  ant;
+    uint32_t timestamp;
+    uint16_t sig_len;
+    uint8_t  rx_state;
+    uint8_t  first_word_invalid;
+    uint16_t len;
+} csi_frame_meta_t;
+
+/**
+ * Returns non-zero if the datagram starts with the binary frame magic.
+ */
+int csi_frame_is_binary(const uint8_t *data, size_t len);
+
+/**
+ * Serializes meta and meta->len payload bytes into out.
+ * Returns the number of bytes written, or 0 if out_cap is too small.
+ */
+size_t csi_frame_encode(const csi_frame_meta_t *meta, const int8_t *payload,
+                        uint8_t *out, size_t out_cap);
+
+/**
+ * Parses a binary frame. On success fills meta, points *payload into data and
+ * returns CSI_FRAME_OK; otherwise returns one of the CSI_FRAME_ERR_* codes.
+ */
+int csi_frame_decode(const uint8_t *data, size_t len,
+                     csi_frame_meta_t *meta, const int8_t **payload);
+
+/**
+ * Formats the frame as the legacy CSI_DATA text line, including the trailing
+ * newline and NUL terminator. Returns the line length (excluding NUL), or 0 if
+ * out_cap is too small; the line is never silently truncated.
+ */
+size_t csi_frame_format_text(const csi_frame_meta_t *meta, const int8_t *payload,
+                             char *out, size_t out_cap);
+
+/**
+ * Reads the transmitter MAC of a binary frame or CSI_DATA line without
+ * decoding the rest. Returns 1 on success, 0 if data is neither.
+ */
+int csi_frame_peek_mac(const uint8_t *data, size_t len, uint8_t mac[6]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,156 @@
+/*
+ * =================================================================================
+ * CSI FRAME HISTORY AND GAP RETRANSMISSION
+ * =================================================================================
+ *
+ * Store-and-forward for the fire-and-forget UDP stream. The node keeps the
+ * frames it sent most recently in a history (csi_history_t); a collector
+ * that sees a gap in the sequence numbers asks for the missing frames with a
+ * NACK, and the node sends them again if it still has them.
+ *
+ * NACK (ASCII, one UDP datagram from the collector to the address and port
+ * the node's frames come from):
+ *
+ *   CSI_NACK,[<mac>,]<first>[-<last>][,<first>[-<last>]...]
+ *
+ *   mac    the transmitter (aa:bb:cc:dd:ee:ff) whose frames are missing, each
+ *          source numbering its frames on its own (csi_sources.h). Without
+ *          it, the transmitter of the newest frame stored.
+ *   at most CSI_HISTORY_MAX_RANGES ranges of sequence numbers, inclusive
+ *
+ * The history is a byte arena written as a circular log plus an index of
+ * slots by transmitter and sequence number, so frames of any length share
+ * the memory and the oldest are overwritten first. It belongs to the sender: each frame is
+ * stored before it is compressed and sent, and requested frames are resent
+ * between live ones, a few at a time, so a burst of NACKs never holds up the
+ * live stream. A resent binary frame carries CSI_FRAME_FLAG_RETRANSMIT and
+ * is always a full frame, never a delta (csi_delta.h). Text frames are
+ * resent unchanged.
+ *
+ * csi_nack_tracker_t is the collector's side: it follows one source's sequence
+ * numbers, keeps the open gaps and says when to NACK which of them. A gap is
+ * first requested CSI_NACK_DELAY_US after it was seen (so plain reordering
+ * does not trigger a request), then again every CSI_NACK_RETRY_US, and given
+ * up after CSI_NACK_MAX_TRIES requests.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_HISTORY_NACK_PREFIX    "CSI_NACK,"
+#define CSI_HISTORY_NACK_MAX_LEN   256
+#define CSI_HISTORY_MAX_RANGES     16
+
+#define CSI_NACK_DELAY_US          20000
+#define CSI_NACK_RETRY_US          150000
+#define CSI_NACK_MAX_TRIES         4
+#define CSI_NACK_MAX_GAPS          64
+/* Gaps further back than this are beyond any node history: given up at once. */
+#define CSI_NACK_MAX_SPAN          1024
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} csi_seq_range_t;
+
+typedef struct {
+    uint8_t         mac[6];
+    csi_seq_range_t range;
+} csi_history_request_t;
+
+typedef struct {
+    uint32_t seq;
+    uint32_t pos;       /* arena byte counter at the start of the frame */
+    uint16_t len;
+    uint8_t  valid;
+    uint8_t  mac[6];    /* transmitter, zero if the frame carries none */
+} csi_history_slot_t;
+
+typedef struct {
+    uint8_t               *arena;
+    uint32_t               arena_mask;
+    csi_history_slot_t    *slots;
+    uint32_t               slot_mask;
+    uint32_t               write;      /* bytes appended since init, wrapping */
+    uint8_t                last_mac[6];  /* transmitter of the newest frame stored */
+    csi_history_request_t  pending[CSI_HISTORY_MAX_RANGES];
+    uint8_t                pending_count;
+    uint32_t               nacks;      /* NACK datagrams accepted */
+    uint32_t               resent;     /* frames sent again */
+    uint32_t               expired;    /* requested frames no longer (or never) held */
+    uint32_t               dropped;    /* requested ranges that did not fit the queue */
+} csi_history_t;
+
+typedef struct {
+    csi_seq_range_t range;
+    uint64_t        due_us;
+    uint8_t         tries;
+} csi_nack_gap_t;
+
+typedef struct {
+    csi_nack_gap_t gaps[CSI_NACK_MAX_GAPS];
+    uint32_t       count;
+    uint32_t       next_seq;    /* one past the highest sequence number seen */
+    uint8_t        started;
+    uint64_t       recovered;   /* frames that filled a gap */
+    uint64_t       abandoned;   /* frames given up on */
+    uint64_t       nacks;       /* NACK datagrams produced */
+} csi_nack_tracker_t;
+
+/**
+ * Initializes the history over caller-provided memory: an arena of
+ * arena_size bytes and slot_count index slots, both powers of two.
+ * Returns 0 on success, -1 on bad arguments.
+ */
+int csi_history_init(csi_history_t *h, void *arena, size_t arena_size, csi_history_slot_t *slots,
+                     uint32_t slot_count);
+
+/**
+ * Keeps a copy of a frame that was just sent, filed under the transmitter it
+ * carries (csi_frame_peek_mac) and seq. Frames longer than a quarter of the
+ * arena are not kept.
+ */
+void csi_history_store(csi_history_t *h, uint32_t seq, const uint8_t *frame, uint16_t len);
+
+/**
+ * Queues the ranges of a NACK datagram for resending. Returns the number of
+ * ranges queued, or -1 if data is not a well-formed NACK.
+ */
+int csi_history_request(csi_history_t *h, const char *data, size_t len);
+
+/**
+ * Next requested frame still held, or NULL when nothing is pending. The
+ * pointer stays valid until the next csi_history_store.
+ */
+const uint8_t *csi_history_next(csi_history_t *h, uint32_t *seq, uint16_t *len);
+
+void csi_nack_init(csi_nack_tracker_t *t);
+
+/**
+ * Accounts for a received frame at now_us. Returns 1 if it filled a gap (a
+ * late or resent frame), 0 otherwise.
+ */
+int csi_nack_on_frame(csi_nack_tracker_t *t, uint32_t seq, uint64_t now_us);
+
+/**
+ * Writes the NACK for the gaps due at now_us to out and returns its length,
+ * 0 if none is due. Gaps requested CSI_NACK_MAX_TRIES times are given up.
+ * mac names the tracked transmitter in the NACK; NULL leaves it out, for a
+ * node with a single source.
+ */
+size_t csi_nack_poll(csi_nack_tracker_t *t, const uint8_t *mac, uint64_t now_us, char *out, size_t cap);
+
+/**
+ * Frames in the gaps still open.
+ */
+uint64_t csi_nack_outstanding(const csi_nack_tracker_t *t);
+
+#ifdef __cplusplus
+}
+#endif
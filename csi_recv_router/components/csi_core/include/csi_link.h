@@ -0,0 +1,181 @@
+/*
+ * =================================================================================
+ * CSI LINK RESUME
+ * =================================================================================
+ *
+ * Fast wake-to-capture. A full connect (scan, association, PEAP handshake on
+ * enterprise networks, DHCP) takes seconds on every wake from deep sleep. The
+ * node therefore keeps what it learned on the last successful connect in RTC
+ * memory (csi_link_retained_t): the AP's BSSID and channel and the address,
+ * netmask and gateway DHCP assigned. While that state is still valid the next
+ * wake associates to the known BSSID on the known channel without scanning
+ * and applies the address statically instead of running DHCP.
+ *
+ * The retained state is valid if it was written by this firmware, belongs to
+ * the same credentials (csi_link_hash over SSID, password, identity, auth type
+ * and collector endpoint, so re-provisioning invalidates it) and the address
+ * is younger than CSI_LINK_MAX_AGE_S, well within a typical DHCP lease.
+ *
+ * csi_link_t is the reconnect state machine. It has no Wi-Fi calls of its
+ * own: the firmware feeds it Wi-Fi events and carries out the action it
+ * returns, which keeps the logic testable on a host with a fake Wi-Fi layer.
+ *
+ *   begin               FAST -> CONNECT_FAST     (retained state valid)
+ *                       FULL -> CONNECT_FULL     (otherwise)
+ *   FAST    CONNECTED   -> SET_STATIC_IP, UP     (the static address is ready)
+ *   FAST    DISCONNECTED or TIMEOUT              (AP moved, channel changed)
+ *                       -> forget the state, FULL, CONNECT_FULL
+ *   FULL    CONNECTED   -> WAIT_IP               (DHCP runs)
+ *   WAIT_IP GOT_IP      -> retain BSSID, channel and address, UP, READY
+ *   FULL or WAIT_IP DISCONNECTED
+ *                       -> RECONNECT, or GIVE_UP after CSI_LINK_MAX_ATTEMPTS
+ *   UP      DISCONNECTED
+ *                       -> FULL, CONNECT_FULL, or GIVE_UP as above
+ *
+ * The wake phases are stamped in milliseconds since boot (csi_link_mark) and
+ * reported once per wake, after the first CSI frame:
+ *
+ *   CSI_WAKE,<mode>,<fell_back>,<wifi_ms>,<assoc_ms>,<ip_ms>,<start_ms>,<first_frame_ms>,<wakes>,<fast_ok>,<fast_failed>
+ *
+ *   mode            fast or full: the path the wake started with
+ *   fell_back       1 if the fast path failed and the full one was used
+ *   *_ms            Wi-Fi started, associated, address ready, start command,
+ *                   first CSI frame; 0 if not reached
+ *   wakes           wakes since the retained state was created
+ *   fast_ok/failed  fast resumes that worked / fell back, over those wakes
+ *
+ * Collectors that only look for CSI_DATA lines ignore it.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_LINK_MAGIC             0xC51C0001u
+#define CSI_LINK_MAX_AGE_S         3600
+#define CSI_LINK_FAST_TIMEOUT_MS   1500
+#define CSI_LINK_MAX_ATTEMPTS      15
+#define CSI_LINK_HASH_INIT         2166136261u
+#define CSI_LINK_REPORT_PREFIX     "CSI_WAKE,"
+#define CSI_LINK_REPORT_MAX_LEN    128
+
+/* Kept in RTC memory across deep sleep. Addresses in network byte order. */
+typedef struct {
+    uint32_t magic;
+    uint32_t creds_hash;
+    uint32_t learned_s;     /* wall-clock seconds when the address was obtained */
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    uint8_t  valid;
+    uint32_t wakes;
+    uint32_t fast_ok;
+    uint32_t fast_failed;
+} csi_link_retained_t;
+
+typedef enum {
+    CSI_LINK_IDLE,
+    CSI_LINK_FAST,
+    CSI_LINK_FULL,
+    CSI_LINK_WAIT_IP,
+    CSI_LINK_UP,
+    CSI_LINK_FAILED,
+} csi_link_phase_t;
+
+typedef enum {
+    CSI_LINK_EV_CONNECTED,      /* info: bssid, channel */
+    CSI_LINK_EV_GOT_IP,         /* info: ip, netmask, gw */
+    CSI_LINK_EV_DISCONNECTED,
+    CSI_LINK_EV_TIMEOUT,        /* CSI_LINK_FAST_TIMEOUT_MS after CONNECT_FAST */
+} csi_link_event_t;
+
+typedef enum {
+    CSI_LINK_ACT_NONE,
+    CSI_LINK_ACT_CONNECT_FAST,  /* retained bssid and channel, no scan, DHCP off */
+    CSI_LINK_ACT_CONNECT_FULL,  /* scan by SSID, DHCP on */
+    CSI_LINK_ACT_SET_STATIC_IP, /* retained ip, netmask and gw; the link is up */
+    CSI_LINK_ACT_RECONNECT,     /* connect again with the current configuration */
+    CSI_LINK_ACT_READY,         /* the link is up with a DHCP address */
+    CSI_LINK_ACT_GIVE_UP,
+} csi_link_action_t;
+
+typedef struct {
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+} csi_link_info_t;
+
+typedef enum {
+    CSI_WAKE_WIFI,
+    CSI_WAKE_ASSOC,
+    CSI_WAKE_IP,
+    CSI_WAKE_START,
+    CSI_WAKE_FIRST_FRAME,
+    CSI_WAKE_MARKS,
+} csi_wake_mark_t;
+
+typedef struct {
+    csi_link_retained_t *retained;
+    csi_link_phase_t phase;
+    uint8_t  fast;          /* the wake started on the fast path */
+    uint8_t  fell_back;
+    uint32_t attempts;      /* failed connects since the last success */
+    uint32_t marks_ms[CSI_WAKE_MARKS];
+} csi_link_t;
+
+typedef struct {
+    uint8_t  fast;
+    uint8_t  fell_back;
+    uint32_t marks_ms[CSI_WAKE_MARKS];
+    uint32_t wakes;
+    uint32_t fast_ok;
+    uint32_t fast_failed;
+} csi_wake_report_t;
+
+/**
+ * FNV-1a of s chained onto h (start from CSI_LINK_HASH_INIT). A NUL separates
+ * consecutive strings so ("ab", "c") and ("a", "bc") differ.
+ */
+uint32_t csi_link_hash(uint32_t h, const char *s);
+
+/**
+ * True if the retained state can be used for a fast resume.
+ */
+int csi_link_retained_valid(const csi_link_retained_t *retained, uint32_t creds_hash, uint32_t now_s);
+
+/**
+ * Starts a wake: resets the retained state if it belongs to other
+ * credentials, counts the wake and picks the path. Returns CONNECT_FAST or
+ * CONNECT_FULL.
+ */
+csi_link_action_t csi_link_begin(csi_link_t *link, csi_link_retained_t *retained, uint32_t creds_hash,
+                                 uint32_t now_s, uint32_t uptime_ms);
+
+/**
+ * Feeds one Wi-Fi event; info is needed for CONNECTED and GOT_IP. Returns the
+ * action to carry out.
+ */
+csi_link_action_t csi_link_on_event(csi_link_t *link, csi_link_event_t event, const csi_link_info_t *info,
+                                    uint32_t now_s, uint32_t uptime_ms);
+
+/**
+ * Stamps a wake phase; only the first stamp of each phase is kept.
+ */
+void csi_link_mark(csi_link_t *link, csi_wake_mark_t mark, uint32_t uptime_ms);
+
+void csi_link_make_report(const csi_link_t *link, csi_wake_report_t *report);
+size_t csi_link_format_report(const csi_wake_report_t *report, char *out, size_t cap);
+int csi_link_parse_report(const char *data, size_t len, csi_wake_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
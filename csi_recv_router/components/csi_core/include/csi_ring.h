@@ -0,0 +1,86 @@
+/*
+ * =================================================================================
+ * CSI FRAME RING
+ * =================================================================================
+ *
+ * Lock-free single-producer/single-consumer ring of fixed-size frame slots.
+ * The producer (the Wi-Fi CSI callback) serializes straight into a slot and
+ * commits it; the consumer (the UDP sender task) peeks, transmits and releases.
+ *
+ * When the ring is full the newest frame is rejected and counted in
+ * overflows, so the consumer never observes a slot being rewritten under it.
+ *
+ * Plain C11 atomics only, so the same code runs on the node and on the host.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t seq;
+    uint16_t len;
+    uint16_t reserved;
+} csi_ring_slot_hdr_t;
+
+/* Bytes of storage needed for slot_count slots of slot_data_size payload bytes. */
+#define CSI_RING_SLOT_STRIDE(slot_data_size) \
+    ((sizeof(csi_ring_slot_hdr_t) + (size_t)(slot_data_size) + 3u) & ~(size_t)3u)
+#define CSI_RING_STORAGE_SIZE(slot_data_size, slot_count) \
+    (CSI_RING_SLOT_STRIDE(slot_data_size) * (size_t)(slot_count))
+
+typedef struct {
+    uint8_t          *storage;
+    size_t            stride;
+    size_t            slot_data_size;
+    uint32_t          mask;
+    _Atomic uint32_t  head;        /* written by the producer only */
+    _Atomic uint32_t  tail;        /* written by the consumer only */
+    _Atomic uint32_t  committed;   /* frames accepted into the ring */
+    _Atomic uint32_t  overflows;   /* frames rejected because the ring was full */
+    _Atomic uint32_t  high_water;  /* deepest occupancy observed by the producer */
+} csi_ring_t;
+
+/**
+ * Initializes the ring over caller-provided storage of
+ * CSI_RING_STORAGE_SIZE(slot_data_size, slot_count) bytes.
+ * slot_count must be a power of two. Returns 0 on success, -1 on bad arguments.
+ */
+int csi_ring_init(csi_ring_t *ring, void *storage, size_t slot_data_size, uint32_t slot_count);
+
+/**
+ * Producer: returns the data area of the next free slot (slot_data_size bytes),
+ * or NULL if the ring is full, in which case the overflow counter is bumped.
+ */
+uint8_t *csi_ring_acquire(csi_ring_t *ring);
+
+/**
+ * Producer: publishes the slot returned by the last csi_ring_acquire.
+ */
+void csi_ring_commit(csi_ring_t *ring, uint32_t seq, uint16_t len);
+
+/**
+ * Consumer: returns the data of the oldest committed slot, or NULL if empty.
+ * The slot stays owned by the consumer until csi_ring_release.
+ */
+const uint8_t *csi_ring_peek(csi_ring_t *ring, uint32_t *seq, uint16_t *len);
+
+/**
+ * Consumer: frees the slot returned by the last csi_ring_peek.
+ */
+void csi_ring_release(csi_ring_t *ring);
+
+/**
+ * Number of committed slots not yet released. Safe to call from either side.
+ */
+uint32_t csi_ring_depth(csi_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
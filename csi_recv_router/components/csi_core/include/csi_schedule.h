@@ -0,0 +1,121 @@
+/*
+ * =================================================================================
+ * CSI SCHEDULED ACQUISITION
+ * =================================================================================
+ *
+ * Instead of waking every few seconds to listen for a start command, a node
+ * can be given a plan of acquisition windows and sleep until each of them.
+ *
+ * Schedule command (ASCII, one UDP datagram on the start command port):
+ *
+ *   schedule,<id>,<first_start_us>,<interval_s>,<count>,start,<seconds>[,options]
+ *   schedule,cancel
+ *
+ *   id              chosen by the collector; a resent command with the same id
+ *                   is only acknowledged again
+ *   first_start_us  start of the first window on the shared clock (csi_clock.h:
+ *                   the collector's wall clock, microseconds since the epoch)
+ *   interval_s      start-to-start distance of the windows; at least the
+ *                   window duration plus CSI_SCHEDULE_MIN_GAP_S if count > 1
+ *   count           number of windows
+ *   start,...       the start command (csi_capture.h) run in every window; its
+ *                   duration is the window length
+ *
+ * The node keeps the plan in NVS and RTC memory and its clock on shared time:
+ * it syncs at every wake and sets its system time, which the RTC keeps across
+ * deep sleep. From the shared time it picks the next window and deep sleeps
+ * until a lead time before it; the lead covers boot, reconnect and the clock
+ * sync and adapts to how long they took on recent wakes (csi_schedule_lead_ms),
+ * or is CSI_SCHEDULE_MAX_LEAD_MS when the wake will need a full connect. The
+ * sleep is shortened by CSI_SCHEDULE_SLEEP_DRIFT_PPM because the RTC slow
+ * clock is far less accurate than the crystal. Once awake
+ * and synced it waits for the exact start; a node that wakes late captures
+ * the rest of the window. After a window it listens for CSI_SCHEDULE_LISTEN_S
+ * for a new command, which is when the collector can replace or cancel the
+ * plan.
+ *
+ * The node acknowledges a plan, and announces the next window after each one,
+ * on the collector's data port:
+ *
+ *   CSI_SCHED,<id>,<index>,<count>,<start_us>
+ *
+ *   index     the next window, 0-based; equal to count when the plan is done
+ *   start_us  its start on the shared clock, 0 when the plan is done
+ *
+ * Collectors that only look for CSI_DATA lines ignore it.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_SCHEDULE_COMMAND_PREFIX   "schedule,"
+#define CSI_SCHEDULE_REPORT_PREFIX    "CSI_SCHED,"
+#define CSI_SCHEDULE_START_MAX_LEN    256
+#define CSI_SCHEDULE_REPORT_MAX_LEN   80
+#define CSI_SCHEDULE_MIN_GAP_S        10
+#define CSI_SCHEDULE_LISTEN_S         2
+#define CSI_SCHEDULE_MIN_LEAD_MS      1000
+#define CSI_SCHEDULE_MAX_LEAD_MS      8000
+#define CSI_SCHEDULE_SLEEP_DRIFT_PPM  2000  /* calibrated internal RC slow clock */
+#define CSI_SCHEDULE_MIN_SLEEP_MS     500
+
+#define CSI_SCHEDULE_OK            0
+#define CSI_SCHEDULE_CANCEL        1
+#define CSI_SCHEDULE_ERR_COMMAND  -1   /* not a schedule command, or fields missing */
+#define CSI_SCHEDULE_ERR_PLAN     -2   /* malformed or inconsistent window plan */
+#define CSI_SCHEDULE_ERR_START    -3   /* the embedded start command does not parse */
+
+typedef struct {
+    uint32_t id;
+    int64_t  first_start_us;
+    uint32_t interval_s;
+    uint32_t count;
+    uint32_t duration_s;
+    char     start[CSI_SCHEDULE_START_MAX_LEN];
+} csi_schedule_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t index;
+    uint32_t count;
+    int64_t  start_us;
+} csi_schedule_report_t;
+
+/**
+ * Parses a NUL-terminated schedule command into plan. Returns CSI_SCHEDULE_OK,
+ * CSI_SCHEDULE_CANCEL or a negative CSI_SCHEDULE_ERR_* code; plan is only
+ * written on success.
+ */
+int csi_schedule_parse(const char *command, csi_schedule_t *plan);
+
+/**
+ * Finds the first window that has not ended at now_us. Returns 1 with its
+ * index and start, or 0 if the plan is done.
+ */
+int csi_schedule_window(const csi_schedule_t *plan, int64_t now_us, uint32_t *index, int64_t *start_us);
+
+/**
+ * Deep sleep to take at now_us so the node is up lead_ms before start_us,
+ * allowing for the slow clock's drift; 0 if the window is too close to sleep.
+ */
+uint64_t csi_schedule_sleep_us(int64_t now_us, int64_t start_us, uint32_t lead_ms);
+
+/**
+ * Lead time for the next wake, given the previous lead (0 if none) and how
+ * long this wake took from boot to a synced clock. Grows at once, shrinks
+ * slowly, within CSI_SCHEDULE_MIN_LEAD_MS..CSI_SCHEDULE_MAX_LEAD_MS.
+ */
+uint32_t csi_schedule_lead_ms(uint32_t previous_ms, uint32_t ready_ms);
+
+size_t csi_schedule_format_report(const csi_schedule_report_t *report, char *out, size_t cap);
+int csi_schedule_parse_report(const char *data, size_t len, csi_schedule_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,107 @@
+/*
+ * =================================================================================
+ * CSI SOURCES
+ * =================================================================================
+ *
+ * The transmitters a node captures CSI from, chosen by the src option of the
+ * start command (csi_capture.h). Each one is a separate link: it has its own
+ * sequence numbers, so the collector tracks its losses on their own, and its
+ * own decimation and rate limit state.
+ *
+ * The CSI callback looks every frame's transmitter up in a fixed table of
+ * CSI_SOURCES_MAX entries behind an open-addressing index of
+ * CSI_SOURCES_BUCKETS buckets, so a lookup is a hash and one or two 6-byte
+ * compares with no allocation. In CSI_CAPTURE_SRC_ANY mode new transmitters
+ * are added as they are heard until the table is full; frames of the others
+ * are counted in overflow. Frames of transmitters not allowed are counted in
+ * rejected.
+ *
+ * The table is written by the CSI callback only; other tasks may read it
+ * through csi_sources_find, csi_sources_count and csi_sources_overflow. An
+ * entry is filled before count and its bucket are published with release
+ * stores, and readers load them with acquire, so a published entry is always
+ * complete. C++ hosts drive the table from one thread and see plain fields.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#ifndef __cplusplus
+#include <stdatomic.h>
+#endif
+
+#include "csi_capture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_SOURCES_MAX            16
+#define CSI_SOURCES_BUCKETS        32   /* power of two, at least twice CSI_SOURCES_MAX */
+
+#ifdef __cplusplus
+#define CSI_SOURCES_ATOMIC(type) type
+#else
+#define CSI_SOURCES_ATOMIC(type) _Atomic type
+#endif
+
+typedef struct {
+    uint8_t         mac[6];
+    uint8_t         ap;        /* the access point the node is associated with */
+    uint32_t        seq;       /* sequence number of this source's next frame */
+    csi_decimator_t dec;
+    uint32_t        frames;    /* kept since csi_sources_configure */
+    uint32_t        limited;   /* dropped by dec or rate since csi_sources_configure */
+} csi_source_t;
+
+typedef struct {
+    csi_source_t                 entries[CSI_SOURCES_MAX];
+    CSI_SOURCES_ATOMIC(uint8_t)  buckets[CSI_SOURCES_BUCKETS];  /* entry index + 1, 0 if empty */
+    CSI_SOURCES_ATOMIC(uint8_t)  count;
+    uint8_t                      mode;                          /* CSI_CAPTURE_SRC_* */
+    CSI_SOURCES_ATOMIC(uint32_t) rejected;
+    CSI_SOURCES_ATOMIC(uint32_t) overflow;
+} csi_sources_t;
+
+/**
+ * Empties the table.
+ */
+void csi_sources_init(csi_sources_t *t);
+
+/**
+ * Sets the table up for a capture with cfg, the node being associated with
+ * ap_bssid. Sources that stay allowed keep their sequence numbers, so a
+ * collector does not see a restart between two captures of one boot; their
+ * decimation and counters start over. The sources cfg names are added at
+ * once, the others of CSI_CAPTURE_SRC_ANY when first heard.
+ */
+void csi_sources_configure(csi_sources_t *t, const csi_capture_config_t *cfg, const uint8_t ap_bssid[6]);
+
+/**
+ * The source of a frame sent by mac, or NULL if its frames are not captured.
+ * Adds mac in CSI_CAPTURE_SRC_ANY mode. For the CSI callback only.
+ */
+csi_source_t *csi_sources_lookup(csi_sources_t *t, const uint8_t mac[6]);
+
+/**
+ * The source of mac if it is in the table, without adding it; NULL otherwise.
+ * From any task.
+ */
+const csi_source_t *csi_sources_find(const csi_sources_t *t, const uint8_t mac[6]);
+
+/**
+ * Number of entries; entries[0..count) are complete. From any task.
+ */
+uint8_t csi_sources_count(const csi_sources_t *t);
+
+/**
+ * Frames of transmitters beyond a full table, and of transmitters not allowed.
+ * From any task.
+ */
+uint32_t csi_sources_overflow(const csi_sources_t *t);
+uint32_t csi_sources_rejected(const csi_sources_t *t);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,151 @@
+/*
+ * =================================================================================
+ * CSI CAPTURE HEALTH
+ * =================================================================================
+ *
+ * Counters and histograms that tell where frames go between the radio and the
+ * collector, so a gap in a session can be blamed on the air, the node or the
+ * host. Every field is a relaxed C11 atomic: the CSI callback and the sender
+ * task update them without locks, and a snapshot can be taken from any task.
+ *
+ * Frame path and the counter bumped at each step:
+ *
+ *   seen        every CSI callback
+ *   filtered    frame from another transmitter (BSSID filter)
+ *   accepted    frame from the access point
+ *   truncated   payload too large for a ring slot, or serialization did not fit
+ *   decimated   skipped by the capture options (csi_capture.h)
+ *   serialized  committed to the ring (ring overflows are counted by the ring)
+ *   sent        frames in datagrams sendto accepted
+ *   send_failed frames in datagrams sendto rejected
+ *   resent      frames sent again for a collector's NACK (csi_history.h)
+ *
+ * Histograms have CSI_STATS_HIST_BINS log2 bins in microseconds: bin 0 counts
+ * 0 us, bin b counts [2^(b-1), 2^b) us and the last bin everything above.
+ *
+ *   callback_us  time spent in the CSI callback for accepted frames
+ *   interval_us  radio-clock gap between consecutive accepted frames
+ *
+ * Stats report (ASCII, one UDP datagram to the collector per second while
+ * capturing; every value is cumulative since the node booted, so a lost
+ * report costs nothing):
+ *
+ *   CSI_STATS,<uptime_ms>,<seen>,<accepted>,<filtered>,<truncated>,<decimated>,
+ *             <ring_full>,<serialized>,<sent>,<send_failed>,<resent>,
+ *             <queue_depth>,<queue_high>,<callback_us bins...>,<interval_us bins...>
+ *
+ *   ring_full    frames rejected because the ring was full
+ *   queue_depth  frames waiting in the ring when the report was built
+ *   queue_high   deepest ring occupancy so far
+ *
+ * Collectors that only look for CSI_DATA lines ignore it.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#ifndef __cplusplus
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_STATS_HIST_BINS       20
+#define CSI_STATS_REPORT_PREFIX   "CSI_STATS,"
+#define CSI_STATS_REPORT_MAX_LEN  512
+
+typedef struct {
+    uint32_t uptime_ms;
+    uint32_t seen;
+    uint32_t accepted;
+    uint32_t filtered;
+    uint32_t truncated;
+    uint32_t decimated;
+    uint32_t ring_full;
+    uint32_t serialized;
+    uint32_t sent;
+    uint32_t send_failed;
+    uint32_t resent;
+    uint32_t queue_depth;
+    uint32_t queue_high;
+    uint32_t callback_us[CSI_STATS_HIST_BINS];
+    uint32_t interval_us[CSI_STATS_HIST_BINS];
+} csi_stats_report_t;
+
+/* The live counters use C11 atomics; C++ hosts only handle reports. */
+#ifndef __cplusplus
+typedef struct {
+    _Atomic uint32_t bins[CSI_STATS_HIST_BINS];
+} csi_hist_t;
+
+typedef struct {
+    _Atomic uint32_t seen;
+    _Atomic uint32_t filtered;
+    _Atomic uint32_t accepted;
+    _Atomic uint32_t truncated;
+    _Atomic uint32_t decimated;
+    _Atomic uint32_t serialized;
+    _Atomic uint32_t sent;
+    _Atomic uint32_t send_failed;
+    _Atomic uint32_t resent;
+    csi_hist_t       callback_us;
+    csi_hist_t       interval_us;
+    uint32_t         last_rx_us;   /* written by the CSI callback only */
+    uint8_t          has_last_rx;
+} csi_stats_t;
+
+void csi_stats_init(csi_stats_t *stats);
+
+static inline void csi_stats_count(_Atomic uint32_t *counter, uint32_t n) {
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+/**
+ * Histogram bin of a duration in microseconds.
+ */
+static inline unsigned csi_stats_bin(uint32_t us) {
+    unsigned bin = us ? 32u - (unsigned)__builtin_clz(us) : 0u;
+    return bin < CSI_STATS_HIST_BINS ? bin : CSI_STATS_HIST_BINS - 1;
+}
+
+static inline void csi_hist_add(csi_hist_t *hist, uint32_t us) {
+    atomic_fetch_add_explicit(&hist->bins[csi_stats_bin(us)], 1, memory_order_relaxed);
+}
+
+/**
+ * CSI callback only: records the gap since the previous accepted frame
+ * received at timestamp_us (the 32-bit local radio clock, wrap-safe).
+ */
+void csi_stats_rx_interval(csi_stats_t *stats, uint32_t timestamp_us);
+
+/**
+ * Copies the counters and histograms into report. The ring and uptime fields
+ * are left for the caller, which owns the ring.
+ */
+void csi_stats_snapshot(csi_stats_t *stats, csi_stats_report_t *report);
+
+#endif /* __cplusplus */
+
+/**
+ * Upper edge in microseconds of the bin holding the p-th percentile (0-100)
+ * of a histogram, 0 if it is empty. The last bin reports its lower edge.
+ */
+uint32_t csi_stats_hist_percentile(const uint32_t bins[CSI_STATS_HIST_BINS], float p);
+
+/**
+ * Writes the CSI_STATS line (no newline, NUL-terminated) into out. Returns its
+ * length, or 0 if cap is too small.
+ */
+size_t csi_stats_format_report(const csi_stats_report_t *report, char *out, size_t cap);
+
+/**
+ * Parses a CSI_STATS datagram of len bytes. Returns 1 on success, 0 otherwise.
+ */
+int csi_stats_parse_report(const char *data, size_t len, csi_stats_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
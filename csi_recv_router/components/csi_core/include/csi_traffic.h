@@ -0,0 +1,164 @@
+/*
+ * =================================================================================
+ * CSI TRAFFIC GENERATION
+ * =================================================================================
+ *
+ * Closed-loop pacing of the probes that make the access point transmit, so
+ * the node receives CSI at a target rate instead of at whatever rate a fixed
+ * probe interval happens to yield.
+ *
+ * Every frame accepted by the CSI callback is fed to a rate meter, without
+ * locks (csi_rate_feed_t). Once per control period the meter's window (frame
+ * count and inter-arrival gaps on the radio clock) is handed to the pacer,
+ * which rescales the probe interval by the square root of target / achieved,
+ * at most 2x per step. The square root damps the loop against replies that
+ * arrive in bursts; a 2% deadband keeps it from hunting around the target.
+ *
+ * Probes (start command option probe=icmp|udp, see csi_capture.h):
+ *
+ *   icmp  1-byte ICMP echo requests to the gateway.
+ *   udp   "CSI_PROBE,<n>" datagrams to the collector, which echoes them back.
+ *         Use it when the gateway rate-limits ICMP.
+ *
+ * Rate report (ASCII, one UDP datagram to the collector per control period):
+ *
+ *   CSI_RATE,<target_hz>,<achieved_hz>,<jitter_us>,<interval_us>,<probe>,<sent>
+ *
+ *   achieved_hz  accepted frames per second over the period, one decimal
+ *   jitter_us    standard deviation of the inter-arrival gap
+ *   interval_us  probe interval chosen for the next period
+ *   probe        icmp or udp
+ *   sent         probes sent during the period
+ *
+ * Collectors that only look for CSI_DATA lines ignore both datagrams.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#ifndef __cplusplus
+#include <stdatomic.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_TRAFFIC_PROBE_ICMP     0
+#define CSI_TRAFFIC_PROBE_UDP      1
+
+#define CSI_TRAFFIC_PROBE_PREFIX   "CSI_PROBE,"
+#define CSI_TRAFFIC_REPORT_PREFIX  "CSI_RATE,"
+#define CSI_TRAFFIC_REPORT_MAX_LEN 80
+
+typedef struct {
+    uint32_t frames;
+    uint32_t gaps;          /* inter-arrival samples in the window */
+    uint64_t gap_sum_us;
+    uint64_t gap_sq_sum_us;
+    uint32_t last_us;
+    uint8_t  started;
+} csi_rate_meter_t;
+
+typedef struct {
+    float    achieved_hz;
+    float    jitter_us;
+    uint32_t frames;
+} csi_rate_stats_t;
+
+typedef struct {
+    uint32_t target_hz;
+    uint32_t interval_us;
+    uint32_t min_interval_us;
+    uint32_t max_interval_us;
+} csi_pacer_t;
+
+typedef struct {
+    uint32_t target_hz;
+    float    achieved_hz;
+    float    jitter_us;
+    uint32_t interval_us;
+    uint8_t  probe;
+    uint32_t sent;
+} csi_traffic_report_t;
+
+void csi_rate_meter_init(csi_rate_meter_t *meter);
+
+/**
+ * Records one accepted frame received at timestamp_us (the 32-bit local radio
+ * clock, wrap-safe).
+ */
+void csi_rate_meter_add(csi_rate_meter_t *meter, uint32_t timestamp_us);
+
+/**
+ * Computes the rate and jitter of a window that lasted elapsed_us.
+ */
+void csi_rate_meter_stats(const csi_rate_meter_t *meter, uint32_t elapsed_us, csi_rate_stats_t *stats);
+
+/**
+ * The window between two snapshots of a meter that is never restarted:
+ * window = now - before, counters wrap-safe.
+ */
+void csi_rate_meter_window(const csi_rate_meter_t *now, const csi_rate_meter_t *before, csi_rate_meter_t *window);
+
+/* The feed uses C11 atomics; C++ hosts only handle reports. */
+#ifndef __cplusplus
+/*
+ * A rate meter written by the CSI callback and read by another task without
+ * locks. The meter is cumulative and guarded by a sequence counter that is odd
+ * while the writer updates it: the writer never waits, and a reader retries
+ * the copy if it overlapped an update. Readers take the difference of two
+ * snapshots (csi_rate_meter_window) instead of restarting the meter.
+ */
+typedef struct {
+    csi_rate_meter_t  totals;
+    _Atomic uint32_t  version;
+    _Atomic uint8_t   rearm;    /* set by a reader: the next frame starts a new gap chain */
+} csi_rate_feed_t;
+
+void csi_rate_feed_init(csi_rate_feed_t *feed);
+
+/**
+ * csi_rate_meter_add for the single writer. It must not be preempted by a
+ * reader on its own core (the CSI callback runs above every reader).
+ */
+void csi_rate_feed_add(csi_rate_feed_t *feed, uint32_t timestamp_us);
+
+/**
+ * Copies a consistent snapshot of the cumulative meter, from any task.
+ */
+void csi_rate_feed_snapshot(csi_rate_feed_t *feed, csi_rate_meter_t *out);
+
+/**
+ * Makes the writer forget its last arrival, so the idle time before a new
+ * capture is not measured as a gap.
+ */
+void csi_rate_feed_rearm(csi_rate_feed_t *feed);
+#endif /* __cplusplus */
+
+/**
+ * Starts the pacer at one probe per target period, clamped to
+ * [min_interval_us, max_interval_us].
+ */
+void csi_pacer_init(csi_pacer_t *pacer, uint32_t target_hz, uint32_t min_interval_us, uint32_t max_interval_us);
+
+/**
+ * Feeds the stats of the last window and returns the new probe interval.
+ */
+uint32_t csi_pacer_update(csi_pacer_t *pacer, const csi_rate_stats_t *stats);
+
+/**
+ * Writes the CSI_RATE line (no newline, NUL-terminated) into out. Returns its
+ * length, or 0 if cap is too small.
+ */
+size_t csi_traffic_format_report(const csi_traffic_report_t *report, char *out, size_t cap);
+
+/**
+ * Parses a CSI_RATE datagram of len bytes. Returns 1 on success, 0 otherwise.
+ */
+int csi_traffic_parse_report(const char *data, size_t len, csi_traffic_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,16 +13,33 @@
  * and server details.
  * 2.  Multi-Authentication Support: Connects to various network types based on
  * the provisioned configuration.
- * 3.  Traffic Generation: Pings the network gateway to generate CSI data.
+ * 3.  Traffic Generation: Probes the gateway (ICMP) or the collector (UDP echo) at an
+ * interval steered towards a target CSI rate, and reports the achieved rate.
  * 4.  Data Transmission: Forwards collected CSI data to a designated server via UDP.
  * 5.  Power Management: Enters a deep sleep cycle to conserve energy between
  * acquisition sessions.
  * 6.  IP Discovery: Broadcasts its IP address upon connection to facilitate discovery.
+ * 7.  Clock Synchronization: Syncs to the collector's clock during acquisition and
+ * reports the mapping of its radio timestamps onto it (csi_clock.h).
+ * 8.  Fast Resume: Keeps the AP's BSSID and channel and the DHCP address in RTC memory
+ * across deep sleep, reconnects without scanning or DHCP while they are valid, and
+ * reports the wake-phase timings (csi_link.h).
+ * 9.  Scheduled Acquisition: Stores a plan of acquisition windows pushed by the
+ * collector and deep sleeps until each of them instead of polling for a start
+ * command (csi_schedule.h).
+ * 10. Gap Retransmission: Keeps the most recently sent frames and resends the ones
+ * the collector reports missing, between live frames (csi_history.h).
+ * 11. Multiple Sources: Captures CSI from the access point, a list of transmitters or
+ * every transmitter on the channel (promiscuous), each numbered as its own stream
+ * (csi_sources.h).
  */
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -37,12 +54,27 @@
 #include "lwip/inet.h"
 #include "lwip/netdb.h"
 #include "lwip/sockets.h"
-#include "ping/ping_sock.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/icmp.h"
 #include "esp_system.h"
 #include "esp_event.h"
 #include "nvs.h"
 #include "driver/gpio.h"
 #include "esp_sleep.h"
+#include "csi_frame.h"
+#include "csi_ring.h"
+#include "csi_batch.h"
+#include "csi_delta.h"
+#include "csi_capture.h"
+#include "csi_traffic.h"
+#include "csi_stats.h"
+#include "csi_clock.h"
+#include "csi_link.h"
+#include "csi_schedule.h"
+#include "csi_history.h"
+#include "csi_sources.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 
 // --- System Definitions ---
 #define CONFIG_SEND_FREQUENCY      100
@@ -62,15 +94,130 @@
 #define DEEP_SLEEP_INTERVAL_S      5
 #define UDP_LISTEN_WINDOW_S        10
 #define UDP_LISTEN_PORT            50000
+#define UDP_START_CMD_MAX_LEN      256  // "start,<s>" plus a full 32-digit subcarrier mask, options and 8 sources
 #define IP_BROADCAST_PORT          50002
 
+// --- CSI Output Format ---
+// CSI_OUTPUT_TEXT keeps the legacy "CSI_DATA,..." lines for the current collectors,
+// CSI_OUTPUT_BINARY sends the packed frame described in csi_frame.h.
+#define CSI_OUTPUT_TEXT            0
+#define CSI_OUTPUT_BINARY          1
+#define CONFIG_CSI_OUTPUT_FORMAT   CSI_OUTPUT_TEXT
+
+// --- CSI Capture/Transmit Split ---
+// The CSI callback only serializes into the ring; csi_sender_task owns the socket.
+#define CSI_PAYLOAD_MAX_LEN        384
+#define CSI_RING_SLOTS             16
+#if CONFIG_CSI_OUTPUT_FORMAT == CSI_OUTPUT_BINARY
+#define CSI_RING_SLOT_SIZE         CSI_FRAME_BIN_SIZE(CSI_PAYLOAD_MAX_LEN)
+#else
+#define CSI_RING_SLOT_SIZE         CSI_FRAME_TEXT_MAX(CSI_PAYLOAD_MAX_LEN)
+#endif
+#define CSI_SENDER_STACK_SIZE      4096
+#define CSI_SENDER_PRIORITY        5
+#define CSI_SENDER_REPORT_MS       1000
+// Coalesce frames into one datagram until the byte budget or the latency deadline is hit.
+// Off by default: only collectors that understand csi_batch.h datagrams can unpack them.
+#define CONFIG_CSI_BATCH_ENABLED   0
+#define CSI_BATCH_MAX_BYTES        1400  // Stays below the 1472-byte UDP payload of a 1500 MTU
+#define CSI_BATCH_MAX_LATENCY_MS   20
+// Lossless payload compression (csi_delta.h): a keyframe every CSI_KEYFRAME_INTERVAL
+// frames and zigzag-varint deltas against the previous frame in between.
+// Off by default: needs binary output and a collector that decodes delta frames.
+#define CONFIG_CSI_COMPRESSION_ENABLED 0
+#define CSI_KEYFRAME_INTERVAL      50
+#if CONFIG_CSI_COMPRESSION_ENABLED && CONFIG_CSI_OUTPUT_FORMAT != CSI_OUTPUT_BINARY
+#error "CSI compression requires CONFIG_CSI_OUTPUT_FORMAT == CSI_OUTPUT_BINARY"
+#endif
+// History of sent frames the collector can ask for again with a NACK (csi_history.h).
+// Frames are unchanged on the wire, so collectors that never send a NACK are unaffected.
+#define CONFIG_CSI_HISTORY_ENABLED 1
+#define CSI_HISTORY_BYTES_PSRAM    (512 * 1024)
+#define CSI_HISTORY_BYTES          (32 * 1024)   // internal RAM when there is no PSRAM
+#define CSI_HISTORY_SLOTS          1024
+#define CSI_HISTORY_RESEND_BUDGET  8             // resent frames per sender pass, between live ones
+#define CSI_HISTORY_POLL_MS        10
+#if CONFIG_FREERTOS_UNICORE
+#define CSI_SENDER_CORE            tskNO_AFFINITY
+#else
+#define CSI_SENDER_CORE            1   // Wi-Fi runs on core 0; keep lwIP sends off it
+#endif
+
+// --- Traffic Generation ---
+// Probe interval is steered so the CSI callback sees the start command's target rate
+// (CONFIG_SEND_FREQUENCY by default); see csi_traffic.h for the control loop and report.
+#define CSI_TRAFFIC_MIN_INTERVAL_US 2000     // Never more than 500 probes per second
+#define CSI_TRAFFIC_MAX_INTERVAL_US 200000
+#define CSI_TRAFFIC_CONTROL_MS     1000
+#define CSI_TRAFFIC_STACK_SIZE     3072
+#define CSI_TRAFFIC_PRIORITY       5
+
+// --- Clock Synchronization ---
+// NTP-style exchanges with the collector on its data port (csi_clock.h); the schedule
+// is CSI_CLOCK_BURST exchanges at start, then one every CSI_CLOCK_PERIOD_MS.
+#define CSI_CLOCK_REPLY_TIMEOUT_MS 100
+#define CSI_CLOCK_STACK_SIZE       3072
+#define CSI_CLOCK_PRIORITY         5
+
+// --- Fast Resume ---
+// Reconnect state machine and the state it keeps in RTC memory (csi_link.h).
+#define CSI_LINK_EVENT_FAST_TIMEOUT 0
+
+ESP_EVENT_DEFINE_BASE(CSI_LINK_EVENT);
+
+// --- Scheduled Acquisition ---
+// Window plans from the collector (csi_schedule.h), kept in NVS across power loss.
+#define CSI_SCHEDULE_NAMESPACE     "csi_sched"
+#define CSI_SCHEDULE_KEY_PLAN      "plan"
+
+typedef enum {
+    NODE_CMD_NONE,
+    NODE_CMD_START,
+    NODE_CMD_SCHEDULE,
+    NODE_CMD_CANCEL,
+} node_command_t;
+
 static const char *TAG = "csi_receiver_node";
 
 // Global variables for the server IP and Port, loaded from NVS
 static char g_csi_server_ip[16] = "127.0.0.1";
 static int  g_csi_server_port = 50000;
 static EventGroupHandle_t s_wifi_event_group;
-static int wifi_fail_count = 0;
+static csi_ring_t s_csi_ring;
+static uint8_t s_csi_ring_storage[CSI_RING_STORAGE_SIZE(CSI_RING_SLOT_SIZE, CSI_RING_SLOTS)];
+static TaskHandle_t s_csi_sender_task = NULL;
+// Subcarrier mask, decimation and payload mode from the start command (csi_capture.h).
+static csi_capture_config_t s_capture_cfg;
+// Transmitters captured, with their sequence numbers and decimators (csi_sources.h).
+static csi_sources_t s_sources;
+static int8_t s_csi_reduced[CSI_PAYLOAD_MAX_LEN];
+// Frames accepted by the CSI callback, read once per control period by csi_traffic_task.
+static csi_rate_feed_t s_rate_feed;
+static TaskHandle_t s_traffic_task = NULL;
+
+static csi_stats_t s_csi_stats;
+
+static csi_clock_t s_clock;
+// Smallest local-minus-radio clock difference seen by the CSI callback since the last
+// clock report: the radio clock offset plus the shortest callback latency.
+static _Atomic int32_t s_radio_offset_min = INT32_MAX;
+static TaskHandle_t s_clock_task = NULL;
+
+// Survives deep sleep; zeroed on power-on, which csi_link_begin treats as no state.
+static RTC_DATA_ATTR csi_link_retained_t s_link_retained;
+// Driven only from the default event loop task, which serializes every event.
+static csi_link_t s_link;
+static esp_netif_t *s_sta_netif;
+static wifi_config_t s_sta_config;
+static esp_timer_handle_t s_link_timer;
+// Uptime of the first accepted CSI frame, set by the CSI callback; the sender task
+// sends the wake report once it is set.
+static _Atomic uint32_t s_first_frame_ms;
+
+// The current plan (count 0: none) and the lead time of the next scheduled wake. The
+// RTC copy spares an NVS read on every wake; after a power loss it is reloaded.
+static RTC_DATA_ATTR csi_schedule_t s_plan;
+static RTC_DATA_ATTR uint32_t s_plan_lead_ms;
 
 // Function Prototypes
 static void erase_wifi_creds_and_restart(void);
@@ -94,67 +241,439 @@ typedef struct {
     extern void phy_force_rx_gain(int force_en, int force_value);
 #endif
 
-static void send_csi_udp(const char *data, size_t len) {
-    static int sock = -1;
-    static struct sockaddr_in dest_addr;
+// Data socket to the collector; NACKs (csi_history.h) come back on it. The
+// sender task and the main task (CSI_SCHED reports) both send on it, so the
+// socket, its destination and every use of them are held under s_csi_sock_lock.
+static int s_csi_sock = -1;
+static SemaphoreHandle_t s_csi_sock_lock;
+static struct sockaddr_in s_csi_dest;
+
+// (Re)opens the socket when the collector address changed. Called with the lock held.
+static bool csi_sock_ready(void) {
     static char last_ip[16] = {0};
     static int last_port = 0;
 
-    if (sock < 0 || strcmp(last_ip, g_csi_server_ip) != 0 || last_port != g_csi_server_port) {
-        if (sock >= 0) {
-            close(sock);
+    if (s_csi_sock < 0 || strcmp(last_ip, g_csi_server_ip) != 0 || last_port != g_csi_server_port) {
+        if (s_csi_sock >= 0) {
+            close(s_csi_sock);
         }
-        sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
-        if (sock < 0) {
+        s_csi_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        if (s_csi_sock < 0) {
             ESP_LOGE(TAG, "Failed to create UDP socket for CSI");
-            return;
+            return false;
         }
-        dest_addr.sin_addr.s_addr = inet_addr(g_csi_server_ip);
-        dest_addr.sin_family = AF_INET;
-        dest_addr.sin_port = htons(g_csi_server_port);
+        s_csi_dest.sin_addr.s_addr = inet_addr(g_csi_server_ip);
+        s_csi_dest.sin_family = AF_INET;
+        s_csi_dest.sin_port = htons(g_csi_server_port);
         
         strlcpy(last_ip, g_csi_server_ip, sizeof(last_ip));
         last_port = g_csi_server_port;
         
         ESP_LOGI(TAG, "Configured to send CSI data to %s:%d", g_csi_server_ip, g_csi_server_port);
     }
-    sendto(sock, data, len, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    return true;
 }
 
-static void wifi_csi_rx_cb(void *ctx, wifi_csi_info_t *info)
-{
-    if (!info || !info->buf) {
+// Returns 0 if the datagram was handed to lwIP, -1 otherwise. From any task.
+static int send_csi_udp(const char *data, size_t len) {
+    int ret = -1;
+    xSemaphoreTake(s_csi_sock_lock, portMAX_DELAY);
+    if (csi_sock_ready() &&
+        sendto(s_csi_sock, data, len, 0, (struct sockaddr *)&s_csi_dest, sizeof(s_csi_dest)) == (int)len) {
+        ret = 0;
+    }
+    xSemaphoreGive(s_csi_sock_lock);
+    return ret;
+}
+
+// Sends frame_count frames in one datagram and accounts for them in the health counters.
+static void send_csi_frames(const char *data, size_t len, uint32_t frame_count) {
+    if (send_csi_udp(data, len) == 0) {
+        csi_stats_count(&s_csi_stats.sent, frame_count);
+    } else {
+        csi_stats_count(&s_csi_stats.send_failed, frame_count);
+    }
+}
+
+#if CONFIG_CSI_BATCH_ENABLED
+static csi_batch_t s_csi_batch;
+static uint8_t s_csi_batch_buf[CSI_BATCH_MAX_BYTES];
+
+static void csi_batch_flush(void) {
+    size_t len = csi_batch_finish(&s_csi_batch);
+    if (len > 0) {
+        send_csi_frames((const char *)s_csi_batch_buf, len, s_csi_batch.count);
+    }
+    csi_batch_reset(&s_csi_batch);
+}
+#endif
+
+#if CONFIG_CSI_COMPRESSION_ENABLED
+// One encoder per entry of the sources table, tagged with the MAC it holds the
+// reference of: transmitters see different channels, so a frame is only a delta
+// against its own source's previous frame.
+static csi_delta_enc_t s_csi_delta[CSI_SOURCES_MAX];
+static uint8_t s_csi_delta_mac[CSI_SOURCES_MAX][6];
+static uint8_t s_csi_delta_payload[CSI_DELTA_ENCODED_MAX(CSI_PAYLOAD_MAX_LEN)];
+static uint8_t s_csi_delta_frame[CSI_FRAME_BIN_SIZE(CSI_DELTA_ENCODED_MAX(CSI_PAYLOAD_MAX_LEN))];
+static uint32_t s_csi_delta_raw_bytes;
+static uint32_t s_csi_delta_out_bytes;
+static uint32_t s_csi_delta_frames;
+static int64_t s_csi_delta_us;
+
+// Re-encodes a ring frame with a compressed payload. Returns the frame to send,
+// which is the original one if it cannot be compressed.
+static const uint8_t *csi_compress_frame(const uint8_t *frame, uint16_t *len) {
+    csi_frame_meta_t meta;
+    const int8_t *payload;
+    if (csi_frame_decode(frame, *len, &meta, &payload) != CSI_FRAME_OK) {
+        return frame;
+    }
+    const csi_source_t *src = csi_sources_find(&s_sources, meta.mac);
+    if (!src) {
+        return frame;  // no longer captured
+    }
+    size_t i = (size_t)(src - s_sources.entries);
+    if (memcmp(meta.mac, s_csi_delta_mac[i], 6) != 0) {
+        // The entry was given to another transmitter by csi_sources_configure.
+        memcpy(s_csi_delta_mac[i], meta.mac, 6);
+        csi_delta_enc_reset(&s_csi_delta[i]);
+    }
+    int64_t start = esp_timer_get_time();
+    size_t n = csi_delta_encode(&s_csi_delta[i], meta.seq, payload, meta.len, s_csi_delta_payload,
+                                sizeof(s_csi_delta_payload), &meta.flags);
+    s_csi_delta_us += esp_timer_get_time() - start;
+    if (n == 0) {
+        return frame;
+    }
+    s_csi_delta_raw_bytes += meta.len;
+    s_csi_delta_out_bytes += n;
+    s_csi_delta_frames++;
+    meta.len = (uint16_t)n;
+    *len = (uint16_t)csi_frame_encode(&meta, (const int8_t *)s_csi_delta_payload, s_csi_delta_frame,
+                                      sizeof(s_csi_delta_frame));
+    return s_csi_delta_frame;
+}
+#endif
+
+#if CONFIG_CSI_HISTORY_ENABLED
+static csi_history_t s_csi_history;
+static csi_history_slot_t s_csi_history_slots[CSI_HISTORY_SLOTS];
+static bool s_csi_history_ready = false;
+
+static void csi_history_start(void) {
+    size_t bytes = CSI_HISTORY_BYTES_PSRAM;
+    void *arena = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+    if (!arena) {
+        bytes = CSI_HISTORY_BYTES;
+        arena = heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    }
+    if (!arena || csi_history_init(&s_csi_history, arena, bytes, s_csi_history_slots, CSI_HISTORY_SLOTS) != 0) {
+        ESP_LOGW(TAG, "No memory for the frame history; lost frames cannot be resent");
+        free(arena);
         return;
     }
-    if (memcmp(info->mac, ctx, 6)) {
+    s_csi_history_ready = true;
+    ESP_LOGI(TAG, "Frame history: %u KB", (unsigned)(bytes / 1024));
+}
+
+// Takes the collector's NACKs off the data socket and resends a few of the requested frames.
+static void csi_history_serve(void) {
+    char buf[CSI_HISTORY_NACK_MAX_LEN];
+    int n;
+    xSemaphoreTake(s_csi_sock_lock, portMAX_DELAY);
+    while (s_csi_sock >= 0 && (n = recv(s_csi_sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        csi_history_request(&s_csi_history, buf, (size_t)n);
+    }
+    xSemaphoreGive(s_csi_sock_lock);
+    const uint8_t *frame;
+    uint32_t seq;
+    uint16_t len;
+    for (int i = 0; i < CSI_HISTORY_RESEND_BUDGET && (frame = csi_history_next(&s_csi_history, &seq, &len)); i++) {
+        if (send_csi_udp((const char *)frame, len) == 0) {
+            csi_stats_count(&s_csi_stats.resent, 1);
+        }
+    }
+}
+#endif
+
+// Sends the CSI_STATS report of the capture health counters (csi_stats.h).
+static void csi_send_stats_report(void) {
+    static char buf[CSI_STATS_REPORT_MAX_LEN];
+    csi_stats_report_t report;
+    csi_stats_snapshot(&s_csi_stats, &report);
+    report.uptime_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    report.ring_full = atomic_load(&s_csi_ring.overflows);
+    report.queue_depth = csi_ring_depth(&s_csi_ring);
+    report.queue_high = atomic_load(&s_csi_ring.high_water);
+    size_t len = csi_stats_format_report(&report, buf, sizeof(buf));
+    if (len > 0) {
+        send_csi_udp(buf, len);
+    }
+}
+
+// Sends the CSI_WAKE report of this wake's phase timings (csi_link.h), once.
+static void csi_send_wake_report(void) {
+    static bool sent = false;
+    uint32_t first_frame_ms = atomic_load(&s_first_frame_ms);
+    if (sent || first_frame_ms == 0) {
         return;
     }
-    static int s_count = 0;
+    char buf[CSI_LINK_REPORT_MAX_LEN];
+    csi_wake_report_t report;
+    csi_link_mark(&s_link, CSI_WAKE_FIRST_FRAME, first_frame_ms);
+    csi_link_make_report(&s_link, &report);
+    size_t len = csi_link_format_report(&report, buf, sizeof(buf));
+    if (len > 0) {
+        send_csi_udp(buf, len);
+        ESP_LOGI(TAG, "%s", buf);
+    }
+    sent = true;
+}
+
+static void csi_sender_task(void *pvParameters) {
+    uint32_t reported_overflows = 0;
+    TickType_t last_report = xTaskGetTickCount();
+#if CONFIG_CSI_BATCH_ENABLED
+    TickType_t batch_deadline = 0;
+    csi_batch_init(&s_csi_batch, s_csi_batch_buf, sizeof(s_csi_batch_buf));
+#endif
+#if CONFIG_CSI_COMPRESSION_ENABLED
+    for (int i = 0; i < CSI_SOURCES_MAX; i++) {
+        csi_delta_enc_init(&s_csi_delta[i], CSI_KEYFRAME_INTERVAL);
+    }
+#endif
+#if CONFIG_CSI_HISTORY_ENABLED
+    uint32_t reported_resent = 0, reported_expired = 0;
+#endif
+    uint32_t reported_sources = 0, reported_source_overflow = 0;
+
+    while (1) {
+        TickType_t wait = pdMS_TO_TICKS(CSI_SENDER_REPORT_MS);
+#if CONFIG_CSI_BATCH_ENABLED
+        if (s_csi_batch.count > 0) {
+            TickType_t now = xTaskGetTickCount();
+            wait = (int32_t)(batch_deadline - now) > 0 ? batch_deadline - now : 0;
+        }
+#endif
+#if CONFIG_CSI_HISTORY_ENABLED
+        // NACKs are only noticed when the task runs.
+        if (s_csi_history_ready && wait > pdMS_TO_TICKS(CSI_HISTORY_POLL_MS)) {
+            wait = pdMS_TO_TICKS(CSI_HISTORY_POLL_MS);
+        }
+#endif
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        const uint8_t *frame;
+        uint32_t seq;
+        uint16_t len;
+        while ((frame = csi_ring_peek(&s_csi_ring, &seq, &len)) != NULL) {
+#if CONFIG_CSI_HISTORY_ENABLED
+            // Kept before compression: a resent frame must not depend on a reference.
+            if (s_csi_history_ready) {
+                csi_history_store(&s_csi_history, seq, frame, len);
+            }
+#endif
+#if CONFIG_CSI_COMPRESSION_ENABLED
+            frame = csi_compress_frame(frame, &len);
+#endif
+#if CONFIG_CSI_BATCH_ENABLED
+            if (csi_batch_add(&s_csi_batch, seq, frame, len) != 0) {
+                csi_batch_flush();
+                if (csi_batch_add(&s_csi_batch, seq, frame, len) != 0) {
+                    // Larger than the whole budget: send it on its own, unbatched.
+                    send_csi_frames((const char *)frame, len, 1);
+                }
+            }
+            if (s_csi_batch.count == 1) {
+                batch_deadline = xTaskGetTickCount() + pdMS_TO_TICKS(CSI_BATCH_MAX_LATENCY_MS);
+            }
+#else
+            send_csi_frames((const char *)frame, len, 1);
+#endif
+            csi_ring_release(&s_csi_ring);
+        }
+#if CONFIG_CSI_BATCH_ENABLED
+        if (s_csi_batch.count > 0 && (int32_t)(xTaskGetTickCount() - batch_deadline) >= 0) {
+            csi_batch_flush();
+        }
+#endif
+#if CONFIG_CSI_HISTORY_ENABLED
+        if (s_csi_history_ready) {
+            csi_history_serve();
+        }
+#endif
+
+        if (xTaskGetTickCount() - last_report < pdMS_TO_TICKS(CSI_SENDER_REPORT_MS)) {
+            continue;
+        }
+        last_report = xTaskGetTickCount();
+        csi_send_stats_report();
+        csi_send_wake_report();
+        uint32_t overflows = atomic_load(&s_csi_ring.overflows);
+        if (overflows != reported_overflows) {
+            ESP_LOGW(TAG, "CSI ring overflow: %u frames dropped (%u sent, high water %u/%d)",
+                     (unsigned)(overflows - reported_overflows), (unsigned)atomic_load(&s_csi_ring.committed),
+                     (unsigned)atomic_load(&s_csi_ring.high_water), CSI_RING_SLOTS);
+            reported_overflows = overflows;
+        }
+        uint8_t source_count = csi_sources_count(&s_sources);
+        uint32_t source_overflow = csi_sources_overflow(&s_sources);
+        if (source_count != reported_sources || source_overflow != reported_source_overflow) {
+            ESP_LOGI(TAG, "CSI sources: %u transmitters, %u frames of transmitters beyond the table",
+                     (unsigned)source_count, (unsigned)(source_overflow - reported_source_overflow));
+            for (uint8_t i = reported_sources < source_count ? reported_sources : 0; i < source_count; i++) {
+                const csi_source_t *src = &s_sources.entries[i];
+                ESP_LOGI(TAG, "  " MACSTR "%s: %u frames, %u rate limited", MAC2STR(src->mac),
+                         src->ap ? " (AP)" : "", (unsigned)src->frames, (unsigned)src->limited);
+            }
+            reported_sources = source_count;
+            reported_source_overflow = source_overflow;
+        }
+#if CONFIG_CSI_HISTORY_ENABLED
+        if (s_csi_history.resent != reported_resent || s_csi_history.expired != reported_expired) {
+            ESP_LOGI(TAG, "CSI history: %u frames resent, %u no longer held (%u NACKs)",
+                     (unsigned)(s_csi_history.resent - reported_resent),
+                     (unsigned)(s_csi_history.expired - reported_expired), (unsigned)s_csi_history.nacks);
+            reported_resent = s_csi_history.resent;
+            reported_expired = s_csi_history.expired;
+        }
+#endif
+#if CONFIG_CSI_COMPRESSION_ENABLED
+        if (s_csi_delta_frames > 0) {
+            ESP_LOGI(TAG, "CSI compression: %u frames, ratio %.2f, %u us/frame",
+                     (unsigned)s_csi_delta_frames, (double)s_csi_delta_raw_bytes / s_csi_delta_out_bytes,
+                     (unsigned)(s_csi_delta_us / s_csi_delta_frames));
+            s_csi_delta_raw_bytes = s_csi_delta_out_bytes = s_csi_delta_frames = 0;
+            s_csi_delta_us = 0;
+        }
+#endif
+    }
+}
+
+static void csi_sender_start(void) {
+    if (s_csi_sender_task) {
+        return;
+    }
+    csi_stats_init(&s_csi_stats);
+    csi_rate_feed_init(&s_rate_feed);
+    if (csi_ring_init(&s_csi_ring, s_csi_ring_storage, CSI_RING_SLOT_SIZE, CSI_RING_SLOTS) != 0) {
+        ESP_LOGE(TAG, "Failed to initialize CSI ring");
+        return;
+    }
+#if CONFIG_CSI_HISTORY_ENABLED
+    csi_history_start();
+#endif
+    xTaskCreatePinnedToCore(csi_sender_task, "csi_sender_task", CSI_SENDER_STACK_SIZE, NULL,
+                            CSI_SENDER_PRIORITY, &s_csi_sender_task, CSI_SENDER_CORE);
+}
+
+// Serializes one frame from a captured transmitter into the ring.
+static void wifi_csi_process(const wifi_csi_info_t *info, csi_source_t *src)
+{
     const wifi_pkt_rx_ctrl_t *rx_ctrl = &info->rx_ctrl;
-    char csi_msg[1024];
-    int offset = 0;
 
-    offset += snprintf(csi_msg + offset, sizeof(csi_msg) - offset, "CSI_DATA,%d," MACSTR,
-                       s_count++, MAC2STR(info->mac));
+    if (info->len > CSI_PAYLOAD_MAX_LEN) {
+        csi_stats_count(&s_csi_stats.truncated, 1);
+        return;
+    }
+
+    // Counted before decimation: the traffic target is the rate the AP delivers.
+    if (src->ap) {
+        csi_rate_feed_add(&s_rate_feed, rx_ctrl->timestamp);
+    }
 
-    offset += snprintf(csi_msg + offset, sizeof(csi_msg) - offset,
-                       ",%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%u,%d,%d,%d",
-                       rx_ctrl->rssi, rx_ctrl->rate, rx_ctrl->sig_mode,
-                       rx_ctrl->mcs, rx_ctrl->cwb, rx_ctrl->smoothing, rx_ctrl->not_sounding,
-                       rx_ctrl->aggregation, rx_ctrl->stbc, rx_ctrl->fec_coding, rx_ctrl->sgi,
-                       rx_ctrl->noise_floor, rx_ctrl->ampdu_cnt, rx_ctrl->channel, rx_ctrl->secondary_channel,
-                       rx_ctrl->timestamp, rx_ctrl->ant, rx_ctrl->sig_len, rx_ctrl->rx_state);
+    // Decimated frames take no sequence number: host-side gaps remain losses.
+    if (!csi_capture_keep_frame(&s_capture_cfg, &src->dec, rx_ctrl->timestamp)) {
+        csi_stats_count(&s_csi_stats.decimated, 1);
+        src->limited++;
+        return;
+    }
 
-    offset += snprintf(csi_msg + offset, sizeof(csi_msg) - offset, ",%d,%d,\"[%d", 
-                       info->len, info->first_word_invalid, info->buf[0]);
+    uint8_t *slot = csi_ring_acquire(&s_csi_ring);
+    if (!slot) {
+        src->seq++;  // Keep the sequence gap visible to the host.
+        return;
+    }
 
-    for (int i = 1; i < info->len; i++) {
-        offset += snprintf(csi_msg + offset, sizeof(csi_msg) - offset, ",%d", info->buf[i]);
+    // Drop unselected subcarriers before serialization so they never reach the socket.
+    const int8_t *payload = info->buf;
+    uint16_t payload_len = info->len;
+    uint8_t flags = 0;
+    if (!csi_capture_is_passthrough(&s_capture_cfg)) {
+        payload_len = csi_capture_reduce(&s_capture_cfg, info->buf, info->len, s_csi_reduced);
+        payload = s_csi_reduced;
+        if (s_capture_cfg.payload_mode == CSI_CAPTURE_MODE_AMPLITUDE) {
+            flags |= CSI_FRAME_FLAG_AMPLITUDE;
+        }
     }
-    
-    snprintf(csi_msg + offset, sizeof(csi_msg) - offset, "]\"\n");
 
-    send_csi_udp(csi_msg, strlen(csi_msg));
+    csi_frame_meta_t meta = {
+        .seq                = src->seq++,
+        .flags              = flags,
+        .rssi               = rx_ctrl->rssi,
+        .rate               = rx_ctrl->rate,
+        .sig_mode           = rx_ctrl->sig_mode,
+        .mcs                = rx_ctrl->mcs,
+        .cwb                = rx_ctrl->cwb,
+        .smoothing          = rx_ctrl->smoothing,
+        .not_sounding       = rx_ctrl->not_sounding,
+        .aggregation        = rx_ctrl->aggregation,
+        .stbc               = rx_ctrl->stbc,
+        .fec_coding         = rx_ctrl->fec_coding,
+        .sgi                = rx_ctrl->sgi,
+        .noise_floor        = rx_ctrl->noise_floor,
+        .ampdu_cnt          = rx_ctrl->ampdu_cnt,
+        .channel            = rx_ctrl->channel,
+        .secondary_channel  = rx_ctrl->secondary_channel,
+        .ant                = rx_ctrl->ant,
+        .timestamp          = rx_ctrl->timestamp,
+        .sig_len            = rx_ctrl->sig_len,
+        .rx_state           = rx_ctrl->rx_state,
+        .first_word_invalid = info->first_word_invalid,
+        .len                = payload_len,
+    };
+    memcpy(meta.mac, info->mac, 6);
+
+#if CONFIG_CSI_OUTPUT_FORMAT == CSI_OUTPUT_BINARY
+    size_t len = csi_frame_encode(&meta, payload, slot, CSI_RING_SLOT_SIZE);
+#else
+    size_t len = csi_frame_format_text(&meta, payload, (char *)slot, CSI_RING_SLOT_SIZE);
+#endif
+    if (len > 0) {
+        csi_ring_commit(&s_csi_ring, meta.seq, (uint16_t)len);
+        csi_stats_count(&s_csi_stats.serialized, 1);
+        src->frames++;
+        xTaskNotifyGive(s_csi_sender_task);
+    } else {
+        csi_stats_count(&s_csi_stats.truncated, 1);
+    }
+}
+
+static void wifi_csi_rx_cb(void *ctx, wifi_csi_info_t *info)
+{
+    csi_stats_count(&s_csi_stats.seen, 1);
+    if (!info || !info->buf) {
+        return;
+    }
+    csi_source_t *src = csi_sources_lookup(&s_sources, info->mac);
+    if (!src) {
+        csi_stats_count(&s_csi_stats.filtered, 1);
+        return;
+    }
+    int64_t start = esp_timer_get_time();
+    int32_t radio_offset = (int32_t)((uint32_t)start - info->rx_ctrl.timestamp);
+    if (radio_offset < atomic_load_explicit(&s_radio_offset_min, memory_order_relaxed)) {
+        atomic_store_explicit(&s_radio_offset_min, radio_offset, memory_order_relaxed);
+    }
+    if (atomic_load_explicit(&s_first_frame_ms, memory_order_relaxed) == 0) {
+        uint32_t ms = (uint32_t)(start / 1000);
+        atomic_store_explicit(&s_first_frame_ms, ms ? ms : 1, memory_order_relaxed);
+    }
+    csi_stats_count(&s_csi_stats.accepted, 1);
+    csi_stats_rx_interval(&s_csi_stats, info->rx_ctrl.timestamp);
+    wifi_csi_process(info, src);
+    csi_hist_add(&s_csi_stats.callback_us, (uint32_t)(esp_timer_get_time() - start));
 }
 
 static void wifi_csi_init()
@@ -170,28 +689,249 @@ static void wifi_csi_init()
     };
     static wifi_ap_record_t s_ap_info = {0};
     ESP_ERROR_CHECK(esp_wifi_sta_get_ap_info(&s_ap_info));
+    // The table belongs to the callback: change it only while CSI is off.
+    esp_wifi_set_csi(false);
+    csi_sources_configure(&s_sources, &s_capture_cfg, s_ap_info.bssid);
+    // Other transmitters' frames only reach the CSI path in promiscuous mode.
+    if (s_capture_cfg.source_mode == CSI_CAPTURE_SRC_ANY) {
+        wifi_promiscuous_filter_t filter = {
+            .filter_mask = WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_DATA,
+        };
+        ESP_ERROR_CHECK(esp_wifi_set_promiscuous_filter(&filter));
+        ESP_ERROR_CHECK(esp_wifi_set_promiscuous(true));
+    } else {
+        ESP_ERROR_CHECK(esp_wifi_set_promiscuous(false));
+    }
     ESP_ERROR_CHECK(esp_wifi_set_csi_config(&csi_config));
-    ESP_ERROR_CHECK(esp_wifi_set_csi_rx_cb(wifi_csi_rx_cb, s_ap_info.bssid));
+    ESP_ERROR_CHECK(esp_wifi_set_csi_rx_cb(wifi_csi_rx_cb, NULL));
     ESP_ERROR_CHECK(esp_wifi_set_csi(true));
 }
 
-static esp_err_t wifi_ping_router_start()
-{
-    static esp_ping_handle_t ping_handle = NULL;
-    esp_ping_config_t ping_config = ESP_PING_DEFAULT_CONFIG();
-    ping_config.count             = 0;
-    ping_config.interval_ms       = 1000 / CONFIG_SEND_FREQUENCY;
-    ping_config.task_stack_size   = 3072;
-    ping_config.data_size         = 1;
-    esp_netif_ip_info_t local_ip;
-    esp_netif_get_ip_info(esp_netif_get_handle_from_ifkey("WIFI_STA_DEF"), &local_ip);
-    ESP_LOGI(TAG, "Obtained IP:" IPSTR ", Gateway: " IPSTR, IP2STR(&local_ip.ip), IP2STR(&local_ip.gw));
-    ping_config.target_addr.u_addr.ip4.addr = ip4_addr_get_u32(&local_ip.gw);
-    ping_config.target_addr.type = ESP_IPADDR_TYPE_V4;
-    esp_ping_callbacks_t cbs = { 0 };
-    esp_ping_new_session(&ping_config, &cbs, &ping_handle);
-    esp_ping_start(ping_handle);
-    return ESP_OK;
+static void csi_probe_timer_cb(void *arg) {
+    xTaskNotifyGive(s_traffic_task);
+}
+
+// Sends one 1-byte ICMP echo request; the gateway's reply is what produces the CSI.
+static void send_icmp_probe(int sock, const struct sockaddr_in *gw, uint16_t seq) {
+    uint8_t packet[sizeof(struct icmp_echo_hdr) + 1] = {0};
+    struct icmp_echo_hdr *hdr = (struct icmp_echo_hdr *)packet;
+    ICMPH_TYPE_SET(hdr, ICMP_ECHO);
+    ICMPH_CODE_SET(hdr, 0);
+    hdr->id = htons(0xC51F);
+    hdr->seqno = htons(seq);
+    hdr->chksum = inet_chksum(packet, sizeof(packet));
+    sendto(sock, packet, sizeof(packet), 0, (const struct sockaddr *)gw, sizeof(*gw));
+}
+
+static void csi_traffic_task(void *pvParameters) {
+    uint8_t probe = s_capture_cfg.probe;
+    uint32_t target_hz = s_capture_cfg.target_hz ? s_capture_cfg.target_hz : CONFIG_SEND_FREQUENCY;
+
+    // Carries the rate reports, and the probes themselves in UDP mode.
+    struct sockaddr_in collector = {
+        .sin_family = AF_INET,
+        .sin_port = htons(g_csi_server_port),
+        .sin_addr.s_addr = inet_addr(g_csi_server_ip),
+    };
+    int udp_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    int probe_sock = udp_sock;
+    struct sockaddr_in gateway = { .sin_family = AF_INET };
+    if (probe == CSI_TRAFFIC_PROBE_ICMP) {
+        esp_netif_ip_info_t local_ip;
+        esp_netif_get_ip_info(esp_netif_get_handle_from_ifkey("WIFI_STA_DEF"), &local_ip);
+        ESP_LOGI(TAG, "Obtained IP:" IPSTR ", Gateway: " IPSTR, IP2STR(&local_ip.ip), IP2STR(&local_ip.gw));
+        gateway.sin_addr.s_addr = local_ip.gw.addr;
+        probe_sock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    }
+    if (udp_sock < 0 || probe_sock < 0) {
+        ESP_LOGE(TAG, "Failed to create traffic generator sockets");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    csi_pacer_t pacer;
+    csi_pacer_init(&pacer, target_hz, CSI_TRAFFIC_MIN_INTERVAL_US, CSI_TRAFFIC_MAX_INTERVAL_US);
+    esp_timer_handle_t probe_timer;
+    const esp_timer_create_args_t timer_args = { .callback = csi_probe_timer_cb, .name = "csi_probe" };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &probe_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(probe_timer, pacer.interval_us));
+    ESP_LOGI(TAG, "Traffic generator: %s probes, target %u Hz, initial interval %u us",
+             probe == CSI_TRAFFIC_PROBE_UDP ? "UDP" : "ICMP", (unsigned)target_hz, (unsigned)pacer.interval_us);
+
+    int64_t window_start = esp_timer_get_time();
+    csi_rate_meter_t window_totals;
+    csi_rate_feed_snapshot(&s_rate_feed, &window_totals);
+    uint32_t sent = 0;
+    uint16_t probe_seq = 0;
+    char probe_buf[24];
+    char report_buf[CSI_TRAFFIC_REPORT_MAX_LEN];
+    uint8_t echo_buf[64];
+
+    while (1) {
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CSI_TRAFFIC_CONTROL_MS)) > 0) {
+            if (probe == CSI_TRAFFIC_PROBE_UDP) {
+                int n = snprintf(probe_buf, sizeof(probe_buf), CSI_TRAFFIC_PROBE_PREFIX "%u", (unsigned)probe_seq);
+                sendto(udp_sock, probe_buf, n, 0, (struct sockaddr *)&collector, sizeof(collector));
+            } else {
+                send_icmp_probe(probe_sock, &gateway, probe_seq);
+            }
+            probe_seq++;
+            sent++;
+            // Replies only matter on the air; drain them so the socket never backs up.
+            while (recv(probe_sock, echo_buf, sizeof(echo_buf), MSG_DONTWAIT) > 0) {
+            }
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - window_start < CSI_TRAFFIC_CONTROL_MS * 1000LL) {
+            continue;
+        }
+        csi_rate_meter_t totals, window;
+        csi_rate_feed_snapshot(&s_rate_feed, &totals);
+        csi_rate_meter_window(&totals, &window_totals, &window);
+        window_totals = totals;
+
+        csi_rate_stats_t stats;
+        csi_rate_meter_stats(&window, (uint32_t)(now - window_start), &stats);
+        window_start = now;
+        uint32_t previous = pacer.interval_us;
+        if (csi_pacer_update(&pacer, &stats) != previous) {
+            esp_timer_restart(probe_timer, pacer.interval_us);
+        }
+
+        csi_traffic_report_t report = {
+            .target_hz   = target_hz,
+            .achieved_hz = stats.achieved_hz,
+            .jitter_us   = stats.jitter_us,
+            .interval_us = pacer.interval_us,
+            .probe       = probe,
+            .sent        = sent,
+        };
+        size_t len = csi_traffic_format_report(&report, report_buf, sizeof(report_buf));
+        if (len > 0) {
+            sendto(udp_sock, report_buf, len, 0, (struct sockaddr *)&collector, sizeof(collector));
+            ESP_LOGI(TAG, "%s", report_buf);
+        }
+        sent = 0;
+    }
+}
+
+static void csi_traffic_start(void) {
+    if (s_traffic_task) {
+        return;
+    }
+    csi_rate_feed_rearm(&s_rate_feed);
+    xTaskCreate(csi_traffic_task, "csi_traffic_task", CSI_TRAFFIC_STACK_SIZE, NULL, CSI_TRAFFIC_PRIORITY,
+                &s_traffic_task);
+}
+
+// Opens the clock sync socket towards the collector, with the reply timeout set.
+static int csi_clock_socket(struct sockaddr_in *collector) {
+    memset(collector, 0, sizeof(*collector));
+    collector->sin_family = AF_INET;
+    collector->sin_port = htons(g_csi_server_port);
+    collector->sin_addr.s_addr = inet_addr(g_csi_server_ip);
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create clock sync socket");
+        return -1;
+    }
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = CSI_CLOCK_REPLY_TIMEOUT_MS * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+}
+
+// One CSI_SYNC exchange; the reply, if it arrives in time, goes into s_clock.
+static void csi_clock_exchange(int sock, const struct sockaddr_in *collector, uint32_t seq) {
+    char buf[CSI_CLOCK_MSG_MAX_LEN];
+    int64_t t1 = esp_timer_get_time();
+    size_t len = csi_clock_format_request(seq, t1, buf, sizeof(buf));
+    sendto(sock, buf, len, 0, (const struct sockaddr *)collector, sizeof(*collector));
+    // Replies to requests that already timed out are skipped; a timeout loses the exchange.
+    while (1) {
+        int n = recv(sock, buf, sizeof(buf), 0);
+        int64_t t4 = esp_timer_get_time();
+        if (n < 0) {
+            return;
+        }
+        uint32_t reply_seq;
+        int64_t reply_t1, t2, t3;
+        if (csi_clock_parse_reply(buf, n, &reply_seq, &reply_t1, &t2, &t3) && reply_seq == seq && reply_t1 == t1) {
+            csi_clock_add_exchange(&s_clock, t1, t2, t3, t4);
+            return;
+        }
+    }
+}
+
+static void csi_clock_task(void *pvParameters) {
+    struct sockaddr_in collector;
+    int sock = csi_clock_socket(&collector);
+    if (sock < 0) {
+        vTaskDelete(NULL);
+        return;
+    }
+
+    int32_t radio_offset = 0;
+    bool have_radio_offset = false;
+    char buf[CSI_CLOCK_MSG_MAX_LEN];
+    for (uint32_t seq = 0;; seq++) {
+        csi_clock_exchange(sock, &collector, seq);
+
+        int32_t observed = atomic_exchange(&s_radio_offset_min, INT32_MAX);
+        if (observed != INT32_MAX) {
+            radio_offset = observed;
+            have_radio_offset = true;
+        }
+        // The mapping is anchored on the radio clock, so it needs at least one frame.
+        if (s_clock.valid && have_radio_offset) {
+            csi_clock_report_t report;
+            csi_clock_make_report(&s_clock, radio_offset, &report);
+            size_t len = csi_clock_format_report(&report, buf, sizeof(buf));
+            if (len > 0) {
+                sendto(sock, buf, len, 0, (struct sockaddr *)&collector, sizeof(collector));
+            }
+            if (seq % 60 == 0) {
+                ESP_LOGI(TAG, "%s", buf);
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(seq + 1 < CSI_CLOCK_BURST ? CSI_CLOCK_BURST_SPACING_MS : CSI_CLOCK_PERIOD_MS));
+    }
+}
+
+// Runs one burst of exchanges before a scheduled capture and puts the system time on
+// the shared clock; the RTC keeps it through deep sleep. Returns 1 if synced.
+static int csi_clock_sync_now(void) {
+    struct sockaddr_in collector;
+    int sock = csi_clock_socket(&collector);
+    if (sock < 0) {
+        return 0;
+    }
+    for (uint32_t seq = 0; seq < CSI_CLOCK_BURST; seq++) {
+        csi_clock_exchange(sock, &collector, seq);
+        vTaskDelay(pdMS_TO_TICKS(CSI_CLOCK_BURST_SPACING_MS));
+    }
+    close(sock);
+    if (!s_clock.valid) {
+        return 0;
+    }
+    int64_t shared_us = csi_clock_to_shared(&s_clock, esp_timer_get_time());
+    struct timeval tv = { .tv_sec = shared_us / 1000000, .tv_usec = shared_us % 1000000 };
+    settimeofday(&tv, NULL);
+    return 1;
+}
+
+// Shared time as kept by the system clock; synced by csi_clock_sync_now.
+static int64_t shared_now_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void csi_clock_start(void) {
+    if (s_clock_task) {
+        return;
+    }
+    xTaskCreate(csi_clock_task, "csi_clock_task", CSI_CLOCK_STACK_SIZE, NULL, CSI_CLOCK_PRIORITY, &s_clock_task);
 }
 
 static void start_wifi_ap(void) {
@@ -320,16 +1060,80 @@ static void udp_prov_task(void *pvParameter) {
     vTaskDelete(NULL);
 }
 
-static void start_wifi_sta(const char *ssid, const char *pass, const char *identity, const char *auth_type) {
-    esp_netif_create_default_wifi_sta();
+static uint32_t uptime_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void link_fast_timeout_cb(void *arg) {
+    esp_event_post(CSI_LINK_EVENT, CSI_LINK_EVENT_FAST_TIMEOUT, NULL, 0, 0);
+}
+
+// Carries out an action of the reconnect state machine (csi_link.h).
+static void link_apply(csi_link_action_t action) {
+    const csi_link_retained_t *r = &s_link_retained;
+    switch (action) {
+    case CSI_LINK_ACT_CONNECT_FAST:
+        ESP_LOGI(TAG, "Fast resume: BSSID " MACSTR " on channel %u, static IP", MAC2STR(r->bssid),
+                 (unsigned)r->channel);
+        s_sta_config.sta.bssid_set = true;
+        memcpy(s_sta_config.sta.bssid, r->bssid, sizeof(s_sta_config.sta.bssid));
+        s_sta_config.sta.channel = r->channel;
+        esp_netif_dhcpc_stop(s_sta_netif);
+        esp_wifi_set_config(WIFI_IF_STA, &s_sta_config);
+        break;
+    case CSI_LINK_ACT_CONNECT_FULL:
+        if (s_link.fell_back && s_sta_config.sta.bssid_set) {
+            ESP_LOGW(TAG, "Fast resume failed, falling back to a full connect");
+            esp_timer_stop(s_link_timer);
+            esp_wifi_disconnect();
+        }
+        s_sta_config.sta.bssid_set = false;
+        s_sta_config.sta.channel = 0;
+        esp_wifi_set_config(WIFI_IF_STA, &s_sta_config);
+        esp_netif_dhcpc_start(s_sta_netif);
+        // Before esp_wifi_start the STA_START event connects.
+        if (s_link.fell_back || s_link.attempts > 0) {
+            esp_wifi_connect();
+        }
+        break;
+    case CSI_LINK_ACT_SET_STATIC_IP: {
+        esp_timer_stop(s_link_timer);
+        esp_netif_ip_info_t ip_info = {
+            .ip.addr = r->ip,
+            .netmask.addr = r->netmask,
+            .gw.addr = r->gw,
+        };
+        esp_netif_set_ip_info(s_sta_netif, &ip_info);
+        ESP_LOGI(TAG, "Wi-Fi resumed in %u ms", (unsigned)(uptime_ms() - s_link.marks_ms[CSI_WAKE_WIFI]));
+        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        break;
+    }
+    case CSI_LINK_ACT_READY:
+        ESP_LOGI(TAG, "Wi-Fi connected in %u ms", (unsigned)(uptime_ms() - s_link.marks_ms[CSI_WAKE_WIFI]));
+        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        break;
+    case CSI_LINK_ACT_RECONNECT:
+        esp_wifi_connect();
+        break;
+    case CSI_LINK_ACT_GIVE_UP:
+        ESP_LOGW(TAG, "%d failed connection attempts. Erasing credentials...", CSI_LINK_MAX_ATTEMPTS);
+        erase_wifi_creds_and_restart();
+        break;
+    default:
+        break;
+    }
+}
+
+static void start_wifi_sta(const char *ssid, const char *pass, const char *identity, const char *auth_type,
+                           const char *server_ip, int server_port) {
+    s_sta_netif = esp_netif_create_default_wifi_sta();
     
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
     
-    wifi_config_t sta_config;
-    memset(&sta_config, 0, sizeof(sta_config));
+    memset(&s_sta_config, 0, sizeof(s_sta_config));
     
-    strlcpy((char *)sta_config.sta.ssid, ssid, sizeof(sta_config.sta.ssid));
+    strlcpy((char *)s_sta_config.sta.ssid, ssid, sizeof(s_sta_config.sta.ssid));
 
     if (strcmp(auth_type, "peap") == 0) {
         ESP_LOGI(TAG, "Configuring for WPA2-Enterprise (PEAP) network.");
@@ -339,36 +1143,62 @@ static void start_wifi_sta(const char *ssid, const char *pass, const char *ident
         ESP_ERROR_CHECK(esp_wifi_sta_wpa2_ent_enable());
     } else if (strcmp(auth_type, "wpa2psk") == 0) {
         ESP_LOGI(TAG, "Configuring for WPA2-Personal network.");
-        strlcpy((char *)sta_config.sta.password, pass, sizeof(sta_config.sta.password));
-        sta_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+        strlcpy((char *)s_sta_config.sta.password, pass, sizeof(s_sta_config.sta.password));
+        s_sta_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
     } else {
         ESP_LOGI(TAG, "Configuring for open network.");
-        sta_config.sta.threshold.authmode = WIFI_AUTH_OPEN;
+        s_sta_config.sta.threshold.authmode = WIFI_AUTH_OPEN;
     }
     
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &sta_config));
+    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &s_sta_config));
+
+    // Anything that changes what the retained state was learned with invalidates it.
+    char port[12];
+    snprintf(port, sizeof(port), "%d", server_port);
+    uint32_t creds_hash = CSI_LINK_HASH_INIT;
+    creds_hash = csi_link_hash(creds_hash, ssid);
+    creds_hash = csi_link_hash(creds_hash, pass);
+    creds_hash = csi_link_hash(creds_hash, identity);
+    creds_hash = csi_link_hash(creds_hash, auth_type);
+    creds_hash = csi_link_hash(creds_hash, server_ip);
+    creds_hash = csi_link_hash(creds_hash, port);
+
+    const esp_timer_create_args_t timer_args = { .callback = link_fast_timeout_cb, .name = "csi_link" };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_link_timer));
+    link_apply(csi_link_begin(&s_link, &s_link_retained, creds_hash, (uint32_t)time(NULL), uptime_ms()));
+
     ESP_ERROR_CHECK(esp_wifi_start());
-    ESP_LOGI(TAG, "Connecting to Wi-Fi: %s", ssid);
+    ESP_LOGI(TAG, "Connecting to Wi-Fi: %s (wake %u, %s path)", ssid, (unsigned)s_link_retained.wakes,
+             s_link.fast ? "fast" : "full");
 }
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+    csi_link_info_t info = {0};
+    uint32_t now_s = (uint32_t)time(NULL);
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        if (s_link.phase == CSI_LINK_FAST) {
+            esp_timer_start_once(s_link_timer, CSI_LINK_FAST_TIMEOUT_MS * 1000ULL);
+        }
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        const wifi_event_sta_connected_t *event = event_data;
         ESP_LOGI(TAG, "Wi-Fi connected to AP");
-        wifi_fail_count = 0;
+        memcpy(info.bssid, event->bssid, sizeof(info.bssid));
+        info.channel = event->channel;
+        link_apply(csi_link_on_event(&s_link, CSI_LINK_EV_CONNECTED, &info, now_s, uptime_ms()));
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
+        const ip_event_got_ip_t *event = event_data;
         ESP_LOGI(TAG, "Wi-Fi obtained IP address");
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        info.ip = event->ip_info.ip.addr;
+        info.netmask = event->ip_info.netmask.addr;
+        info.gw = event->ip_info.gw.addr;
+        link_apply(csi_link_on_event(&s_link, CSI_LINK_EV_GOT_IP, &info, now_s, uptime_ms()));
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
         ESP_LOGI(TAG, "Wi-Fi disconnected, attempting to reconnect...");
-        wifi_fail_count++;
-        if (wifi_fail_count >= 15) {
-            ESP_LOGW(TAG, "15 failed connection attempts. Erasing credentials...");
-            erase_wifi_creds_and_restart();
-        }
-        esp_wifi_connect();
+        link_apply(csi_link_on_event(&s_link, CSI_LINK_EV_DISCONNECTED, NULL, now_s, uptime_ms()));
+    } else if (event_base == CSI_LINK_EVENT && event_id == CSI_LINK_EVENT_FAST_TIMEOUT) {
+        link_apply(csi_link_on_event(&s_link, CSI_LINK_EV_TIMEOUT, NULL, now_s, uptime_ms()));
     }
 }
 
@@ -385,49 +1215,235 @@ static void erase_wifi_creds_and_restart(void) {
         nvs_commit(nvs);
         nvs_close(nvs);
     }
+    // A plan belongs to the collector the node was provisioned for.
+    if (nvs_open(CSI_SCHEDULE_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_key(nvs, CSI_SCHEDULE_KEY_PLAN);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
     ESP_LOGI(TAG, "Wi-Fi credentials erased! Restarting...");
     vTaskDelay(1000 / portTICK_PERIOD_MS);
     esp_restart();
 }
 
-static void enter_deep_sleep(uint64_t sleep_time_s) {
-    ESP_LOGI(TAG, "Entering deep sleep for %llu seconds...", sleep_time_s);
+static void enter_deep_sleep_us(uint64_t sleep_time_us) {
+    ESP_LOGI(TAG, "Entering deep sleep for %llu ms...", sleep_time_us / 1000);
     vTaskDelay(100 / portTICK_PERIOD_MS);
-    esp_deep_sleep(sleep_time_s * 1000000ULL);
+    // The delay above lets the log drain; it comes out of the sleep.
+    esp_deep_sleep(sleep_time_us > 100000 ? sleep_time_us - 100000 : 1000);
 }
 
-static int udp_listen_for_start() {
+static void enter_deep_sleep(uint64_t sleep_time_s) {
+    enter_deep_sleep_us(sleep_time_s * 1000000ULL);
+}
+
+// Listens up to window_s seconds for a start command, which fills capture, or a schedule
+// command (csi_schedule.h), which fills plan.
+static node_command_t udp_listen_for_command(int window_s, csi_capture_config_t *capture, csi_schedule_t *plan) {
     int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
     struct sockaddr_in server_addr, source_addr;
     socklen_t socklen = sizeof(source_addr);
-    char rx_buffer[64];
-    int csi_time = 0;
+    char rx_buffer[UDP_START_CMD_MAX_LEN + 64];  // a schedule command wraps a start command
+    node_command_t command = NODE_CMD_NONE;
     if (sock < 0) {
         ESP_LOGE(TAG, "Failed to create UDP socket for start command listener");
-        return 0;
+        return NODE_CMD_NONE;
     }
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(UDP_LISTEN_PORT);
     server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
     bind(sock, (struct sockaddr *)&server_addr, sizeof(server_addr));
-    ESP_LOGI(TAG, "Awaiting 'start' command via UDP on port %d for %d seconds...", UDP_LISTEN_PORT, UDP_LISTEN_WINDOW_S);
+    ESP_LOGI(TAG, "Awaiting 'start' command via UDP on port %d for %d seconds...", UDP_LISTEN_PORT, window_s);
     struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
     setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
     int listen_time = 0;
-    while (listen_time < UDP_LISTEN_WINDOW_S) {
+    while (listen_time < window_s && command == NODE_CMD_NONE) {
         int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0, (struct sockaddr *)&source_addr, &socklen);
         if (len > 0) {
             rx_buffer[len] = 0;
             if (strncmp(rx_buffer, "start,", 6) == 0) {
-                csi_time = atoi(rx_buffer + 6);
-                ESP_LOGI(TAG, "'start' command received: %d seconds", csi_time);
-                break;
+                if (csi_capture_parse_start(rx_buffer, capture) != CSI_CAPTURE_OK) {
+                    ESP_LOGW(TAG, "Ignoring malformed 'start' command: %s", rx_buffer);
+                } else {
+                    command = NODE_CMD_START;
+                    ESP_LOGI(TAG, "'start' command received: %d seconds, subcarrier mask %s, decimation %u, "
+                             "rate %u Hz, %s payload, target %u Hz, %s probes", (int)capture->duration_s,
+                             capture->sc_mask_set ? "set" : "off",
+                             (unsigned)capture->decimation, (unsigned)capture->rate_hz,
+                             capture->payload_mode == CSI_CAPTURE_MODE_AMPLITUDE ? "amplitude" : "raw",
+                             (unsigned)(capture->target_hz ? capture->target_hz : CONFIG_SEND_FREQUENCY),
+                             capture->probe == CSI_TRAFFIC_PROBE_UDP ? "UDP" : "ICMP");
+                }
+            } else if (strncmp(rx_buffer, CSI_SCHEDULE_COMMAND_PREFIX, strlen(CSI_SCHEDULE_COMMAND_PREFIX)) == 0) {
+                int rc = csi_schedule_parse(rx_buffer, plan);
+                if (rc == CSI_SCHEDULE_OK) {
+                    command = NODE_CMD_SCHEDULE;
+                    ESP_LOGI(TAG, "'schedule' command received: plan %u, %u windows of %u s every %u s",
+                             (unsigned)plan->id, (unsigned)plan->count, (unsigned)plan->duration_s,
+                             (unsigned)plan->interval_s);
+                } else if (rc == CSI_SCHEDULE_CANCEL) {
+                    command = NODE_CMD_CANCEL;
+                } else {
+                    ESP_LOGW(TAG, "Ignoring malformed 'schedule' command (%d): %s", rc, rx_buffer);
+                }
             }
         }
         listen_time++;
     }
     close(sock);
-    return csi_time;
+    return command;
+}
+
+// Starts the capture tasks (once per boot) and captures for duration_ms.
+static void run_capture(uint32_t duration_ms) {
+    csi_link_mark(&s_link, CSI_WAKE_START, uptime_ms());
+    ESP_LOGI(TAG, "Initiating CSI acquisition for %u ms", (unsigned)duration_ms);
+    csi_clock_start();
+    csi_sender_start();
+    wifi_csi_init();
+    csi_traffic_start();
+    vTaskDelay(pdMS_TO_TICKS(duration_ms));
+    ESP_LOGI(TAG, "CSI acquisition finished.");
+}
+
+// Sends the CSI_SCHED report of the plan's next window (csi_schedule.h).
+static void schedule_report(uint32_t index, int64_t start_us) {
+    csi_schedule_report_t report = {
+        .id = s_plan.id,
+        .index = index,
+        .count = s_plan.count,
+        .start_us = start_us,
+    };
+    char buf[CSI_SCHEDULE_REPORT_MAX_LEN];
+    size_t len = csi_schedule_format_report(&report, buf, sizeof(buf));
+    if (len > 0) {
+        send_csi_udp(buf, len);
+    }
+}
+
+// Makes plan the current one, in RTC memory and NVS; a plan with count 0 clears it.
+static void schedule_store(const csi_schedule_t *plan) {
+    s_plan = *plan;
+    nvs_handle_t nvs;
+    if (nvs_open(CSI_SCHEDULE_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS for the acquisition plan");
+        return;
+    }
+    if (plan->count) {
+        nvs_set_blob(nvs, CSI_SCHEDULE_KEY_PLAN, plan, sizeof(*plan));
+    } else {
+        nvs_erase_key(nvs, CSI_SCHEDULE_KEY_PLAN);
+    }
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void schedule_load(void) {
+    if (s_plan.count) {
+        return;  // the RTC copy survived deep sleep
+    }
+    nvs_handle_t nvs;
+    size_t len = sizeof(s_plan);
+    if (nvs_open(CSI_SCHEDULE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs, CSI_SCHEDULE_KEY_PLAN, &s_plan, &len) != ESP_OK || len != sizeof(s_plan)) {
+        memset(&s_plan, 0, sizeof(s_plan));
+    }
+    nvs_close(nvs);
+}
+
+static void schedule_cancel(void) {
+    const csi_schedule_t none = { .id = s_plan.id };
+    ESP_LOGI(TAG, "Acquisition plan %u cancelled", (unsigned)s_plan.id);
+    schedule_store(&none);
+    schedule_report(0, 0);
+}
+
+// Lead for the wake before the window at start_us. If the retained connection state
+// will have expired by then, the wake needs a full connect: allow the most.
+static uint32_t schedule_lead_ms(int64_t start_us) {
+    uint32_t wake_s = (uint32_t)((start_us - (int64_t)CSI_SCHEDULE_MAX_LEAD_MS * 1000) / 1000000);
+    if (!csi_link_retained_valid(&s_link_retained, s_link_retained.creds_hash, wake_s)) {
+        return CSI_SCHEDULE_MAX_LEAD_MS;
+    }
+    return s_plan_lead_ms;
+}
+
+// Runs the current plan for this wake: syncs, then either deep sleeps until shortly
+// before the next window or captures it. Never returns.
+static void run_schedule(void) {
+    uint32_t sync_start_ms = uptime_ms();
+    if (!csi_clock_sync_now()) {
+        ESP_LOGW(TAG, "Clock sync failed; scheduling on the RTC time");
+    }
+    // Boot to address plus the sync; a listen window before it does not count.
+    uint32_t ready_ms = s_link.marks_ms[CSI_WAKE_IP] + (uptime_ms() - sync_start_ms);
+    s_plan_lead_ms = csi_schedule_lead_ms(s_plan_lead_ms, ready_ms);
+
+    uint32_t index;
+    int64_t start_us, now_us = shared_now_us();
+    if (!csi_schedule_window(&s_plan, now_us, &index, &start_us)) {
+        ESP_LOGI(TAG, "Acquisition plan %u finished", (unsigned)s_plan.id);
+        schedule_report(s_plan.count, 0);
+        const csi_schedule_t none = { .id = s_plan.id };
+        schedule_store(&none);
+        esp_wifi_stop();
+        enter_deep_sleep(DEEP_SLEEP_INTERVAL_S);
+    }
+    schedule_report(index, start_us);
+    uint32_t lead_ms = schedule_lead_ms(start_us);
+    uint64_t sleep_us = csi_schedule_sleep_us(now_us, start_us, lead_ms);
+    if (sleep_us > 0) {
+        ESP_LOGI(TAG, "Window %u/%u of plan %u in %lld ms (lead %u ms)", (unsigned)index + 1,
+                 (unsigned)s_plan.count, (unsigned)s_plan.id, (start_us - now_us) / 1000, (unsigned)lead_ms);
+        esp_wifi_stop();
+        enter_deep_sleep_us(sleep_us);
+    }
+
+    // Within the lead: wait for the exact start, or join a window that is already open.
+    if (start_us > now_us) {
+        vTaskDelay(pdMS_TO_TICKS((start_us - now_us) / 1000));
+    }
+    csi_capture_parse_start(s_plan.start, &s_capture_cfg);
+    int64_t end_us = start_us + (int64_t)s_plan.duration_s * 1000000;
+    now_us = shared_now_us();
+    if (end_us > now_us) {
+        ESP_LOGI(TAG, "Window %u/%u of plan %u, %lld ms late", (unsigned)index + 1, (unsigned)s_plan.count,
+                 (unsigned)s_plan.id, (now_us - start_us) / 1000);
+        run_capture((uint32_t)((end_us - now_us) / 1000));
+        esp_wifi_set_csi(false);
+    } else {
+        // A failed sync or an overslept wait: the window closed before it could start.
+        ESP_LOGW(TAG, "Window %u/%u of plan %u already closed %lld ms ago; skipped", (unsigned)index + 1,
+                 (unsigned)s_plan.count, (unsigned)s_plan.id, (now_us - end_us) / 1000);
+    }
+
+    // Announce the next window, then give the collector a chance to change the plan.
+    uint32_t next;
+    int64_t next_start_us;
+    if (!csi_schedule_window(&s_plan, end_us, &next, &next_start_us)) {
+        next = s_plan.count;
+        next_start_us = 0;
+    }
+    schedule_report(next, next_start_us);
+    csi_schedule_t plan;
+    csi_capture_config_t capture;
+    node_command_t command = udp_listen_for_command(CSI_SCHEDULE_LISTEN_S, &capture, &plan);
+    if (command == NODE_CMD_SCHEDULE && plan.id != s_plan.id) {
+        schedule_store(&plan);
+    } else if (command == NODE_CMD_CANCEL) {
+        schedule_cancel();
+    }
+    esp_wifi_stop();
+    now_us = shared_now_us();
+    if (s_plan.count && csi_schedule_window(&s_plan, now_us, &next, &next_start_us)) {
+        // Still synced: sleep straight to the next window's lead.
+        sleep_us = csi_schedule_sleep_us(now_us, next_start_us, schedule_lead_ms(next_start_us));
+        enter_deep_sleep_us(sleep_us ? sleep_us : 1000);
+    }
+    // Done or cancelled; the next wake reports it and returns to the start command cycle.
+    enter_deep_sleep_us(s_plan.count ? 1000 : DEEP_SLEEP_INTERVAL_S * 1000000ULL);
 }
 
 static void check_for_factory_reset_request(void) {
@@ -522,8 +1538,10 @@ void app_main()
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     
     s_wifi_event_group = xEventGroupCreate();
+    s_csi_sock_lock = xSemaphoreCreateMutex();
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(CSI_LINK_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
 
     if (load_wifi_creds(ssid, pass, identity, auth_type, server_ip, &server_port) == ESP_OK) {
         strlcpy(g_csi_server_ip, server_ip, sizeof(g_csi_server_ip));
@@ -531,19 +1549,28 @@ void app_main()
 
         xTaskCreate(send_ip_broadcast_task, "ip_broadcast_task", 4096, NULL, 5, NULL);
 
+        schedule_load();
+        csi_clock_init(&s_clock);
         while (1) {
-            start_wifi_sta(ssid, pass, identity, auth_type);
+            start_wifi_sta(ssid, pass, identity, auth_type, server_ip, server_port);
             xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
-            int csi_time = udp_listen_for_start();
-            if (csi_time > 0) {
-                ESP_LOGI(TAG, "Initiating CSI acquisition for %d seconds", csi_time);
-                wifi_csi_init();
-                wifi_ping_router_start();
-                vTaskDelay(csi_time * 1000 / portTICK_PERIOD_MS);
-                ESP_LOGI(TAG, "CSI acquisition finished. Entering deep sleep.");
+            if (s_plan.count) {
+                run_schedule();
+            }
+            csi_schedule_t plan;
+            node_command_t command = udp_listen_for_command(UDP_LISTEN_WINDOW_S, &s_capture_cfg, &plan);
+            if (command == NODE_CMD_SCHEDULE) {
+                schedule_store(&plan);
+                run_schedule();
+            } else if (command == NODE_CMD_START) {
+                run_capture(s_capture_cfg.duration_s * 1000);
+                ESP_LOGI(TAG, "Entering deep sleep.");
                 esp_wifi_stop();
                 enter_deep_sleep(DEEP_SLEEP_INTERVAL_S);
             } else {
+                if (command == NODE_CMD_CANCEL) {
+                    schedule_cancel();
+                }
                 ESP_LOGI(TAG, "No 'start' command received. Entering deep sleep.");
                 esp_wifi_stop();
                 enter_deep_sleep(DEEP_SLEEP_INTERVAL_S);